@@ -0,0 +1,205 @@
+// Cold loads of a large agent: load time and peak RSS for the streaming .af
+// importer, the binary snapshot, and (at the smaller size) a DOM parse of
+// the whole document, each in a fresh child process so peaks do not mix.
+#include "AgentFile.hpp"
+#include "AgentSnapshot.hpp"
+#include "Log.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct PhaseResult {
+    double seconds = 0;
+    double peak_mb = 0;
+    size_t messages = 0;
+};
+
+std::string corpus() {
+    static const char* words[] = {"agent", "memory", "block", "the", "archival", "passage", "of", "embedding",
+                                  "token", "a", "context", "window", "tool", "call", "summary", "recall"};
+    std::string text;
+    uint32_t state = 7;
+    while (text.size() < (1 << 20)) {
+        state = state * 1103515245 + 12345;
+        text += words[(state >> 16) % 16];
+        text += ' ';
+    }
+    return text;
+}
+
+// A user / assistant-with-tool-call / tool cycle, 100 B to 4 KB of text each
+json message(size_t i, const std::string& text) {
+    uint32_t h = static_cast<uint32_t>(i * 2654435761u);
+    std::string body = text.substr(h % (text.size() - 4096), 100 + h % 4000);
+    json m = {{"id", "message-" + std::to_string(i)}, {"created_at", "2025-01-01T00:00:00Z"},
+              {"model", "gpt-4o-mini"}, {"name", nullptr}, {"tool_call_id", nullptr}, {"tool_calls", nullptr}};
+    std::string call_id = "call_" + std::to_string(i / 3);
+    switch (i % 3) {
+    case 0:
+        m["role"] = "user";
+        m["content"] = json::array({{{"type", "text"}, {"text", body}}});
+        break;
+    case 1:
+        m["role"] = "assistant";
+        m["content"] = json::array({{{"type", "text"}, {"text", "thinking"}}});
+        m["tool_calls"] = json::array({{{"id", call_id}, {"type", "function"},
+                                        {"function", {{"name", "send_message"},
+                                                      {"arguments", json{{"message", body}}.dump()}}}}});
+        break;
+    default:
+        m["role"] = "tool";
+        m["content"] = json::array({{{"type", "text"}, {"text", "{\"status\":\"OK\"}"}}});
+        m["tool_call_id"] = call_id;
+        m["name"] = "send_message";
+    }
+    return m;
+}
+
+// Stream an .af document of about `bytes`, every message in context
+void generate(const std::string& path, size_t bytes) {
+    std::string text = corpus();
+    size_t count = 0;
+    for (size_t total = 0; total < bytes; ++count) total += message(count, text).dump().size() + 12;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << "{\"agent_type\":\"memgpt_agent\",\"core_memory\":["
+        << "{\"label\":\"persona\",\"value\":\"I am Sam.\",\"limit\":5000,\"read_only\":false},"
+        << "{\"label\":\"human\",\"value\":\"Name: Chad\",\"limit\":5000,\"read_only\":false}],"
+        << "\"in_context_message_indices\":[";
+    for (size_t i = 0; i < count; ++i) out << (i ? "," : "") << i;
+    out << "],\"llm_config\":{\"model\":\"gpt-4o-mini\",\"context_window\":128000},\"messages\":[";
+    for (size_t i = 0; i < count; ++i) out << (i ? "," : "") << message(i, text).dump();
+    out << "],\"name\":\"sam\",\"system\":\"You are Sam.\",\"tools\":[]}";
+}
+
+// Evict a file from the page cache so the next read comes from disk
+void dropCache(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+size_t fileMb(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return static_cast<size_t>(in.tellg()) >> 20;
+}
+
+// Run `phase` in a child; it returns the message count and times itself
+PhaseResult inChild(const std::function<size_t(double& seconds)>& phase) {
+    int fds[2];
+    if (::pipe(fds) != 0) return {};
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::close(fds[0]);
+        PhaseResult result;
+        result.messages = phase(result.seconds);
+        rusage usage{};
+        ::getrusage(RUSAGE_SELF, &usage);
+        result.peak_mb = usage.ru_maxrss / 1024.0;
+        ssize_t written = ::write(fds[1], &result, sizeof(result));
+        ::_exit(written == sizeof(result) ? 0 : 1);
+    }
+    ::close(fds[1]);
+    PhaseResult result;
+    if (::read(fds[0], &result, sizeof(result)) != sizeof(result)) result.seconds = -1;
+    ::close(fds[0]);
+    ::waitpid(pid, nullptr, 0);
+    return result;
+}
+
+template <typename F>
+size_t timed(double& seconds, F load) {
+    auto start = Clock::now();
+    size_t messages = load();
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return messages;
+}
+
+void report(const char* name, size_t mb, const PhaseResult& r) {
+    if (r.seconds < 0) {
+        std::printf("%-26s failed\n", name);
+        return;
+    }
+    if (mb == 0) {
+        std::printf("%-26s %9s %9s %12.0f\n", name, "-", "-", r.peak_mb);
+        return;
+    }
+    std::printf("%-26s %9.2f %9.0f %12.0f %10zu\n", name, r.seconds, mb / r.seconds, r.peak_mb, r.messages);
+}
+
+void run(const std::string& dir, size_t megabytes, bool dom) {
+    std::string prefix = dir + "/letta-agentfile-bench-" + std::to_string(getpid());
+    std::string af = prefix + ".af";
+    std::string snap = prefix + ".snap";
+    std::string exported = prefix + "-export.af";
+    generate(af, megabytes << 20);
+    size_t mb = fileMb(af);
+    std::printf("\n%zu MB agent file\n%-26s %9s %9s %12s %10s\n", mb, "", "seconds", "MB/s", "peak RSS MB",
+                "messages");
+
+    report("baseline process", 0, inChild([](double&) { return size_t{0}; }));
+    dropCache(af);
+    report(".af streaming import", mb, inChild([&](double& seconds) {
+        return timed(seconds, [&] { return AgentFile::read(af).messages.size(); });
+    }));
+    if (dom) {
+        report(".af DOM parse + convert", mb, inChild([&](double& seconds) {
+            return timed(seconds, [&] {
+                std::ifstream in(af, std::ios::binary);
+                json document = json::parse(in);
+                MessageStore store;
+                for (const auto& m : document["messages"]) AgentFile::appendMessage(store, m);
+                return store.size();
+            });
+        }));
+    }
+    report(".af export", mb, inChild([&](double& seconds) {
+        AgentState state = AgentFile::read(af);
+        return timed(seconds, [&] {
+            AgentFile::write(exported, state);
+            return state.messages.size();
+        });
+    }));
+    report("snapshot write", mb, inChild([&](double& seconds) {
+        AgentState state = AgentFile::read(af);
+        return timed(seconds, [&] {
+            AgentSnapshot::write(snap, state);
+            return state.messages.size();
+        });
+    }));
+    std::printf("  (snapshot is %zu MB)\n", fileMb(snap));
+    auto load = [&](double& seconds) {
+        return timed(seconds, [&] { return AgentSnapshot::read(snap).messages.size(); });
+    };
+    dropCache(snap);
+    report("snapshot load (cold)", mb, inChild(load));
+    report("snapshot load (warm)", mb, inChild(load));
+    ::unlink(af.c_str());
+    ::unlink(snap.c_str());
+    ::unlink(exported.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 1024;
+    std::string dir = argc > 2 ? argv[2] : "/tmp";
+    Log::setLevel(LogLevel::Off);
+
+    // The DOM parse holds the whole document as a json tree, so it only runs
+    // at a size that fits comfortably
+    run(dir, std::min<size_t>(megabytes, 128), true);
+    if (megabytes > 128) run(dir, megabytes, false);
+    return 0;
+}
@@ -0,0 +1,167 @@
+// Compressed request transport: bytes on the wire and end-to-end step latency
+// against a local stand-in server behind a constrained egress link.
+//
+// First the codecs themselves on serialized agent histories (the numbers
+// adaptiveLevel's tables come from), then whole chatCompletion calls. The
+// stand-in charges each request its upload time at the link's rate, decodes
+// the body as a real server would, and answers in the coding the client
+// accepts. Compared: identity, fixed levels, and the adaptive level.
+#include "Compression.hpp"
+#include "LLMClient.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Chat-like prose with JSON fragments, escapes and non-ASCII
+std::string prose(size_t bytes, std::mt19937& rng) {
+    static const char* words[] = {"the", "user", "asked", "about", "their", "trip", "to", "Zürich", "and",
+                                  "I", "remembered", "that", "they", "prefer", "tea", "\"quoted\"", "line\n",
+                                  "{\"status\":\"OK\",\"message\":\"None\"}", "archival", "memory", "search",
+                                  "results", "2026-10-19T08:00:19Z", "café", "42", "because", "notes"};
+    std::string out;
+    while (out.size() < bytes) {
+        if (!out.empty()) out += ' ';
+        out += words[rng() % (sizeof(words) / sizeof(words[0]))];
+    }
+    return out;
+}
+
+// An agent history of roughly `bytes`: a system prompt with memory blocks,
+// then user turns, tool calls and tool results
+MessageStore history(size_t bytes) {
+    std::mt19937 rng(7);
+    MessageStore store;
+    store.append(MessageRole::System, prose(std::min<size_t>(bytes / 4, 24000), rng));
+    size_t turn = 0;
+    while (store.memoryBytes() < bytes) {
+        store.append(MessageRole::User, prose(200 + rng() % 600, rng));
+        std::string id = "call_" + std::to_string(turn++);
+        json args = {{"query", prose(40, rng)}, {"page", static_cast<int>(rng() % 5)}};
+        std::string arguments = args.dump();
+        store.appendAssistant("", {ToolCallView{id, "archival_memory_search", arguments}});
+        json result = {{"status", "OK"}, {"message", prose(1500 + rng() % 3000, rng)}};
+        store.appendToolResult(id, "archival_memory_search", result.dump());
+    }
+    return store;
+}
+
+void codecTable(const char* label, const std::string& body) {
+    std::printf("%s (%.1f KB)\n", label, body.size() / 1e3);
+    struct Row { ContentCoding coding; std::vector<int> levels; };
+    std::vector<Row> rows = {{ContentCoding::Gzip, {1, 3, 6, 9}}};
+    if (codingSupported(ContentCoding::Zstd)) rows.push_back({ContentCoding::Zstd, {1, 3, 6, 9, 12, 15}});
+    for (const Row& row : rows) {
+        for (int level : row.levels) {
+            auto start = Clock::now();
+            std::string packed = encode(row.coding, body, level);
+            double encode_s = std::chrono::duration<double>(Clock::now() - start).count();
+            start = Clock::now();
+            std::string back = decode(row.coding, packed);
+            double decode_s = std::chrono::duration<double>(Clock::now() - start).count();
+            if (back != body) std::printf("  round trip mismatch!\n");
+            std::printf("  %-4s %2d  %7.1f MB/s  ratio %5.2f  decode %7.1f MB/s\n", codingName(row.coding), level,
+                        body.size() / encode_s / 1e6, static_cast<double>(body.size()) / packed.size(),
+                        body.size() / decode_s / 1e6);
+        }
+    }
+}
+
+// Stand-in server: the request pays its upload time on a link of
+// `link_bytes_per_sec`, a fixed think time, and its body is decoded
+HttpTransport makeStandIn(double link_bytes_per_sec, size_t& wire_bytes) {
+    return [link_bytes_per_sec, &wire_bytes](const HttpRequest& req, const std::atomic<bool>&) {
+        wire_bytes += req.body.size() + req.url.size();
+        for (const auto& [key, value] : req.headers) wire_bytes += key.size() + value.size() + 4;
+        std::this_thread::sleep_for(std::chrono::duration<double>(req.body.size() / link_bytes_per_sec));
+
+        auto encoding = req.headers.find("Content-Encoding");
+        ContentCoding coding = encoding == req.headers.end() ? ContentCoding::Identity : parseCoding(encoding->second);
+        std::string body = decode(coding, req.body);
+        if (body.back() != '}') return HttpResponse{400, "bad body", "", {}};
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        json message = {{"role", "assistant"}, {"content", std::string(2000, 'x')}};
+        std::string reply = json{{"choices", {{{"message", message}}}}}.dump();
+        auto accept = req.headers.find("Accept-Encoding");
+        if (accept == req.headers.end()) return HttpResponse{200, reply, "", {}};
+        ContentCoding back = pickCoding(accept->second, ContentCoding::Gzip);
+        return HttpResponse{200, encode(back, reply), "", {{"Content-Encoding", codingName(back)}}};
+    };
+}
+
+struct Variant {
+    const char* name;
+    bool enabled;
+    ContentCoding coding;
+    int level;
+};
+
+void endToEnd(const MessageStore& messages, double link, int rounds) {
+    size_t body = LLMClient("key", "http://stand-in/v1", "bench-model").prepareRequest(messages).body.size();
+    std::printf("\n%.1f KB request, %.1f MB/s egress\n", body / 1e3, link / 1e6);
+    std::vector<Variant> variants = {
+        {"identity", false, ContentCoding::Identity, 0},
+        {"gzip-1", true, ContentCoding::Gzip, 1},
+        {"gzip-6", true, ContentCoding::Gzip, 6},
+        {"gzip adaptive", true, ContentCoding::Gzip, 0},
+    };
+    if (codingSupported(ContentCoding::Zstd)) {
+        variants.push_back({"zstd-1", true, ContentCoding::Zstd, 1});
+        variants.push_back({"zstd-12", true, ContentCoding::Zstd, 12});
+        variants.push_back({"zstd adaptive", true, ContentCoding::Zstd, 0});
+    }
+    double baseline = 0;
+    for (const Variant& v : variants) {
+        LLMClient client("key", "http://stand-in/v1", "bench-model");
+        RequestScheduler scheduler;
+        client.setScheduler(scheduler);
+        CompressionPolicy policy;
+        policy.enabled = v.enabled;
+        policy.coding = v.coding;
+        policy.level = v.level;
+        policy.egress_bytes_per_sec = link;
+        client.setCompressionPolicy(policy);
+        size_t wire = 0;
+        client.setTransport(makeStandIn(link, wire));
+
+        int level = v.enabled ? v.level : 0;
+        if (v.enabled && !level) level = adaptiveLevel(v.coding, messages.memoryBytes(), cpuHeadroom(), link);
+        double total = 0;
+        for (int i = 0; i < rounds; ++i) {
+            auto start = Clock::now();
+            json response = client.chatCompletion(messages);
+            total += std::chrono::duration<double>(Clock::now() - start).count();
+            if (response.contains("error")) std::printf("  %s: %s\n", v.name, response["error"].dump().c_str());
+        }
+        double ms = total / rounds * 1e3;
+        if (!v.enabled) baseline = ms;
+        std::printf("  %-14s level %2d  %9.1f KB/request  %8.1f ms/step  %5.2fx\n", v.name, level,
+                    wire / 1e3 / rounds, ms, baseline / ms);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+
+    MessageStore small = history(100 * 1000);
+    MessageStore large = history(4 * 1000 * 1000);
+    LLMClient client("key", "http://stand-in/v1", "bench-model");
+    codecTable("serialized history", client.prepareRequest(small).body);
+    std::printf("\n");
+    codecTable("serialized history", client.prepareRequest(large).body);
+
+    std::printf("\ncpu headroom %.2f\n", cpuHeadroom());
+    for (double link : {2.5e6, 12.5e6, 125e6}) {
+        endToEnd(small, link, rounds * 4);
+        endToEnd(large, link, rounds);
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Embedding client throughput and cache hit rate against a local stand-in
+// server with per-request latency, for a Zipf-distributed query mix issued
+// from many threads: no batching or cache, batching only, batching plus the
+// LRU, and the LRU with a small memory tier backed by the disk tier.
+#include "EmbeddingClient.hpp"
+#include "Log.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// OpenAI-style /embeddings that sleeps `latency` per request, whatever its
+// size, like a remote provider dominated by round trips
+HttpTransport standIn(std::chrono::microseconds latency, std::atomic<uint64_t>& inputs) {
+    return [latency, &inputs](const HttpRequest& req, const std::atomic<bool>&) {
+        std::this_thread::sleep_for(latency);
+        json body = json::parse(req.body);
+        json data = json::array();
+        const json& input = body["input"];
+        inputs += input.size();
+        for (size_t i = 0; i < input.size(); ++i) {
+            std::vector<float> v(256);
+            uint64_t h = 1469598103934665603ull;
+            for (char c : input[i].get<std::string>()) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            for (size_t d = 0; d < v.size(); ++d) v[d] = static_cast<float>((h >> (d % 56)) & 0xFF) / 255.0f;
+            data.push_back({{"index", i}, {"embedding", v}});
+        }
+        return HttpResponse{200, json{{"data", data}}.dump(), "", {}};
+    };
+}
+
+// Query ids with P(rank k) ~ 1/k^s over `distinct` queries
+std::vector<size_t> zipf(size_t count, size_t distinct, double s, uint32_t seed) {
+    std::vector<double> weights(distinct);
+    for (size_t k = 0; k < distinct; ++k) weights[k] = 1.0 / std::pow(static_cast<double>(k + 1), s);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+    std::mt19937 rng(seed);
+    std::vector<size_t> ids(count);
+    for (auto& id : ids) id = pick(rng);
+    return ids;
+}
+
+void run(const char* name, size_t threads, size_t per_thread, size_t distinct, EmbeddingCacheOptions cache,
+         EmbeddingBatchPolicy policy) {
+    std::atomic<uint64_t> inputs{0};
+    RequestScheduler scheduler; // the shared one would throttle to real provider limits
+    EmbeddingClient client("sk-bench", "https://api.openai.com/v1", "text-embedding-3-small", cache);
+    client.setScheduler(scheduler);
+    client.setTransport(standIn(std::chrono::milliseconds(20), inputs));
+    client.setBatchPolicy(policy);
+
+    std::vector<std::thread> pool;
+    auto start = Clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            for (size_t id : zipf(per_thread, distinct, 1.1, static_cast<uint32_t>(t + 1))) {
+                client.embed("what did the user say about topic " + std::to_string(id) + "?");
+            }
+        });
+    }
+    for (auto& t : pool) t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t total = threads * per_thread;
+    std::printf("%-32s %10.0f %9.1f%% %9llu %10.1f\n", name, total / seconds,
+                100.0 * client.hits() / total, static_cast<unsigned long long>(client.requests()),
+                client.requests() ? static_cast<double>(inputs) / client.requests() : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t threads = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 32;
+    size_t per_thread = argc > 2 ? static_cast<size_t>(std::atol(argv[2])) : 100;
+    size_t distinct = 2000;
+    Log::setLevel(LogLevel::Off);
+
+    std::printf("%zu threads x %zu queries, %zu distinct (zipf 1.1), 20 ms per request\n", threads, per_thread,
+                distinct);
+    std::printf("%-32s %10s %10s %9s %10s\n", "", "embeds/s", "hit rate", "requests", "per req");
+
+    EmbeddingBatchPolicy unbatched;
+    unbatched.window = std::chrono::microseconds(0);
+    unbatched.max_batch = 1;
+    EmbeddingBatchPolicy batched;
+    batched.window = std::chrono::milliseconds(2);
+
+    run("no batching, no cache", threads, per_thread, distinct, {0, 1, ""}, unbatched);
+    run("batching", threads, per_thread, distinct, {0, 1, ""}, batched);
+    run("batching + LRU", threads, per_thread, distinct, {}, batched);
+
+    // A memory tier far smaller than the working set leans on the disk tier
+    std::string disk = "/tmp/letta-embedding-bench-" + std::to_string(getpid()) + ".bin";
+    ::unlink(disk.c_str());
+    run("batching + 64-entry LRU + disk", threads, per_thread, distinct, {64, 16, disk}, batched);
+    ::unlink(disk.c_str());
+    return 0;
+}
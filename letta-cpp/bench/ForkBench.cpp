@@ -0,0 +1,122 @@
+// Branch one long conversation into many variants: Agent::fork (shared frozen
+// history, copy-on-write memory) vs deep copies of the history, then let every
+// branch take a turn so they diverge.
+#include "Agent.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+HttpResponse geminiCall(const std::string& name, const json& args) {
+    json call = {{"name", name}, {"args", args}};
+    json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+    return HttpResponse{200, body.dump(), "", {}};
+}
+
+// Resident set size in bytes
+size_t rss() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * 4096;
+}
+
+double percentile(std::vector<double> samples, double q) {
+    std::sort(samples.begin(), samples.end());
+    return samples[static_cast<size_t>(q * (samples.size() - 1))];
+}
+
+void report(const char* name, const std::vector<double>& us, size_t bytes, int copies) {
+    double total = 0;
+    for (double v : us) total += v;
+    std::printf("%-22s %10.2f %10.2f %12.1f %14.1f\n", name, total / us.size(), percentile(us, 0.99),
+                total / 1000.0, bytes / 1024.0 / copies);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int history = argc > 1 ? std::atoi(argv[1]) : 10000;
+    int copies = argc > 2 ? std::atoi(argv[2]) : 1000;
+    int threads = argc > 3 ? std::atoi(argv[3]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    Log::setLevel(LogLevel::Off);
+
+    // Grow a real agent to `history` messages: each turn is user, assistant
+    // tool call and tool result
+    Agent parent("key");
+    parent.setMessageHandler([](const std::string&) {});
+    parent.getLLMClient().setTransport([](const HttpRequest&, const std::atomic<bool>&) {
+        return geminiCall("send_message", {{"message", "Here is a reasonably sized reply to keep the history realistic."}});
+    });
+    for (int turn = 0; parent.getMessages().size() < static_cast<size_t>(history); ++turn) {
+        parent.step("user message number " + std::to_string(turn) + " with some padding text to look like a question");
+    }
+    std::printf("parent history: %zu messages, %.1f KB\n", parent.getMessages().size(),
+                parent.getMessages().memoryBytes() / 1024.0);
+    std::printf("%-22s %10s %10s %12s %14s\n", "", "mean us", "p99 us", "total ms", "KB per copy");
+
+    {
+        // What branching cost before: copying the columns and pool outright
+        MessageStore flat;
+        for (size_t m = 0; m < parent.getMessages().size(); ++m) flat.append(parent.getMessages()[m]);
+        std::vector<MessageStore> deep;
+        deep.reserve(copies);
+        std::vector<double> us;
+        size_t before = rss();
+        for (int i = 0; i < copies; ++i) {
+            auto start = Clock::now();
+            deep.push_back(flat);
+            us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        report("deep copy (history)", us, rss() - before, copies);
+    }
+
+    std::vector<std::unique_ptr<Agent>> forks;
+    forks.reserve(copies);
+    {
+        std::vector<double> us;
+        size_t before = rss();
+        for (int i = 0; i < copies; ++i) {
+            auto start = Clock::now();
+            forks.push_back(parent.fork());
+            us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        report("Agent::fork", us, rss() - before, copies);
+    }
+
+    // Every fork takes one turn (memory edit + reply) on `threads` threads
+    {
+        size_t before = rss();
+        auto start = Clock::now();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                for (int i = t; i < copies; i += threads) {
+                    Agent& fork = *forks[i];
+                    int calls = 0;
+                    fork.getLLMClient().setTransport([&calls, i](const HttpRequest&, const std::atomic<bool>&) {
+                        if (calls++ == 0) {
+                            return geminiCall("core_memory_append", {{"label", "human"}, {"content", "variant " + std::to_string(i)}});
+                        }
+                        return geminiCall("send_message", {{"message", "ok"}});
+                    });
+                    fork.step("variant " + std::to_string(i));
+                }
+            });
+        }
+        for (auto& t : pool) t.join();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        size_t unshared = 0;
+        for (auto& fork : forks) unshared += fork->getMessages().unsharedBytes();
+        std::printf("\none diverging turn per fork on %d threads: %.1f ms, +%.1f KB RSS per fork, "
+                    "%.1f KB unshared history per fork\n", threads, ms, (rss() - before) / 1024.0 / copies,
+                    unshared / 1024.0 / copies);
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Tail-latency benchmark for LLMClient request hedging.
+//
+// A stand-in transport answers in ~base_ms, but a fraction of requests hit a
+// latency spike. We compare p50/p99 and request amplification with hedging
+// disabled and enabled.
+#include "LLMClient.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct StandInConfig {
+    int base_ms = 5;
+    int spike_ms = 150;
+    double spike_rate = 0.05;
+};
+
+HttpTransport makeStandIn(const StandInConfig& cfg, std::atomic<uint64_t>& sent) {
+    auto rng = std::make_shared<std::mt19937>(42);
+    auto rng_mutex = std::make_shared<std::mutex>();
+    return [cfg, rng, rng_mutex, &sent](const HttpRequest&, const std::atomic<bool>& cancelled) {
+        sent++;
+        double roll, jitter;
+        {
+            std::lock_guard<std::mutex> lock(*rng_mutex);
+            roll = std::uniform_real_distribution<double>(0, 1)(*rng);
+            jitter = std::uniform_real_distribution<double>(0.8, 1.2)(*rng);
+        }
+        int ms = static_cast<int>((roll < cfg.spike_rate ? cfg.spike_ms : cfg.base_ms) * jitter);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        while (std::chrono::steady_clock::now() < deadline) {
+            if (cancelled.load()) return HttpResponse{0, "", "cancelled"};
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        json body = {{"choices", {{{"message", {
+            {"role", "assistant"},
+            {"tool_calls", {{{"id", "c"}, {"type", "function"},
+                {"function", {{"name", "send_message"}, {"arguments", "{\"message\":\"hi\"}"}}}}}}
+        }}}}}};
+        return HttpResponse{200, body.dump(), ""};
+    };
+}
+
+void run(const char* label, bool hedged, int iterations, const StandInConfig& cfg) {
+    std::atomic<uint64_t> sent{0};
+    LLMClient client("key", "http://stand-in/v1", "bench-model");
+    client.setTransport(makeStandIn(cfg, sent));
+
+    HedgingPolicy policy;
+    policy.enabled = hedged;
+    policy.percentile = 0.95;
+    policy.min_delay = std::chrono::milliseconds(1);
+    policy.initial_delay = std::chrono::milliseconds(cfg.base_ms * 3);
+    client.setHedgingPolicy(policy);
+
+    std::vector<json> messages = {{{"role", "user"}, {"content", "hello"}}};
+    std::vector<json> tools = {{{"type", "function"}, {"function", {{"name", "send_message"}}}}};
+
+    std::vector<double> latencies;
+    latencies.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        client.chatCompletion(messages, tools);
+        latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double q) { return latencies[static_cast<size_t>(q * (latencies.size() - 1))]; };
+
+    std::printf("%-10s p50=%7.2fms p90=%7.2fms p99=%7.2fms max=%7.2fms  requests/call=%.3f hedges=%llu won=%llu\n",
+                label, pct(0.5), pct(0.9), pct(0.99), latencies.back(),
+                static_cast<double>(sent.load()) / iterations,
+                static_cast<unsigned long long>(client.hedgesFired()),
+                static_cast<unsigned long long>(client.hedgesWon()));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 500;
+    StandInConfig cfg;
+    std::printf("stand-in: base=%dms spike=%dms spike_rate=%.0f%% iterations=%d\n",
+                cfg.base_ms, cfg.spike_ms, cfg.spike_rate * 100, iterations);
+    run("baseline", false, iterations, cfg);
+    run("hedged", true, iterations, cfg);
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Document ingestion throughput across thread counts: the chunker alone, and
+// the whole pipeline (mmap, chunk, batch, embed with a local stand-in, store)
+// with an instant backend and with one that takes a few ms per request.
+#include "Ingestion.hpp"
+#include "Log.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string corpus(size_t bytes) {
+    static const char* words[] = {"agent", "memory", "block", "the", "archival", "passage", "of", "embedding",
+                                  "token", "a", "context", "window", "tool", "call", "summary", "recall"};
+    std::string text;
+    text.reserve(bytes + 64);
+    uint32_t state = 7;
+    int in_sentence = 0, in_paragraph = 0;
+    while (text.size() < bytes) {
+        state = state * 1103515245 + 12345;
+        text += words[(state >> 16) % 16];
+        if (++in_sentence == 14) {
+            in_sentence = 0;
+            text += ++in_paragraph == 5 ? ".\n\n" : ". ";
+            if (in_paragraph == 5) in_paragraph = 0;
+        } else {
+            text += ' ';
+        }
+    }
+    return text;
+}
+
+// 64-dimensional vectors from a hash of the text, after `latency`
+EmbeddingBackend standIn(std::chrono::microseconds latency) {
+    return [latency](const std::vector<std::string_view>& texts) {
+        if (latency.count()) std::this_thread::sleep_for(latency);
+        std::vector<std::vector<float>> out(texts.size(), std::vector<float>(64));
+        for (size_t i = 0; i < texts.size(); ++i) {
+            uint64_t h = 1469598103934665603ull;
+            for (char c : texts[i]) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            for (size_t d = 0; d < 64; ++d) out[i][d] = static_cast<float>((h >> (d % 56)) & 0xFF) / 255.0f;
+        }
+        return out;
+    };
+}
+
+void chunkOnly(const std::string& text, size_t threads) {
+    TextChunker chunker;
+    auto start = Clock::now();
+    std::vector<size_t> cuts = chunker.segments(text);
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> chunks{0};
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&] {
+            std::vector<Chunk> local;
+            for (size_t s; (s = next++) + 1 < cuts.size();) {
+                local.clear();
+                chunker.chunkSegment(text, cuts[s], cuts[s + 1], 0, local);
+                chunks += local.size();
+            }
+        });
+    }
+    for (auto& t : pool) t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf("%-24s %8zu %10.1f %12.0f\n", "chunker only", threads, text.size() / seconds / 1e6,
+                chunks / seconds);
+}
+
+void pipeline(const char* name, const std::string& doc, size_t threads, std::chrono::microseconds latency,
+              size_t in_flight) {
+    std::string store = "/tmp/letta-ingest-bench-" + std::to_string(getpid()) + ".jsonl";
+    ::unlink(store.c_str());
+    IngestionOptions options;
+    options.threads = threads;
+    options.max_in_flight = in_flight;
+    options.embedding_model = "stand-in";
+    IngestionStats stats = IngestionPipeline(standIn(latency), options).run({doc}, store);
+    if (!stats.ok()) std::printf("%s: failed: %s\n", name, stats.error.c_str());
+    std::printf("%-24s %8zu %10.1f %12.0f   %llu requests, batch %zu\n", name, threads,
+                stats.bytes / stats.seconds / 1e6, stats.embedded / stats.seconds,
+                static_cast<unsigned long long>(stats.requests), stats.batch_size);
+    ::unlink(store.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 64;
+    size_t max_threads = argc > 2 ? static_cast<size_t>(std::atol(argv[2]))
+                                  : std::max(1u, std::thread::hardware_concurrency());
+    Log::setLevel(LogLevel::Off);
+
+    std::string text = corpus(megabytes << 20);
+    std::string doc = "/tmp/letta-ingest-bench-" + std::to_string(getpid()) + ".txt";
+    std::ofstream(doc, std::ios::binary) << text;
+    std::printf("%zu MB document, %u cores\n", text.size() >> 20, std::thread::hardware_concurrency());
+    std::printf("%-24s %8s %10s %12s\n", "", "threads", "MB/s", "chunks/s");
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) chunkOnly(text, threads);
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        pipeline("pipeline, instant", doc, threads, std::chrono::microseconds(0), 3);
+    }
+    // A backend with real latency is bound by requests in flight, not cores
+    for (size_t in_flight : {1, 3, 8}) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "pipeline, 5 ms, %zu flight", in_flight);
+        pipeline(name, doc, max_threads, std::chrono::microseconds(5000), in_flight);
+    }
+    ::unlink(doc.c_str());
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Agent step throughput under multithreaded load with logging enabled:
+// asynchronous ring-buffer logging vs synchronous write-and-flush per line
+// (the old std::endl behaviour) vs logging off.
+#include "Agent.hpp"
+#include "Log.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+HttpResponse sendMessageResponse() {
+    static const std::string body = json{
+        {"candidates", {{{"content", {{"parts", {{{"functionCall", {{"name", "send_message"}, {"args", {{"message", "ok"}}}}}}}}}}}}}
+    }.dump();
+    return HttpResponse{200, body, ""};
+}
+
+double stepsPerSecond(int threads, int steps_per_thread) {
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([steps_per_thread] {
+            std::unique_ptr<Agent> agent;
+            for (int i = 0; i < steps_per_thread; ++i) {
+                // Keep history short so the benchmark measures the step, not serialization of a growing history
+                if (i % 25 == 0) {
+                    agent = std::make_unique<Agent>("key");
+                    agent->getLLMClient().setTransport([](const HttpRequest&, const std::atomic<bool>&) { return sendMessageResponse(); });
+                    agent->setMessageHandler([](const std::string&) {});
+                }
+                agent->step("hello");
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    Log::flush();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return threads * steps_per_thread / seconds;
+}
+
+// Raw logging cost: records/s when every thread does nothing but log
+double recordsPerSecond(int threads, int records_per_thread) {
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([records_per_thread, t] {
+            for (int i = 0; i < records_per_thread; ++i) {
+                LETTA_LOG_INFO("bench", "Executing tool", {"tool", "send_message"}, {"thread", t}, {"i", i});
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    Log::flush();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return threads * records_per_thread / seconds;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int steps = argc > 1 ? std::atoi(argv[1]) : 2000;
+    std::FILE* devnull = std::fopen("/dev/null", "w");
+    Log::setSink([devnull](std::string_view text) {
+        std::fwrite(text.data(), 1, text.size(), devnull);
+        std::fflush(devnull);
+    });
+    Log::setLevel(LogLevel::Trace); // tool name + arguments on every call
+
+    std::printf("%-8s %14s %14s %14s\n", "threads", "async", "synchronous", "off");
+    for (int threads : {1, 2, 4, 8}) {
+        Log::setLevel(LogLevel::Trace);
+        Log::setSynchronous(false);
+        double async_rate = stepsPerSecond(threads, steps);
+        Log::setSynchronous(true);
+        double sync_rate = stepsPerSecond(threads, steps);
+        Log::setSynchronous(false);
+        Log::setLevel(LogLevel::Off);
+        double off_rate = stepsPerSecond(threads, steps);
+        std::printf("%-8d %10.0f/s   %10.0f/s   %10.0f/s\n", threads, async_rate, sync_rate, off_rate);
+    }
+
+    std::printf("\n%-8s %14s %14s\n", "threads", "async rec", "sync rec");
+    Log::setLevel(LogLevel::Info);
+    for (int threads : {1, 2, 4, 8}) {
+        Log::setSynchronous(false);
+        double async_rate = recordsPerSecond(threads, steps * 20);
+        Log::setSynchronous(true);
+        double sync_rate = recordsPerSecond(threads, steps * 20);
+        Log::setSynchronous(false);
+        std::printf("%-8d %10.0f/s   %10.0f/s\n", threads, async_rate, sync_rate);
+    }
+    std::printf("dropped records: %llu\n", static_cast<unsigned long long>(Log::dropped()));
+    Log::setSink(nullptr);
+    std::fclose(devnull);
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Per-call overhead of MCP tools over a stdio server: one persistent session
+// (sequential, then many threads multiplexed on it) vs starting and
+// initializing a fresh session for every call.
+#include "McpClient.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#ifndef LETTA_MCP_STAND_IN
+#define LETTA_MCP_STAND_IN "mcp-stand-in"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double percentile(std::vector<double> samples, double q) {
+    std::sort(samples.begin(), samples.end());
+    return samples[static_cast<size_t>(q * (samples.size() - 1))];
+}
+
+McpServerConfig server(const char* command) {
+    McpServerConfig config;
+    config.name = "stand-in";
+    config.command = {command};
+    return config;
+}
+
+void report(const char* name, const std::vector<double>& us, double seconds) {
+    std::printf("%-30s %10.1f %10.1f %12.0f\n", name, percentile(us, 0.5), percentile(us, 0.99),
+                us.size() / seconds);
+}
+
+bool ok(const json& result) {
+    if (result.value("status", "") == "OK") return true;
+    std::printf("call failed: %s\n", result.dump().c_str());
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 5000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 8;
+    const char* command = argc > 3 ? argv[3] : LETTA_MCP_STAND_IN;
+    Log::setLevel(LogLevel::Off);
+    json args = {{"a", 2}, {"b", 3}};
+
+    std::printf("%d calls per row\n", calls);
+    std::printf("%-30s %10s %10s %12s\n", "", "p50 us", "p99 us", "calls/s");
+
+    McpClient client(server(command));
+    if (!client.connect()) {
+        std::printf("could not start %s\n", command);
+        return 1;
+    }
+    client.tools();
+    client.callTool("add", args); // warm up
+
+    {
+        std::vector<double> us;
+        auto start = Clock::now();
+        for (int i = 0; i < calls; ++i) {
+            auto t0 = Clock::now();
+            if (!ok(client.callTool("add", args))) return 1;
+            us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        }
+        report("persistent session", us, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    {
+        std::vector<std::vector<double>> per_thread(threads);
+        std::vector<std::thread> pool;
+        auto start = Clock::now();
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                for (int i = t; i < calls; i += threads) {
+                    auto t0 = Clock::now();
+                    client.callTool("add", args);
+                    per_thread[t].push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+                }
+            });
+        }
+        for (auto& t : pool) t.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::vector<double> us;
+        for (auto& samples : per_thread) us.insert(us.end(), samples.begin(), samples.end());
+        char name[64];
+        std::snprintf(name, sizeof(name), "persistent, %d threads", threads);
+        report(name, us, seconds);
+    }
+
+    {
+        // What every call costs without a kept session: spawn, initialize,
+        // call, shut down
+        int fresh = std::max(1, calls / 50);
+        std::vector<double> us;
+        auto start = Clock::now();
+        for (int i = 0; i < fresh; ++i) {
+            auto t0 = Clock::now();
+            McpClient once(server(command));
+            if (!ok(once.callTool("add", args))) return 1;
+            once.disconnect();
+            us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        }
+        report("session per call", us, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    std::printf("\nrequests on the persistent session: %llu, reconnects: %llu\n",
+                static_cast<unsigned long long>(client.requests()),
+                static_cast<unsigned long long>(client.reconnects()));
+    return 0;
+}
@@ -0,0 +1,160 @@
+// History footprint and request-conversion cost: the previous
+// std::vector<json> history vs the column-wise MessageStore.
+#include "LLMClient.hpp"
+#include "Log.hpp"
+#include "MessageStore.hpp"
+#include "Telemetry.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+namespace {
+
+// Live heap bytes, tracked through the global allocator
+std::atomic<int64_t> heap_bytes{0};
+
+} // namespace
+
+// Kept out of line: once inlined, GCC pairs the malloc here with the free in
+// operator delete and reports -Wmismatched-new-delete at every call site
+__attribute__((noinline)) void* operator new(size_t size) {
+    void* p = std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    heap_bytes += static_cast<int64_t>(malloc_usable_size(p));
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    if (!p) return;
+    heap_bytes -= static_cast<int64_t>(malloc_usable_size(p));
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A typical Letta turn: user message, assistant tool call, tool result
+std::vector<json> buildHistory(int turns) {
+    std::vector<json> messages;
+    messages.push_back({{"role", "system"}, {"content", std::string(3000, 's')}});
+    for (int i = 0; i < turns; ++i) {
+        messages.push_back({{"role", "user"}, {"content", "Tell me something about topic number " + std::to_string(i)}});
+        messages.push_back({
+            {"role", "assistant"},
+            {"content", nullptr},
+            {"tool_calls", {{
+                {"id", "call_send_message"},
+                {"type", "function"},
+                {"function", {{"name", "send_message"},
+                              {"arguments", json{{"message", "Here is a fact about topic " + std::to_string(i) + "."}}.dump()}}}
+            }}}
+        });
+        messages.push_back({{"role", "tool"}, {"tool_call_id", "call_send_message"}, {"name", "send_message"},
+                            {"content", "{\"message\":\"Message sent to user.\",\"status\":\"OK\"}"}});
+    }
+    return messages;
+}
+
+// The Gemini conversion as it was written against std::vector<json>
+std::string legacyGeminiBody(const std::vector<json>& messages) {
+    json contents = json::array();
+    json system_instruction;
+    for (const auto& msg : messages) {
+        std::string role = msg.value("role", "");
+        if (role == "system") {
+            system_instruction = {{"parts", {{{"text", msg.value("content", "")}}}}};
+        } else if (role == "user") {
+            contents.push_back({{"role", "user"}, {"parts", {{{"text", msg.value("content", "")}}}}});
+        } else if (role == "assistant") {
+            json parts = json::array();
+            if (msg.contains("tool_calls")) {
+                for (const auto& tc : msg["tool_calls"]) {
+                    json func_call = {{"name", tc["function"]["name"]},
+                                      {"args", json::parse(tc["function"]["arguments"].get<std::string>())}};
+                    parts.push_back({{"functionCall", func_call}});
+                }
+            } else {
+                parts.push_back({{"text", msg.value("content", "")}});
+            }
+            contents.push_back({{"role", "model"}, {"parts", parts}});
+        } else if (role == "tool") {
+            json function_response = {{"name", msg.value("name", "")}};
+            try {
+                function_response["response"] = json::parse(msg.value("content", ""));
+            } catch (...) {
+                function_response["response"] = {{"result", msg.value("content", "")}};
+            }
+            contents.push_back({{"role", "function"}, {"parts", {{{"functionResponse", function_response}}}}});
+        }
+    }
+    json payload = {{"contents", contents}, {"system_instruction", system_instruction}};
+    return payload.dump();
+}
+
+std::string legacyOpenAIBody(const std::vector<json>& messages) {
+    json payload = {{"model", "bench-model"}, {"messages", messages}};
+    return payload.dump();
+}
+
+// Average LLMClient::buildRequest time, read back from the serialize histogram
+double storeConversionUs(const std::string& base_url, const MessageStore& store, int iterations) {
+    LLMClient client("key", base_url, "bench-model");
+    client.setTransport([](const HttpRequest&, const std::atomic<bool>&) { return HttpResponse{500, "", ""}; });
+    Histogram* serialize = Telemetry::metrics().serialize_duration;
+    double sum_before = serialize->sum();
+    uint64_t count_before = serialize->count();
+    for (int i = 0; i < iterations; ++i) {
+        client.chatCompletion(store);
+        Telemetry::instance().drainSpans();
+    }
+    return (serialize->sum() - sum_before) / static_cast<double>(serialize->count() - count_before) * 1e6;
+}
+
+template <typename F>
+double legacyConversionUs(F&& convert, int iterations) {
+    size_t sink = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) sink += convert().size();
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+    if (sink == 0) std::printf("(empty)\n");
+    return us;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+    Log::setLevel(LogLevel::Off); // the stub transport fails every request on purpose
+    Telemetry::setEnabled(true);
+
+    std::printf("%-8s %12s %12s   %14s %14s   %14s %14s\n", "msgs", "json B/msg", "store B/msg",
+                "gemini json", "gemini store", "openai json", "openai store");
+    for (int turns : {10, 100, 1000, 10000}) {
+        int64_t before = heap_bytes.load();
+        std::vector<json> legacy = buildHistory(turns);
+        int64_t legacy_bytes = heap_bytes.load() - before;
+
+        before = heap_bytes.load();
+        MessageStore store = MessageStore::fromJson(legacy);
+        store.setContent(0, store[0].content()); // settle capacity the way a live agent would
+        int64_t store_bytes = heap_bytes.load() - before;
+
+        int reps = std::max(1, iterations * 100 / turns);
+        double gemini_legacy = legacyConversionUs([&] { return legacyGeminiBody(legacy); }, reps);
+        double gemini_store = storeConversionUs("https://generativelanguage.googleapis.com/v1beta", store, reps);
+        double openai_legacy = legacyConversionUs([&] { return legacyOpenAIBody(legacy); }, reps);
+        double openai_store = storeConversionUs("http://stand-in/v1", store, reps);
+
+        double n = static_cast<double>(legacy.size());
+        std::printf("%-8zu %12.0f %12.0f   %11.1f us %11.1f us   %11.1f us %11.1f us\n", legacy.size(),
+                    legacy_bytes / n, store_bytes / n, gemini_legacy, gemini_store, openai_legacy, openai_store);
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+// System prompt rendering: the previous hard-coded stringstream compile vs the
+// compiled default template rendered into a reused buffer.
+#include "Memory.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Memory::compile as it was before templates
+std::string legacyCompile(const std::vector<MemoryBlock>& blocks) {
+    std::stringstream ss;
+    ss << "You are a Letta agent. You have access to a set of tools and a memory system.\n";
+    ss << "You must use the `send_message` tool to communicate with the user.\n";
+    ss << "You must use the `core_memory_append` or `core_memory_replace` tools to update your memory when you learn new facts.\n\n";
+    ss << "### Memory Blocks\n";
+    for (const auto& block : blocks) {
+        ss << "Block '" << block.label << "' (" << block.value.length() << "/" << block.limit << " chars):\n";
+        ss << block.value << "\n\n";
+    }
+    return ss.str();
+}
+
+template <typename F>
+double nsPerOp(F&& f, int iterations) {
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) f();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    auto custom = PromptTemplate::compile(
+        "{{ block_count }} memory blocks (~{{ total_tokens }} tokens) as of {{ now }}\n"
+        "{% for block in blocks %}<{{ block.label }}{% if block.read_only %} readonly{% endif %} "
+        "tokens=\"{{ block.tokens }}\">\n{{ block.value }}\n</{{ block.label }}>\n{% endfor %}");
+
+    std::printf("%-7s %-7s %14s %14s %14s %14s\n", "blocks", "bytes", "stringstream", "compile()", "reused buf",
+                "custom tmpl");
+    for (int count : {2, 8, 32}) {
+        for (size_t bytes : {200u, 2000u}) {
+            Memory memory;
+            std::vector<MemoryBlock> blocks;
+            for (int i = 0; i < count; ++i) {
+                MemoryBlock block{"block_" + std::to_string(i), std::string(bytes, 'a' + i % 26), 5000, i % 3 == 0};
+                blocks.push_back(block);
+                memory.addBlock(block);
+            }
+            if (legacyCompile(blocks) != memory.compile()) {
+                std::printf("output mismatch\n");
+                return 1;
+            }
+
+            int n = static_cast<int>(iterations * 2 / count);
+            size_t sink = 0;
+            std::string buffer;
+            double legacy = nsPerOp([&] { sink += legacyCompile(blocks).size(); }, n);
+            double fresh = nsPerOp([&] { sink += memory.compile().size(); }, n);
+            double reused = nsPerOp([&] { memory.compileInto(buffer); sink += buffer.size(); }, n);
+            memory.setTemplate(custom);
+            double templated = nsPerOp([&] { memory.compileInto(buffer); sink += buffer.size(); }, n);
+
+            std::printf("%-7d %-7zu %11.0f ns %11.0f ns %11.0f ns %11.0f ns%s\n", count, bytes, legacy, fresh, reused,
+                        templated, sink ? "" : " ");
+        }
+    }
+    return 0;
+}
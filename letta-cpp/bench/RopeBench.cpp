@@ -0,0 +1,113 @@
+// Frequent edits to large memory blocks: the previous copy-the-whole-string
+// edits vs Memory::editBlock on a Rope, plus raw search throughput.
+#include "Memory.hpp"
+#include "Log.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string makeText(size_t bytes) {
+    std::string text;
+    for (int i = 0; text.size() < bytes; ++i) text += "fact " + std::to_string(i) + ": the user mentioned something relevant.\n";
+    return text;
+}
+
+double usSince(Clock::time_point start, int ops) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / ops;
+}
+
+// What core_memory_append / core_memory_replace used to do
+void legacyAppend(std::string& value, const std::string& content) {
+    std::string new_value = value + "\n" + content;
+    value = new_value;
+}
+
+bool legacyReplace(std::string& value, const std::string& old_content, const std::string& new_content) {
+    std::string current_val = value;
+    size_t pos = current_val.find(old_content);
+    if (pos == std::string::npos) return false;
+    current_val.replace(pos, old_content.length(), new_content);
+    value = current_val;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int edits = argc > 1 ? std::atoi(argv[1]) : 2000;
+    Log::setLevel(LogLevel::Off);
+
+    std::printf("%-8s %14s %14s %14s %14s %14s\n", "block", "append str", "append rope", "replace str", "replace rope",
+                "compile rope");
+    for (size_t bytes : {100u << 10, 400u << 10, 1u << 20}) {
+        std::string base = makeText(bytes);
+
+        std::string legacy = base;
+        auto start = Clock::now();
+        for (int i = 0; i < edits; ++i) legacyAppend(legacy, "fact appended " + std::to_string(i));
+        double append_str = usSince(start, edits);
+
+        Memory memory;
+        memory.addBlock(MemoryBlock{"scratchpad", base, 1 << 30, false});
+        start = Clock::now();
+        for (int i = 0; i < edits; ++i) {
+            std::string content = "fact appended " + std::to_string(i);
+            memory.editBlock("scratchpad", [&](Rope& value) {
+                value += "\n";
+                value += content;
+                return true;
+            });
+        }
+        double append_rope = usSince(start, edits);
+
+        // Replace a fact in the middle-to-end of the block, as a correction would
+        start = Clock::now();
+        for (int i = 0; i < edits; ++i) {
+            legacyReplace(legacy, "fact appended " + std::to_string(i), "fact corrected " + std::to_string(i));
+        }
+        double replace_str = usSince(start, edits);
+
+        start = Clock::now();
+        for (int i = 0; i < edits; ++i) {
+            std::string old_content = "fact appended " + std::to_string(i);
+            std::string new_content = "fact corrected " + std::to_string(i);
+            memory.editBlock("scratchpad", [&](Rope& value) {
+                size_t pos = value.find(old_content);
+                if (pos == Rope::npos) return false;
+                value.replace(pos, old_content.length(), new_content);
+                return true;
+            });
+        }
+        double replace_rope = usSince(start, edits);
+
+        start = Clock::now();
+        size_t sink = 0;
+        for (int i = 0; i < 20; ++i) sink += memory.compile().size();
+        double compile_rope = usSince(start, 20);
+
+        if (memory.findBlock("scratchpad")->value != legacy || sink == 0) {
+            std::printf("mismatch between string and rope results\n");
+            return 1;
+        }
+        std::printf("%-6zuKB %11.1f us %11.1f us %11.1f us %11.1f us %11.1f us\n", bytes >> 10, append_str, append_rope,
+                    replace_str, replace_rope, compile_rope);
+    }
+
+    // Search throughput on a 1 MB block, needle absent (full scan)
+    std::string text = makeText(1 << 20);
+    Rope rope(text);
+    const std::string needle = "the assistant forgot";
+    auto start = Clock::now();
+    size_t hits = 0;
+    for (int i = 0; i < 200; ++i) hits += text.find(needle) != std::string::npos;
+    double str_us = usSince(start, 200);
+    start = Clock::now();
+    for (int i = 0; i < 200; ++i) hits += rope.find(needle) != Rope::npos;
+    double rope_us = usSince(start, 200);
+    std::printf("\nfind, 1 MB, miss: std::string %.0f us (%.2f GB/s)   Rope %.0f us (%.2f GB/s)%s\n", str_us,
+                text.size() / str_us / 1e3, rope_us, text.size() / rope_us / 1e3, hits ? " (unexpected hit)" : "");
+    return 0;
+}
@@ -0,0 +1,129 @@
+// Goodput and interactive tail latency for many agents sharing one provider
+// quota, with and without the shared RequestScheduler.
+//
+// The stand-in provider admits `quota_per_sec` requests per one-second window
+// and answers 429 beyond that. Batch agents hammer it continuously while a few
+// interactive agents issue one request at a time.
+#include "LLMClient.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Provider {
+    int quota_per_sec = 50;
+    std::chrono::milliseconds service_time{20};
+
+    std::mutex mutex;
+    Clock::time_point window_start = Clock::now();
+    int in_window = 0;
+    std::atomic<uint64_t> ok{0};
+    std::atomic<uint64_t> limited{0};
+
+    HttpResponse handle() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto now = Clock::now();
+            if (now - window_start >= std::chrono::seconds(1)) {
+                window_start = now;
+                in_window = 0;
+            }
+            if (++in_window > quota_per_sec) {
+                limited++;
+                HttpResponse r{429, "{\"error\":\"rate limited\"}", ""};
+                auto remaining = std::chrono::duration<double>(window_start + std::chrono::seconds(1) - now).count();
+                r.headers["Retry-After"] = std::to_string(remaining);
+                return r;
+            }
+        }
+        std::this_thread::sleep_for(service_time);
+        ok++;
+        json body = {{"choices", {{{"message", {{"role", "assistant"}, {"content", "ok"}}}}}},
+                     {"usage", {{"total_tokens", 100}}}};
+        return HttpResponse{200, body.dump(), ""};
+    }
+};
+
+struct Result {
+    double goodput = 0;
+    uint64_t rejected = 0;
+    std::vector<double> interactive_ms;
+};
+
+Result run(bool scheduled, int batch_agents, int interactive_agents, std::chrono::seconds duration) {
+    Provider provider;
+    RequestScheduler scheduler;
+    if (scheduled) {
+        RateLimits limits;
+        limits.requests_per_minute = provider.quota_per_sec * 60 * 0.95;
+        limits.burst_fraction = 5.0 / limits.requests_per_minute;
+        scheduler.setLimits("bench-model", limits);
+    }
+
+    std::vector<json> messages = {{{"role", "user"}, {"content", "hello"}}};
+    std::atomic<bool> stop{false};
+    std::mutex result_mutex;
+    Result result;
+
+    auto agent = [&](int index, RequestPriority priority) {
+        LLMClient client("key", "http://stand-in/v1", "bench-model");
+        client.setTransport([&](const HttpRequest&, const std::atomic<bool>&) { return provider.handle(); });
+        client.setScheduler(scheduler);
+        client.setSchedulingContext("agent-" + std::to_string(index), priority);
+        // Without the scheduler every client just retries as soon as it sees an error
+        client.setMaxRateLimitRetries(scheduled ? 10 : 0);
+
+        while (!stop) {
+            auto start = Clock::now();
+            while (!stop && client.chatCompletion(messages).contains("error")) {}
+            if (priority == RequestPriority::Interactive && !stop) {
+                {
+                    std::lock_guard<std::mutex> lock(result_mutex);
+                    result.interactive_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+                }
+                // Interactive users think between turns
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    int index = 0;
+    for (int i = 0; i < batch_agents; ++i) threads.emplace_back(agent, index++, RequestPriority::Batch);
+    for (int i = 0; i < interactive_agents; ++i) threads.emplace_back(agent, index++, RequestPriority::Interactive);
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& t : threads) t.join();
+
+    result.goodput = static_cast<double>(provider.ok.load()) / duration.count();
+    result.rejected = provider.limited.load();
+    std::sort(result.interactive_ms.begin(), result.interactive_ms.end());
+    return result;
+}
+
+void report(const char* label, const Result& r) {
+    auto pct = [&](double q) {
+        return r.interactive_ms.empty() ? 0.0 : r.interactive_ms[static_cast<size_t>(q * (r.interactive_ms.size() - 1))];
+    };
+    std::printf("%-10s goodput=%6.1f req/s  429s=%8llu  interactive p50=%7.1fms p99=%7.1fms (n=%zu)\n",
+                label, r.goodput, static_cast<unsigned long long>(r.rejected), pct(0.5), pct(0.99), r.interactive_ms.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int batch_agents = argc > 1 ? std::atoi(argv[1]) : 32;
+    int interactive_agents = argc > 2 ? std::atoi(argv[2]) : 4;
+    std::chrono::seconds duration(argc > 3 ? std::atoi(argv[3]) : 5);
+
+    std::printf("provider quota=50 req/s, %d batch + %d interactive agents, %llds\n",
+                batch_agents, interactive_agents, static_cast<long long>(duration.count()));
+    report("unmanaged", run(false, batch_agents, interactive_agents, duration));
+    report("scheduled", run(true, batch_agents, interactive_agents, duration));
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Thousands of agents reading one organisation-wide block while a single
+// writer updates it: RCU shared block vs a reader-writer lock, plus the cost
+// of fanning an update out to per-agent private copies.
+#include "Memory.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <shared_mutex>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const std::string kPolicy(1024, 'p');
+
+struct Result {
+    double checks_per_sec;
+    double renders_per_sec;
+    double write_p50_us;
+    double write_p99_us;
+    size_t writes;
+};
+
+double percentileUs(std::vector<double> samples, double q) {
+    if (samples.empty()) return 0;
+    std::sort(samples.begin(), samples.end());
+    return samples[static_cast<size_t>(q * (samples.size() - 1))];
+}
+
+// Readers sweep their agents; an agent re-renders only when its version moved.
+// `check` returns the current version, `render` produces the prompt.
+template <typename Check, typename Render, typename Write>
+Result run(int agents, int readers, std::chrono::milliseconds duration, Check check, Render render, Write write) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> checks{0}, renders{0};
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::vector<uint64_t> seen(agents, 0);
+            uint64_t local_checks = 0, local_renders = 0;
+            size_t sink = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int a = r; a < agents; a += readers) {
+                    uint64_t v = check(a);
+                    ++local_checks;
+                    if (v != seen[a]) {
+                        seen[a] = v;
+                        sink += render(a).size();
+                        ++local_renders;
+                    }
+                }
+            }
+            checks += local_checks;
+            renders += local_renders + (sink == 0);
+        });
+    }
+
+    std::vector<double> write_us;
+    auto start = Clock::now();
+    for (int i = 0; Clock::now() - start < duration; ++i) {
+        auto t0 = Clock::now();
+        write(i);
+        write_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    for (auto& t : threads) t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return Result{checks / seconds, renders / seconds, percentileUs(write_us, 0.5), percentileUs(write_us, 0.99), write_us.size()};
+}
+
+// The same block behind a std::shared_mutex
+struct LockedBlock {
+    mutable std::shared_mutex mutex;
+    std::string value = kPolicy;
+    uint64_t version = 1;
+};
+
+void print(const char* name, const Result& r) {
+    std::printf("%-16s %12.0f %12.0f %8zu %12.1f %12.1f\n", name, r.checks_per_sec, r.renders_per_sec, r.writes,
+                r.write_p50_us, r.write_p99_us);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int agents = argc > 1 ? std::atoi(argv[1]) : 4000;
+    int readers = argc > 2 ? std::atoi(argv[2]) : 8;
+    auto duration = std::chrono::milliseconds(argc > 3 ? std::atoi(argv[3]) : 2000);
+    Log::setLevel(LogLevel::Off);
+
+    std::printf("%d agents, %d reader threads, 1 writer updating every ~1ms\n", agents, readers);
+    std::printf("%-16s %12s %12s %8s %12s %12s\n", "", "checks/s", "renders/s", "writes", "write p50us", "write p99us");
+
+    {
+        auto policy = std::make_shared<SharedBlock>(MemoryBlock{"policy", kPolicy, 2000, false});
+        std::vector<Memory> memories(agents);
+        for (auto& m : memories) {
+            m.initializeDefault();
+            m.attachShared(policy);
+        }
+        Result r = run(agents, readers, duration,
+            [&](int a) { return memories[a].version(); },
+            [&](int a) { return memories[a].compile(); },
+            [&](int i) { policy->update(kPolicy + std::to_string(i)); });
+        print("rcu", r);
+    }
+
+    {
+        LockedBlock policy;
+        std::vector<Memory> memories(agents);
+        for (auto& m : memories) m.initializeDefault();
+        Result r = run(agents, readers, duration,
+            [&](int) { std::shared_lock<std::shared_mutex> lock(policy.mutex); return policy.version; },
+            [&](int a) {
+                std::shared_lock<std::shared_mutex> lock(policy.mutex);
+                return memories[a].compile() + policy.value;
+            },
+            [&](int i) {
+                std::unique_lock<std::shared_mutex> lock(policy.mutex);
+                policy.value = kPolicy + std::to_string(i);
+                policy.version++;
+            });
+        print("shared_mutex", r);
+    }
+
+    {
+        // Before shared blocks: every agent held its own copy
+        std::vector<Memory> memories(agents);
+        for (auto& m : memories) {
+            m.initializeDefault();
+            m.addBlock(MemoryBlock{"policy", kPolicy, 2000, false});
+        }
+        auto start = Clock::now();
+        for (auto& m : memories) m.updateBlock("policy", kPolicy + "x");
+        double fanout_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        std::printf("\nper-agent copies: one policy change = %d updates, %.0f us (single-threaded, no readers)\n",
+                    agents, fanout_us);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Foreground cost of memory upkeep: the model edits memory inline (one extra
+// round trip per edit, memory tools in every request) vs a sleep-time agent
+// that does it between turns. The stand-in provider answers after a fixed
+// delay per request.
+#include "Agent.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+HttpResponse geminiCall(const std::string& name, const json& args) {
+    json call = {{"name", name}, {"args", args}};
+    json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+    return HttpResponse{200, body.dump(), "", {}};
+}
+
+bool answersToolResult(const HttpRequest& req) {
+    // The last content entry is a function response right after a memory edit
+    size_t last_user = req.body.rfind("\"role\":\"user\"");
+    size_t last_function = req.body.rfind("functionResponse");
+    return last_function != std::string::npos && (last_user == std::string::npos || last_function > last_user);
+}
+
+struct Result {
+    double p50_ms;
+    double p99_ms;
+    double round_trips_per_turn;
+    double request_kb_per_turn;
+};
+
+double percentile(std::vector<double> samples, double q) {
+    std::sort(samples.begin(), samples.end());
+    return samples[static_cast<size_t>(q * (samples.size() - 1))];
+}
+
+// `edit_every`: the model decides to store a fact on every n-th turn
+Result run(bool sleep_time, int turns, int edit_every, std::chrono::milliseconds latency) {
+    Agent agent("key");
+    agent.setMessageHandler([](const std::string&) {});
+    std::atomic<uint64_t> round_trips{0}, request_bytes{0};
+    int turn = 0;
+
+    agent.getLLMClient().setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        std::this_thread::sleep_for(latency);
+        round_trips++;
+        request_bytes += req.body.size();
+        bool wants_edit = !sleep_time && turn % edit_every == 0 && !answersToolResult(req);
+        if (wants_edit) {
+            return geminiCall("core_memory_append", {{"label", "human"}, {"content", "fact " + std::to_string(turn)}});
+        }
+        return geminiCall("send_message", {{"message", "ok"}});
+    });
+
+    if (sleep_time) {
+        agent.enableSleepTime();
+        agent.getSleepTimeAgent()->getLLMClient().setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+            std::this_thread::sleep_for(latency);
+            if (answersToolResult(req)) return geminiCall("finish_memory_edits", json::object());
+            return geminiCall("core_memory_append", {{"label", "human"}, {"content", "fact"}});
+        });
+    }
+
+    std::vector<double> step_ms;
+    for (turn = 0; turn < turns; ++turn) {
+        auto start = Clock::now();
+        agent.step("message " + std::to_string(turn));
+        step_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        // The user takes longer to type than the consolidation takes to run
+        if (sleep_time) agent.getSleepTimeAgent()->waitIdle();
+    }
+    return Result{percentile(step_ms, 0.5), percentile(step_ms, 0.99),
+                  static_cast<double>(round_trips) / turns, request_bytes / 1024.0 / turns};
+}
+
+void print(const char* name, const Result& r) {
+    std::printf("%-12s %10.1f %10.1f %14.2f %14.1f\n", name, r.p50_ms, r.p99_ms, r.round_trips_per_turn,
+                r.request_kb_per_turn);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int turns = argc > 1 ? std::atoi(argv[1]) : 40;
+    int edit_every = argc > 2 ? std::atoi(argv[2]) : 2;
+    auto latency = std::chrono::milliseconds(argc > 3 ? std::atoi(argv[3]) : 20);
+    Log::setLevel(LogLevel::Off);
+
+    std::printf("%d turns, memory edit every %d turns, %lld ms per LLM request\n", turns, edit_every,
+                static_cast<long long>(latency.count()));
+    std::printf("%-12s %10s %10s %14s %14s\n", "", "step p50ms", "step p99ms", "fg trips/turn", "fg KB/turn");
+    print("inline", run(false, turns, edit_every, latency));
+    print("sleep-time", run(true, turns, edit_every, latency));
+    return 0;
+}
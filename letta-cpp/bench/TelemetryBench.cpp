@@ -0,0 +1,61 @@
+// Overhead of the instrumentation surface with telemetry disabled (the
+// production default) and enabled.
+#include "LLMClient.hpp"
+#include "Telemetry.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double nsPerOp(Clock::duration elapsed, int ops) {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+}
+
+double spanCost(int iterations) {
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        ScopedSpan span("bench.span", Telemetry::metrics().tool_duration);
+        span.setAttribute("i", static_cast<int64_t>(i));
+        if ((i & 4095) == 0) Telemetry::instance().drainSpans();
+    }
+    return nsPerOp(Clock::now() - start, iterations);
+}
+
+double completionCost(int iterations) {
+    LLMClient client("key", "http://stand-in/v1", "bench-model");
+    json body = {{"choices", {{{"message", {{"role", "assistant"}, {"content", "ok"}}}}}},
+                 {"usage", {{"prompt_tokens", 10}, {"completion_tokens", 2}, {"total_tokens", 12}}}};
+    std::string text = body.dump();
+    client.setTransport([&](const HttpRequest&, const std::atomic<bool>&) { return HttpResponse{200, text, ""}; });
+
+    std::vector<json> messages;
+    messages.push_back({{"role", "system"}, {"content", std::string(2000, 's')}});
+    for (int i = 0; i < 20; ++i) messages.push_back({{"role", "user"}, {"content", "message " + std::to_string(i)}});
+
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        client.chatCompletion(messages);
+        if ((i & 1023) == 0) Telemetry::instance().drainSpans();
+    }
+    return nsPerOp(Clock::now() - start, iterations);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    Telemetry::setEnabled(false);
+    double span_off = spanCost(iterations);
+    double call_off = completionCost(iterations / 100);
+    Telemetry::setEnabled(true);
+    double span_on = spanCost(iterations);
+    double call_on = completionCost(iterations / 100);
+
+    std::printf("ScopedSpan + attribute: disabled %8.1f ns/op   enabled %8.1f ns/op\n", span_off, span_on);
+    std::printf("chatCompletion (stub):  disabled %8.1f us/op   enabled %8.1f us/op  (%.2f%% overhead)\n",
+                call_off / 1000, call_on / 1000, (call_on - call_off) / call_off * 100);
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Custom-tool call latency: pre-forked sandbox workers vs a fresh sandboxed
+// process per call, for a tiny payload and a large one, plus the large
+// payload with the shared arena disabled (everything through the socket).
+#include "ToolSandbox.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+json functionSchema(const std::string& name) {
+    return {{"type", "function"}, {"function", {{"name", name}, {"parameters", {{"type", "object"}}}}}};
+}
+
+double percentile(std::vector<double> samples, double q) {
+    std::sort(samples.begin(), samples.end());
+    return samples[static_cast<size_t>(q * (samples.size() - 1))];
+}
+
+void run(const char* name, SandboxOptions options, const json& arguments, int calls) {
+    ToolSandbox sandbox(options);
+    sandbox.registerTool(functionSchema("count"), [](const json& args) {
+        const std::string& text = args["text"].get_ref<const std::string&>();
+        return json{{"status", "OK"}, {"words", std::count(text.begin(), text.end(), ' ') + 1}};
+    });
+    sandbox.start();
+    sandbox.execute("count", arguments); // warm up
+
+    std::vector<double> us;
+    auto start = Clock::now();
+    for (int i = 0; i < calls; ++i) {
+        auto t0 = Clock::now();
+        json result = sandbox.execute("count", arguments);
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        if (result.value("status", "") != "OK") {
+            std::printf("%s: call failed: %s\n", name, result.dump().c_str());
+            return;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf("%-28s %10.1f %10.1f %12.0f\n", name, percentile(us, 0.5), percentile(us, 0.99), calls / seconds);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 2000;
+    size_t large_bytes = argc > 2 ? static_cast<size_t>(std::atol(argv[2])) : (1u << 20);
+    Log::setLevel(LogLevel::Off);
+
+    json small = {{"text", "how many words are in this sentence"}};
+    std::string text;
+    while (text.size() < large_bytes) text += "lorem ipsum dolor sit amet ";
+    json large = {{"text", text}};
+
+    SandboxOptions pooled;
+    pooled.workers = 1;
+    SandboxOptions per_call = pooled;
+    per_call.workers = 0;
+    SandboxOptions socket_only = pooled;
+    socket_only.arena_bytes = 0;
+
+    std::printf("%d calls per row, large payload %zu KB\n", calls, text.size() / 1024);
+    std::printf("%-28s %10s %10s %12s\n", "", "p50 us", "p99 us", "calls/s");
+    run("small, pre-forked", pooled, small, calls);
+    run("small, fork per call", per_call, small, calls);
+    run("large, pre-forked (arena)", pooled, large, calls / 10);
+    run("large, pre-forked (socket)", socket_only, large, calls / 10);
+    run("large, fork per call", per_call, large, calls / 10);
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Tool-argument validation throughput: json::parse alone (what the agent did
+// before checking anything), a whole-document schema check, and the streaming
+// validator fed as a provider would stream (small chunks) or a byte at a time.
+// Also how far into a malformed call the streaming check gets before it
+// rejects it, and the per-request cost of compiling the tool list's grammar.
+#include "ToolSchema.hpp"
+#include "Tools.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Best of three runs of `fn` over `rounds` iterations, in seconds
+template <typename F>
+double best(size_t rounds, F fn) {
+    double fastest = 1e9;
+    for (int run = 0; run < 3; ++run) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < rounds; ++i) fn();
+        fastest = std::min(fastest, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return fastest;
+}
+
+// Memory content of roughly `bytes`: prose with some escapes and non-ASCII
+std::string content(size_t bytes, uint32_t seed) {
+    static const char* words[] = {"the", "user", "prefers", "tea", "over", "coffee", "and", "lives", "in",
+                                  "Zürich", "\"quoted\"", "line\nbreak", "tab\there", "naïve", "café"};
+    std::mt19937 rng(seed);
+    std::string out;
+    while (out.size() < bytes) {
+        if (!out.empty()) out += ' ';
+        out += words[rng() % (sizeof(words) / sizeof(words[0]))];
+    }
+    return out;
+}
+
+void row(const char* name, size_t bytes, size_t rounds, double seconds) {
+    std::printf("  %-28s %10.1f MB/s %10.2f us/call\n", name, bytes * rounds / seconds / 1e6,
+                seconds / rounds * 1e6);
+}
+
+void run(const char* label, const ToolSchema& schema, const std::string& args, size_t rounds) {
+    std::printf("%s (%zu bytes)\n", label, args.size());
+    volatile size_t sink = 0;
+    row("json::parse", args.size(), rounds, best(rounds, [&] { sink = sink + json::parse(args).size(); }));
+    row("validate (whole)", args.size(), rounds, best(rounds, [&] { sink = sink + schema.validate(args); }));
+    row("validate + parse", args.size(), rounds, best(rounds, [&] {
+        if (schema.validate(args)) sink = sink + json::parse(args).size();
+    }));
+    for (size_t chunk : {size_t{16}, size_t{1}}) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "streamed, %zu-byte chunks", chunk);
+        row(name, args.size(), rounds, best(rounds, [&] {
+            ArgumentValidator validator(schema);
+            for (size_t at = 0; at < args.size(); at += chunk) {
+                validator.feed(std::string_view(args).substr(at, chunk));
+            }
+            sink = sink + validator.finish();
+        }));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t scale = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 1;
+
+    ToolSchema replace = ToolSchema::compile(Tools::core_memory_replace["function"]["parameters"]);
+    json small = {{"label", "human"}, {"old_content", "Name: Chad"}, {"new_content", "Name: Chad (prefers tea)"}};
+    run("core_memory_replace, short", replace, small.dump(), 200000 * scale);
+    json large = {{"label", "human"}, {"old_content", content(2000, 1)}, {"new_content", content(62000, 2)}};
+    run("core_memory_replace, 64 KB", replace, large.dump(), 500 * scale);
+
+    ToolSchema nested = ToolSchema::compile(R"({
+        "type": "object",
+        "properties": {
+            "rows": {"type": "array", "items": {"type": "object",
+                "properties": {"id": {"type": "integer"}, "score": {"type": "number"},
+                               "kind": {"enum": ["fact", "preference", "event"]},
+                               "tags": {"type": "array", "items": {"type": "string"}}},
+                "required": ["id", "kind"], "additionalProperties": false}}
+        },
+        "required": ["rows"]
+    })"_json);
+    json rows = json::array();
+    for (int i = 0; i < 500; ++i) {
+        rows.push_back({{"id", i}, {"score", i * 0.37}, {"kind", i % 3 ? "fact" : "event"},
+                        {"tags", {"t" + std::to_string(i % 7), "x"}}});
+    }
+    run("nested records, 500 rows", nested, json{{"rows", rows}}.dump(), 2000 * scale);
+
+    // A call whose first field is already wrong: the stream is rejected there
+    std::string bad = json{{"label", 42}, {"old_content", content(2000, 3)}, {"new_content", content(62000, 4)}}.dump();
+    ArgumentValidator validator(replace);
+    validator.feed(bad);
+    std::printf("\nmalformed 64 KB call rejected after %zu of %zu bytes: %s\n", validator.offset(), bad.size(),
+                validator.error().c_str());
+
+    std::vector<json> tools = Tools::get_all_tools();
+    size_t rounds = 20000 * scale;
+    size_t grammar_bytes = 0, regex_bytes = 0;
+    double gbnf = best(rounds, [&] { grammar_bytes = ToolSchemas(tools).gbnf().size(); });
+    double regex = best(rounds, [&] { regex_bytes = ToolSchemas(tools).regex().size(); });
+    std::printf("\ntool list -> GBNF  %6.2f us/request (%zu bytes)\n", gbnf / rounds * 1e6, grammar_bytes);
+    std::printf("tool list -> regex %6.2f us/request (%zu bytes)\n", regex / rounds * 1e6, regex_bytes);
+    return 0;
+}
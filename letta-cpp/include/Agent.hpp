@@ -1,7 +1,16 @@
 #pragma once
 
+#include "AgentFile.hpp"
+#include "Cancellation.hpp"
 #include "Memory.hpp"
 #include "LLMClient.hpp"
+#include "McpClient.hpp"
+#include "MessageStore.hpp"
+#include "SleepTimeAgent.hpp"
+#include "ToolSandbox.hpp"
+#include "ToolSchema.hpp"
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
@@ -10,10 +19,24 @@ using json = nlohmann::json;
 
 class Agent {
 public:
+    // Receives what the agent says to the user (send_message or a raw reply)
+    using MessageHandler = std::function<void(const std::string&)>;
+
     Agent(const std::string& api_key, const std::string& model = "gemini-2.5-flash");
+    ~Agent();
     
-    // Main interaction step
-    void step(const std::string& user_message);
+    // Branch the conversation: the fork starts from this agent's history and
+    // memory and diverges from there. Costs O(1) in the history length (the
+    // messages so far are shared, block values are copy-on-write Ropes) and
+    // forks may step concurrently with each other. Shared blocks stay shared;
+    // sleep-time consolidation is not inherited.
+    std::unique_ptr<Agent> fork();
+
+    // Main interaction step. Returns false if `cancel` fired before the turn
+    // finished: the model call in flight is abandoned and no further tool
+    // rounds start. A tool round already under way completes first, so the
+    // history never holds a tool call without its result.
+    bool step(const std::string& user_message, const CancellationToken& cancel = {});
     
     // Get the current memory state string
     std::string getMemoryDump() const;
@@ -21,20 +44,109 @@ public:
     // Add a new memory block
     void addMemoryBlock(const std::string& label, const std::string& value, int limit = 2000, bool read_only = false);
 
-    // Remove a memory block
+    // Attach a block shared with other agents; edits from any of them show up
+    // in this agent's next prompt
+    void attachSharedBlock(std::shared_ptr<SharedBlock> block);
+
+    // Remove a memory block (detaches a shared one)
     void removeMemoryBlock(const std::string& label);
 
+    // Render the system prompt with a custom template (see PromptTemplate.hpp)
+    void setPromptTemplate(std::shared_ptr<const PromptTemplate> tmpl);
+
+    // Move memory upkeep to a background agent that runs between turns (see
+    // SleepTimeAgent.hpp). Writable blocks become shared with it; blocks added
+    // later stay foreground-only.
+    void enableSleepTime(SleepTimeOptions options = {});
+    void disableSleepTime();
+
+    // nullptr unless sleep-time consolidation is enabled
+    SleepTimeAgent* getSleepTimeAgent() { return sleeper.get(); }
+
+    // Offer the sandbox's tools to the model and run them there (see
+    // ToolSandbox.hpp); forks share the sandbox
+    void setToolSandbox(std::shared_ptr<ToolSandbox> sandbox);
+
+    // Offer an MCP server's tools to the model and call them over its
+    // session (see McpClient.hpp). The tool list follows the server's
+    // list_changed notifications from the next turn on; forks share the
+    // client. Names already taken by another tool are skipped.
+    void addMcpServer(std::shared_ptr<McpClient> server);
+
+    // Replace the default handler, which prints to stdout
+    void setMessageHandler(MessageHandler handler);
+
+    // Unique id; also the fairness key in the shared request scheduler
+    const std::string& getId() const { return id; }
+
+    // Conversation history, system prompt first
+    const MessageStore& getMessages() const { return messages; }
+
+    // Portable copy of the agent (see AgentFile.hpp, AgentSnapshot.hpp).
+    // The history is forked, not copied, so this is cheap however long it is.
+    AgentState snapshot();
+
+    // Replace memory and history with `state`'s. The system prompt is
+    // re-rendered from the restored blocks; the model and tools stay this
+    // agent's own (tools letta-cpp cannot run are reported and kept for
+    // export), as does sleep-time consolidation, which starts from the
+    // restored history's end.
+    void restore(AgentState state);
+
+    // Access the underlying LLM client (transport, hedging policy, stats)
+    LLMClient& getLLMClient() { return llm; }
+
 private:
+    struct ForkTag {};
+    Agent(Agent& parent, ForkTag);
+
+    std::string id;
+    std::string api_key;
+    std::string model;
     Memory memory;
     LLMClient llm;
-    std::vector<json> messages;
+    MessageStore messages;
     
     // Tools
     std::vector<json> tools;
+    ToolSchemas tool_schemas; // arguments are checked against these before a tool runs
+    std::shared_ptr<ToolSandbox> sandbox;
+    std::vector<std::shared_ptr<McpClient>> mcp_servers;
+    uint64_t mcp_tools_version = 0; // sum of toolsVersion() tools were built from
+
+    MessageHandler message_handler;
+
+    // What restore() took that the agent itself has no use for (name, base
+    // instructions, tool records, extra .af fields), handed back by snapshot()
+    AgentState imported;
+
+    // memory.version() the system prompt was last rendered from
+    uint64_t rendered_version = 0;
+    std::string prompt_buffer; // reused across renders
+
+    std::unique_ptr<SleepTimeAgent> sleeper;
+    size_t handed_off = 0; // messages before this index were given to the sleeper
 
     // Helper: Rebuild system prompt
     void rebuildSystemPrompt();
+
+    // Helper: Rebuild only if memory changed since the last render
+    void refreshSystemPrompt();
     
+    // Helper: The turn loop behind step(); false if cancelled
+    bool runTurn(const std::string& user_message, const CancellationToken& cancel);
+
+    // Helper: Built-in tools for the current mode plus the sandbox's and the
+    // MCP servers'
+    void rebuildTools();
+
+    // Helper: Sum of the MCP servers' tool list versions
+    uint64_t mcpToolsVersion() const;
+
     // Helper: Execute a tool call
     json executeTool(const std::string& tool_name, const json& arguments);
+
+    // Helper: Check a call's raw arguments and execute it, or return the
+    // error result the model gets to correct itself from
+    json runToolCall(const std::string& tool_name, const json& raw_arguments);
 };
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Memory.hpp"
+#include "MessageStore.hpp"
+#include <iosfwd>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+class AgentFileError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// An agent's portable state: what Agent::snapshot() produces and
+// Agent::restore() takes, and what agent files and binary snapshots hold.
+struct AgentState {
+    std::string name;
+    std::string model;
+    std::string system;                // Letta's base instructions ("system")
+    std::string agent_type = "memgpt_agent";
+    std::vector<MemoryBlock> blocks;   // in prompt order
+    MessageStore messages;             // the in-context history, system prompt first
+    std::vector<json> tools;           // OpenAI-style schemas the agent offers
+    // Tool records from an imported file, verbatim (source code and all), so
+    // tools letta-cpp cannot run survive a round trip
+    std::vector<json> tool_records;
+    // Top-level .af fields letta-cpp has no use for (llm_config, tool_rules,
+    // tags, ...), exported back unchanged
+    json extra = json::object();
+};
+
+struct AgentFileStats {
+    size_t messages_read = 0;    // in the file
+    size_t messages_kept = 0;    // in context, so imported
+    uint64_t bytes = 0;
+};
+
+// Letta agent files (.af): the JSON document the Python server exports,
+// with core_memory, messages, in_context_message_indices and tools at the
+// top level.
+//
+// Both directions stream. read() runs a SAX parse over a small buffer and
+// only ever materialises one message (or one top-level field) as JSON
+// before converting it into the MessageStore, so memory is the imported
+// state plus a buffer, not the document. Messages outside
+// in_context_message_indices are dropped as they stream past when the
+// indices come first (as Letta writes them, keys sorted), or afterwards
+// otherwise. write() emits one message at a time.
+class AgentFile {
+public:
+    static AgentState read(std::istream& in, AgentFileStats* stats = nullptr);
+    static AgentState read(const std::string& path, AgentFileStats* stats = nullptr);
+
+    static void write(std::ostream& out, const AgentState& state);
+    static void write(const std::string& path, const AgentState& state);
+
+    // One .af message object in and out of a store
+    static bool appendMessage(MessageStore& messages, const json& message);
+    static json messageJson(const MessageStore::Message& message, const std::string& model);
+};
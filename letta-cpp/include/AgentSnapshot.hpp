@@ -0,0 +1,39 @@
+#pragma once
+
+#include "AgentFile.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+class AgentSnapshotError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Binary agent snapshots: the same AgentState as an .af file, laid out so a
+// cold load is a few bulk copies instead of a parse.
+//
+// Layout (host byte order; a marker in the header rejects foreign files):
+//   header    "LETTASNP", version, byte-order marker, section count, file size
+//   table     per section: kind, flags, offset, length
+//   sections  each 8-byte aligned, so the u32 columns are read in place
+//     Fields     JSON: name, model, system, agent_type, tools, tool_records, extra
+//     Blocks     per block: limit, read_only, label and value (length-prefixed)
+//     Roles      one byte per message
+//     Contents   (offset, length) into Pool per message
+//     CallBegin  message count + 1 indices into ToolCalls
+//     ToolCalls  (offset, length) for id, name and arguments per call
+//     Pool       all message text
+// which is MessageStore's own column layout, so read() hands the mapped
+// columns to MessageStore::fromColumns. Unknown section kinds are skipped, so
+// later versions can add sections older readers ignore.
+class AgentSnapshot {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    static void write(const std::string& path, const AgentState& state);
+
+    // Maps the file and validates every offset before copying anything out;
+    // throws AgentSnapshotError for a file that is not a valid snapshot
+    static AgentState read(const std::string& path);
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+// Cooperative cancellation for an agent step and the requests it waits on.
+//
+// A token is a cheap handle to shared state: copies observe and trigger the
+// same cancellation, so a REPL thread can hold one while the step it was
+// passed to runs elsewhere. Code that polls reads cancelled() or hands flag()
+// to a transport or the request scheduler; code that blocks registers an
+// onCancel() callback to be woken. Cancelling is idempotent.
+class CancellationToken {
+public:
+    // Unregisters its callback when destroyed. If cancel() is running the
+    // callback at that moment, waits for it to return.
+    class Registration {
+    public:
+        Registration() = default;
+        Registration(Registration&& other) noexcept;
+        Registration& operator=(Registration&& other) noexcept;
+        Registration(const Registration&) = delete;
+        Registration& operator=(const Registration&) = delete;
+        ~Registration();
+
+    private:
+        friend class CancellationToken;
+        struct State;
+        std::shared_ptr<State> state;
+        uint64_t id = 0;
+        void reset();
+    };
+
+    CancellationToken();
+
+    // Raise the flag and run the registered callbacks on this thread
+    void cancel();
+
+    bool cancelled() const { return flag().load(std::memory_order_acquire); }
+
+    // For HttpTransport and RequestScheduler::acquire, which poll an atomic
+    const std::atomic<bool>& flag() const;
+
+    // Run `callback` once when the token is cancelled, or right away if it
+    // already is. Callbacks run under the token's lock: keep them short and
+    // do not register or cancel from inside one.
+    [[nodiscard]] Registration onCancel(std::function<void()> callback) const;
+
+    // Sleep for `duration` unless cancelled first; false if cancelled
+    bool sleepFor(std::chrono::steady_clock::duration duration) const;
+
+    // When cancel() was first called (epoch if not yet)
+    std::chrono::steady_clock::time_point cancelledAt() const;
+
+private:
+    std::shared_ptr<Registration::State> state;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// HTTP content codings for request and response bodies. gzip is always
+// available; zstd when built with libzstd (LETTA_HAVE_ZSTD).
+enum class ContentCoding { Identity, Gzip, Zstd };
+
+class CompressionError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Token as used in Content-Encoding / Accept-Encoding
+const char* codingName(ContentCoding coding);
+
+// Coding for a Content-Encoding value; Identity for anything unknown
+ContentCoding parseCoding(std::string_view name);
+
+// Whether this build can produce and decode `coding`
+bool codingSupported(ContentCoding coding);
+
+// Accept-Encoding value offering every coding this build decodes, best first
+const std::string& acceptEncodingHeader();
+
+// What to encode with for a server whose Accept-Encoding is `accept_encoding`
+// (RFC 7694 servers send one with a 415): `preferred` if listed, else the best
+// other coding this build supports, else Identity. Honours q=0.
+ContentCoding pickCoding(std::string_view accept_encoding, ContentCoding preferred);
+
+// Streaming encoder: write the body in pieces and compressed bytes are
+// appended to `out` as they become available, so the whole uncompressed body
+// never has to be held next to the compressed one.
+class Encoder {
+public:
+    // `level` in the codec's own range (gzip 1-9, zstd 1-19); 0 for its default
+    Encoder(ContentCoding coding, int level);
+    ~Encoder();
+    Encoder(const Encoder&) = delete;
+    Encoder& operator=(const Encoder&) = delete;
+
+    void write(std::string_view data, std::string& out);
+    // Flush everything and end the stream; the encoder is spent afterwards
+    void finish(std::string& out);
+
+    ContentCoding coding() const { return kind; }
+    size_t bytesIn() const { return bytes_in; }
+
+private:
+    struct State;
+    ContentCoding kind;
+    std::unique_ptr<State> state;
+    size_t bytes_in = 0;
+};
+
+std::string encode(ContentCoding coding, std::string_view data, int level = 0);
+
+// Throws CompressionError on corrupt input, a coding this build lacks, or
+// output past `limit` bytes
+std::string decode(ContentCoding coding, std::string_view data, size_t limit = size_t{1} << 30);
+
+// Fraction of the machine's CPUs that are idle (1-minute load average against
+// the CPU count), refreshed at most once a second
+double cpuHeadroom();
+
+// Level for a body of `bytes` that minimises the time to compress it plus
+// the time to upload the result at `egress_bytes_per_sec`, from measured
+// per-level speeds and ratios on chat-completion payloads. Compression is
+// counted as slower by the fraction of CPU that is busy (see cpuHeadroom), so
+// a loaded machine or a fast link gets a cheaper level, and large bodies
+// (whose ratio keeps improving with effort) a higher one. 0 when even the
+// cheapest level loses to sending the body as is.
+int adaptiveLevel(ContentCoding coding, size_t bytes, double headroom, double egress_bytes_per_sec);
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "HttpTransport.hpp"
+#include "Ingestion.hpp"
+#include "RequestScheduler.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct EmbeddingCacheOptions {
+    size_t capacity = 100000;   // vectors held in memory, across all shards; 0 keeps none
+    size_t shards = 16;
+    std::string disk_path;      // optional second tier; empty keeps the cache in memory
+};
+
+// Embedding vectors keyed by a 128-bit hash of (model, text).
+//
+// The memory tier is an LRU split into independently locked shards, so
+// lookups from many threads rarely contend. The optional disk tier is an
+// append-only file of [key, dimension, float32 values] records, written
+// through on every put and indexed in memory by offset at open; a vector
+// evicted from memory (or from a previous process) is read back from there
+// and promoted. A torn final record is cut off at open.
+class EmbeddingCache {
+public:
+    struct Key {
+        uint64_t hi = 0, lo = 0;
+        bool operator==(const Key& other) const { return hi == other.hi && lo == other.lo; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(key.lo); }
+    };
+
+    static Key key(std::string_view model, std::string_view text);
+
+    explicit EmbeddingCache(EmbeddingCacheOptions options = {});
+    ~EmbeddingCache();
+    EmbeddingCache(const EmbeddingCache&) = delete;
+    EmbeddingCache& operator=(const EmbeddingCache&) = delete;
+
+    bool get(const Key& key, std::vector<float>& out);
+    void put(const Key& key, const std::vector<float>& vector);
+
+    size_t size() const;                               // in memory
+    size_t diskSize() const;                           // on disk
+    uint64_t diskHits() const { return disk_hits.load(); }
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<std::pair<Key, std::vector<float>>> lru; // most recent first
+        std::unordered_map<Key, std::list<std::pair<Key, std::vector<float>>>::iterator, KeyHash> index;
+    };
+
+    EmbeddingCacheOptions opts;
+    size_t shard_capacity;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    int disk_fd = -1;
+    mutable std::mutex disk_mutex;
+    std::unordered_map<Key, uint64_t, KeyHash> disk_index; // record offsets
+    uint64_t disk_end = 0;
+    std::atomic<uint64_t> disk_hits{0};
+
+    // Helper: Shard for a key
+    Shard& shardFor(const Key& key) { return *shards[key.hi % shards.size()]; }
+
+    // Helper: Insert into the memory tier, evicting the shard's oldest
+    void remember(Shard& shard, const Key& key, std::vector<float> vector);
+
+    // Helper: Open the disk tier and index its records
+    void openDisk();
+
+    // Helper: Read a vector from the disk tier
+    bool readDisk(const Key& key, std::vector<float>& out);
+};
+
+struct EmbeddingBatchPolicy {
+    std::chrono::microseconds window{2000}; // how long the first caller holds a batch open
+    size_t max_batch = 256;                 // inputs per request; a full batch goes at once
+};
+
+// Text embeddings from an OpenAI-compatible /embeddings endpoint, or from
+// Gemini's batchEmbedContents when the base URL is Google's.
+//
+// Concurrent embed() calls are micro-batched: the first caller with texts
+// the cache does not hold opens a batch and waits up to `window` (or until
+// `max_batch` inputs have joined) before sending it; callers arriving in the
+// meantime add their texts and wait for the same request. A text already
+// in flight for another caller is not requested twice. Requests go through
+// the RequestScheduler like LLMClient's do, and 429s are retried after the
+// scheduler backs the model off.
+class EmbeddingClient {
+public:
+    EmbeddingClient(const std::string& api_key, const std::string& base_url = "https://api.openai.com/v1",
+                    const std::string& model = "text-embedding-3-small", EmbeddingCacheOptions cache = {});
+    EmbeddingClient(const EmbeddingClient&) = delete;
+    EmbeddingClient& operator=(const EmbeddingClient&) = delete;
+
+    // One vector per text, in order. Throws std::runtime_error if the
+    // provider fails.
+    std::vector<std::vector<float>> embed(const std::vector<std::string_view>& texts);
+    std::vector<float> embed(std::string_view text);
+
+    // For IngestionPipeline
+    EmbeddingBackend backend();
+
+    // Replace the HTTP transport (e.g. with a local stand-in for tests)
+    void setTransport(HttpTransport transport);
+    void setBatchPolicy(const EmbeddingBatchPolicy& policy);
+    void setScheduler(RequestScheduler& scheduler);
+    void setSchedulingContext(const std::string& agent_id, RequestPriority priority);
+    void setMaxRateLimitRetries(int retries) { max_rate_limit_retries = retries; }
+
+    const std::string& getModel() const { return model; }
+    EmbeddingCache& cache() { return *vectors; }
+
+    // Texts answered from the cache (either tier), texts that were not (and
+    // were fetched or joined a fetch already in flight), provider requests
+    uint64_t hits() const { return cache_hits.load(); }
+    uint64_t misses() const { return cache_misses.load(); }
+    uint64_t requests() const { return requests_sent.load(); }
+
+private:
+    // One text being fetched; shared by every caller waiting on it
+    struct Slot {
+        std::vector<float> vector;
+        std::string error;
+        bool done = false;
+    };
+    struct Batch {
+        std::chrono::steady_clock::time_point opened;
+        std::vector<std::string> texts;
+        std::vector<EmbeddingCache::Key> keys;
+        std::vector<std::shared_ptr<Slot>> slots;
+    };
+
+    std::string api_key;
+    std::string base_url;
+    std::string model;
+    HttpTransport transport;
+    EmbeddingBatchPolicy policy;
+    std::unique_ptr<EmbeddingCache> vectors;
+
+    RequestScheduler* scheduler;
+    std::string agent_id = "default";
+    RequestPriority priority = RequestPriority::Interactive;
+    int max_rate_limit_retries = 3;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::shared_ptr<Batch> forming; // open for joiners
+    // Texts requested but not answered yet, across all batches
+    std::unordered_map<EmbeddingCache::Key, std::shared_ptr<Slot>, EmbeddingCache::KeyHash> in_flight;
+
+    std::atomic<uint64_t> cache_hits{0};
+    std::atomic<uint64_t> cache_misses{0};
+    std::atomic<uint64_t> requests_sent{0};
+
+    // Helper: Send one batch and fill its slots
+    void send(Batch& batch);
+
+    // Helper: One provider request for `texts`; throws on failure
+    std::vector<std::vector<float>> request(const std::vector<std::string>& texts);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+
+struct HttpRequest {
+    std::string url;
+    std::map<std::string, std::string> headers;
+    std::string body;
+    size_t identity_size = 0; // body size before its Content-Encoding; 0 if sent as is
+};
+
+struct HttpResponse {
+    long status_code = 0; // 0 means the transfer itself failed (see error)
+    std::string text;
+    std::string error;
+    std::map<std::string, std::string> headers;
+
+    HttpResponse() = default;
+    HttpResponse(long status_code, std::string text, std::string error = "",
+                 std::map<std::string, std::string> headers = {})
+        : status_code(status_code), text(std::move(text)), error(std::move(error)), headers(std::move(headers)) {}
+};
+
+// A transport performs one POST. Implementations should poll `cancelled` and
+// return as soon as it becomes true (status 0, error "cancelled"), aborting
+// the transfer if they can.
+using HttpTransport = std::function<HttpResponse(const HttpRequest&, const std::atomic<bool>& cancelled)>;
+
+// Default transport: libcurl transfers on one multi handle per transport.
+// Honours `cancelled` within a few ms and closes the abandoned connection.
+HttpTransport makeCurlTransport();
+
+// Value of a response header, matched case-insensitively; "" if absent
+std::string headerValue(const HttpResponse& response, const std::string& name);
+
+// How long a 429 asks us to wait (Retry-After in seconds); 1 s if unstated
+std::chrono::milliseconds retryAfter(const HttpResponse& response);
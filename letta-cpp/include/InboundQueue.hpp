@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Agent.hpp"
+#include "Cancellation.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+struct InboundPolicy {
+    // After a message arrives, wait this long for the next one before
+    // starting a turn; every arrival restarts the wait
+    std::chrono::milliseconds debounce{250};
+    // ...but never hold the oldest waiting message longer than this
+    std::chrono::milliseconds max_delay{2000};
+    size_t max_messages = 16;        // per turn; the rest wait for the next one
+    size_t max_bytes = 16384;        // per turn; a single larger message still goes alone
+    bool interrupt = false;          // a message arriving mid-step cancels the step
+    std::string separator = "\n\n";  // between coalesced messages
+};
+
+struct InboundStats {
+    uint64_t messages = 0;    // posted
+    uint64_t turns = 0;       // Agent::step calls made
+    uint64_t coalesced = 0;   // messages that rode along in another's turn
+    uint64_t interrupted = 0; // steps cancelled by a newer message
+    uint64_t largest_turn = 0;
+
+    // Each message would otherwise have been a step with at least one LLM
+    // round trip over the whole history
+    uint64_t llmCallsSaved() const { return coalesced; }
+};
+
+// Per-agent inbox that turns bursts of user messages into single turns.
+//
+// Messages posted while the agent is stepping, or within `debounce` of each
+// other, are joined (in posting order, with `separator`) into one user
+// message and handed to Agent::step on the queue's worker thread. Ordering
+// guarantees:
+//   - messages reach the agent in the order post() returned them ids, never
+//     split or reordered across turns
+//   - turns never overlap; the next starts after the previous step returns
+//   - a message is in the turn that was forming when it arrived, or a later
+//     one
+// With `interrupt`, a message arriving mid-step cancels that step (see
+// Agent::step) and goes out with the rest of the burst as the next turn;
+// the cancelled turn's message stays in the history without a reply, so the
+// model still sees it.
+//
+// While a queue is attached, only its worker may step the agent.
+class InboundQueue {
+public:
+    explicit InboundQueue(Agent& agent, InboundPolicy policy = {});
+    ~InboundQueue(); // runs the messages already posted, then stops
+    InboundQueue(const InboundQueue&) = delete;
+    InboundQueue& operator=(const InboundQueue&) = delete;
+
+    // Queue a message; returns its id (1, 2, ...)
+    uint64_t post(std::string message);
+
+    // Block until the turn holding message `id` has finished
+    void waitFor(uint64_t id);
+
+    // Block until every posted message has been through a turn
+    void drain();
+
+    InboundStats stats() const;
+    const InboundPolicy& policy() const { return opts; }
+
+private:
+    Agent& agent;
+    InboundPolicy opts;
+
+    mutable std::mutex mutex;
+    std::condition_variable arrived;  // worker waits for messages / quiet
+    std::condition_variable finished; // waitFor() waits for turns to end
+    std::deque<std::string> pending;
+    std::chrono::steady_clock::time_point oldest_arrival;
+    std::chrono::steady_clock::time_point latest_arrival;
+    uint64_t next_id = 1;
+    uint64_t done_through = 0;        // every id up to this one has been handled
+    std::optional<CancellationToken> running;
+    bool stopping = false;
+    InboundStats counters;
+
+    std::thread worker;
+
+    // Helper: Worker loop
+    void run();
+
+    // Helper: Pop the next turn's messages (lock held); returns how many
+    size_t takeTurn(std::string& turn);
+};
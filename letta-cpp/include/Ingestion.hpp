@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+struct ChunkerOptions {
+    size_t chunk_tokens = 300;         // DEFAULT_EMBEDDING_CHUNK_SIZE in the Python server
+    size_t overlap_tokens = 0;         // carried over from the end of the previous chunk
+    size_t segment_bytes = 1u << 20;   // unit of parallel work; see TextChunker
+};
+
+// A passage-to-be: a byte range of one document
+struct Chunk {
+    uint32_t document = 0;
+    uint64_t offset = 0;
+    uint32_t length = 0;
+    uint32_t tokens = 0;
+};
+
+// Splits text into chunks of at most `chunk_tokens` tokens, cutting only
+// between words and preferring paragraph breaks, then sentence ends, in the
+// second half of a chunk. Tokens are the ~4 bytes/token estimate the
+// scheduler uses, counted per word, so a word is never split unless it alone
+// is over the limit (then it is cut on UTF-8 character boundaries).
+//
+// For parallel chunking a document is first cut into segments near every
+// `segment_bytes`, snapped to the next paragraph break (or line break, or
+// space). Cuts depend only on the text, so the chunks come out the same for
+// any number of threads; chunks never span a segment cut.
+class TextChunker {
+public:
+    explicit TextChunker(ChunkerOptions options = {});
+
+    // Segment cuts: 0, ..., text.size()
+    std::vector<size_t> segments(std::string_view text) const;
+
+    // Chunk text[begin, end), appending to `out`; offsets are into `text`
+    void chunkSegment(std::string_view text, size_t begin, size_t end, uint32_t document,
+                      std::vector<Chunk>& out) const;
+
+    // Every segment in order, on the calling thread
+    std::vector<Chunk> chunk(std::string_view text, uint32_t document = 0) const;
+
+    const ChunkerOptions& options() const { return opts; }
+
+private:
+    ChunkerOptions opts;
+};
+
+// Append-only file of embedded passages, one JSON object per line. The first
+// line records the settings the passages were made with; a store is only
+// resumed with the same ones. A passage is keyed by its document path, the
+// document's fingerprint (size and mtime) and its byte offset, so a changed
+// document is ingested again under its new fingerprint (the old passages
+// stay). Embeddings are little-endian float32, base64-encoded.
+class PassageStore {
+public:
+    struct Passage {
+        std::string document;
+        std::string fingerprint;
+        uint64_t offset = 0;
+        std::string text;
+        std::vector<float> embedding;
+    };
+
+    PassageStore() = default;
+    ~PassageStore();
+    PassageStore(const PassageStore&) = delete;
+    PassageStore& operator=(const PassageStore&) = delete;
+
+    // Create or resume the store at `path`. A torn last line (from a run that
+    // died mid-write) is cut off. False, with `error` set, if the file holds
+    // passages made with different settings or cannot be opened.
+    bool open(const std::string& path, const json& settings, std::string& error);
+
+    bool contains(const std::string& document, const std::string& fingerprint, uint64_t offset) const;
+
+    // Write passages as one append; thread-safe
+    bool append(const std::vector<Passage>& passages);
+
+    // Flush to disk
+    void sync();
+
+    size_t size() const { return passage_count.load(); }
+
+    // Every passage in the file, in write order
+    static std::vector<Passage> readAll(const std::string& path);
+
+private:
+    int fd = -1;
+    std::unordered_set<std::string> keys;
+    std::atomic<size_t> passage_count{0};
+    std::mutex write_mutex;
+
+    // Helper: Lookup key for a passage
+    static std::string key(const std::string& document, const std::string& fingerprint, uint64_t offset);
+};
+
+// Embeds a batch of texts, one vector per text, in order. Throws on failure.
+// The views point into mapped documents and are valid for the call only.
+using EmbeddingBackend = std::function<std::vector<std::vector<float>>(const std::vector<std::string_view>& texts)>;
+
+struct IngestionStats {
+    uint64_t documents = 0;
+    uint64_t bytes = 0;
+    uint64_t chunks = 0;           // found by the chunker
+    uint64_t skipped = 0;          // already in the store
+    uint64_t embedded = 0;         // written this run
+    uint64_t failed = 0;           // embedding gave up on them; a rerun retries
+    uint64_t requests = 0;         // embedding calls, retries included
+    size_t batch_size = 0;         // where the adaptive batch size ended up
+    double seconds = 0;
+    std::string error;             // set when the run could not start
+
+    bool ok() const { return error.empty() && failed == 0; }
+};
+
+struct IngestionOptions {
+    ChunkerOptions chunker;
+    std::string embedding_model;        // recorded in the store's settings
+    size_t threads = 0;                 // chunking threads; 0 = one per core
+    size_t max_in_flight = 3;           // concurrent embedding requests
+    size_t initial_batch = 32;          // chunks per request to start with
+    size_t max_batch = 200;             // EMBEDDING_BATCH_SIZE in the Python server
+    size_t max_batch_tokens = 100000;   // per request, by the chunker's estimate
+    std::chrono::milliseconds target_latency{2000}; // per request; batches adapt toward it
+    std::function<void(const IngestionStats&)> on_progress; // after each stored batch
+};
+
+// Loads documents into a PassageStore: files are mapped, chunked on
+// `threads` threads and handed to up to `max_in_flight` concurrent embedding
+// calls through a bounded queue, so chunking runs ahead of embedding only so
+// far. Batch size adapts per request: it grows while requests come back well
+// under `target_latency` and halves when one runs over or fails. A failed
+// batch is split and retried down to single chunks before those are given up
+// on. Passages are stored as their batch completes, so a rerun on the same
+// store picks up where an interrupted one stopped.
+class IngestionPipeline {
+public:
+    IngestionPipeline(EmbeddingBackend backend, IngestionOptions options = {});
+
+    IngestionStats run(const std::vector<std::string>& paths, const std::string& store_path);
+
+    const IngestionOptions& options() const { return opts; }
+
+private:
+    EmbeddingBackend embed;
+    IngestionOptions opts;
+};
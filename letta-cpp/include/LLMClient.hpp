@@ -1,22 +1,191 @@
 #pragma once
 
+#include "Cancellation.hpp"
+#include "Compression.hpp"
+#include "HttpTransport.hpp"
+#include "LatencyHistogram.hpp"
+#include "MessageStore.hpp"
+#include "RequestScheduler.hpp"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
+// Optional request hedging: if the primary request has not answered within the
+// `percentile` of recent latency, counted from when the scheduler admitted it,
+// fire a duplicate (optionally to a secondary model/base URL). The first
+// response wins and the other is cancelled. A primary that answers before the
+// delay is returned as is, whether it failed (transport error, 4xx/5xx) or
+// replied in plain text where tools were offered.
+struct HedgingPolicy {
+    bool enabled = false;
+    double percentile = 0.95;
+    std::chrono::milliseconds min_delay{50};        // never hedge earlier than this
+    std::chrono::milliseconds initial_delay{2000};  // used until enough samples are recorded
+    uint64_t min_samples = 20;
+    std::string secondary_base_url;                 // empty: same as primary
+    std::string secondary_model;                    // empty: same as primary
+    // Opt-in: with tools offered, only a response carrying a well-formed tool
+    // call wins, and a primary that answers 200 without one is re-asked at once
+    bool reask_without_tool_call = false;
+};
+
+// Compressed transport for long-context payloads. Request bodies past
+// `min_bytes` are compressed while they are serialized and sent with
+// Content-Encoding; responses are asked for compressed (Accept-Encoding) and
+// decoded. A server that does not take the coding answers 415: the body is
+// re-sent the way its Accept-Encoding asks (RFC 7694) and that sticks for the
+// endpoint, as does an Accept-Encoding it volunteers on any response.
+struct CompressionPolicy {
+    bool enabled = false;
+    ContentCoding coding = ContentCoding::Zstd; // gzip where zstd is not built in
+    size_t min_bytes = 32 * 1024;               // smaller bodies are sent as they are
+    int level = 0;                              // 0: adaptiveLevel() for each body
+    double egress_bytes_per_sec = 2.5e6;        // upload bandwidth the adaptive level assumes
+    bool accept_compressed = true;              // offer Accept-Encoding for responses
+};
+
+// Constrained decoding on OpenAI-compatible local backends (llama.cpp server,
+// vLLM). Each request carries a grammar or regex, compiled from the offered
+// tools' schemas (see ToolSchema.hpp), that only admits one call to one of
+// them with valid arguments, written as {"name": ..., "arguments": {...}};
+// a reply whose content is such a call is turned back into a tool call.
+// Not used for Gemini.
+struct GuidedDecoding {
+    enum class Format { None, Gbnf, Regex };
+    Format format = Format::None;
+    std::string field = "grammar"; // "grammar" (llama.cpp), "guided_grammar" / "guided_regex" (vLLM)
+    bool send_tools = true;        // llama.cpp refuses a grammar alongside "tools"
+};
+
 class LLMClient {
 public:
     LLMClient(const std::string& api_key, const std::string& base_url = "https://api.openai.com/v1", const std::string& model = "gpt-4");
 
-    json chatCompletion(const std::vector<json>& messages, const std::vector<json>& tools = {});
+    // Same endpoint, transport, policies and scheduler. Hedge counters start at
+    // zero; the latency histogram is shared since it describes the endpoint.
+    LLMClient(const LLMClient& other);
+    LLMClient& operator=(const LLMClient&) = delete;
+
+    // Returns {"error": "cancelled"} as soon as `cancel` fires, whether the
+    // request is queued in the scheduler or on the wire; hedges are torn down
+    // with it.
+    json chatCompletion(const MessageStore& messages, const std::vector<json>& tools = {},
+                        const CancellationToken& cancel = {});
+    json chatCompletion(const std::vector<json>& messages, const std::vector<json>& tools = {},
+                        const CancellationToken& cancel = {});
+
+    // The provider adapters on their own, for callers that do their own I/O
+    // (see letta_core.h): the request chatCompletion would send for this
+    // client's endpoint, and a provider response in the OpenAI shape
+    HttpRequest prepareRequest(const MessageStore& messages, const std::vector<json>& tools = {}) const;
+    json normalizeResponse(const HttpResponse& response) const;
+
+    // Replace the HTTP transport (e.g. with a local stand-in for tests)
+    void setTransport(HttpTransport transport);
+
+    void setCompressionPolicy(const CompressionPolicy& policy);
+    const CompressionPolicy& getCompressionPolicy() const { return compression; }
+    // How request bodies are encoded for this endpoint now (after negotiation)
+    ContentCoding requestCoding() const { return request_coding->load(); }
+
+    void setGuidedDecoding(const GuidedDecoding& guided);
+    const GuidedDecoding& getGuidedDecoding() const { return guided; }
+
+    void setHedgingPolicy(const HedgingPolicy& policy);
+    const HedgingPolicy& getHedgingPolicy() const { return hedging; }
+
+    // Latency of completed requests, from the primary's admission when hedged;
+    // drives the hedge threshold
+    const LatencyHistogram& latencyHistogram() const { return *latency; }
+
+    // Delay after which a hedge would currently be fired
+    std::chrono::milliseconds hedgeDelay() const;
+
+    // Admission control shared with other clients (global scheduler by default)
+    void setScheduler(RequestScheduler& scheduler);
+    void setSchedulingContext(const std::string& agent_id, RequestPriority priority);
+    void setMaxRateLimitRetries(int retries) { max_rate_limit_retries = retries; }
+
+    // Number of duplicate requests fired / won since construction
+    uint64_t hedgesFired() const { return hedges_fired.load(); }
+    uint64_t hedgesWon() const { return hedges_won.load(); }
+
+    // Endpoint a request is sent to; Gemini is detected from the base URL
+    struct Target {
+        std::string base_url;
+        std::string model;
+    };
 
 private:
     std::string api_key;
     std::string base_url;
     std::string model;
-    
+
+    HttpTransport transport;
+    HedgingPolicy hedging;
+    GuidedDecoding guided;
+    CompressionPolicy compression;
+    // Negotiated request coding, shared with copies like the latency histogram
+    std::shared_ptr<std::atomic<ContentCoding>> request_coding;
+
+    // The guided-decoding grammar for the last tool list seen. Tool lists
+    // change rarely (Agent::rebuildTools), so compiling the schemas once per
+    // list rather than per request (and per hedge) is enough.
+    struct GrammarCache {
+        std::mutex mutex;
+        GuidedDecoding::Format format = GuidedDecoding::Format::None;
+        std::vector<json> tools;
+        std::shared_ptr<const std::string> grammar;
+    };
+    std::shared_ptr<GrammarCache> grammar_cache;
+    std::shared_ptr<LatencyHistogram> latency;
+    std::atomic<uint64_t> hedges_fired{0};
+    std::atomic<uint64_t> hedges_won{0};
+
+    RequestScheduler* scheduler;
+    std::string agent_id = "default";
+    RequestPriority priority = RequestPriority::Interactive;
+    int max_rate_limit_retries = 3;
+
+    // Everything needed to send one request through the scheduler. Copied into
+    // hedge threads so they never touch the client after it returns.
+    struct Dispatch {
+        HttpTransport transport;
+        RequestScheduler* scheduler;
+        std::string agent_id;
+        RequestPriority priority;
+        int max_rate_limit_retries;
+        CompressionPolicy compression;
+        std::shared_ptr<std::atomic<ContentCoding>> request_coding;
+
+        // Admit, send, back off/retry on 429 and re-encode on 415, and decode
+        // the response body. `transport_time` excludes queueing. `on_wire`, if
+        // set, is called with true each time the scheduler admits the request
+        // and with false when a 429 sends it back to the scheduler.
+        HttpResponse send(const Target& target, const HttpRequest& request, uint64_t estimated_tokens,
+                          const std::atomic<bool>& cancelled, std::chrono::microseconds& transport_time,
+                          const std::function<void(bool)>& on_wire = nullptr) const;
+        // Report provider token usage back to the scheduler
+        void reconcile(const Target& target, uint64_t estimated_tokens, const json& response) const;
+    };
+    Dispatch makeDispatch() const;
+
+    // Helper: Provider adapters (request building / response normalisation)
+    HttpRequest buildRequest(const Target& target, const MessageStore& messages, const std::vector<json>& tools) const;
+    static json parseResponse(const Target& target, const HttpResponse& response);
+    // Helper: The guided-decoding grammar for `tools`, from grammar_cache
+    std::shared_ptr<const std::string> guidedGrammar(const std::vector<json>& tools) const;
+
+    // Helper: Race primary against a delayed hedge
+    json hedgedCompletion(const MessageStore& messages, const std::vector<json>& tools,
+                          const CancellationToken& cancel);
+
     // Helper to print debug info
     void printDebug(const std::string& label, const std::string& content);
 };
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Log-linear latency histogram (8 sub-buckets per power of two, ~12% relative
+// error). Recording is lock-free. Once `window` samples have been recorded the
+// counts are halved, so percentiles track recent latency rather than the whole
+// process lifetime.
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(uint64_t window = 1024);
+
+    void record(std::chrono::microseconds latency);
+
+    // Latency at quantile q in [0, 1]. Returns zero when empty.
+    std::chrono::microseconds percentile(double q) const;
+
+    // Number of samples currently weighted in the histogram
+    uint64_t count() const;
+
+    void reset();
+
+private:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int NUM_BUCKETS = 40 * SUB_BUCKETS;
+
+    static int bucketFor(uint64_t micros);
+    static uint64_t upperBoundOf(int bucket);
+
+    void decay();
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets;
+    std::atomic<uint64_t> total{0};
+    std::atomic<bool> decaying{false};
+    uint64_t window;
+};
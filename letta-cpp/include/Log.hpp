@@ -0,0 +1,119 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Structured, asynchronous logging.
+//
+// Producers copy the record (level, component, message, key/value fields) into
+// a lock-free single-producer ring owned by their thread; a background sink
+// thread does the formatting and the I/O. Nothing on the request path takes a
+// global lock or flushes a stream.
+//
+// Levels are filtered twice: LETTA_LOG_COMPILED_LEVEL removes calls below it
+// at compile time, Log::setLevel() filters at runtime. Use the LETTA_LOG_*
+// macros so that disabled calls do not even evaluate their arguments.
+
+enum class LogLevel : uint8_t {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5
+};
+
+#ifndef LETTA_LOG_COMPILED_LEVEL
+#define LETTA_LOG_COMPILED_LEVEL 0
+#endif
+
+constexpr int kLogCompiledLevel = LETTA_LOG_COMPILED_LEVEL;
+
+// True if calls at `level` survive compile-time filtering
+constexpr bool logCompiledIn(LogLevel level) {
+    return static_cast<int>(level) >= kLogCompiledLevel;
+}
+
+enum class LogFormat {
+    Text, // 2026-01-01T00:00:00.000Z INFO  [agent] message key=value
+    Json  // one JSON object per line
+};
+
+class LogField {
+public:
+    LogField(const char* key, std::string_view value) : key(key), view(value) {}
+    LogField(const char* key, const std::string& value) : key(key), view(value) {}
+    LogField(const char* key, const char* value) : key(key), view(value ? value : "") {}
+    LogField(const char* key, bool value) : key(key), view(value ? "true" : "false") {}
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    LogField(const char* key, T value) : key(key) {
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        owned = static_cast<uint8_t>(result.ptr - buffer);
+    }
+
+    LogField(const char* key, double value);
+
+    std::string_view name() const { return key; }
+    // Numbers are rendered into the field itself, so read through value()
+    std::string_view value() const { return owned ? std::string_view(buffer, owned) : view; }
+
+private:
+    const char* key;
+    std::string_view view;
+    char buffer[32];
+    uint8_t owned = 0;
+};
+
+class Log {
+public:
+    // Receives formatted output, one or more complete lines at a time
+    using Sink = std::function<void(std::string_view)>;
+
+    static void setLevel(LogLevel level);
+    static LogLevel level();
+    static bool enabled(LogLevel level);
+
+    // Parse "trace" / "debug" / "info" / "warn" / "error" / "off"
+    static LogLevel parseLevel(const std::string& name, LogLevel fallback = LogLevel::Info);
+
+    static void setFormat(LogFormat format);
+
+    // Default sink writes to stderr
+    static void setSink(Sink sink);
+
+    // Synchronous mode formats and writes on the calling thread under a lock
+    // and flushes after every record (the old std::endl behaviour). Handy when
+    // debugging crashes; slow under load.
+    static void setSynchronous(bool synchronous);
+
+    // Size of each thread's ring; applies to threads that have not logged yet
+    static void setRingCapacity(size_t bytes);
+
+    static void write(LogLevel level, const char* component, std::string_view message,
+                      std::initializer_list<LogField> fields = {});
+
+    // Block until everything logged by this thread so far has reached the sink
+    static void flush();
+
+    // Records dropped because a producer's ring was full
+    static uint64_t dropped();
+};
+
+#define LETTA_LOG(level, component, message, ...)                                                  \
+    do {                                                                                           \
+        if (logCompiledIn(level) && Log::enabled(level)) {                                         \
+            Log::write(level, component, message, {__VA_ARGS__});                                  \
+        }                                                                                          \
+    } while (0)
+
+#define LETTA_LOG_TRACE(component, message, ...) LETTA_LOG(LogLevel::Trace, component, message, __VA_ARGS__)
+#define LETTA_LOG_DEBUG(component, message, ...) LETTA_LOG(LogLevel::Debug, component, message, __VA_ARGS__)
+#define LETTA_LOG_INFO(component, message, ...) LETTA_LOG(LogLevel::Info, component, message, __VA_ARGS__)
+#define LETTA_LOG_WARN(component, message, ...) LETTA_LOG(LogLevel::Warn, component, message, __VA_ARGS__)
+#define LETTA_LOG_ERROR(component, message, ...) LETTA_LOG(LogLevel::Error, component, message, __VA_ARGS__)
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Where an MCP server lives: a command to run over stdio, or a Unix socket
+// path to connect to. Exactly one of `command` and `socket_path` is set.
+struct McpServerConfig {
+    std::string name;                                 // shows up in logs and errors
+    std::vector<std::string> command;                 // argv; looked up on PATH
+    std::map<std::string, std::string> env;           // added to the child's environment
+    std::string socket_path;
+    std::chrono::milliseconds timeout{30000};         // per request
+};
+
+// Client for one Model Context Protocol server.
+//
+// The session is long-lived: the server process is started (or the socket
+// connected) once, initialized once, and reused for every call. If it goes
+// away, the next request reconnects and initializes a fresh session.
+//
+// Messages are newline-delimited JSON-RPC 2.0. A single reader thread owns
+// the receive side and hands each response to whichever caller is waiting on
+// its id, so any number of threads can have tools/call requests in flight on
+// the one connection and they complete in whatever order the server answers.
+//
+// tools/list is fetched once per session and cached in OpenAI function format
+// (see Tools.hpp). A notifications/tools/list_changed from the server marks
+// the cache stale; the next tools() call re-fetches it and bumps
+// toolsVersion().
+class McpClient {
+public:
+    explicit McpClient(McpServerConfig config);
+    ~McpClient();
+    McpClient(const McpClient&) = delete;
+    McpClient& operator=(const McpClient&) = delete;
+
+    // Start the session now instead of on first use. False if the server
+    // could not be reached or refused to initialize.
+    bool connect();
+    void disconnect();
+    bool connected() const { return session_open.load(); }
+
+    // The server's tools as function schemas; fetched once per session
+    std::vector<json> tools();
+    bool hasTool(const std::string& name);
+    uint64_t toolsVersion() const { return tools_version.load(); }
+
+    // tools/call, flattened to a tool result: {"status": "OK" | "ERROR",
+    // "message": <text content joined>}. Thread-safe; calls are multiplexed.
+    json callTool(const std::string& name, const json& arguments);
+
+    // Any JSON-RPC request. Returns the "result" member, or throws
+    // std::runtime_error on an error response, timeout or lost connection.
+    json request(const std::string& method, const json& params = json::object());
+
+    const McpServerConfig& config() const { return cfg; }
+    const json& serverInfo() const { return server_info; }
+
+    // Requests sent, and sessions started after the first
+    uint64_t requests() const { return requests_sent.load(); }
+    uint64_t reconnects() const { return sessions_started.load() > 1 ? sessions_started.load() - 1 : 0; }
+
+private:
+    struct Pending {
+        bool done = false;
+        json message;
+    };
+
+    McpServerConfig cfg;
+
+    // Connection state; `session_mutex` serializes connect/disconnect
+    std::mutex session_mutex;
+    int fd = -1;
+    pid_t child = -1;
+    std::thread reader;
+    std::atomic<bool> session_open{false};
+    std::atomic<uint64_t> sessions_started{0};
+    json server_info;
+
+    // In-flight requests by id; `reader_alive` goes false when the reader
+    // hits EOF, after which nothing new is registered
+    std::mutex pending_mutex;
+    std::condition_variable answered;
+    std::map<int64_t, Pending*> pending;
+    bool reader_alive = false;
+    std::atomic<int64_t> next_id{1};
+    std::atomic<uint64_t> requests_sent{0};
+
+    std::mutex write_mutex;
+
+    // Tool cache
+    std::mutex tools_mutex;
+    std::vector<json> tool_schemas;
+    std::set<std::string> tool_names;
+    std::atomic<bool> tools_stale{true};
+    std::atomic<uint64_t> tools_version{0};
+
+    // Helper: Open the transport and run the initialize handshake
+    bool open();
+
+    // Helper: Close the transport, fail pending requests, reap the server
+    void close();
+
+    // Helper: Spawn the stdio server on one end of a socketpair
+    int spawnServer();
+
+    // Helper: Connect to the Unix socket
+    int connectSocket();
+
+    // Helper: Write one message; false if the connection is gone
+    bool send(const json& message);
+
+    // Helper: Send a request on the current session and wait for its answer
+    json roundTrip(const std::string& method, const json& params);
+
+    // Helper: Reader thread; dispatches responses until EOF
+    void readLoop(int read_fd);
+
+    // Helper: Answer a request the server sent us
+    void handleServerRequest(const json& message);
+};
@@ -1,21 +1,70 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <nlohmann/json.hpp>
+#include "PromptTemplate.hpp"
+#include "Rope.hpp"
 
 using json = nlohmann::json;
 
 struct MemoryBlock {
     std::string label;
-    std::string value;
+    Rope value; // large scratchpads are edited in place without full copies
     int limit; // Character limit, roughly
     bool read_only;
     
     json toJson() const;
 };
 
+enum class BlockEdit {
+    Ok,
+    NotFound,
+    ReadOnly,
+    Rejected // the edit function declined (e.g. text to replace not present)
+};
+
+// A block many agents attach to (organisation policies, product facts).
+//
+// The current version is an immutable MemoryBlock published through an atomic
+// pointer: reads are wait-free under an Rcu::ReadGuard, writes are serialised
+// and copy the block. version() bumps on every write so attached agents can
+// tell cheaply whether their rendered prompt is stale.
+class SharedBlock {
+public:
+    explicit SharedBlock(MemoryBlock block);
+    ~SharedBlock();
+    SharedBlock(const SharedBlock&) = delete;
+    SharedBlock& operator=(const SharedBlock&) = delete;
+
+    const std::string& label() const { return block_label; }
+    uint64_t version() const { return current_version.load(std::memory_order_acquire); }
+
+    // Only valid inside an Rcu::ReadGuard; do not keep the pointer past it
+    const MemoryBlock* read() const { return current.load(std::memory_order_acquire); }
+
+    // Copy of the current version
+    MemoryBlock snapshot() const;
+
+    bool update(const std::string& new_value);
+
+    // Read-modify-write under the writer lock, so concurrent appends from
+    // different agents are not lost. `edit` returns false to abandon the change.
+    BlockEdit edit(const std::function<bool(Rope& value)>& edit);
+
+private:
+    std::string block_label;
+    std::atomic<const MemoryBlock*> current;
+    std::atomic<uint64_t> current_version{1};
+    std::mutex write_mutex;
+};
+
 class Memory {
 public:
     Memory();
@@ -26,22 +75,64 @@ public:
     // Compile memory into the system prompt string
     std::string compile() const;
 
-    // Get a block by label
+    // Same, into a buffer the caller reuses across renders
+    void compileInto(std::string& out) const;
+
+    // Template the prompt is rendered with (nullptr restores the default)
+    void setTemplate(std::shared_ptr<const PromptTemplate> tmpl);
+    const std::shared_ptr<const PromptTemplate>& getTemplate() const { return prompt_template; }
+
+    // Get a private block by label (shared blocks are not mutable in place)
     MemoryBlock* getBlock(const std::string& label);
+
+    // Copy of a private or shared block
+    std::optional<MemoryBlock> findBlock(const std::string& label) const;
     
     // Update a block's value
     bool updateBlock(const std::string& label, const std::string& new_value);
 
+    // Read-modify-write a private or shared block
+    BlockEdit editBlock(const std::string& label, const std::function<bool(Rope& value)>& edit);
+
     // List all blocks
     std::vector<MemoryBlock> getBlocks() const;
 
     // Add a new block
     void addBlock(const MemoryBlock& block);
 
-    // Remove a block by label
+    // Remove a block by label (detaches shared blocks)
     void removeBlock(const std::string& label);
 
+    // Attach a shared block; it compiles in attach order like a private one
+    void attachShared(std::shared_ptr<SharedBlock> block);
+
+    // Turn a private block into a shared one in place (same position, same
+    // value) so another agent can attach it. Returns the existing shared block
+    // if it already is one, nullptr if there is no such block.
+    std::shared_ptr<SharedBlock> share(const std::string& label);
+
+    // Copy for a forked agent. O(number of blocks): values are Ropes, so the
+    // text is shared until either side edits it. Blocks attached from outside
+    // stay shared; blocks this memory turned shared via share() become private
+    // copies again, so the fork's edits do not leak back.
+    Memory fork() const;
+
+    // Changes whenever compile() could produce different output, including
+    // writes to attached shared blocks made through other agents
+    uint64_t version() const;
+
 private:
     std::map<std::string, MemoryBlock> blocks;
+    std::map<std::string, std::shared_ptr<SharedBlock>> shared_blocks;
+    std::vector<std::string> shared_here; // labels share() converted from private blocks
     std::vector<std::string> block_order; // To maintain consistent compilation order
+    std::shared_ptr<const PromptTemplate> prompt_template;
+    uint64_t local_version = 1;
+    uint64_t detached_versions = 0; // keeps version() monotonic across detaches
+
+    // Helper: Drop a label from block_order
+    void eraseFromOrder(const std::string& label);
+
+    // Helper: Forget that share() created a block
+    void forgetShared(const std::string& label);
 };
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+enum class MessageRole : uint8_t {
+    System,
+    User,
+    Assistant,
+    Tool
+};
+
+const char* roleName(MessageRole role);
+
+// Parse "system" / "user" / "assistant" / "tool"; returns false for anything else
+bool parseRole(std::string_view name, MessageRole& role);
+
+struct ToolCallView {
+    std::string_view id;
+    std::string_view name;
+    std::string_view arguments; // raw JSON text, as the provider sent it
+};
+
+// Conversation history stored column-wise instead of as a vector of JSON trees.
+//
+// Every message is a role byte, a content slice and an offset into the tool
+// call side table; all text lives in a contiguous string pool. Assistant
+// messages own the tool calls they made. A tool message owns exactly one entry:
+// the call it answers (id and name, no arguments).
+//
+// fork() freezes the messages so far into an immutable segment shared by both
+// stores; each side then appends to its own tail. Forking and copying a forked
+// store are O(number of segments), which is capped, no matter how long the
+// history is. Rewriting a frozen message's content (the system prompt after a
+// memory edit) is recorded per store and never touches the shared segment.
+//
+// Views returned by the store point into the pool and are invalidated by any
+// mutation.
+class MessageStore {
+private:
+    struct Slice {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    struct ToolCallRecord {
+        Slice id;
+        Slice name;
+        Slice arguments;
+    };
+
+    // A run of messages in column form
+    struct Columns {
+        std::vector<MessageRole> roles;
+        std::vector<Slice> contents;
+        std::vector<uint32_t> call_begin{0}; // size() + 1 entries; calls of message i are [call_begin[i], call_begin[i+1])
+        std::vector<ToolCallRecord> tool_calls;
+        std::string pool;
+
+        size_t size() const { return roles.size(); }
+        std::string_view text(Slice slice) const { return std::string_view(pool.data() + slice.offset, slice.length); }
+        size_t bytes() const;
+    };
+
+    // Frozen by fork(); never modified afterwards, so forks read it concurrently
+    struct Segment {
+        std::shared_ptr<const Segment> parent;
+        size_t offset = 0; // history index of the first message
+        Columns columns;
+    };
+
+public:
+    class Message {
+    public:
+        MessageRole role() const { return columns->roles[local]; }
+        std::string_view content() const {
+            if (store->overrides.empty()) return columns->text(columns->contents[local]);
+            return store->overriddenContent(*this);
+        }
+
+        size_t toolCallCount() const { return columns->call_begin[local + 1] - columns->call_begin[local]; }
+        ToolCallView toolCall(size_t i) const;
+
+        // Tool messages only: the call being answered
+        std::string_view toolCallId() const { return toolCall(0).id; }
+        std::string_view toolName() const { return toolCall(0).name; }
+
+        json toJson() const;
+
+    private:
+        friend class MessageStore;
+        Message(const MessageStore* store, const Columns* columns, size_t local, size_t index)
+            : store(store), columns(columns), local(local), index(index) {}
+        const MessageStore* store;
+        const Columns* columns;
+        size_t local; // index within `columns`
+        size_t index; // index within the store
+    };
+
+    MessageStore() = default;
+
+    size_t size() const { return frozen_size + tail.size(); }
+    bool empty() const { return size() == 0; }
+    Message operator[](size_t index) const {
+        if (index >= frozen_size) return Message(this, &tail, index - frozen_size, index);
+        return frozenMessage(index);
+    }
+    Message back() const { return (*this)[size() - 1]; }
+
+    void append(MessageRole role, std::string_view content);
+    void appendAssistant(std::string_view content, const std::vector<ToolCallView>& tool_calls);
+    void appendToolResult(std::string_view tool_call_id, std::string_view name, std::string_view content);
+
+    // Copy a message, tool calls included (from this or another store)
+    void append(const Message& message);
+
+    // Append an OpenAI-style message object. Returns false (and appends nothing)
+    // if the role is not one of the four above.
+    bool appendJson(const json& message);
+
+    // Inserting before a frozen message un-shares the history (O(n))
+    void insert(size_t index, MessageRole role, std::string_view content);
+
+    // Replace a message's content (e.g. the system prompt after a memory edit)
+    void setContent(size_t index, std::string_view content);
+
+    void clear();
+
+    // Copy that shares all messages so far with this store
+    MessageStore fork();
+
+    // OpenAI-style message array
+    json toJson() const;
+    static MessageStore fromJson(const std::vector<json>& messages);
+
+    // Build a store from flat columns, as AgentSnapshot writes them: per
+    // message a role byte and an (offset, length) pair into `pool`;
+    // `call_begin` holds count + 1 indices into `tool_calls`, which has three
+    // (offset, length) pairs (id, name, arguments) per call. The arrays are
+    // copied in bulk. Throws std::invalid_argument if anything points outside
+    // its array or the pool.
+    static MessageStore fromColumns(const uint8_t* roles, size_t count, const uint32_t* contents,
+                                    const uint32_t* call_begin, const uint32_t* tool_calls, size_t call_count,
+                                    std::string pool);
+
+    // Heap bytes held by the columns, side table and pool, shared segments included
+    size_t memoryBytes() const;
+
+    // The part of memoryBytes() no other fork can be holding
+    size_t unsharedBytes() const;
+
+    // Frozen segments behind this store, for tests and benchmarks
+    size_t segmentCount() const { return segments.size(); }
+
+private:
+    std::shared_ptr<const Segment> frozen; // newest frozen segment; older ones hang off `parent`
+    std::vector<const Segment*> segments;  // the same chain, oldest first
+    size_t frozen_size = 0;
+
+    Columns tail;             // messages appended since the last fork
+    size_t garbage_bytes = 0; // tail pool bytes no longer referenced after setContent
+
+    // New contents of frozen messages, by history index (in practice just the
+    // system prompt)
+    std::vector<std::pair<size_t, std::string>> overrides;
+
+    // Helper: Locate a frozen message
+    Message frozenMessage(size_t index) const;
+
+    // Helper: Content of a message, honouring overrides
+    std::string_view overriddenContent(const Message& message) const;
+
+    // Helper: Copy text into the tail pool
+    Slice intern(std::string_view text);
+
+    // Helper: Rewrite the tail pool without unreferenced text
+    void compact();
+
+    // Helper: Copy everything into a fresh, unshared tail
+    void flatten();
+};
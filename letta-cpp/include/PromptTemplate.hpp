@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct MemoryBlock;
+
+class TemplateError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// What a system prompt template can see
+struct PromptContext {
+    std::vector<const MemoryBlock*> blocks; // compile order
+    std::chrono::system_clock::time_point now;
+};
+
+// A small Jinja-like language for the system prompt, compiled once into an
+// instruction list and rendered into a caller-owned buffer.
+//
+//   {{ name }}                                   output a value
+//   {% for block in blocks %} ... {% endfor %}   loop over memory blocks
+//   {% if cond %} ... {% elif cond %} ... {% else %} ... {% endif %}
+//   {# comment #}
+//   {%- / -%} and {{- / -}}                      trim whitespace on that side
+//
+// Inside the loop: block.label, block.value, block.length, block.limit,
+// block.tokens, block.read_only, loop.index (from 1), loop.first, loop.last.
+// Anywhere: block_count, total_chars, total_tokens, now (UTC, ISO 8601).
+// Conditions: `name`, `not name`, or `name <op> literal` with ==, !=, <, <=,
+// >, >= against a "string" or integer literal. Token counts are the same
+// ~4 bytes/token estimate the scheduler uses.
+//
+// Names are resolved when the template is compiled; unknown names and
+// unbalanced tags throw TemplateError with the line number.
+class PromptTemplate {
+public:
+    static std::shared_ptr<const PromptTemplate> compile(std::string_view source);
+
+    // The built-in Letta prompt (what Memory::compile always produced)
+    static std::shared_ptr<const PromptTemplate> defaultTemplate();
+
+    // The same, for agents whose memory a sleep-time agent maintains
+    static std::shared_ptr<const PromptTemplate> sleepTimeTemplate();
+
+    // Append the rendered prompt to `out`
+    void render(const PromptContext& context, std::string& out) const;
+
+private:
+    enum class Field : uint8_t {
+        BlockLabel, BlockValue, BlockLength, BlockLimit, BlockTokens, BlockReadOnly,
+        LoopIndex, LoopFirst, LoopLast,
+        BlockCount, TotalChars, TotalTokens, Now
+    };
+
+    enum class Op : uint8_t {
+        Text,        // a = offset into literals, b = length
+        Emit,        // a = field
+        JumpIfFalse, // a = condition, b = target
+        Jump,        // b = target
+        ForBegin,    // b = instruction after the matching ForEnd
+        ForEnd       // b = first instruction of the body
+    };
+
+    struct Instruction {
+        Op op;
+        uint32_t a = 0;
+        uint32_t b = 0;
+    };
+
+    struct Condition {
+        enum class Compare : uint8_t { Truthy, Eq, Ne, Lt, Le, Gt, Ge };
+        Field field;
+        Compare compare = Compare::Truthy;
+        bool negate = false;
+        bool numeric = false; // literal is an integer
+        std::string text;
+        int64_t number = 0;
+    };
+
+    std::vector<Instruction> program;
+    std::vector<Condition> conditions;
+    std::string literals;
+    bool uses_now = false;
+    bool uses_totals = false;
+
+    friend class TemplateCompiler;
+    friend class TemplateRenderer;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+// Epoch-based read-copy-update for data that is read on hot paths and written
+// rarely (shared memory blocks).
+//
+// Readers wrap access in an Rcu::ReadGuard, which announces the current epoch
+// in a per-thread slot: no locks, no retries, no reference counting. Writers
+// publish a new version with an atomic pointer store and hand the old one to
+// retire(); it is freed once every reader that could still see it has left its
+// critical section. Guards nest.
+class Rcu {
+public:
+    class ReadGuard {
+    public:
+        ReadGuard();
+        ~ReadGuard();
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+    };
+
+    // Call after unpublishing `object`
+    template <typename T>
+    static void retire(const T* object) {
+        retire(const_cast<T*>(object), [](void* p) { delete static_cast<T*>(p); });
+    }
+    static void retire(void* object, void (*deleter)(void*));
+
+    // Free what no reader can still reference; returns the number freed
+    static size_t reclaim();
+
+    // Wait until everything retired so far is freed. Must not be called from
+    // inside a ReadGuard.
+    static void synchronize();
+
+    // Objects retired but not yet freed
+    static size_t pending();
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+enum class RequestPriority {
+    Interactive = 0, // user is waiting on the answer
+    Batch = 1        // background work; yields to interactive traffic
+};
+
+// Provider quota for one model. Zero means unlimited.
+struct RateLimits {
+    double requests_per_minute = 0;
+    double tokens_per_minute = 0;
+    double burst_fraction = 1.0; // bucket capacity as a fraction of the per-minute quota
+};
+
+// Process-wide admission control for LLM requests. Every LLMClient submits
+// through a scheduler (the global one by default) so that many agents share
+// per-model request/token buckets instead of bursting past provider limits
+// and all receiving 429s together.
+//
+// Waiting requests are ordered by priority class, then round-robin across
+// agents so one chatty agent cannot starve the others. Batch requests that
+// have waited longer than `batch_aging` are treated as interactive.
+class RequestScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t admitted_interactive = 0;
+        uint64_t admitted_batch = 0;
+        uint64_t rate_limited = 0; // 429s reported through backoff()
+        uint64_t cancelled = 0;
+        double total_wait_ms = 0;
+        size_t queued = 0;
+    };
+
+    RequestScheduler() = default;
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    // Shared instance used by LLMClient unless told otherwise
+    static RequestScheduler& global();
+
+    void setLimits(const std::string& model, const RateLimits& limits);
+    void setBatchAging(std::chrono::milliseconds aging);
+
+    // Block until the request may be sent. Returns false if `cancelled` was
+    // raised while waiting.
+    bool acquire(const std::string& model, const std::string& agent_id, RequestPriority priority,
+                 uint64_t estimated_tokens, const std::atomic<bool>* cancelled = nullptr);
+
+    // Wake every waiting acquire() so a caller whose flag was just raised
+    // gives up its place now rather than at its next poll
+    void interrupt();
+
+    // True up the token bucket once the provider reports actual usage
+    void reconcile(const std::string& model, uint64_t estimated_tokens, uint64_t actual_tokens);
+
+    // Provider returned 429: hold all traffic for this model for `retry_after`
+    void backoff(const std::string& model, std::chrono::milliseconds retry_after);
+
+    Stats stats() const;
+
+private:
+    struct TokenBucket {
+        double capacity = 0;
+        double rate_per_sec = 0;
+        double level = 0;
+        Clock::time_point last;
+
+        bool limited() const { return capacity > 0; }
+        void refill(Clock::time_point now);
+        // Time until `amount` is available (zero if it already is)
+        Clock::duration timeUntil(double amount) const;
+    };
+
+    struct Waiter {
+        std::string agent_id;
+        RequestPriority priority;
+        double tokens;
+        Clock::time_point enqueued;
+        bool admitted = false;
+    };
+
+    struct ModelState {
+        TokenBucket requests;
+        TokenBucket tokens;
+        Clock::time_point paused_until;
+        // Per priority class: FIFO per agent plus the round-robin order of agents
+        std::map<std::string, std::deque<Waiter*>> queues[2];
+        std::deque<std::string> round_robin[2];
+
+        bool limited() const { return requests.limited() || tokens.limited(); }
+        bool idle() const { return round_robin[0].empty() && round_robin[1].empty(); }
+    };
+
+    // Helper: Admit as many queued waiters as the buckets allow; returns when
+    // the head of the queue could next be admitted.
+    Clock::time_point dispatch(ModelState& state, Clock::time_point now);
+    int nextClass(const ModelState& state, Clock::time_point now) const;
+    void enqueue(ModelState& state, Waiter* waiter);
+    void remove(ModelState& state, Waiter* waiter);
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::map<std::string, ModelState> models;
+    std::chrono::milliseconds batch_aging{30000};
+    Stats counters;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Text stored as a balanced tree of immutable chunks, for memory blocks that
+// grow large (scratchpads, knowledge dumps) and are edited often.
+//
+// Appends, inserts, erases and replaces are O(log n) plus the size of the new
+// text; nothing is flattened until the prompt is compiled. Nodes are shared
+// between copies, so copying a Rope is O(1) and an edit only rebuilds the path
+// it touches - SharedBlock's copy-on-write edits and agent forks get this for
+// free.
+class Rope {
+public:
+    static constexpr size_t npos = std::string::npos;
+
+    Rope() = default;
+    Rope(std::string_view text);
+    Rope(const std::string& text) : Rope(std::string_view(text)) {}
+    Rope(const char* text) : Rope(std::string_view(text)) {}
+
+    size_t size() const;
+    size_t length() const { return size(); }
+    bool empty() const { return size() == 0; }
+
+    void append(std::string_view text);
+    Rope& operator+=(std::string_view text) {
+        append(text);
+        return *this;
+    }
+    void insert(size_t pos, std::string_view text);
+    void erase(size_t pos, size_t count = npos);
+    void replace(size_t pos, size_t count, std::string_view text);
+
+    // First occurrence of `needle` at or after `from`, or npos. Matches may span
+    // chunk boundaries; the scan within a chunk is SIMD-accelerated.
+    size_t find(std::string_view needle, size_t from = 0) const;
+
+    std::string substr(size_t pos, size_t count = npos) const;
+
+    // Contiguous copy; prefer forEachChunk / appendTo on hot paths
+    std::string str() const;
+    void appendTo(std::string& out) const;
+
+    // Visit the text in order, one contiguous chunk at a time
+    template <typename F>
+    void forEachChunk(F&& visit) const {
+        forEachChunk(root.get(), visit);
+    }
+
+    // Number of chunks and tree height, for tests and benchmarks
+    size_t chunkCount() const;
+    int height() const;
+
+    friend bool operator==(const Rope& a, const Rope& b);
+    friend bool operator==(const Rope& a, std::string_view b) { return a.equals(b); }
+    friend bool operator==(const Rope& a, const std::string& b) { return a.equals(b); }
+    friend bool operator==(const Rope& a, const char* b) { return a.equals(b); }
+    friend bool operator==(std::string_view a, const Rope& b) { return b.equals(a); }
+    friend bool operator==(const std::string& a, const Rope& b) { return b.equals(a); }
+    friend bool operator==(const char* a, const Rope& b) { return b.equals(a); }
+    template <typename T>
+    friend bool operator!=(const Rope& a, const T& b) { return !(a == b); }
+
+    friend std::ostream& operator<<(std::ostream& os, const Rope& rope);
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+private:
+    NodePtr root;
+
+    explicit Rope(NodePtr root) : root(std::move(root)) {}
+
+    bool equals(std::string_view text) const;
+
+    template <typename F>
+    static void forEachChunk(const Node* node, F& visit);
+};
+
+struct Rope::Node {
+    NodePtr left;
+    NodePtr right;
+    std::string text; // leaves only
+    size_t length = 0;
+    int height = 1;   // leaves are 1
+
+    bool leaf() const { return !left; }
+};
+
+template <typename F>
+void Rope::forEachChunk(const Node* node, F& visit) {
+    if (!node) return;
+    if (node->leaf()) {
+        visit(std::string_view(node->text));
+        return;
+    }
+    forEachChunk(node->left.get(), visit);
+    forEachChunk(node->right.get(), visit);
+}
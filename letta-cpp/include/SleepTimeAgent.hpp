@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Cancellation.hpp"
+#include "LLMClient.hpp"
+#include "Memory.hpp"
+#include "MessageStore.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SleepTimeOptions {
+    std::string model;                         // empty: same as the primary
+    size_t min_new_messages = 1;               // consolidate once this many are waiting
+    int max_steps = 5;                         // tool-call rounds per consolidation run
+    bool remove_foreground_memory_tools = true; // primary only gets send_message
+    int nice = 10;                             // worker thread niceness (Linux only)
+};
+
+// Background "sleep-time" agent that keeps a primary agent's memory up to date
+// so the primary does not spend user-facing round trips on memory edits.
+//
+// The primary hands off each finished turn and marks itself idle; a worker
+// thread replays the new messages to its own LLM with the memory tools and
+// applies the edits through Memory::editBlock. The blocks it edits are
+// SharedBlocks attached to both agents (Memory::share), so writes take the
+// usual copy-on-write path and the primary picks them up before its next LLM
+// call. Runs only start while the primary is idle, and requests go out at
+// Batch priority so they yield to interactive traffic in the scheduler.
+class SleepTimeAgent {
+public:
+    SleepTimeAgent(const std::string& primary_id, const std::string& api_key, const std::string& base_url,
+                   const std::string& model, SleepTimeOptions options = {});
+    ~SleepTimeAgent(); // cancels a run in flight; messages not consolidated yet are dropped
+    SleepTimeAgent(const SleepTimeAgent&) = delete;
+    SleepTimeAgent& operator=(const SleepTimeAgent&) = delete;
+
+    // Blocks the agent may read and rewrite; attach before the first handoff
+    void attachBlock(std::shared_ptr<SharedBlock> block);
+
+    // Swap every attached block for `blocks`, after the primary's memory was
+    // replaced wholesale (Agent::restore). Messages still queued belong to the
+    // old history and are dropped; a run in flight finishes first.
+    void replaceBlocks(std::vector<std::shared_ptr<SharedBlock>> blocks);
+
+    // Queue messages [from, size()) of the primary's history. System messages
+    // are skipped.
+    void submit(const MessageStore& messages, size_t from);
+
+    // The primary started / finished a turn. A run already in flight when the
+    // primary turns busy completes; queued work waits for the next idle period.
+    void primaryBusy();
+    void primaryIdle();
+
+    // Block until nothing is queued or running (queued work waiting for the
+    // primary to go idle counts as queued)
+    void waitIdle();
+
+    const SleepTimeOptions& options() const { return opts; }
+
+    // Consolidation runs completed and memory edits applied since construction
+    uint64_t runs() const { return runs_completed.load(); }
+    uint64_t editsApplied() const { return edits_applied.load(); }
+
+    // Set the transport or scheduler before the first handoff
+    LLMClient& getLLMClient() { return llm; }
+
+private:
+    std::string id;
+    SleepTimeOptions opts;
+    LLMClient llm;
+    Memory memory; // only the attached shared blocks; touched by the worker alone after start
+
+    std::mutex mutex;
+    std::condition_variable work_cv;  // worker waits for queued messages + idle primary
+    std::condition_variable idle_cv;  // waitIdle() waits for the worker to drain
+    MessageStore pending;
+    bool primary_busy = false;
+    bool running = false;
+    bool stopping = false;
+    CancellationToken cancel; // cancelled by the destructor to cut a run short
+
+    std::atomic<uint64_t> runs_completed{0};
+    std::atomic<uint64_t> edits_applied{0};
+
+    std::thread worker;
+
+    // Helper: Worker thread body
+    void run();
+
+    // Helper: One tool-calling conversation over `transcript`
+    void consolidate(const MessageStore& transcript);
+
+    // Helper: Render the handed-off messages as the run's user message
+    static std::string renderTranscript(const MessageStore& transcript);
+};
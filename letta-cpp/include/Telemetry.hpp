@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Built-in tracing and metrics. Everything is compiled in; while telemetry is
+// disabled (the default) each instrumentation point costs one relaxed atomic
+// load and a branch.
+
+class Counter {
+public:
+    void add(double value = 1.0);
+    double value() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> total{0.0};
+};
+
+// Cumulative-bucket histogram in the Prometheus sense
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    const std::vector<double>& bounds() const { return upper_bounds; }
+    // Non-cumulative count for bucket i (the last bucket is +Inf)
+    uint64_t bucketCount(size_t i) const { return counts[i].load(std::memory_order_relaxed); }
+    uint64_t count() const { return observations.load(std::memory_order_relaxed); }
+    double sum() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<double> upper_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::atomic<uint64_t> observations{0};
+    std::atomic<double> total{0.0};
+};
+
+// Metrics recorded by the agent step loop, resolved once so the hot path does
+// no name lookups.
+struct AgentMetrics {
+    Histogram* step_duration;        // seconds per Agent::step
+    Histogram* llm_duration;         // seconds per LLM round trip
+    Histogram* serialize_duration;   // seconds to build a request payload
+    Histogram* parse_duration;       // seconds to normalise a response
+    Histogram* request_bytes;
+    Histogram* response_bytes;
+    Histogram* request_wire_bytes;
+    Histogram* response_wire_bytes;
+    Histogram* history_length;       // messages sent per LLM call
+    Histogram* tool_calls_per_step;
+    Histogram* tool_duration;        // seconds per executeTool
+    Counter* prompt_tokens;
+    Counter* completion_tokens;
+    Counter* steps;
+    Counter* steps_cancelled;
+    Counter* llm_errors;
+};
+
+struct SpanData {
+    std::array<uint8_t, 16> trace_id{};
+    uint64_t span_id = 0;
+    uint64_t parent_span_id = 0;
+    std::string name;
+    int kind = 1; // OTLP SpanKind: 1 internal, 3 client
+    bool error = false;
+    uint64_t start_unix_nanos = 0;
+    uint64_t end_unix_nanos = 0;
+    std::vector<std::pair<std::string, std::string>> attributes;
+};
+
+// Identifies a span so work on another thread can be parented to it
+struct SpanContext {
+    std::array<uint8_t, 16> trace_id{};
+    uint64_t span_id = 0;
+
+    bool valid() const { return span_id != 0; }
+};
+
+class Telemetry {
+public:
+    static Telemetry& instance();
+
+    static bool enabled() { return enabled_flag.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled) { enabled_flag.store(enabled, std::memory_order_relaxed); }
+
+    // Well-known agent metrics (always registered)
+    static const AgentMetrics& metrics() { return instance().agent_metrics; }
+
+    // Find or register a metric. `labels` is the rendered label set, e.g. tool="send_message".
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                         const std::string& labels = "");
+
+    // Prometheus text exposition format (version 0.0.4)
+    std::string renderPrometheus() const;
+
+    // Finished spans are buffered until an exporter drains them. When the
+    // buffer is full new spans are dropped and counted.
+    void recordSpan(SpanData&& span);
+    std::vector<SpanData> drainSpans();
+    uint64_t droppedSpans() const { return dropped.load(std::memory_order_relaxed); }
+    void setSpanBufferLimit(size_t limit);
+
+private:
+    Telemetry();
+
+    struct Family {
+        std::string help;
+        std::string type;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    };
+
+    static std::atomic<bool> enabled_flag;
+
+    mutable std::mutex metrics_mutex;
+    std::map<std::string, Family> families;
+    AgentMetrics agent_metrics;
+
+    std::mutex span_mutex;
+    std::vector<SpanData> spans;
+    size_t span_limit = 65536;
+    std::atomic<uint64_t> dropped{0};
+};
+
+// RAII span. Nests under the innermost active span on this thread unless an
+// explicit parent is given. Optionally observes its duration (seconds) into a
+// histogram. Does nothing while telemetry is disabled.
+class ScopedSpan {
+public:
+    explicit ScopedSpan(const char* name, Histogram* duration = nullptr, int kind = 1);
+    ScopedSpan(const char* name, const SpanContext& parent, Histogram* duration = nullptr, int kind = 1);
+    ~ScopedSpan();
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    bool active() const { return data != nullptr; }
+
+    void setAttribute(const char* key, const std::string& value);
+    void setAttribute(const char* key, int64_t value);
+    void setError(const std::string& message);
+
+    SpanContext context() const;
+
+    // Context of the innermost active span on the calling thread
+    static SpanContext current();
+
+private:
+    void start(const char* name, const SpanContext& parent, int kind);
+
+    std::unique_ptr<SpanData> data;
+    Histogram* duration_histogram;
+    std::chrono::steady_clock::time_point started;
+    ScopedSpan* previous = nullptr;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "HttpTransport.hpp"
+#include "Telemetry.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Serialise spans as an OTLP/JSON ExportTraceServiceRequest
+std::string toOtlpJson(const std::vector<SpanData>& spans, const std::string& service_name);
+
+struct OtlpExporterOptions {
+    // OTLP/HTTP receiver; the collector configs in otel/ listen on :4318
+    std::string endpoint = "http://localhost:4318/v1/traces";
+    // When set, append one OTLP/JSON document per line to this file instead
+    std::string file_path;
+    std::string service_name = "letta-cpp";
+    std::chrono::milliseconds interval{1000};
+};
+
+// Periodically drains finished spans from Telemetry and ships them.
+class OtlpExporter {
+public:
+    explicit OtlpExporter(OtlpExporterOptions options, HttpTransport transport = makeCurlTransport());
+    ~OtlpExporter();
+
+    void start();
+    void stop(); // flushes what is left
+
+    // Export everything buffered now; returns the number of spans written
+    size_t flush();
+
+private:
+    OtlpExporterOptions options;
+    HttpTransport transport;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool running = false;
+};
+
+// Minimal HTTP server exposing Telemetry::renderPrometheus() for scraping
+class PrometheusEndpoint {
+public:
+    PrometheusEndpoint() = default;
+    ~PrometheusEndpoint();
+
+    // Listen on 127.0.0.1:port (0 picks a free port). Returns false on failure.
+    bool start(int port = 9464, const std::string& bind_address = "127.0.0.1");
+    void stop();
+
+    int port() const { return bound_port; }
+
+private:
+    void serve();
+
+    int listen_fd = -1;
+    int bound_port = 0;
+    std::atomic<bool> running{false};
+    std::thread worker;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// What one tool call may consume inside its worker
+struct SandboxLimits {
+    std::chrono::milliseconds timeout{5000}; // wall clock; the worker is killed past it
+    int cpu_seconds = 5;                     // RLIMIT_CPU, re-armed before every call
+    size_t memory_bytes = 256u << 20;        // address space a call may add (RLIMIT_AS)
+    int max_open_files = 8;                  // RLIMIT_NOFILE
+    bool seccomp = true;                     // syscall allowlist; no files, sockets or processes
+};
+
+struct SandboxOptions {
+    size_t workers = 2;             // pre-forked processes; 0 forks a fresh one per call
+    size_t arena_bytes = 4u << 20;  // shared memory per worker for arguments and results
+    SandboxLimits limits;
+};
+
+// Runs user-defined tools out of process, in a pool of pre-forked workers.
+//
+// Tools are C++ callables registered before start(); each worker is a fork of
+// a copy of this process, so it already has them and a call costs two socket
+// messages instead of a process start. Workers drop to the configured rlimits
+// and a seccomp allowlist before they take their first call, so a tool can
+// burn its own CPU and memory but cannot open files, talk to the network or
+// spawn processes. A worker that crashes, times out or is killed by the
+// sandbox is reaped and replaced; the caller gets an error result.
+//
+// Requests and results are framed as a 16-byte header over a Unix socket.
+// Payloads that fit in the worker's shared arena (a memfd both sides map
+// MAP_SHARED) never go through the socket: they are written there once and
+// parsed in place on the other side. Anything larger follows its header on
+// the socket.
+//
+// start() forks a zygote: a single-threaded copy of the host that does
+// nothing but fork and reap workers on request, so no worker is ever forked
+// from a process with other threads running. Workers see the host's memory
+// as of start() and only ever write to their own socket and arena.
+class ToolSandbox {
+public:
+    using ToolFunction = std::function<json(const json& arguments)>;
+
+    explicit ToolSandbox(SandboxOptions options = {});
+    ~ToolSandbox();
+    ToolSandbox(const ToolSandbox&) = delete;
+    ToolSandbox& operator=(const ToolSandbox&) = delete;
+
+    // `schema` is an OpenAI-style function tool (see Tools.hpp). Register
+    // everything before start().
+    void registerTool(const json& schema, ToolFunction function);
+
+    // Fork the zygote and the workers. Call it early, before the process
+    // starts threads: the zygote is a snapshot of the process at this point,
+    // and a lock another thread held then stays held in every worker.
+    void start();
+
+    bool hasTool(const std::string& name) const { return tool_index.count(name) > 0; }
+    std::vector<json> schemas() const;
+
+    // Run a tool in a worker; failures come back as {"status": "ERROR", ...},
+    // as does any call before start(). Thread-safe; at most `workers` calls
+    // run at once.
+    json execute(const std::string& name, const json& arguments);
+
+    const SandboxOptions& options() const { return opts; }
+
+    // Calls served, and workers replaced after a crash or timeout
+    uint64_t calls() const { return calls_served.load(); }
+    uint64_t restarts() const { return workers_replaced.load(); }
+
+    struct Worker;
+
+private:
+    struct Tool {
+        json schema;
+        ToolFunction function;
+    };
+
+    SandboxOptions opts;
+    std::vector<Tool> tools;
+    std::map<std::string, uint32_t> tool_index;
+    std::atomic<bool> started{false};
+
+    std::vector<std::unique_ptr<Worker>> pool;
+    std::vector<Worker*> idle;
+    std::mutex mutex;
+    std::condition_variable worker_free;
+
+    int zygote_pid = -1;
+    int zygote_fd = -1; // SOCK_SEQPACKET; one request in flight at a time
+    std::mutex zygote_mutex;
+
+    std::atomic<uint64_t> calls_served{0};
+    std::atomic<uint64_t> workers_replaced{0};
+
+    // Helper: Have the zygote fork a worker process into `worker`'s slot
+    bool spawn(Worker& worker);
+
+    // Helper: Kill and reap a worker; returns how it ended
+    std::string reap(Worker& worker, bool kill_first);
+
+    // Helper: One request/response exchange
+    json call(Worker& worker, uint32_t tool, const json& arguments);
+
+    // Helper: Zygote process main loop (never returns)
+    [[noreturn]] void zygote(int fd, size_t page_size);
+
+    // Helper: Worker process main loop (never returns)
+    [[noreturn]] void serve(int socket_fd, int arena_fd, size_t address_space);
+};
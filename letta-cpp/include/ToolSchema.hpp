@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+class SchemaError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// A tool's "parameters" JSON schema compiled for checking arguments the model
+// produced, and for telling a local backend what it may produce.
+//
+// Supported keywords: type (one or a list), properties, required,
+// additionalProperties (false or a schema), items, enum and const. Anything
+// else (anyOf, $ref, string formats, bounds) is not checked: the node accepts
+// any value of its declared type, so a schema the compiler does not fully
+// understand only ever makes validation more permissive.
+class ToolSchema {
+public:
+    // Throws SchemaError if `parameters` is malformed (not an object, a type
+    // that is not a JSON type, properties that are not an object, ...)
+    static ToolSchema compile(const json& parameters);
+
+    // Accepts any JSON value; what tools without a usable schema get
+    ToolSchema();
+
+    // Whole-document check. On failure `error` (if given) says what is wrong
+    // and where, in terms the model can act on.
+    bool validate(std::string_view arguments, std::string* error = nullptr) const;
+
+    // GBNF (llama.cpp grammar) for the arguments, rules prefixed with `name`
+    // and the whole document being rule `name`. Objects are written with their
+    // required properties first (in "required" order) and the optional ones
+    // after, in name order; extra properties are never generated.
+    std::string gbnf(const std::string& name = "root") const;
+
+    // The same language as a regular expression (vLLM guided_regex,
+    // Outlines). Regexes cannot nest, so values the schema leaves open are
+    // limited to scalars and flat arrays/objects of scalars.
+    std::string regex() const;
+
+private:
+    friend class ArgumentValidator;
+    friend class ToolSchemas;
+
+    enum Type : uint8_t {
+        Null = 1, Boolean = 2, Integer = 4, Number = 8, String = 16, Array = 32, Object = 64,
+        Any = 127
+    };
+
+    struct Property {
+        std::string name;
+        int node;
+        int required_bit; // -1 if optional
+    };
+
+    struct Node {
+        uint8_t types = Any;
+        std::vector<std::string> enum_values;  // compact JSON of each allowed value; empty: any
+        std::vector<std::string> enum_strings; // the string members of enum_values, decoded
+        bool declared_properties = false;      // "properties" given, even if empty
+        std::vector<Property> properties;      // sorted by name
+        std::vector<int> grammar_order;        // indices into properties: required first
+        uint64_t required_mask = 0;
+        int additional = -1;                   // schema of extra properties; -1 any
+        bool additional_allowed = true;
+        int items = -1;                        // schema of array items; -1 any
+    };
+
+    std::vector<Node> nodes; // nodes[0] is the root
+
+    struct GrammarWriter;
+
+    int compileNode(const json& schema, int depth);
+    // Helper: GBNF expression for a node, defining rules it needs under `rule`
+    std::string nodeGbnf(int node, const std::string& rule, GrammarWriter& out) const;
+    // Helper: A rule name (or primitive) standing for the node
+    std::string refGbnf(int node, const std::string& rule, GrammarWriter& out) const;
+    std::string nodeRegex(int node) const;
+};
+
+// Checks arguments as they arrive, a chunk (or a byte) at a time, so a
+// streamed tool call can be rejected at the first byte that cannot lead to a
+// valid document instead of after the model has finished writing it.
+//
+// Runs in constant memory per nesting level: strings are only buffered when
+// the schema needs their value (object keys, enums).
+class ArgumentValidator {
+public:
+    // `schema` must outlive the validator
+    explicit ArgumentValidator(const ToolSchema& schema);
+
+    // Consume the next chunk. False once the input can no longer be valid;
+    // further input is ignored.
+    bool feed(std::string_view chunk);
+
+    // End of input: true if everything fed is one complete, valid document
+    bool finish();
+
+    bool failed() const { return !error_message.empty(); }
+    // What went wrong ("" while valid)
+    const std::string& error() const { return error_message; }
+    // Bytes consumed so far; on failure, the offset of the offending byte
+    size_t offset() const { return consumed; }
+
+    // Start over for a new document against the same schema
+    void reset();
+
+    static constexpr size_t kMaxDepth = 64;
+
+private:
+    enum class State : uint8_t {
+        Value,          // expecting a value
+        ObjectFirst,    // after '{': key or '}'
+        ObjectKey,      // after ',': key
+        Colon,          // after a key
+        ObjectNext,     // after a member: ',' or '}'
+        ArrayFirst,     // after '[': value or ']'
+        ArrayNext,      // after an element: ',' or ']'
+        String,         // inside a string
+        Escape,         // after '\'
+        Unicode,        // inside \uXXXX
+        Utf8,           // inside a multi-byte UTF-8 sequence
+        Literal,        // inside true / false / null
+        NumMinus, NumZero, NumInt, NumDot, NumFrac, NumExp, NumExpSign, NumExpInt,
+        Done
+    };
+
+    struct Frame {
+        int node;            // schema node of the container
+        bool object;
+        uint64_t seen = 0;   // required properties seen (objects)
+        size_t index = 0;    // elements so far (arrays)
+        std::string key;     // current member (objects), for error paths
+    };
+
+    const ToolSchema* schema;
+    std::vector<Frame> stack;
+    State state = State::Value;
+    int value_node = 0;                  // schema node of the value being read
+    bool in_key = false;                 // the current string is an object key
+    bool capture = false;                // buffer the current string / scalar
+    std::string text;                    // captured key, enum value or literal
+    const char* literal = nullptr;       // remaining bytes of true/false/null
+    uint8_t pending = 0;                 // hex digits or UTF-8 continuation bytes left
+    uint32_t code_point = 0;
+    bool integer_only = false;
+    size_t consumed = 0;
+    std::string error_message;
+
+    bool step(char c);
+    bool beginValue(char c);
+    bool endValue();
+    bool endString();
+    bool endScalar();
+    bool closeContainer();
+    bool fail(const std::string& message);
+    // Helper: Whether the captured prefix can still become an allowed key / enum
+    bool prefixAllowed() const;
+    // Helper: "$.a[2].b" for the value being read; without the innermost
+    // member if `member` is false
+    std::string path(bool member = true) const;
+};
+
+// Compiled schemas for a tool list (OpenAI function tools, as in Tools.hpp),
+// by tool name
+class ToolSchemas {
+public:
+    ToolSchemas() = default;
+    // Tools whose schema does not compile are logged and left unchecked
+    explicit ToolSchemas(const std::vector<json>& tools);
+
+    // nullptr for tools without a schema
+    const ToolSchema* find(const std::string& name) const;
+    size_t size() const { return schemas.size(); }
+
+    // A grammar / regex for one call to any of the tools, as the JSON
+    // envelope {"name": "<tool>", "arguments": {...}} that local backends
+    // emit for tool calls (see LLMClient GuidedDecoding)
+    std::string gbnf() const;
+    std::string regex() const;
+
+private:
+    std::vector<std::pair<std::string, ToolSchema>> schemas; // in tool list order
+};
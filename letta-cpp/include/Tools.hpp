@@ -1,9 +1,12 @@
 #pragma once
+#include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
+class Memory;
+
 namespace Tools {
 
     static json send_message = {
@@ -72,7 +75,30 @@ namespace Tools {
         }}
     };
 
+    static json finish_memory_edits = {
+        {"type", "function"},
+        {"function", {
+            {"name", "finish_memory_edits"},
+            {"description", "Call when memory is up to date and there is nothing left to edit."},
+            {"parameters", {
+                {"type", "object"},
+                {"properties", json::object()}
+            }}
+        }}
+    };
+
     static std::vector<json> get_all_tools() {
         return {send_message, core_memory_append, core_memory_replace};
     }
+
+    // What the background sleep-time agent may call (it never talks to the user)
+    static std::vector<json> get_memory_tools() {
+        return {core_memory_append, core_memory_replace, finish_memory_edits};
+    }
+
+    bool is_memory_tool(const std::string& name);
+
+    // Run core_memory_append / core_memory_replace against `memory` and return
+    // the tool result. Shared by the foreground and sleep-time agents.
+    json execute_memory_tool(Memory& memory, const std::string& name, const json& arguments);
 }
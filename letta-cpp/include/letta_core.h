@@ -0,0 +1,154 @@
+/*
+ * letta_core: a stable C ABI over the letta-cpp hot paths, for the Python
+ * server (see python/letta_core) and anything else that can call C.
+ *
+ * Conventions
+ *   - Objects are opaque handles from letta_*_new() and released with the
+ *     matching letta_*_free(). A handle may be used from any thread, but by
+ *     one thread at a time; different handles are independent.
+ *   - Strings go in as letta_str (pointer + length, no terminator needed,
+ *     UTF-8). Nothing is copied out: results are letta_str views into a
+ *     buffer the handle owns, valid until the next call on that handle.
+ *   - Functions that can fail return a letta_status; on failure
+ *     letta_last_error() describes the problem (per thread).
+ *   - No C++ exception ever crosses this boundary.
+ *
+ * Additions keep existing signatures and bump LETTA_CORE_ABI_VERSION's minor
+ * part; a change to anything below bumps the major part.
+ */
+#ifndef LETTA_CORE_H
+#define LETTA_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define LETTA_CORE_API __declspec(dllexport)
+#else
+#define LETTA_CORE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LETTA_CORE_ABI_VERSION 0x00010000u /* major << 16 | minor */
+
+typedef enum letta_status {
+    LETTA_OK = 0,
+    LETTA_ERROR_INVALID_ARGUMENT = 1, /* null handle, bad role, malformed shape */
+    LETTA_ERROR_PARSE = 2,            /* JSON or template syntax */
+    LETTA_ERROR_NOT_FOUND = 3,        /* no such block */
+    LETTA_ERROR_IO = 4,               /* agent files and snapshots */
+    LETTA_ERROR_INTERNAL = 5
+} letta_status;
+
+typedef enum letta_role {
+    LETTA_ROLE_SYSTEM = 0,
+    LETTA_ROLE_USER = 1,
+    LETTA_ROLE_ASSISTANT = 2,
+    LETTA_ROLE_TOOL = 3
+} letta_role;
+
+typedef struct letta_str {
+    const char* data;
+    size_t size;
+} letta_str;
+
+typedef struct letta_memory letta_memory;
+typedef struct letta_messages letta_messages;
+typedef struct letta_client letta_client;
+typedef struct letta_agent letta_agent;
+typedef struct letta_response letta_response;
+
+LETTA_CORE_API uint32_t letta_core_abi_version(void);
+
+/* Message for the last failed call on this thread ("" if none) */
+LETTA_CORE_API const char* letta_last_error(void);
+
+/* --- Memory: blocks and system prompt compilation ----------------------- */
+
+/* Empty memory rendering with the built-in template */
+LETTA_CORE_API letta_memory* letta_memory_new(void);
+LETTA_CORE_API void letta_memory_free(letta_memory* memory);
+
+/* Add a block, or replace the one with this label in place */
+LETTA_CORE_API letta_status letta_memory_set_block(letta_memory* memory, letta_str label, letta_str value,
+                                                   int32_t limit, int read_only);
+LETTA_CORE_API letta_status letta_memory_remove_block(letta_memory* memory, letta_str label);
+LETTA_CORE_API size_t letta_memory_block_count(const letta_memory* memory);
+
+/* Render with a PromptTemplate source (see PromptTemplate.hpp); an empty
+ * source restores the built-in template */
+LETTA_CORE_API letta_status letta_memory_set_template(letta_memory* memory, letta_str source);
+
+/* The compiled system prompt */
+LETTA_CORE_API letta_status letta_memory_compile(letta_memory* memory, letta_str* out);
+
+/* --- Messages: conversation history -------------------------------------- */
+
+LETTA_CORE_API letta_messages* letta_messages_new(void);
+LETTA_CORE_API void letta_messages_free(letta_messages* messages);
+
+/* One OpenAI-style message object, or an array of them; all or nothing */
+LETTA_CORE_API letta_status letta_messages_append_json(letta_messages* messages, letta_str json);
+LETTA_CORE_API letta_status letta_messages_append(letta_messages* messages, letta_role role, letta_str content);
+LETTA_CORE_API letta_status letta_messages_set_content(letta_messages* messages, size_t index, letta_str content);
+LETTA_CORE_API size_t letta_messages_size(const letta_messages* messages);
+LETTA_CORE_API void letta_messages_clear(letta_messages* messages);
+
+/* OpenAI-style message array */
+LETTA_CORE_API letta_status letta_messages_to_json(letta_messages* messages, letta_str* out);
+
+/* --- Provider adapters ---------------------------------------------------- */
+
+/* Endpoint as LLMClient takes it; Gemini is detected from the base URL */
+LETTA_CORE_API letta_client* letta_client_new(letta_str api_key, letta_str base_url, letta_str model);
+LETTA_CORE_API void letta_client_free(letta_client* client);
+
+/* The HTTP request for a completion over `messages` offering `tools_json`
+ * (a JSON array of OpenAI tool schemas; empty for none). `headers_json` is a
+ * JSON object. All three views are valid until the next call on `client`. */
+LETTA_CORE_API letta_status letta_client_build_request(letta_client* client, const letta_messages* messages,
+                                                       letta_str tools_json, letta_str* url, letta_str* headers_json,
+                                                       letta_str* body);
+
+/* A provider's response as an OpenAI chat completion (or {"error": ...}) */
+LETTA_CORE_API letta_status letta_client_parse_response(letta_client* client, long status_code, letta_str body,
+                                                        letta_str* out);
+
+/* --- Agent ---------------------------------------------------------------- */
+
+/* Called for each model request an agent makes; fill `response` with
+ * letta_response_set before returning. Runs on the thread in
+ * letta_agent_step. */
+typedef void (*letta_transport_fn)(void* user, letta_str url, letta_str headers_json, letta_str body,
+                                   letta_response* response);
+LETTA_CORE_API void letta_response_set(letta_response* response, long status_code, letta_str body);
+
+LETTA_CORE_API letta_agent* letta_agent_new(letta_str api_key, letta_str model);
+LETTA_CORE_API void letta_agent_free(letta_agent* agent);
+
+/* Route the agent's model requests through `transport` instead of HTTP */
+LETTA_CORE_API letta_status letta_agent_set_transport(letta_agent* agent, letta_transport_fn transport, void* user);
+
+LETTA_CORE_API letta_status letta_agent_set_block(letta_agent* agent, letta_str label, letta_str value, int32_t limit,
+                                                  int read_only);
+
+/* One turn; `replies_json` is a JSON array of what the agent said */
+LETTA_CORE_API letta_status letta_agent_step(letta_agent* agent, letta_str user_message, letta_str* replies_json);
+
+LETTA_CORE_API letta_status letta_agent_memory(letta_agent* agent, letta_str* out);
+LETTA_CORE_API letta_status letta_agent_messages_json(letta_agent* agent, letta_str* out);
+
+/* Agent files (.af) and binary snapshots (see AgentFile.hpp) */
+LETTA_CORE_API letta_status letta_agent_import(letta_agent* agent, const char* path);
+LETTA_CORE_API letta_status letta_agent_export(letta_agent* agent, const char* path);
+LETTA_CORE_API letta_status letta_agent_load_snapshot(letta_agent* agent, const char* path);
+LETTA_CORE_API letta_status letta_agent_save_snapshot(letta_agent* agent, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LETTA_CORE_H */
@@ -0,0 +1,321 @@
+"""letta_core against the pure-Python code paths it replaces in the server.
+
+The Python side mirrors the server: Memory._render_memory_blocks_standard
+(letta/schemas/memory.py), building the provider payload from OpenAI-style
+dicts and json.dumps, and normalising a Gemini response. Each pair is checked
+for identical output before it is timed.
+
+    LETTA_CORE_LIB=build/libletta_core.so python3 python/bench_letta_core.py
+    ... --check     parity checks only (what ctest runs)
+"""
+
+import io
+import json
+import os
+import sys
+import threading
+import time
+
+import letta_core
+
+# Letta's standard memory rendering as a letta-cpp prompt template
+LETTA_MEMORY_TEMPLATE = (
+    "{% if block_count > 0 %}"
+    "<memory_blocks>\nThe following memory blocks are currently engaged in your core memory unit:\n\n"
+    "{% for block in blocks %}"
+    "<{{ block.label }}>\n<description>\n\n</description>\n<metadata>"
+    "{% if block.read_only %}\n- read_only=true{% endif %}"
+    "\n- chars_current={{ block.length }}\n- chars_limit={{ block.limit }}\n</metadata>\n"
+    "<value>\n{{ block.value }}\n</value>\n</{{ block.label }}>\n"
+    "{% if not loop.last %}\n{% endif %}"
+    "{% endfor %}"
+    "\n</memory_blocks>"
+    "{% endif %}"
+)
+
+GEMINI_URL = "https://generativelanguage.googleapis.com/v1beta"
+
+WORDS = "agent memory block the archival passage of embedding token a context window tool call summary recall".split()
+
+
+def text(n, seed):
+    out, state = [], seed
+    while sum(len(w) + 1 for w in out) < n:
+        state = (state * 1103515245 + 12345) & 0xFFFFFFFF
+        out.append(WORDS[(state >> 16) % len(WORDS)])
+    return " ".join(out)[:n]
+
+
+# --- The pure-Python equivalents ----------------------------------------------
+
+
+class Block:
+    def __init__(self, label, value, limit, read_only=False):
+        self.label, self.value, self.limit, self.read_only, self.description = label, value, limit, read_only, None
+
+
+def render_memory_blocks_standard(blocks):
+    """letta.schemas.memory.Memory._render_memory_blocks_standard"""
+    s = io.StringIO()
+    if len(blocks) == 0:
+        s.write("")
+        return s.getvalue()
+    s.write("<memory_blocks>\nThe following memory blocks are currently engaged in your core memory unit:\n\n")
+    for idx, block in enumerate(blocks):
+        label = block.label or "block"
+        value = block.value or ""
+        desc = block.description or ""
+        chars_current = len(value)
+        limit = block.limit if block.limit is not None else 0
+        s.write(f"<{label}>\n")
+        s.write("<description>\n")
+        s.write(f"{desc}\n")
+        s.write("</description>\n")
+        s.write("<metadata>")
+        if getattr(block, "read_only", False):
+            s.write("\n- read_only=true")
+        s.write(f"\n- chars_current={chars_current}")
+        s.write(f"\n- chars_limit={limit}\n")
+        s.write("</metadata>\n")
+        s.write("<value>\n")
+        s.write(f"{value}\n")
+        s.write("</value>\n")
+        s.write(f"</{label}>\n")
+        if idx != len(blocks) - 1:
+            s.write("\n")
+    s.write("\n</memory_blocks>")
+    return s.getvalue()
+
+
+def openai_payload(messages, tools, model):
+    payload = {"messages": messages, "model": model}
+    if tools:
+        payload["tools"] = tools
+        payload["tool_choice"] = "auto"
+    return json.dumps(payload, separators=(",", ":")).encode()
+
+
+def gemini_payload(messages, tools):
+    contents, system = [], None
+    for m in messages:
+        role = m["role"]
+        if role == "system":
+            system = m["content"]
+        elif role == "user":
+            contents.append({"role": "user", "parts": [{"text": m["content"]}]})
+        elif role == "assistant":
+            calls = m.get("tool_calls") or []
+            if calls:
+                parts = [{"functionCall": {"name": c["function"]["name"], "args": json.loads(c["function"]["arguments"])}}
+                         for c in calls]
+            else:
+                parts = [{"text": m.get("content") or ""}]
+            contents.append({"role": "model", "parts": parts})
+        else:
+            try:
+                response = json.loads(m["content"])
+                if not isinstance(response, dict):
+                    response = {"result": m["content"]}
+            except ValueError:
+                response = {"result": m["content"]}
+            contents.append({"role": "function", "parts": [{"functionResponse": {"name": m["name"], "response": response}}]})
+    payload = {"contents": contents}
+    if system is not None:
+        payload["system_instruction"] = {"parts": [{"text": system}]}
+    if tools:
+        payload["tools"] = [{"function_declarations": [t["function"] for t in tools if t["type"] == "function"]}]
+    return json.dumps(payload, separators=(",", ":")).encode()
+
+
+def gemini_normalize(body):
+    response = json.loads(body)
+    message = {"role": "assistant"}
+    candidates = response.get("candidates") or []
+    if candidates and "parts" in candidates[0].get("content", {}):
+        calls, content = [], ""
+        for part in candidates[0]["content"]["parts"]:
+            if "text" in part:
+                content += part["text"]
+            elif "functionCall" in part:
+                fc = part["functionCall"]
+                calls.append({"id": "call_" + fc["name"], "type": "function",
+                              "function": {"name": fc["name"], "arguments": json.dumps(fc["args"], separators=(",", ":"))}})
+        message["content"] = content or None
+        if calls:
+            message["tool_calls"] = calls
+    adapted = {"choices": [{"message": message}]}
+    if "usageMetadata" in response:
+        usage = response["usageMetadata"]
+        adapted["usage"] = {"prompt_tokens": usage.get("promptTokenCount", 0),
+                            "completion_tokens": usage.get("candidatesTokenCount", 0),
+                            "total_tokens": usage.get("totalTokenCount", 0)}
+    return json.dumps(adapted).encode()
+
+
+# --- Workloads --------------------------------------------------------------------
+
+
+def blocks(count, size):
+    return [Block(f"block_{i}", text(size, i + 1), size * 2, read_only=i % 3 == 0) for i in range(count)]
+
+
+def history(turns, size):
+    messages = [{"role": "system", "content": text(4000, 99)}]
+    for i in range(turns):
+        messages.append({"role": "user", "content": text(size, 3 * i)})
+        args = json.dumps({"message": text(size, 3 * i + 1)})
+        messages.append({"role": "assistant", "content": None,
+                         "tool_calls": [{"id": f"call_{i}", "type": "function",
+                                         "function": {"name": "send_message", "arguments": args}}]})
+        messages.append({"role": "tool", "tool_call_id": f"call_{i}", "name": "send_message",
+                         "content": json.dumps({"status": "OK", "message": None})})
+    return messages
+
+
+TOOLS = [{"type": "function", "function": {"name": n, "description": "d",
+                                           "parameters": {"type": "object", "properties": {}}}}
+         for n in ("send_message", "core_memory_append", "core_memory_replace")]
+
+GEMINI_REPLY = json.dumps({
+    "candidates": [{"content": {"parts": [{"text": "thinking"}] + [
+        {"functionCall": {"name": "send_message", "args": {"message": text(2000, 5)}}}]}}],
+    "usageMetadata": {"promptTokenCount": 9000, "candidatesTokenCount": 500, "totalTokenCount": 9500},
+}).encode()
+
+
+def make_memory(workload):
+    memory = letta_core.Memory(LETTA_MEMORY_TEMPLATE)
+    for b in workload:
+        memory.set_block(b.label, b.value, b.limit, b.read_only)
+    return memory
+
+
+# --- Checks and timing ----------------------------------------------------------
+
+
+def check():
+    for workload in (blocks(0, 10), blocks(1, 100), blocks(8, 2000)):
+        assert make_memory(workload).compile() == render_memory_blocks_standard(workload), "memory rendering differs"
+
+    messages = history(20, 500)
+    store = letta_core.Messages(messages)
+    assert len(store) == len(messages)
+    openai = letta_core.Client("k", "http://localhost:8000/v1", "gpt-4o-mini")
+    _, headers, body = openai.build_request(store, TOOLS)
+    assert headers["Authorization"] == "Bearer k"
+    assert json.loads(body) == json.loads(openai_payload(messages, TOOLS, "gpt-4o-mini")), "OpenAI payload differs"
+    gemini = letta_core.Client("k", GEMINI_URL, "gemini-2.5-flash")
+    _, _, body = gemini.build_request(store, TOOLS)
+    assert json.loads(body) == json.loads(gemini_payload(messages, TOOLS)), "Gemini payload differs"
+    assert gemini.parse_response(200, GEMINI_REPLY) == json.loads(gemini_normalize(GEMINI_REPLY)), "normalising differs"
+
+    # Zero-copy in and out: a bytearray goes in by address, the view aliases the library's buffer
+    memory = letta_core.Memory()
+    memory.set_block(bytearray(b"human"), bytearray(b"Name: Chad"))
+    assert b"Name: Chad" in bytes(memory.compile_view())
+
+    # A step through a Python transport, and errors as exceptions
+    def transport(url, headers, body):
+        call = {"name": "send_message", "args": {"message": "hi from python"}}
+        return 200, json.dumps({"candidates": [{"content": {"parts": [{"functionCall": call}]}}]})
+
+    agent = letta_core.Agent("k", transport=transport)
+    assert agent.step("hello") == ["hi from python"]
+    try:
+        memory.remove_block("missing")
+        raise AssertionError("expected LettaError")
+    except letta_core.LettaError as e:
+        assert e.status == 3
+    print("letta_core parity checks passed")
+
+
+def per_call(fn, min_seconds=0.2, repeats=3):
+    """Best of `repeats` timings of at least `min_seconds`, per call."""
+    fn()
+    best = float("inf")
+    for _ in range(repeats):
+        runs, start = 0, time.perf_counter()
+        while True:
+            fn()
+            runs += 1
+            elapsed = time.perf_counter() - start
+            if elapsed >= min_seconds:
+                break
+        best = min(best, elapsed / runs)
+    return best
+
+
+def compare(name, python_fn, core_fn):
+    p, c = per_call(python_fn), per_call(core_fn)
+    print(f"{name:44s} {p * 1e6:12.1f} {c * 1e6:12.1f} {p / c:8.1f}x")
+
+
+def progress_during(fn):
+    """Pure-Python iterations this thread gets through while another thread
+    makes the single call `fn()`, and how long that call took."""
+    done = threading.Event()
+
+    def work():
+        fn()
+        done.set()
+
+    counter, start = 0, time.perf_counter()
+    worker = threading.Thread(target=work)
+    worker.start()
+    while not done.is_set():
+        counter += 1
+    worker.join()
+    return counter, time.perf_counter() - start
+
+
+def bench():
+    # Raise glibc's dynamic mmap threshold up front, so whichever side runs
+    # first does not pay page faults on its large buffers
+    scratch = bytearray(16 << 20)
+    del scratch
+    print(f"letta_core ABI {letta_core.abi_version()}, {os.cpu_count()} CPUs")
+    print(f"{'':44s} {'python us':>12s} {'core us':>12s} {'speedup':>9s}")
+
+    for count, size in ((8, 2000), (4, 50000)):
+        workload = blocks(count, size)
+        memory = make_memory(workload)
+        compare(f"memory compile, {count} x {size // 1000} KB blocks",
+                lambda: render_memory_blocks_standard(workload), memory.compile)
+        compare(f"  ... as a zero-copy view", lambda: render_memory_blocks_standard(workload), memory.compile_view)
+
+    for turns in (50, 500):
+        messages = history(turns, 1000)
+        store = letta_core.Messages(messages)
+        openai = letta_core.Client("k", "http://localhost:8000/v1", "gpt-4o-mini")
+        gemini = letta_core.Client("k", GEMINI_URL, "gemini-2.5-flash")
+        n = len(messages)
+        compare(f"OpenAI request body, {n} messages", lambda: openai_payload(messages, TOOLS, "gpt-4o-mini"),
+                lambda: openai.build_request_view(store, TOOLS))
+        compare(f"Gemini request body, {n} messages", lambda: gemini_payload(messages, TOOLS),
+                lambda: gemini.build_request_view(store, TOOLS))
+        raw = json.dumps(messages).encode()
+
+        def ingest():
+            store.clear()
+            store.extend(raw)
+
+        compare(f"load history JSON, {n} messages", lambda: json.loads(raw), ingest)
+
+    gemini = letta_core.Client("k", GEMINI_URL, "gemini-2.5-flash")
+    compare("normalise Gemini response", lambda: gemini_normalize(GEMINI_REPLY),
+            lambda: gemini.parse_response_view(200, GEMINI_REPLY))
+
+    # json.loads keeps the GIL for the whole parse; letta_core hands it back
+    raw = json.dumps(history(3000, 1000)).encode()
+    store = letta_core.Messages()
+    print()
+    for name, fn in (("json.loads", lambda: json.loads(raw)), ("letta_core Messages.extend", lambda: store.extend(raw))):
+        counter, seconds = progress_during(fn)
+        print(f"{name:28s} {len(raw) >> 20} MB in {seconds * 1e3:6.1f} ms; "
+              f"the main thread meanwhile ran {counter} loop iterations")
+
+
+if __name__ == "__main__":
+    check()
+    if "--check" not in sys.argv:
+        bench()
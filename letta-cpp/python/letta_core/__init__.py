@@ -0,0 +1,340 @@
+"""Python bindings for letta-cpp's C ABI (include/letta_core.h).
+
+The bindings use ctypes against libletta_core.so, so nothing needs compiling
+against the interpreter and one build serves every Python version. ctypes
+releases the GIL for the duration of every foreign call, so prompt
+compilation, serialization and agent steps run in parallel with other
+Python threads (a transport callback takes the GIL back while it runs).
+
+Buffers are passed without copying where Python allows it:
+  - `bytes`, `bytearray` and writable buffers go in by address; `str` is
+    encoded once.
+  - The `*_view()` methods return a memoryview over the library's own
+    buffer. It is valid until the next call on the same object; take
+    `bytes(view)` to keep it.
+
+The library is found through $LETTA_CORE_LIB, next to this package, or on
+the loader path.
+"""
+
+import ctypes
+import json
+import os
+from ctypes import CFUNCTYPE, POINTER, Structure, c_char, c_char_p, c_int, c_int32, c_long, c_size_t, c_uint32, c_void_p
+
+__all__ = ["Agent", "Client", "LettaError", "Memory", "Messages", "ROLE_ASSISTANT", "ROLE_SYSTEM", "ROLE_TOOL",
+           "ROLE_USER", "abi_version"]
+
+ROLE_SYSTEM, ROLE_USER, ROLE_ASSISTANT, ROLE_TOOL = range(4)
+
+_STATUS = {1: "invalid argument", 2: "parse error", 3: "not found", 4: "I/O error", 5: "internal error"}
+
+
+class LettaError(Exception):
+    """A letta_core call failed; `status` is the letta_status code."""
+
+    def __init__(self, status, message):
+        super().__init__(f"{_STATUS.get(status, status)}: {message}")
+        self.status = status
+
+
+class _Str(Structure):
+    _fields_ = [("data", c_void_p), ("size", c_size_t)]
+
+
+class _Response(Structure):
+    pass
+
+
+_TRANSPORT = CFUNCTYPE(None, c_void_p, _Str, _Str, _Str, POINTER(_Response))
+
+
+def _load():
+    candidates = []
+    if os.environ.get("LETTA_CORE_LIB"):
+        candidates.append(os.environ["LETTA_CORE_LIB"])
+    candidates.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "libletta_core.so"))
+    candidates.append("libletta_core.so")
+    errors = []
+    for path in candidates:
+        try:
+            return ctypes.CDLL(path)
+        except OSError as e:
+            errors.append(str(e))
+    raise ImportError("cannot load libletta_core: " + "; ".join(errors))
+
+
+_lib = _load()
+
+
+def _declare(name, restype, *argtypes):
+    fn = getattr(_lib, name)
+    fn.restype = restype
+    fn.argtypes = argtypes
+    return fn
+
+
+_S = POINTER(_Str)
+_declare("letta_core_abi_version", c_uint32)
+_declare("letta_last_error", c_char_p)
+_declare("letta_memory_new", c_void_p)
+_declare("letta_memory_free", None, c_void_p)
+_declare("letta_memory_set_block", c_int, c_void_p, _Str, _Str, c_int32, c_int)
+_declare("letta_memory_remove_block", c_int, c_void_p, _Str)
+_declare("letta_memory_block_count", c_size_t, c_void_p)
+_declare("letta_memory_set_template", c_int, c_void_p, _Str)
+_declare("letta_memory_compile", c_int, c_void_p, _S)
+_declare("letta_messages_new", c_void_p)
+_declare("letta_messages_free", None, c_void_p)
+_declare("letta_messages_append_json", c_int, c_void_p, _Str)
+_declare("letta_messages_append", c_int, c_void_p, c_int, _Str)
+_declare("letta_messages_set_content", c_int, c_void_p, c_size_t, _Str)
+_declare("letta_messages_size", c_size_t, c_void_p)
+_declare("letta_messages_clear", None, c_void_p)
+_declare("letta_messages_to_json", c_int, c_void_p, _S)
+_declare("letta_client_new", c_void_p, _Str, _Str, _Str)
+_declare("letta_client_free", None, c_void_p)
+_declare("letta_client_build_request", c_int, c_void_p, c_void_p, _Str, _S, _S, _S)
+_declare("letta_client_parse_response", c_int, c_void_p, c_long, _Str, _S)
+_declare("letta_response_set", None, POINTER(_Response), c_long, _Str)
+_declare("letta_agent_new", c_void_p, _Str, _Str)
+_declare("letta_agent_free", None, c_void_p)
+_declare("letta_agent_set_transport", c_int, c_void_p, _TRANSPORT, c_void_p)
+_declare("letta_agent_set_block", c_int, c_void_p, _Str, _Str, c_int32, c_int)
+_declare("letta_agent_step", c_int, c_void_p, _Str, _S)
+_declare("letta_agent_memory", c_int, c_void_p, _S)
+_declare("letta_agent_messages_json", c_int, c_void_p, _S)
+for _name in ("letta_agent_import", "letta_agent_export", "letta_agent_load_snapshot", "letta_agent_save_snapshot"):
+    _declare(_name, c_int, c_void_p, c_char_p)
+
+
+def abi_version():
+    """(major, minor) of the loaded library's C ABI."""
+    v = _lib.letta_core_abi_version()
+    return v >> 16, v & 0xFFFF
+
+
+def _arg(value):
+    """A letta_str over `value` and whatever must stay alive while it is used."""
+    if value is None:
+        return _Str(None, 0), None
+    if isinstance(value, str):
+        value = value.encode()
+    if isinstance(value, bytes):
+        # Points into the bytes object itself
+        return _Str(ctypes.cast(c_char_p(value), c_void_p), len(value)), value
+    view = memoryview(value)
+    if not view.contiguous:
+        raise ValueError("buffer must be contiguous")
+    if view.readonly:
+        data = view.tobytes()
+        return _Str(ctypes.cast(c_char_p(data), c_void_p), len(data)), data
+    array = (c_char * view.nbytes).from_buffer(view)
+    return _Str(ctypes.addressof(array), view.nbytes), array
+
+
+def _view(s):
+    if not s.size:
+        return memoryview(b"")
+    return memoryview((c_char * s.size).from_address(s.data)).cast("B")
+
+
+def _bytes(s):
+    return ctypes.string_at(s.data, s.size) if s.size else b""
+
+
+def _check(status):
+    if status:
+        raise LettaError(status, _lib.letta_last_error().decode(errors="replace"))
+
+
+class _Handle:
+    _free = None
+
+    def __init__(self, pointer):
+        if not pointer:
+            raise LettaError(5, _lib.letta_last_error().decode(errors="replace"))
+        self._ptr = pointer
+
+    def close(self):
+        if self._ptr:
+            type(self)._free(self._ptr)
+            self._ptr = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+
+class Memory(_Handle):
+    """Memory blocks and the system prompt they compile into."""
+
+    _free = _lib.letta_memory_free
+
+    def __init__(self, template=None):
+        super().__init__(_lib.letta_memory_new())
+        if template:
+            self.set_template(template)
+
+    def set_block(self, label, value, limit=5000, read_only=False):
+        (l, keep_l), (v, keep_v) = _arg(label), _arg(value)
+        _check(_lib.letta_memory_set_block(self._ptr, l, v, limit, int(bool(read_only))))
+
+    def remove_block(self, label):
+        l, keep = _arg(label)
+        _check(_lib.letta_memory_remove_block(self._ptr, l))
+
+    def __len__(self):
+        return _lib.letta_memory_block_count(self._ptr)
+
+    def set_template(self, source):
+        """PromptTemplate source (see PromptTemplate.hpp); None restores the built-in one."""
+        s, keep = _arg(source)
+        _check(_lib.letta_memory_set_template(self._ptr, s))
+
+    def compile_view(self):
+        out = _Str()
+        _check(_lib.letta_memory_compile(self._ptr, ctypes.byref(out)))
+        return _view(out)
+
+    def compile(self):
+        out = _Str()
+        _check(_lib.letta_memory_compile(self._ptr, ctypes.byref(out)))
+        return _bytes(out).decode()
+
+
+class Messages(_Handle):
+    """Conversation history in letta-cpp's columnar store."""
+
+    _free = _lib.letta_messages_free
+
+    def __init__(self, messages=None):
+        super().__init__(_lib.letta_messages_new())
+        if messages is not None:
+            self.extend(messages)
+
+    def extend(self, messages):
+        """Append OpenAI-style messages: a list of dicts, or JSON text/bytes of one."""
+        if isinstance(messages, (list, dict)):
+            messages = json.dumps(messages)
+        s, keep = _arg(messages)
+        _check(_lib.letta_messages_append_json(self._ptr, s))
+
+    def append(self, role, content):
+        s, keep = _arg(content)
+        _check(_lib.letta_messages_append(self._ptr, role, s))
+
+    def set_content(self, index, content):
+        s, keep = _arg(content)
+        _check(_lib.letta_messages_set_content(self._ptr, index, s))
+
+    def clear(self):
+        _lib.letta_messages_clear(self._ptr)
+
+    def __len__(self):
+        return _lib.letta_messages_size(self._ptr)
+
+    def json_view(self):
+        out = _Str()
+        _check(_lib.letta_messages_to_json(self._ptr, ctypes.byref(out)))
+        return _view(out)
+
+    def to_list(self):
+        return json.loads(bytes(self.json_view()))
+
+
+class Client(_Handle):
+    """Provider adapters: request building and response normalisation, no I/O."""
+
+    _free = _lib.letta_client_free
+
+    def __init__(self, api_key, base_url="https://api.openai.com/v1", model="gpt-4"):
+        (k, a), (b, c), (m, d) = _arg(api_key), _arg(base_url), _arg(model)
+        super().__init__(_lib.letta_client_new(k, b, m))
+
+    def build_request_view(self, messages, tools=None):
+        """(url, headers, body memoryview) for a completion over `messages`."""
+        if isinstance(tools, list):
+            tools = json.dumps(tools)
+        t, keep = _arg(tools)
+        url, headers, body = _Str(), _Str(), _Str()
+        _check(_lib.letta_client_build_request(self._ptr, messages._ptr, t, ctypes.byref(url), ctypes.byref(headers),
+                                               ctypes.byref(body)))
+        return _bytes(url).decode(), json.loads(_bytes(headers)), _view(body)
+
+    def build_request(self, messages, tools=None):
+        url, headers, body = self.build_request_view(messages, tools)
+        return url, headers, bytes(body)
+
+    def parse_response_view(self, status_code, body):
+        b, keep = _arg(body)
+        out = _Str()
+        _check(_lib.letta_client_parse_response(self._ptr, status_code, b, ctypes.byref(out)))
+        return _view(out)
+
+    def parse_response(self, status_code, body):
+        return json.loads(bytes(self.parse_response_view(status_code, body)))
+
+
+class Agent(_Handle):
+    """A letta-cpp agent. `transport(url, headers, body) -> (status, body)`
+    replaces its HTTP client, e.g. to route requests through the server's own."""
+
+    _free = _lib.letta_agent_free
+
+    def __init__(self, api_key, model="", transport=None):
+        (k, a), (m, b) = _arg(api_key), _arg(model)
+        super().__init__(_lib.letta_agent_new(k, m))
+        self._transport = None
+        if transport is not None:
+            self.set_transport(transport)
+
+    def set_transport(self, transport):
+        def call(user, url, headers, body, response):
+            try:
+                status, text = transport(_bytes(url).decode(), json.loads(_bytes(headers)), _bytes(body))
+            except Exception as e:  # an exception must not unwind into C
+                status, text = 0, str(e)
+            s, keep = _arg(text)
+            _lib.letta_response_set(response, status, s)
+
+        self._transport = _TRANSPORT(call)  # must outlive the agent's use of it
+        _check(_lib.letta_agent_set_transport(self._ptr, self._transport, None))
+
+    def set_block(self, label, value, limit=2000, read_only=False):
+        (l, a), (v, b) = _arg(label), _arg(value)
+        _check(_lib.letta_agent_set_block(self._ptr, l, v, limit, int(bool(read_only))))
+
+    def step(self, message):
+        """Run one turn; returns what the agent said."""
+        s, keep = _arg(message)
+        out = _Str()
+        _check(_lib.letta_agent_step(self._ptr, s, ctypes.byref(out)))
+        return json.loads(_bytes(out))
+
+    def memory(self):
+        out = _Str()
+        _check(_lib.letta_agent_memory(self._ptr, ctypes.byref(out)))
+        return _bytes(out).decode()
+
+    def messages(self):
+        out = _Str()
+        _check(_lib.letta_agent_messages_json(self._ptr, ctypes.byref(out)))
+        return json.loads(_bytes(out))
+
+    def import_file(self, path):
+        _check(_lib.letta_agent_import(self._ptr, os.fsencode(path)))
+
+    def export_file(self, path):
+        _check(_lib.letta_agent_export(self._ptr, os.fsencode(path)))
+
+    def load_snapshot(self, path):
+        _check(_lib.letta_agent_load_snapshot(self._ptr, os.fsencode(path)))
+
+    def save_snapshot(self, path):
+        _check(_lib.letta_agent_save_snapshot(self._ptr, os.fsencode(path)))
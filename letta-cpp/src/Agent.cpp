@@ -1,36 +1,138 @@
 #include "Agent.hpp"
 #include "Tools.hpp"
+#include "Log.hpp"
+#include "Telemetry.hpp"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 
 using json = nlohmann::json;
 
+namespace {
+std::atomic<uint64_t> next_agent_id{1};
+
+const char* kGeminiBaseUrl = "https://generativelanguage.googleapis.com/v1beta";
+
+// Records tool calls per step on every exit path of Agent::step
+struct StepToolCalls {
+    int64_t count = 0;
+    ~StepToolCalls() {
+        if (Telemetry::enabled()) Telemetry::metrics().tool_calls_per_step->observe(static_cast<double>(count));
+    }
+};
+}
+
 Agent::Agent(const std::string& api_key, const std::string& model) 
-    : llm(api_key, "https://generativelanguage.googleapis.com/v1beta", model) 
+    : id("agent-" + std::to_string(next_agent_id++)),
+      api_key(api_key),
+      model(model),
+      llm(api_key, kGeminiBaseUrl, model) 
 {
+    llm.setSchedulingContext(id, RequestPriority::Interactive);
+    message_handler = [](const std::string& msg) {
+        std::cout << "\n\033[1;32m[Agent (Sam)]: " << msg << "\033[0m\n\n";
+    };
     memory.initializeDefault();
-    tools = Tools::get_all_tools();
+    rebuildTools();
     rebuildSystemPrompt();
 }
 
+Agent::Agent(Agent& parent, ForkTag)
+    : id("agent-" + std::to_string(next_agent_id++)),
+      api_key(parent.api_key),
+      model(parent.model),
+      memory(parent.memory.fork()),
+      llm(parent.llm),
+      messages(parent.messages.fork()),
+      sandbox(parent.sandbox),
+      mcp_servers(parent.mcp_servers),
+      message_handler(parent.message_handler),
+      imported(parent.imported),
+      rendered_version(parent.rendered_version)
+{
+    llm.setSchedulingContext(id, RequestPriority::Interactive);
+    rebuildTools();
+    if (parent.sleeper) {
+        // Nobody consolidates for the fork, so it edits memory itself again
+        if (memory.getTemplate() == PromptTemplate::sleepTimeTemplate()) memory.setTemplate(nullptr);
+    }
+}
+
+std::unique_ptr<Agent> Agent::fork() {
+    std::unique_ptr<Agent> child(new Agent(*this, ForkTag{}));
+    LETTA_LOG_DEBUG("agent", "Forked", {"agent", id}, {"fork", child->id}, {"messages", messages.size()});
+    return child;
+}
+
+Agent::~Agent() {
+    // Stop the worker before the blocks it edits go away with `memory`
+    sleeper.reset();
+}
+
+void Agent::setToolSandbox(std::shared_ptr<ToolSandbox> tool_sandbox) {
+    sandbox = std::move(tool_sandbox);
+    rebuildTools();
+}
+
+void Agent::addMcpServer(std::shared_ptr<McpClient> server) {
+    mcp_servers.push_back(std::move(server));
+    rebuildTools();
+}
+
+uint64_t Agent::mcpToolsVersion() const {
+    uint64_t version = 0;
+    for (const auto& server : mcp_servers) version += server->toolsVersion();
+    return version;
+}
+
+void Agent::rebuildTools() {
+    bool memory_tools = !sleeper || !sleeper->options().remove_foreground_memory_tools;
+    tools = memory_tools ? Tools::get_all_tools() : std::vector<json>{Tools::send_message};
+    if (sandbox) {
+        for (auto& schema : sandbox->schemas()) tools.push_back(std::move(schema));
+    }
+    mcp_tools_version = mcpToolsVersion();
+    for (const auto& server : mcp_servers) {
+        for (auto& schema : server->tools()) {
+            const std::string& name = schema["function"]["name"].get_ref<const std::string&>();
+            bool taken = std::any_of(tools.begin(), tools.end(), [&](const json& tool) {
+                return tool["function"]["name"] == name;
+            });
+            if (taken) {
+                LETTA_LOG_WARN("agent", "Skipping MCP tool with a taken name", {"agent", id},
+                               {"server", server->config().name}, {"tool", name});
+                continue;
+            }
+            tools.push_back(std::move(schema));
+        }
+    }
+    tool_schemas = ToolSchemas(tools);
+}
+
+void Agent::setMessageHandler(MessageHandler handler) {
+    message_handler = std::move(handler);
+}
+
+void Agent::refreshSystemPrompt() {
+    if (memory.version() != rendered_version) {
+        rebuildSystemPrompt();
+    }
+}
+
 void Agent::rebuildSystemPrompt() {
-    std::string system_prompt = memory.compile();
+    rendered_version = memory.version();
+    memory.compileInto(prompt_buffer);
+    const std::string& system_prompt = prompt_buffer;
     
-    // If messages is empty, add system prompt. 
+    // If messages is empty, add system prompt.
     // If not empty, update the first message (assuming it's system)
-    json system_msg = {
-        {"role", "system"},
-        {"content", system_prompt}
-    };
-
     if (messages.empty()) {
-        messages.push_back(system_msg);
+        messages.append(MessageRole::System, system_prompt);
+    } else if (messages[0].role() == MessageRole::System) {
+        messages.setContent(0, system_prompt);
     } else {
-        if (messages[0]["role"] == "system") {
-            messages[0] = system_msg;
-        } else {
-            // Should not happen if logic is correct, but safe insert
-            messages.insert(messages.begin(), system_msg);
-        }
+        // Should not happen if logic is correct, but safe insert
+        messages.insert(0, MessageRole::System, system_prompt);
     }
 }
 
@@ -39,74 +141,94 @@ std::string Agent::getMemoryDump() const {
 }
 
 json Agent::executeTool(const std::string& tool_name, const json& arguments) {
-    std::cout << "[Agent] Executing tool: " << tool_name << std::endl;
-    // std::cout << "[Agent] Args: " << arguments.dump() << std::endl;
+    ScopedSpan span("agent.execute_tool", Telemetry::metrics().tool_duration);
+    span.setAttribute("tool.name", tool_name);
+    if (Telemetry::enabled()) {
+        Telemetry::instance().counter("letta_agent_tool_executions_total", "Tool executions by tool name.",
+                                      "tool=\"" + tool_name + "\"").add();
+    }
+
+    LETTA_LOG_INFO("agent", "Executing tool", {"agent", id}, {"tool", tool_name});
+    LETTA_LOG_TRACE("agent", "Tool arguments", {"agent", id}, {"args", arguments.dump()});
 
     if (tool_name == "send_message") {
         std::string msg = arguments.value("message", "");
-        std::cout << "\n\033[1;32m[Agent (Sam)]: " << msg << "\033[0m\n" << std::endl;
+        message_handler(msg);
         return {
             {"status", "OK"},
             {"message", "Message sent to user."}
         };
     }
     
-    if (tool_name == "core_memory_append") {
-        std::string label = arguments.value("label", "");
-        std::string content = arguments.value("content", "");
-        
-        MemoryBlock* block = memory.getBlock(label);
-        if (!block) {
-            return {{"status", "ERROR"}, {"message", "Block not found: " + label}};
-        }
-        
-        std::string new_value = block->value + "\n" + content;
-        if (memory.updateBlock(label, new_value)) {
-             // System prompt needs update next turn
-             rebuildSystemPrompt();
-             return {{"status", "OK"}, {"message", "Memory block '" + label + "' updated."}};
-        } else {
-             return {{"status", "ERROR"}, {"message", "Failed to update block (maybe read-only?)"}};
-        }
+    if (Tools::is_memory_tool(tool_name)) {
+        return Tools::execute_memory_tool(memory, tool_name, arguments);
     }
 
-    if (tool_name == "core_memory_replace") {
-        std::string label = arguments.value("label", "");
-        std::string old_content = arguments.value("old_content", "");
-        std::string new_content = arguments.value("new_content", "");
+    if (sandbox && sandbox->hasTool(tool_name)) {
+        return sandbox->execute(tool_name, arguments);
+    }
 
-        MemoryBlock* block = memory.getBlock(label);
-        if (!block) {
-            return {{"status", "ERROR"}, {"message", "Block not found: " + label}};
-        }
-        
-        // Simple replace for now, ignoring exact match check of 'old_content' for MVP simplicity
-        // But in real Letta, we check if old_content exists.
-        
-        std::string current_val = block->value;
-        size_t pos = current_val.find(old_content);
-        if (pos != std::string::npos) {
-             current_val.replace(pos, old_content.length(), new_content);
-             if (memory.updateBlock(label, current_val)) {
-                 rebuildSystemPrompt();
-                 return {{"status", "OK"}, {"message", "Memory block '" + label + "' updated."}};
-             }
-        } else {
-             return {{"status", "ERROR"}, {"message", "Old content not found in block."}};
-        }
-        return {{"status", "ERROR"}, {"message", "Failed to update block."}};
+    for (const auto& server : mcp_servers) {
+        if (server->hasTool(tool_name)) return server->callTool(tool_name, arguments);
     }
 
     return {{"status", "ERROR"}, {"message", "Unknown tool: " + tool_name}};
 }
 
+json Agent::runToolCall(const std::string& tool_name, const json& raw_arguments) {
+    // Providers send the arguments as JSON text; some local servers as an object
+    std::string text = raw_arguments.is_string() ? raw_arguments.get<std::string>()
+                                                 : raw_arguments.is_null() ? "{}" : raw_arguments.dump();
+    std::string error;
+    const ToolSchema* schema = tool_schemas.find(tool_name);
+    if (schema && !schema->validate(text, &error)) {
+        LETTA_LOG_WARN("agent", "Rejected tool arguments", {"agent", id}, {"tool", tool_name}, {"error", error});
+        if (Telemetry::enabled()) {
+            Telemetry::instance().counter("letta_agent_tool_argument_errors_total",
+                                          "Tool calls rejected by their schema, by tool name.",
+                                          "tool=\"" + tool_name + "\"").add();
+        }
+        return {{"status", "ERROR"}, {"message", "Invalid arguments for " + tool_name + ": " + error}};
+    }
+    json arguments = json::parse(text, nullptr, false);
+    if (arguments.is_discarded()) {
+        return {{"status", "ERROR"}, {"message", "Arguments are not valid JSON."}};
+    }
+    return executeTool(tool_name, arguments);
+}
+
+bool Agent::step(const std::string& user_message, const CancellationToken& cancel) {
+    if (!sleeper) {
+        return runTurn(user_message, cancel);
+    }
+
+    // Hand the turn to the sleep-time agent on every exit path, exceptions
+    // included, so it is never left waiting on a primary that looks busy
+    struct TurnHandoff {
+        Agent& agent;
+        ~TurnHandoff() {
+            agent.sleeper->submit(agent.messages, agent.handed_off);
+            agent.handed_off = agent.messages.size();
+            agent.sleeper->primaryIdle();
+        }
+    };
+    sleeper->primaryBusy();
+    TurnHandoff handoff{*this};
+    return runTurn(user_message, cancel);
+}
+
+bool Agent::runTurn(const std::string& user_message, const CancellationToken& cancel) {
+    ScopedSpan span("agent.step", Telemetry::metrics().step_duration);
+    span.setAttribute("agent.id", id);
+    StepToolCalls tool_call_count;
+    if (Telemetry::enabled()) Telemetry::metrics().steps->add();
+
+    // Shared blocks may have been updated through other agents since last turn
+    refreshSystemPrompt();
+    if (!mcp_servers.empty() && mcpToolsVersion() != mcp_tools_version) rebuildTools();
 
-void Agent::step(const std::string& user_message) {
     // 1. Add user message
-    messages.push_back({
-        {"role", "user"},
-        {"content", user_message}
-    });
+    messages.append(MessageRole::User, user_message);
 
     // Loop for tool calls
     int steps = 0;
@@ -114,12 +236,19 @@ void Agent::step(const std::string& user_message) {
     
     while (steps < MAX_STEPS) {
         steps++;
-        
-        // 2. Call LLM
-        json response = llm.chatCompletion(messages, tools);
-        
+
+        // Between rounds is the only place a cancel can stop the turn without
+        // leaving a tool call unanswered in the history
+        if (cancel.cancelled()) break;
+
+        // 2. Call LLM (with memory edits from the previous iteration rendered)
+        refreshSystemPrompt();
+        json response = llm.chatCompletion(messages, tools, cancel);
+        if (cancel.cancelled()) break;
+
         if (response.contains("error")) {
-            std::cerr << "LLM Error: " << response["error"] << std::endl;
+            LETTA_LOG_ERROR("agent", "LLM error", {"agent", id}, {"error", response["error"].dump()});
+            span.setError("LLM error");
             break;
         }
 
@@ -127,7 +256,7 @@ void Agent::step(const std::string& user_message) {
         json message = choice["message"];
         
         // Append assistant message to history
-        messages.push_back(message);
+        messages.appendJson(message);
 
         // Check for tool calls
         if (message.contains("tool_calls") && !message["tool_calls"].empty()) {
@@ -136,36 +265,41 @@ void Agent::step(const std::string& user_message) {
             for (const auto& tool_call : tool_calls) {
                 std::string id = tool_call["id"];
                 std::string name = tool_call["function"]["name"];
-                std::string args_str = tool_call["function"]["arguments"];
-                json args = json::parse(args_str);
 
                 // Execute
-                json tool_result = executeTool(name, args);
+                tool_call_count.count++;
+                json tool_result = runToolCall(name, tool_call["function"].value("arguments", json()));
                 
                 // Add tool result to messages
-                messages.push_back({
-                    {"role", "tool"},
-                    {"tool_call_id", id},
-                    {"name", name},
-                    {"content", tool_result.dump()}
-                });
+                messages.appendToolResult(id, name, tool_result.dump());
 
                 // If send_message was called, we generally stop the loop and wait for user input, 
                 // UNLESS we want to support multiple tool calls in a row.
                 // For this MVP, if send_message is called, we consider it a 'yield' point.
-                if (name == "send_message") {
-                    return; 
+                // A rejected one is not: the model gets the error and another round.
+                if (name == "send_message" && tool_result.value("status", "") == "OK") {
+                    return true;
                 }
             }
         } else {
             // No tool calls (shouldn't happen with Letta usually, as it forces tool calls, but handling it as generic chat)
             std::string content = message.value("content", "");
             if (!content.empty()) {
-                std::cout << "[Agent (Raw)]: " << content << std::endl;
+                message_handler(content);
             }
             break; 
         }
     }
+
+    if (cancel.cancelled()) {
+        auto latency = std::chrono::steady_clock::now() - cancel.cancelledAt();
+        LETTA_LOG_INFO("agent", "Step cancelled", {"agent", id}, {"rounds", steps},
+                       {"latency_us", static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count())});
+        span.setAttribute("agent.cancelled", static_cast<int64_t>(1));
+        if (Telemetry::enabled()) Telemetry::metrics().steps_cancelled->add();
+        return false;
+    }
+    return true;
 }
 
 void Agent::addMemoryBlock(const std::string& label, const std::string& value, int limit, bool read_only) {
@@ -177,11 +311,103 @@ void Agent::addMemoryBlock(const std::string& label, const std::string& value, i
     
     memory.addBlock(block);
     rebuildSystemPrompt();
-    std::cout << "[Agent] Added memory block '" << label << "'" << std::endl;
+    LETTA_LOG_INFO("agent", "Added memory block", {"agent", id}, {"label", label});
+}
+
+void Agent::attachSharedBlock(std::shared_ptr<SharedBlock> block) {
+    std::string label = block->label();
+    memory.attachShared(std::move(block));
+    rebuildSystemPrompt();
+    LETTA_LOG_INFO("agent", "Attached shared memory block", {"agent", id}, {"label", label});
+}
+
+void Agent::setPromptTemplate(std::shared_ptr<const PromptTemplate> tmpl) {
+    memory.setTemplate(std::move(tmpl));
+    rebuildSystemPrompt();
 }
 
 void Agent::removeMemoryBlock(const std::string& label) {
     memory.removeBlock(label);
     rebuildSystemPrompt();
-    std::cout << "[Agent] Removed memory block '" << label << "'" << std::endl;
+    LETTA_LOG_INFO("agent", "Removed memory block", {"agent", id}, {"label", label});
+}
+
+void Agent::enableSleepTime(SleepTimeOptions options) {
+    if (sleeper) disableSleepTime();
+    sleeper = std::make_unique<SleepTimeAgent>(id, api_key, kGeminiBaseUrl, model, std::move(options));
+    for (const auto& block : memory.getBlocks()) {
+        if (!block.read_only) sleeper->attachBlock(memory.share(block.label));
+    }
+    handed_off = messages.size();
+
+    // Without memory round trips the foreground only needs to answer
+    rebuildTools();
+    if (sleeper->options().remove_foreground_memory_tools) {
+        if (memory.getTemplate() == PromptTemplate::defaultTemplate()) {
+            memory.setTemplate(PromptTemplate::sleepTimeTemplate());
+        }
+    }
+    rebuildSystemPrompt();
+    LETTA_LOG_INFO("agent", "Enabled sleep-time consolidation", {"agent", id});
+}
+
+void Agent::disableSleepTime() {
+    sleeper.reset();
+    rebuildTools();
+    if (memory.getTemplate() == PromptTemplate::sleepTimeTemplate()) {
+        memory.setTemplate(nullptr);
+        rebuildSystemPrompt();
+    }
+}
+
+AgentState Agent::snapshot() {
+    AgentState state;
+    state.name = imported.name.empty() ? id : imported.name;
+    state.model = model;
+    state.system = imported.system;
+    state.agent_type = imported.agent_type;
+    state.blocks = memory.getBlocks();
+    state.messages = messages.fork();
+    state.tools = tools;
+    state.tool_records = imported.tool_records;
+    state.extra = imported.extra;
+    return state;
+}
+
+void Agent::restore(AgentState state) {
+    for (const auto& block : memory.getBlocks()) memory.removeBlock(block.label);
+    for (const auto& block : state.blocks) memory.addBlock(block);
+    messages = std::move(state.messages);
+    rebuildSystemPrompt();
+    handed_off = messages.size();
+    if (sleeper) {
+        // The sleeper's attachments are the blocks just removed; share the
+        // restored ones with it as enableSleepTime() does
+        std::vector<std::shared_ptr<SharedBlock>> writable;
+        for (const auto& block : memory.getBlocks()) {
+            if (!block.read_only) writable.push_back(memory.share(block.label));
+        }
+        sleeper->replaceBlocks(std::move(writable));
+    }
+
+    for (const auto& record : state.tool_records) {
+        if (!record.contains("name") || !record["name"].is_string()) continue;
+        const std::string& name = record["name"].get_ref<const std::string&>();
+        bool available = std::any_of(tools.begin(), tools.end(), [&](const json& tool) {
+            return tool["function"]["name"] == name;
+        });
+        if (!available) {
+            LETTA_LOG_WARN("agent", "Restored agent uses a tool letta-cpp does not provide", {"agent", id},
+                           {"tool", name});
+        }
+    }
+    if (!state.model.empty() && state.model != model) {
+        LETTA_LOG_INFO("agent", "Restored agent keeps this agent's model", {"agent", id},
+                       {"model", model}, {"restored_model", state.model});
+    }
+    state.blocks.clear();
+    state.tools.clear();
+    imported = std::move(state);
+    LETTA_LOG_INFO("agent", "Restored agent state", {"agent", id}, {"name", imported.name},
+                   {"messages", messages.size()}, {"blocks", static_cast<int64_t>(memory.getBlocks().size())});
 }
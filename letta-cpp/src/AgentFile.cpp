@@ -0,0 +1,510 @@
+#include "AgentFile.hpp"
+#include "Tools.hpp"
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <set>
+
+namespace {
+
+constexpr size_t kReadChunk = 1 << 20;
+
+// Input iterator over a stream, refilled a chunk at a time. nlohmann's own
+// stream adapter goes through the streambuf once per character; this keeps
+// the per-character cost to a compare and an increment.
+class ChunkIterator {
+public:
+    struct Source {
+        std::istream* in;
+        std::vector<char> buffer = std::vector<char>(kReadChunk);
+        size_t pos = 0;
+        size_t end = 0;
+        uint64_t consumed = 0;
+
+        bool fill() {
+            consumed += end;
+            in->read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            end = static_cast<size_t>(in->gcount());
+            pos = 0;
+            return end > 0;
+        }
+    };
+
+    using iterator_category = std::input_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char*;
+    using reference = const char&;
+
+    ChunkIterator() = default;
+    explicit ChunkIterator(Source& source) : source(source.fill() ? &source : nullptr) {}
+
+    reference operator*() const { return source->buffer[source->pos]; }
+    ChunkIterator& operator++() {
+        if (++source->pos == source->end && !source->fill()) source = nullptr;
+        return *this;
+    }
+    bool operator==(const ChunkIterator& other) const { return source == other.source; }
+    bool operator!=(const ChunkIterator& other) const { return source != other.source; }
+
+private:
+    Source* source = nullptr;
+};
+
+// Builds one JSON value from SAX events. Only the innermost open container
+// ever grows, so the pointers to its ancestors stay valid.
+class SubtreeBuilder {
+public:
+    bool done() const { return finished; }
+    json take() {
+        finished = false;
+        return std::move(root);
+    }
+
+    void value(json v) {
+        if (stack.empty()) {
+            root = std::move(v);
+            finished = true;
+        } else if (stack.back()->is_object()) {
+            (*stack.back())[key] = std::move(v);
+        } else {
+            stack.back()->push_back(std::move(v));
+        }
+    }
+
+    void open(json container) {
+        json* slot;
+        if (stack.empty()) {
+            root = std::move(container);
+            slot = &root;
+        } else if (stack.back()->is_object()) {
+            slot = &((*stack.back())[key] = std::move(container));
+        } else {
+            stack.back()->push_back(std::move(container));
+            slot = &stack.back()->back();
+        }
+        stack.push_back(slot);
+    }
+
+    void close() {
+        stack.pop_back();
+        if (stack.empty()) finished = true;
+    }
+
+    void setKey(std::string k) { key = std::move(k); }
+    bool building() const { return !stack.empty(); }
+
+private:
+    json root;
+    std::vector<json*> stack;
+    std::string key;
+    bool finished = false;
+};
+
+std::string joinedText(const json& content) {
+    if (content.is_string()) return content.get<std::string>();
+    std::string text;
+    if (!content.is_array()) return text;
+    for (const auto& part : content) {
+        if (!part.is_object() || !part.contains("text") || !part["text"].is_string()) continue;
+        if (!text.empty()) text += '\n';
+        text += part["text"].get_ref<const std::string&>();
+    }
+    return text;
+}
+
+std::string stringOr(const json& object, const char* key, const std::string& fallback) {
+    auto it = object.find(key);
+    return it != object.end() && it->is_string() ? it->get<std::string>() : fallback;
+}
+
+// Streams an .af document into an AgentState
+class AgentFileHandler : public nlohmann::json_sax<json> {
+public:
+    AgentFileHandler(AgentState& state, AgentFileStats& stats) : state(state), stats(stats) {}
+
+    bool null() override { return scalar(nullptr); }
+    bool boolean(bool v) override { return scalar(v); }
+    bool number_integer(number_integer_t v) override { return scalar(v); }
+    bool number_unsigned(number_unsigned_t v) override { return scalar(v); }
+    bool number_float(number_float_t v, const string_t&) override { return scalar(v); }
+    bool string(string_t& v) override { return scalar(std::move(v)); }
+    bool binary(binary_t& v) override { return scalar(json::binary(std::move(v))); }
+
+    bool key(string_t& k) override {
+        if (builder.building()) builder.setKey(std::move(k));
+        else field = std::move(k);
+        return true;
+    }
+
+    bool start_object(std::size_t) override { return open(json::object()); }
+    bool start_array(std::size_t) override { return open(json::array()); }
+
+    bool end_object() override {
+        if (builder.building()) return close();
+        if (where != Where::Root) return fail("unbalanced object");
+        where = Where::Done;
+        return true;
+    }
+
+    bool end_array() override {
+        if (builder.building()) return close();
+        if (where != Where::Messages) return fail("unbalanced array");
+        where = Where::Root;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override {
+        error = "invalid JSON at byte " + std::to_string(position) + ": " + e.what();
+        return false;
+    }
+
+    // Select and order the in-context messages once the whole file is in
+    void finish() {
+        if (!error.empty()) throw AgentFileError(error);
+        if (where != Where::Done) throw AgentFileError("agent file is truncated");
+        if (!indices) {
+            stats.messages_kept = state.messages.size();
+            return;
+        }
+        // Indices into the file's message list, in context order
+        std::vector<size_t> order;
+        if (filtered_while_streaming) {
+            // Kept messages are in file order; map each index to its rank
+            std::vector<size_t> sorted(indices->begin(), indices->end());
+            std::sort(sorted.begin(), sorted.end());
+            sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+            for (size_t index : *indices) {
+                order.push_back(std::lower_bound(sorted.begin(), sorted.end(), index) - sorted.begin());
+            }
+        } else {
+            order = *indices;
+        }
+        bool identity = order.size() == state.messages.size();
+        for (size_t i = 0; identity && i < order.size(); ++i) identity = order[i] == i;
+        if (!identity) {
+            MessageStore selected;
+            for (size_t i : order) {
+                if (i >= state.messages.size()) throw AgentFileError("in_context_message_indices out of range");
+                selected.append(state.messages[i]);
+            }
+            state.messages = std::move(selected);
+        }
+        stats.messages_kept = state.messages.size();
+    }
+
+private:
+    enum class Where { Start, Root, Messages, Done };
+
+    AgentState& state;
+    AgentFileStats& stats;
+    Where where = Where::Start;
+    std::string field;
+    SubtreeBuilder builder;
+    std::string error;
+
+    std::optional<std::vector<size_t>> indices;
+    std::vector<size_t> wanted;         // sorted file indices, when indices came first
+    size_t next_wanted = 0;             // first entry of `wanted` not yet passed
+    bool filtered_while_streaming = false;
+    size_t message_index = 0;
+
+    bool fail(std::string message) {
+        error = std::move(message);
+        return false;
+    }
+
+    bool scalar(json v) {
+        if (builder.building()) {
+            builder.value(std::move(v));
+            return true;
+        }
+        if (where == Where::Root) return topLevel(std::move(v));
+        if (where == Where::Messages) return fail("messages must be objects");
+        return fail("agent file must be a JSON object");
+    }
+
+    bool open(json container) {
+        if (builder.building() || where == Where::Messages) {
+            if (!builder.building() && !container.is_object()) return fail("messages must be objects");
+            builder.open(std::move(container));
+            return true;
+        }
+        if (where == Where::Start) {
+            if (!container.is_object()) return fail("agent file must be a JSON object");
+            where = Where::Root;
+            return true;
+        }
+        if (where != Where::Root) return fail("unexpected data after the agent");
+        if (field == "messages") {
+            if (!container.is_array()) return fail("messages must be an array");
+            where = Where::Messages;
+            return true;
+        }
+        builder.open(std::move(container));
+        return true;
+    }
+
+    bool close() {
+        builder.close();
+        if (!builder.done()) return true;
+        json value = builder.take();
+        if (where == Where::Messages) return message(value);
+        return topLevel(std::move(value));
+    }
+
+    bool message(const json& m) {
+        size_t index = message_index++;
+        stats.messages_read++;
+        if (filtered_while_streaming) {
+            while (next_wanted < wanted.size() && wanted[next_wanted] < index) next_wanted++;
+            if (next_wanted == wanted.size() || wanted[next_wanted] != index) return true;
+        }
+        if (!AgentFile::appendMessage(state.messages, m)) {
+            return fail("message " + std::to_string(index) + " has no valid role");
+        }
+        return true;
+    }
+
+    bool topLevel(json value) {
+        if (field == "name") state.name = value.is_string() ? value.get<std::string>() : "";
+        else if (field == "system") state.system = value.is_string() ? value.get<std::string>() : "";
+        else if (field == "agent_type") state.agent_type = value.is_string() ? value.get<std::string>() : "";
+        else if (field == "core_memory") return blocks(value);
+        else if (field == "in_context_message_indices") return contextIndices(value);
+        else if (field == "tools") return tools(std::move(value));
+        else if (field == "messages") return fail("messages must be an array");
+        else {
+            if (field == "llm_config" && value.is_object()) state.model = stringOr(value, "model", state.model);
+            state.extra[field] = std::move(value);
+        }
+        return true;
+    }
+
+    bool blocks(const json& value) {
+        if (!value.is_array()) return fail("core_memory must be an array");
+        for (const auto& b : value) {
+            if (!b.is_object() || !b.contains("label") || !b["label"].is_string()) return fail("core_memory block without a label");
+            MemoryBlock block;
+            block.label = b["label"].get<std::string>();
+            block.value = stringOr(b, "value", "");
+            block.limit = b.value("limit", 5000);
+            block.read_only = b.value("read_only", false);
+            state.blocks.push_back(std::move(block));
+        }
+        return true;
+    }
+
+    bool contextIndices(const json& value) {
+        if (!value.is_array()) return fail("in_context_message_indices must be an array");
+        std::vector<size_t> list;
+        list.reserve(value.size());
+        for (const auto& i : value) {
+            if (!i.is_number_unsigned()) return fail("in_context_message_indices must hold indices");
+            list.push_back(i.get<size_t>());
+        }
+        if (message_index == 0) {
+            // Still ahead of the messages: drop the others as they stream
+            // past. Kept as a sorted list rather than a bitmap as long as the
+            // largest index, which the file controls; an index past the last
+            // message is reported once the messages are in.
+            wanted = list;
+            std::sort(wanted.begin(), wanted.end());
+            wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+            filtered_while_streaming = true;
+        }
+        indices = std::move(list);
+        return true;
+    }
+
+    bool tools(json value) {
+        if (!value.is_array()) return fail("tools must be an array");
+        for (auto& record : value) {
+            if (!record.is_object()) continue;
+            if (record.contains("json_schema") && record["json_schema"].is_object()) {
+                state.tools.push_back({{"type", "function"}, {"function", record["json_schema"]}});
+            }
+            state.tool_records.push_back(std::move(record));
+        }
+        return true;
+    }
+};
+
+std::string timestamp() {
+    std::time_t now = std::time(nullptr);
+    std::tm utc{};
+    gmtime_r(&now, &utc);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return buffer;
+}
+
+// The .af record for a tool the agent offers but the file did not bring
+json toolRecord(const json& schema) {
+    const json& function = schema["function"];
+    std::string name = stringOr(function, "name", "");
+    std::string type = name == "send_message" ? "letta_core" : Tools::is_memory_tool(name) ? "letta_memory_core" : "custom";
+    return {{"name", name},
+            {"description", function.value("description", json())},
+            {"json_schema", function},
+            {"source_type", "json"},
+            {"source_code", nullptr},
+            {"tool_type", type},
+            {"tags", json::array()},
+            {"return_char_limit", 6000}};
+}
+
+void writeKey(std::ostream& out, bool& first, const std::string& key) {
+    out << (first ? "{" : ",") << json(key).dump() << ':';
+    first = false;
+}
+
+} // namespace
+
+bool AgentFile::appendMessage(MessageStore& messages, const json& message) {
+    if (!message.is_object()) return false;
+    MessageRole role;
+    if (!parseRole(stringOr(message, "role", ""), role)) return false;
+
+    // Current files keep text in content parts; older ones in "text"
+    std::string text;
+    auto content = message.find("content");
+    if (content != message.end() && !content->is_null()) text = joinedText(*content);
+    else text = stringOr(message, "text", "");
+
+    if (role == MessageRole::Tool) {
+        messages.appendToolResult(stringOr(message, "tool_call_id", ""), stringOr(message, "name", ""), text);
+    } else if (role == MessageRole::Assistant && message.contains("tool_calls") && message["tool_calls"].is_array()) {
+        messages.appendJson({{"role", "assistant"}, {"content", std::move(text)}, {"tool_calls", message["tool_calls"]}});
+    } else {
+        messages.append(role, text);
+    }
+    return true;
+}
+
+json AgentFile::messageJson(const MessageStore::Message& message, const std::string& model) {
+    MessageRole role = message.role();
+    json out = {{"role", roleName(role)},
+                {"content", json::array({{{"type", "text"}, {"text", message.content()}}})},
+                {"model", model},
+                {"name", nullptr},
+                {"tool_call_id", nullptr},
+                {"tool_calls", nullptr}};
+    if (role == MessageRole::Tool) {
+        out["name"] = message.toolName();
+        out["tool_call_id"] = message.toolCallId();
+    } else if (message.toolCallCount() > 0) {
+        json calls = json::array();
+        for (size_t i = 0; i < message.toolCallCount(); ++i) {
+            ToolCallView call = message.toolCall(i);
+            calls.push_back({{"id", call.id},
+                             {"type", "function"},
+                             {"function", {{"name", call.name}, {"arguments", call.arguments}}}});
+        }
+        out["tool_calls"] = std::move(calls);
+    }
+    return out;
+}
+
+AgentState AgentFile::read(std::istream& in, AgentFileStats* stats) {
+    AgentState state;
+    AgentFileStats local;
+    AgentFileStats& s = stats ? *stats : local;
+    s = AgentFileStats{};
+
+    AgentFileHandler handler(state, s);
+    ChunkIterator::Source source{&in};
+    ChunkIterator first(source);
+    json::sax_parse(first, ChunkIterator(), &handler);
+    s.bytes = source.consumed + source.end;
+    handler.finish();
+    return state;
+}
+
+AgentState AgentFile::read(const std::string& path, AgentFileStats* stats) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw AgentFileError("cannot open " + path);
+    return read(in, stats);
+}
+
+void AgentFile::write(std::ostream& out, const AgentState& state) {
+    std::string now = timestamp();
+
+    // Small fields are gathered into one object so keys come out sorted, as
+    // Letta writes them (which puts the indices ahead of the messages);
+    // the two fields that grow with the history are streamed in place.
+    json top = state.extra;
+    top["agent_type"] = state.agent_type;
+    top["name"] = state.name;
+    top["system"] = state.system;
+    if (!top.contains("created_at")) top["created_at"] = now;
+    top["updated_at"] = now;
+    if (!top.contains("llm_config") || !top["llm_config"].is_object()) top["llm_config"] = json::object();
+    if (!state.model.empty()) top["llm_config"]["model"] = state.model;
+
+    json blocks = json::array();
+    for (const auto& block : state.blocks) {
+        blocks.push_back({{"label", block.label},
+                          {"value", block.value.str()},
+                          {"limit", block.limit},
+                          {"read_only", block.read_only},
+                          {"description", nullptr},
+                          {"metadata_", json::object()}});
+    }
+    top["core_memory"] = std::move(blocks);
+
+    json tools = json::array();
+    std::set<std::string> recorded;
+    for (const auto& record : state.tool_records) {
+        recorded.insert(stringOr(record, "name", ""));
+        tools.push_back(record);
+    }
+    for (const auto& schema : state.tools) {
+        if (!schema.contains("function") || !schema["function"].is_object()) continue;
+        if (recorded.count(stringOr(schema["function"], "name", ""))) continue;
+        tools.push_back(toolRecord(schema));
+    }
+    top["tools"] = std::move(tools);
+    top["in_context_message_indices"] = nullptr;
+    top["messages"] = nullptr;
+
+    bool first = true;
+    for (const auto& [key, value] : top.items()) {
+        writeKey(out, first, key);
+        if (key == "in_context_message_indices") {
+            out << '[';
+            for (size_t i = 0; i < state.messages.size(); ++i) {
+                if (i) out << ',';
+                out << i;
+            }
+            out << ']';
+        } else if (key == "messages") {
+            out << '[';
+            for (size_t i = 0; i < state.messages.size(); ++i) {
+                if (i) out << ',';
+                json m = messageJson(state.messages[i], state.model);
+                m["created_at"] = now;
+                out << m.dump(-1, ' ', false, json::error_handler_t::replace);
+            }
+            out << ']';
+        } else {
+            out << value.dump(-1, ' ', false, json::error_handler_t::replace);
+        }
+    }
+    out << (first ? "{}" : "}");
+    if (!out) throw AgentFileError("write failed");
+}
+
+void AgentFile::write(const std::string& path, const AgentState& state) {
+    // The buffer outlives the stream, and libstdc++ only takes it before open
+    std::vector<char> buffer(kReadChunk);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw AgentFileError("cannot create " + path);
+    write(out, state);
+    out.flush();
+    if (!out) throw AgentFileError("write failed: " + path);
+}
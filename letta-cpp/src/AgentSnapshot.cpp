@@ -0,0 +1,400 @@
+#include "AgentSnapshot.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kMagic[8] = {'L', 'E', 'T', 'T', 'A', 'S', 'N', 'P'};
+constexpr uint32_t kByteOrder = 0x01020304;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t section_count;
+    uint32_t reserved;
+    uint64_t file_size;
+};
+
+struct SectionEntry {
+    uint32_t kind;
+    uint32_t flags; // none defined yet
+    uint64_t offset;
+    uint64_t length;
+};
+
+static_assert(sizeof(FileHeader) == 32 && sizeof(SectionEntry) == 24, "on-disk layout");
+
+enum SectionKind : uint32_t {
+    kFields = 1,
+    kBlocks,
+    kRoles,
+    kContents,
+    kCallBegin,
+    kToolCalls,
+    kPool,
+    kSectionKinds = kPool
+};
+
+constexpr size_t kBatch = 1 << 16;        // column entries per write
+constexpr size_t kPoolChunk = 8u << 20;   // bytes copied before dropping the pages
+
+uint64_t align8(uint64_t n) {
+    return (n + 7) & ~uint64_t{7};
+}
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Output file that knows its position, for padding
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path) : path(path), buffer(1 << 20) {
+        out.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out) throw AgentSnapshotError("cannot create " + path);
+    }
+
+    void bytes(const void* data, size_t n) {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+        position += n;
+    }
+
+    void padTo(uint64_t offset) {
+        static const char zeros[8] = {};
+        bytes(zeros, offset - position);
+    }
+
+    template <typename T>
+    void column(std::vector<T>& batch, T value) {
+        batch.push_back(value);
+        if (batch.size() == kBatch) flush(batch);
+    }
+
+    template <typename T>
+    void flush(std::vector<T>& batch) {
+        bytes(batch.data(), batch.size() * sizeof(T));
+        batch.clear();
+    }
+
+    void close() {
+        out.flush();
+        out.close();
+        if (!out) throw AgentSnapshotError("write failed: " + path);
+    }
+
+private:
+    std::string path;
+    std::vector<char> buffer;
+    std::ofstream out;
+    uint64_t position = 0;
+};
+
+// Read-only mapping of a whole snapshot
+struct MappedSnapshot {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    MappedSnapshot() = default;
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+    ~MappedSnapshot() {
+        if (data) ::munmap(const_cast<char*>(data), size);
+    }
+
+    void open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw AgentSnapshotError(path + ": " + std::strerror(errno));
+        struct stat st {};
+        ::fstat(fd, &st);
+        size = static_cast<size_t>(st.st_size);
+        if (size > 0) {
+            void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw AgentSnapshotError(path + ": " + std::strerror(error));
+            }
+            ::madvise(p, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(p);
+        }
+        ::close(fd);
+    }
+
+    // Copy [offset, offset + length) out, handing each chunk's pages back as
+    // it goes so the mapping and the copy are never both resident
+    std::string copyOut(uint64_t offset, uint64_t length) const {
+        std::string out(length, '\0');
+        const uintptr_t page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+        for (uint64_t done = 0; done < length;) {
+            uint64_t n = std::min<uint64_t>(kPoolChunk, length - done);
+            std::memcpy(&out[done], data + offset + done, n);
+            done += n;
+            uintptr_t from = (reinterpret_cast<uintptr_t>(data + offset) + page - 1) & ~(page - 1);
+            uintptr_t to = reinterpret_cast<uintptr_t>(data + offset + done) & ~(page - 1);
+            if (to > from) ::madvise(reinterpret_cast<void*>(from), to - from, MADV_DONTNEED);
+        }
+        return out;
+    }
+};
+
+// Bounds-checked reads from the blocks section
+class Cursor {
+public:
+    Cursor(const char* data, uint64_t size) : data(data), size(size) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::string string(uint64_t n) { return std::string(take(n), n); }
+
+    uint64_t remaining() const { return size - pos; }
+
+private:
+    const char* data;
+    uint64_t size;
+    uint64_t pos = 0;
+
+    const char* take(uint64_t n) {
+        if (n > size - pos) throw AgentSnapshotError("blocks section is truncated");
+        const char* p = data + pos;
+        pos += n;
+        return p;
+    }
+};
+
+std::string encodeBlocks(const std::vector<MemoryBlock>& blocks) {
+    std::string out;
+    put<uint32_t>(out, static_cast<uint32_t>(blocks.size()));
+    for (const auto& block : blocks) {
+        std::string value = block.value.str();
+        put<int32_t>(out, block.limit);
+        put<uint32_t>(out, block.read_only ? 1 : 0);
+        put<uint32_t>(out, static_cast<uint32_t>(block.label.size()));
+        put<uint64_t>(out, value.size());
+        out += block.label;
+        out += value;
+    }
+    return out;
+}
+
+std::vector<MemoryBlock> decodeBlocks(const char* data, uint64_t size) {
+    // limit, read_only, label and value sizes come before each block's text
+    constexpr uint64_t kBlockHeader = sizeof(int32_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+    Cursor in(data, size);
+    uint32_t count = in.get<uint32_t>();
+    if (count > in.remaining() / kBlockHeader) throw AgentSnapshotError("blocks section is truncated");
+    std::vector<MemoryBlock> blocks(count);
+    for (auto& block : blocks) {
+        block.limit = in.get<int32_t>();
+        block.read_only = in.get<uint32_t>() != 0;
+        uint32_t label_size = in.get<uint32_t>();
+        uint64_t value_size = in.get<uint64_t>();
+        block.label = in.string(label_size);
+        block.value = in.string(value_size);
+    }
+    return blocks;
+}
+
+} // namespace
+
+void AgentSnapshot::write(const std::string& path, const AgentState& state) {
+    const MessageStore& messages = state.messages;
+    std::string fields = json{{"name", state.name},
+                              {"model", state.model},
+                              {"system", state.system},
+                              {"agent_type", state.agent_type},
+                              {"tools", state.tools},
+                              {"tool_records", state.tool_records},
+                              {"extra", state.extra}}
+                             .dump(-1, ' ', false, json::error_handler_t::replace);
+    std::string blocks = encodeBlocks(state.blocks);
+
+    // First pass: sizes, so the table can go out ahead of the sections
+    uint64_t calls = 0;
+    uint64_t pool = 0;
+    for (size_t i = 0; i < messages.size(); ++i) {
+        auto m = messages[i];
+        pool += m.content().size();
+        for (size_t c = 0; c < m.toolCallCount(); ++c) {
+            ToolCallView call = m.toolCall(c);
+            pool += call.id.size() + call.name.size() + call.arguments.size();
+        }
+        calls += m.toolCallCount();
+    }
+    if (pool > std::numeric_limits<uint32_t>::max() || calls > std::numeric_limits<uint32_t>::max()) {
+        throw AgentSnapshotError("message history exceeds 4 GiB");
+    }
+
+    const uint64_t n = messages.size();
+    SectionEntry table[kSectionKinds] = {
+        {kFields, 0, 0, fields.size()},
+        {kBlocks, 0, 0, blocks.size()},
+        {kRoles, 0, 0, n},
+        {kContents, 0, 0, n * 2 * sizeof(uint32_t)},
+        {kCallBegin, 0, 0, (n + 1) * sizeof(uint32_t)},
+        {kToolCalls, 0, 0, calls * 6 * sizeof(uint32_t)},
+        {kPool, 0, 0, pool},
+    };
+    uint64_t offset = align8(sizeof(FileHeader) + sizeof(table));
+    for (auto& section : table) {
+        section.offset = offset;
+        offset = align8(offset + section.length);
+    }
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrder;
+    header.section_count = kSectionKinds;
+    header.file_size = offset;
+
+    SnapshotWriter out(path);
+    out.bytes(&header, sizeof(header));
+    out.bytes(table, sizeof(table));
+    out.padTo(table[0].offset);
+    out.bytes(fields.data(), fields.size());
+    out.padTo(table[1].offset);
+    out.bytes(blocks.data(), blocks.size());
+
+    // One pass per column; the pool offsets are recomputed in each
+    out.padTo(table[2].offset);
+    std::vector<uint8_t> roles;
+    for (size_t i = 0; i < n; ++i) out.column(roles, static_cast<uint8_t>(messages[i].role()));
+    out.flush(roles);
+
+    out.padTo(table[3].offset);
+    std::vector<uint32_t> batch;
+    uint32_t at = 0;
+    for (size_t i = 0; i < n; ++i) {
+        auto m = messages[i];
+        auto length = static_cast<uint32_t>(m.content().size());
+        out.column(batch, at);
+        out.column(batch, length);
+        at += length;
+        for (size_t c = 0; c < m.toolCallCount(); ++c) {
+            ToolCallView call = m.toolCall(c);
+            at += static_cast<uint32_t>(call.id.size() + call.name.size() + call.arguments.size());
+        }
+    }
+    out.flush(batch);
+
+    out.padTo(table[4].offset);
+    uint32_t call_index = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out.column(batch, call_index);
+        call_index += static_cast<uint32_t>(messages[i].toolCallCount());
+    }
+    out.column(batch, call_index);
+    out.flush(batch);
+
+    out.padTo(table[5].offset);
+    at = 0;
+    for (size_t i = 0; i < n; ++i) {
+        auto m = messages[i];
+        at += static_cast<uint32_t>(m.content().size());
+        for (size_t c = 0; c < m.toolCallCount(); ++c) {
+            ToolCallView call = m.toolCall(c);
+            for (std::string_view text : {call.id, call.name, call.arguments}) {
+                out.column(batch, at);
+                out.column(batch, static_cast<uint32_t>(text.size()));
+                at += static_cast<uint32_t>(text.size());
+            }
+        }
+    }
+    out.flush(batch);
+
+    out.padTo(table[6].offset);
+    for (size_t i = 0; i < n; ++i) {
+        auto m = messages[i];
+        std::string_view content = m.content();
+        out.bytes(content.data(), content.size());
+        for (size_t c = 0; c < m.toolCallCount(); ++c) {
+            ToolCallView call = m.toolCall(c);
+            out.bytes(call.id.data(), call.id.size());
+            out.bytes(call.name.data(), call.name.size());
+            out.bytes(call.arguments.data(), call.arguments.size());
+        }
+    }
+    out.padTo(header.file_size);
+    out.close();
+}
+
+AgentState AgentSnapshot::read(const std::string& path) {
+    MappedSnapshot file;
+    file.open(path);
+
+    FileHeader header;
+    if (file.size < sizeof(header)) throw AgentSnapshotError(path + ": not an agent snapshot");
+    std::memcpy(&header, file.data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) throw AgentSnapshotError(path + ": not an agent snapshot");
+    if (header.byte_order != kByteOrder) throw AgentSnapshotError(path + ": written on a machine of the other byte order");
+    if (header.version > kVersion) {
+        throw AgentSnapshotError(path + ": snapshot version " + std::to_string(header.version) + " is newer than this build");
+    }
+    if (header.file_size != file.size) throw AgentSnapshotError(path + ": truncated snapshot");
+    if (header.section_count > (file.size - sizeof(header)) / sizeof(SectionEntry)) {
+        throw AgentSnapshotError(path + ": section table is truncated");
+    }
+
+    // Locate the sections; every offset is checked here, once
+    const SectionEntry* found[kSectionKinds + 1] = {};
+    const auto* table = reinterpret_cast<const SectionEntry*>(file.data + sizeof(header));
+    for (uint32_t i = 0; i < header.section_count; ++i) {
+        const SectionEntry& section = table[i];
+        if (section.offset % 8 != 0 || section.offset > file.size || section.length > file.size - section.offset) {
+            throw AgentSnapshotError(path + ": section " + std::to_string(i) + " lies outside the file");
+        }
+        if (section.kind == 0 || section.kind > kSectionKinds) continue;
+        if (found[section.kind]) throw AgentSnapshotError(path + ": duplicate section " + std::to_string(section.kind));
+        found[section.kind] = &section;
+    }
+    for (uint32_t kind = 1; kind <= kSectionKinds; ++kind) {
+        if (!found[kind]) throw AgentSnapshotError(path + ": missing section " + std::to_string(kind));
+    }
+    auto at = [&](uint32_t kind) { return file.data + found[kind]->offset; };
+    auto length = [&](uint32_t kind) { return found[kind]->length; };
+
+    const uint64_t n = length(kRoles);
+    if (length(kContents) != n * 2 * sizeof(uint32_t) || length(kCallBegin) != (n + 1) * sizeof(uint32_t) ||
+        length(kToolCalls) % (6 * sizeof(uint32_t)) != 0) {
+        throw AgentSnapshotError(path + ": message columns disagree on the message count");
+    }
+
+    AgentState state;
+    try {
+        json fields = json::parse(at(kFields), at(kFields) + length(kFields));
+        state.name = fields.at("name").get<std::string>();
+        state.model = fields.at("model").get<std::string>();
+        state.system = fields.at("system").get<std::string>();
+        state.agent_type = fields.at("agent_type").get<std::string>();
+        state.tools = fields.at("tools").get<std::vector<json>>();
+        state.tool_records = fields.at("tool_records").get<std::vector<json>>();
+        state.extra = std::move(fields.at("extra"));
+    } catch (const json::exception& e) {
+        throw AgentSnapshotError(path + ": bad fields section: " + e.what());
+    }
+    state.blocks = decodeBlocks(at(kBlocks), length(kBlocks));
+
+    try {
+        state.messages = MessageStore::fromColumns(
+            reinterpret_cast<const uint8_t*>(at(kRoles)), n, reinterpret_cast<const uint32_t*>(at(kContents)),
+            reinterpret_cast<const uint32_t*>(at(kCallBegin)), reinterpret_cast<const uint32_t*>(at(kToolCalls)),
+            length(kToolCalls) / (6 * sizeof(uint32_t)), file.copyOut(found[kPool]->offset, length(kPool)));
+    } catch (const std::invalid_argument& e) {
+        throw AgentSnapshotError(path + ": " + e.what());
+    }
+    return state;
+}
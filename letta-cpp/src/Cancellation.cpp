@@ -0,0 +1,81 @@
+#include "Cancellation.hpp"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+struct CancellationToken::Registration::State {
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    std::condition_variable cv; // wakes sleepFor()
+    std::map<uint64_t, std::function<void()>> callbacks;
+    uint64_t next_id = 1;
+    std::chrono::steady_clock::time_point cancelled_at;
+};
+
+CancellationToken::Registration::Registration(Registration&& other) noexcept
+    : state(std::move(other.state)), id(other.id) {
+    other.id = 0;
+}
+
+CancellationToken::Registration& CancellationToken::Registration::operator=(Registration&& other) noexcept {
+    if (this != &other) {
+        reset();
+        state = std::move(other.state);
+        id = other.id;
+        other.id = 0;
+    }
+    return *this;
+}
+
+CancellationToken::Registration::~Registration() {
+    reset();
+}
+
+void CancellationToken::Registration::reset() {
+    if (state && id) {
+        // Taking the lock waits out a cancel() that is running our callback
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->callbacks.erase(id);
+    }
+    state.reset();
+    id = 0;
+}
+
+CancellationToken::CancellationToken() : state(std::make_shared<Registration::State>()) {}
+
+void CancellationToken::cancel() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->cancelled.load()) return;
+    state->cancelled_at = std::chrono::steady_clock::now();
+    state->cancelled.store(true, std::memory_order_release);
+    state->cv.notify_all();
+    for (auto& [id, callback] : state->callbacks) callback();
+    state->callbacks.clear();
+}
+
+const std::atomic<bool>& CancellationToken::flag() const {
+    return state->cancelled;
+}
+
+CancellationToken::Registration CancellationToken::onCancel(std::function<void()> callback) const {
+    Registration registration;
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->cancelled.load()) {
+        callback();
+        return registration;
+    }
+    registration.state = state;
+    registration.id = state->next_id++;
+    state->callbacks.emplace(registration.id, std::move(callback));
+    return registration;
+}
+
+bool CancellationToken::sleepFor(std::chrono::steady_clock::duration duration) const {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    return !state->cv.wait_for(lock, duration, [this] { return state->cancelled.load(); });
+}
+
+std::chrono::steady_clock::time_point CancellationToken::cancelledAt() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->cancelled_at;
+}
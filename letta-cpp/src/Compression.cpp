@@ -0,0 +1,325 @@
+#include "Compression.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+#ifdef LETTA_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// Output is grown this much at a time while a codec has more to say
+constexpr size_t kOutStep = 64 * 1024;
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+[[noreturn]] void zlibError(const char* what, int code) {
+    throw CompressionError(std::string(what) + " (zlib error " + std::to_string(code) + ")");
+}
+
+} // namespace
+
+const char* codingName(ContentCoding coding) {
+    switch (coding) {
+    case ContentCoding::Gzip: return "gzip";
+    case ContentCoding::Zstd: return "zstd";
+    case ContentCoding::Identity: break;
+    }
+    return "identity";
+}
+
+ContentCoding parseCoding(std::string_view name) {
+    name = trim(name);
+    if (equalsIgnoreCase(name, "gzip") || equalsIgnoreCase(name, "x-gzip")) return ContentCoding::Gzip;
+    if (equalsIgnoreCase(name, "zstd")) return ContentCoding::Zstd;
+    return ContentCoding::Identity;
+}
+
+bool codingSupported(ContentCoding coding) {
+#ifdef LETTA_HAVE_ZSTD
+    (void)coding;
+    return true;
+#else
+    return coding != ContentCoding::Zstd;
+#endif
+}
+
+const std::string& acceptEncodingHeader() {
+    static const std::string header = codingSupported(ContentCoding::Zstd) ? "zstd, gzip" : "gzip";
+    return header;
+}
+
+ContentCoding pickCoding(std::string_view accept_encoding, ContentCoding preferred) {
+    bool gzip = false, zstd = false, any = false;
+    while (!accept_encoding.empty()) {
+        size_t comma = accept_encoding.find(',');
+        std::string_view item = accept_encoding.substr(0, comma);
+        accept_encoding = comma == std::string_view::npos ? std::string_view() : accept_encoding.substr(comma + 1);
+
+        size_t semi = item.find(';');
+        std::string_view token = trim(item.substr(0, semi));
+        if (semi != std::string_view::npos) {
+            std::string_view param = trim(item.substr(semi + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=' &&
+                std::strtod(std::string(param.substr(2)).c_str(), nullptr) <= 0.0) {
+                continue; // q=0: explicitly refused
+            }
+        }
+        if (token == "*") any = true;
+        ContentCoding coding = parseCoding(token);
+        if (coding == ContentCoding::Gzip) gzip = true;
+        if (coding == ContentCoding::Zstd) zstd = true;
+    }
+    bool takes_preferred = any || (preferred == ContentCoding::Zstd ? zstd : gzip);
+    if (preferred != ContentCoding::Identity && codingSupported(preferred) && takes_preferred) return preferred;
+    if ((zstd || any) && codingSupported(ContentCoding::Zstd)) return ContentCoding::Zstd;
+    if (gzip || any) return ContentCoding::Gzip;
+    return ContentCoding::Identity;
+}
+
+// --- Encoder ----------------------------------------------------------------
+
+struct Encoder::State {
+    z_stream z{};
+    bool z_open = false;
+#ifdef LETTA_HAVE_ZSTD
+    ZSTD_CCtx* cctx = nullptr;
+#endif
+
+    ~State() {
+        if (z_open) deflateEnd(&z);
+#ifdef LETTA_HAVE_ZSTD
+        ZSTD_freeCCtx(cctx);
+#endif
+    }
+
+    void deflateInto(std::string_view data, std::string& out, int flush) {
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        z.avail_in = static_cast<uInt>(data.size());
+        do {
+            size_t used = out.size();
+            out.resize(used + kOutStep);
+            z.next_out = reinterpret_cast<Bytef*>(&out[used]);
+            z.avail_out = static_cast<uInt>(kOutStep);
+            int rc = deflate(&z, flush);
+            if (rc == Z_STREAM_ERROR) zlibError("gzip encoding failed", rc);
+            out.resize(used + kOutStep - z.avail_out);
+        } while (z.avail_out == 0 || z.avail_in > 0);
+    }
+
+#ifdef LETTA_HAVE_ZSTD
+    void zstdInto(std::string_view data, std::string& out, ZSTD_EndDirective mode) {
+        ZSTD_inBuffer in{data.data(), data.size(), 0};
+        size_t remaining;
+        do {
+            size_t used = out.size();
+            out.resize(used + kOutStep);
+            ZSTD_outBuffer buffer{&out[used], kOutStep, 0};
+            remaining = ZSTD_compressStream2(cctx, &buffer, &in, mode);
+            if (ZSTD_isError(remaining)) throw CompressionError(std::string("zstd encoding failed: ") + ZSTD_getErrorName(remaining));
+            out.resize(used + buffer.pos);
+        } while (mode == ZSTD_e_end ? remaining != 0 : in.pos < in.size);
+    }
+#endif
+};
+
+Encoder::Encoder(ContentCoding coding, int level) : kind(coding), state(std::make_unique<State>()) {
+    switch (coding) {
+    case ContentCoding::Gzip: {
+        // windowBits 15 + 16 writes a gzip header and trailer rather than zlib's
+        int rc = deflateInit2(&state->z, level > 0 ? std::min(level, 9) : Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                              15 + 16, 8, Z_DEFAULT_STRATEGY);
+        if (rc != Z_OK) zlibError("gzip encoder setup failed", rc);
+        state->z_open = true;
+        break;
+    }
+    case ContentCoding::Zstd:
+#ifdef LETTA_HAVE_ZSTD
+        state->cctx = ZSTD_createCCtx();
+        if (!state->cctx) throw CompressionError("zstd encoder setup failed");
+        ZSTD_CCtx_setParameter(state->cctx, ZSTD_c_compressionLevel,
+                               level > 0 ? std::min(level, ZSTD_maxCLevel()) : ZSTD_CLEVEL_DEFAULT);
+        break;
+#else
+        throw CompressionError("zstd is not available in this build");
+#endif
+    case ContentCoding::Identity:
+        break;
+    }
+}
+
+Encoder::~Encoder() = default;
+
+void Encoder::write(std::string_view data, std::string& out) {
+    bytes_in += data.size();
+    switch (kind) {
+    case ContentCoding::Gzip:
+        if (!data.empty()) state->deflateInto(data, out, Z_NO_FLUSH);
+        break;
+    case ContentCoding::Zstd:
+#ifdef LETTA_HAVE_ZSTD
+        if (!data.empty()) state->zstdInto(data, out, ZSTD_e_continue);
+#endif
+        break;
+    case ContentCoding::Identity:
+        out.append(data);
+        break;
+    }
+}
+
+void Encoder::finish(std::string& out) {
+    switch (kind) {
+    case ContentCoding::Gzip:
+        state->deflateInto({}, out, Z_FINISH);
+        break;
+    case ContentCoding::Zstd:
+#ifdef LETTA_HAVE_ZSTD
+        state->zstdInto({}, out, ZSTD_e_end);
+#endif
+        break;
+    case ContentCoding::Identity:
+        break;
+    }
+}
+
+std::string encode(ContentCoding coding, std::string_view data, int level) {
+    std::string out;
+    out.reserve(data.size() / 4 + 64);
+    Encoder encoder(coding, level);
+    encoder.write(data, out);
+    encoder.finish(out);
+    return out;
+}
+
+// --- Decoding ---------------------------------------------------------------
+
+std::string decode(ContentCoding coding, std::string_view data, size_t limit) {
+    std::string out;
+    if (coding == ContentCoding::Identity) {
+        if (data.size() > limit) throw CompressionError("decoded body exceeds the size limit");
+        return std::string(data);
+    }
+
+    if (coding == ContentCoding::Gzip) {
+        z_stream z{};
+        // windowBits 15 + 32 takes gzip or zlib framing, whichever it finds
+        int rc = inflateInit2(&z, 15 + 32);
+        if (rc != Z_OK) zlibError("gzip decoder setup failed", rc);
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        z.avail_in = static_cast<uInt>(data.size());
+        do {
+            size_t used = out.size();
+            out.resize(used + std::max(kOutStep, data.size() * 2));
+            z.next_out = reinterpret_cast<Bytef*>(&out[used]);
+            z.avail_out = static_cast<uInt>(out.size() - used);
+            rc = inflate(&z, Z_NO_FLUSH);
+            out.resize(out.size() - z.avail_out);
+            if (out.size() > limit) rc = Z_MEM_ERROR;
+        } while (rc == Z_OK);
+        inflateEnd(&z);
+        if (rc == Z_MEM_ERROR && out.size() > limit) throw CompressionError("decoded body exceeds the size limit");
+        if (rc != Z_STREAM_END) zlibError("corrupt or truncated gzip body", rc);
+        return out;
+    }
+
+#ifdef LETTA_HAVE_ZSTD
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    if (!dctx) throw CompressionError("zstd decoder setup failed");
+    ZSTD_inBuffer in{data.data(), data.size(), 0};
+    size_t remaining = 1;
+    while (in.pos < in.size || remaining != 0) {
+        size_t used = out.size();
+        out.resize(used + std::max(kOutStep, data.size() * 2));
+        ZSTD_outBuffer buffer{&out[used], out.size() - used, 0};
+        size_t before = in.pos;
+        remaining = ZSTD_decompressStream(dctx, &buffer, &in);
+        out.resize(used + buffer.pos);
+        if (ZSTD_isError(remaining)) {
+            ZSTD_freeDCtx(dctx);
+            throw CompressionError(std::string("corrupt zstd body: ") + ZSTD_getErrorName(remaining));
+        }
+        if (out.size() > limit) {
+            ZSTD_freeDCtx(dctx);
+            throw CompressionError("decoded body exceeds the size limit");
+        }
+        if (remaining != 0 && in.pos == in.size && in.pos == before && buffer.pos == 0) {
+            ZSTD_freeDCtx(dctx);
+            throw CompressionError("truncated zstd body");
+        }
+    }
+    ZSTD_freeDCtx(dctx);
+    return out;
+#else
+    throw CompressionError("zstd is not available in this build");
+#endif
+}
+
+// --- Level selection --------------------------------------------------------
+
+double cpuHeadroom() {
+    static std::atomic<double> cached{1.0};
+    static std::atomic<int64_t> refreshed_at{0};
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t last = refreshed_at.load(std::memory_order_relaxed);
+    if (last != 0 && now - last < 1000) return cached.load(std::memory_order_relaxed);
+    if (!refreshed_at.compare_exchange_strong(last, now)) return cached.load(std::memory_order_relaxed);
+
+    double load = 0.0;
+    if (getloadavg(&load, 1) == 1) {
+        double cpus = std::max(1u, std::thread::hardware_concurrency());
+        cached.store(std::clamp(1.0 - load / cpus, 0.0, 1.0), std::memory_order_relaxed);
+    }
+    return cached.load(std::memory_order_relaxed);
+}
+
+int adaptiveLevel(ContentCoding coding, size_t bytes, double headroom, double egress_bytes_per_sec) {
+    // Single-core MB/s and ratio on serialized agent histories (see
+    // bench/CompressionBench), for bodies under 1 MB and above it
+    struct Point { int level; double mb_per_sec; double ratio; };
+    static const Point gzip_small[] = {{1, 116, 5.56}, {3, 84, 6.34}, {6, 26, 7.34}, {9, 19, 7.43}};
+    static const Point gzip_large[] = {{1, 125, 5.98}, {3, 80, 6.98}, {6, 27, 8.30}, {9, 17, 8.47}};
+    static const Point zstd_small[] = {{1, 350, 6.33}, {3, 330, 6.55}, {6, 86, 6.82}, {9, 36, 7.03}, {12, 3, 7.35}};
+    static const Point zstd_large[] = {{1, 345, 6.95}, {3, 300, 7.18}, {6, 68, 7.41}, {9, 43, 7.80},
+                                       {12, 16, 8.55}, {15, 4, 9.5}};
+
+    const Point* begin;
+    const Point* end;
+    bool large = bytes >= (1u << 20);
+    if (coding == ContentCoding::Zstd) {
+        begin = large ? std::begin(zstd_large) : std::begin(zstd_small);
+        end = large ? std::end(zstd_large) : std::end(zstd_small);
+    } else {
+        begin = large ? std::begin(gzip_large) : std::begin(gzip_small);
+        end = large ? std::end(gzip_large) : std::end(gzip_small);
+    }
+
+    double cpu = std::max(headroom, 0.1);
+    double link = std::max(egress_bytes_per_sec, 1.0);
+    int best = 0;
+    double best_seconds = bytes / link;
+    for (const Point* p = begin; p != end; ++p) {
+        double seconds = bytes / (p->mb_per_sec * 1e6 * cpu) + bytes / p->ratio / link;
+        if (seconds < best_seconds) {
+            best_seconds = seconds;
+            best = p->level;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,372 @@
+#include "EmbeddingClient.hpp"
+#include "Log.hpp"
+#include "Telemetry.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t kMultiplier = 0x9E3779B97F4A7C15ull;
+
+uint64_t finalize(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// 64-bit hash of `model`, a separator and `text`, 8 bytes at a time
+uint64_t hashWith(uint64_t seed, std::string_view model, std::string_view text) {
+    uint64_t h = seed ^ (model.size() * kMultiplier) ^ text.size();
+    auto feed = [&h](std::string_view bytes) {
+        size_t i = 0;
+        for (; i + 8 <= bytes.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes.data() + i, 8);
+            uint64_t v = h ^ (word * kMultiplier);
+            h = ((v << 27) | (v >> 37)) * 0xC2B2AE3D27D4EB4Full;
+        }
+        uint64_t tail = 0;
+        if (i < bytes.size()) std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+        h = (h ^ (tail * kMultiplier) ^ (bytes.size() - i)) * 0xC2B2AE3D27D4EB4Full;
+    };
+    feed(model);
+    h ^= 0xFF;
+    feed(text);
+    return finalize(h);
+}
+
+struct DiskRecordHeader {
+    uint64_t hi;
+    uint64_t lo;
+    uint32_t dimension;
+    uint32_t reserved;
+};
+static_assert(sizeof(DiskRecordHeader) == 24, "disk format");
+
+bool isGemini(const std::string& base_url) {
+    return base_url.find("googleapis.com") != std::string::npos;
+}
+
+const std::atomic<bool> kNeverCancelled{false};
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// EmbeddingCache
+
+EmbeddingCache::Key EmbeddingCache::key(std::string_view model, std::string_view text) {
+    return {hashWith(0x243F6A8885A308D3ull, model, text), hashWith(0x13198A2E03707344ull, model, text)};
+}
+
+EmbeddingCache::EmbeddingCache(EmbeddingCacheOptions options) : opts(std::move(options)) {
+    size_t count = std::max<size_t>(1, opts.shards);
+    shard_capacity = opts.capacity ? std::max<size_t>(1, opts.capacity / count) : 0;
+    for (size_t i = 0; i < count; ++i) shards.push_back(std::make_unique<Shard>());
+    if (!opts.disk_path.empty()) openDisk();
+}
+
+EmbeddingCache::~EmbeddingCache() {
+    if (disk_fd >= 0) ::close(disk_fd);
+}
+
+bool EmbeddingCache::get(const Key& key, std::vector<float>& out) {
+    Shard& shard = shardFor(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            out = it->second->second;
+            return true;
+        }
+    }
+    if (disk_fd < 0 || !readDisk(key, out)) return false;
+    disk_hits++;
+    remember(shard, key, out);
+    return true;
+}
+
+void EmbeddingCache::put(const Key& key, const std::vector<float>& vector) {
+    remember(shardFor(key), key, vector);
+    if (disk_fd < 0) return;
+
+    std::lock_guard<std::mutex> lock(disk_mutex);
+    if (disk_index.count(key)) return;
+    DiskRecordHeader header{key.hi, key.lo, static_cast<uint32_t>(vector.size()), 0};
+    std::string record(sizeof(header) + vector.size() * sizeof(float), '\0');
+    std::memcpy(&record[0], &header, sizeof(header));
+    std::memcpy(&record[sizeof(header)], vector.data(), vector.size() * sizeof(float));
+    if (::write(disk_fd, record.data(), record.size()) != static_cast<ssize_t>(record.size())) {
+        LETTA_LOG_WARN("embedding", "Could not write to the disk cache", {"path", opts.disk_path},
+                       {"error", std::strerror(errno)});
+        return;
+    }
+    disk_index[key] = disk_end;
+    disk_end += record.size();
+}
+
+size_t EmbeddingCache::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->index.size();
+    }
+    return total;
+}
+
+size_t EmbeddingCache::diskSize() const {
+    std::lock_guard<std::mutex> lock(disk_mutex);
+    return disk_index.size();
+}
+
+void EmbeddingCache::remember(Shard& shard, const Key& key, std::vector<float> vector) {
+    if (shard_capacity == 0) return;
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    shard.lru.emplace_front(key, std::move(vector));
+    shard.index[key] = shard.lru.begin();
+    if (shard.index.size() > shard_capacity) {
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+    }
+}
+
+void EmbeddingCache::openDisk() {
+    disk_fd = ::open(opts.disk_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (disk_fd < 0) {
+        LETTA_LOG_WARN("embedding", "Disk cache unavailable", {"path", opts.disk_path}, {"error", std::strerror(errno)});
+        return;
+    }
+    off_t size = ::lseek(disk_fd, 0, SEEK_END);
+    uint64_t offset = 0;
+    DiskRecordHeader header{};
+    while (offset + sizeof(header) <= static_cast<uint64_t>(size) &&
+           ::pread(disk_fd, &header, sizeof(header), static_cast<off_t>(offset)) == sizeof(header)) {
+        uint64_t next = offset + sizeof(header) + uint64_t{header.dimension} * sizeof(float);
+        if (next > static_cast<uint64_t>(size)) break;
+        disk_index[{header.hi, header.lo}] = offset;
+        offset = next;
+    }
+    if (offset < static_cast<uint64_t>(size)) {
+        // A process died mid-append
+        LETTA_LOG_WARN("embedding", "Truncating torn disk cache record", {"path", opts.disk_path},
+                       {"bytes", static_cast<uint64_t>(size) - offset});
+        if (::ftruncate(disk_fd, static_cast<off_t>(offset)) != 0) {
+            LETTA_LOG_WARN("embedding", "Could not truncate disk cache", {"error", std::strerror(errno)});
+        }
+    }
+    disk_end = offset;
+    LETTA_LOG_DEBUG("embedding", "Opened disk cache", {"path", opts.disk_path}, {"vectors", disk_index.size()});
+}
+
+bool EmbeddingCache::readDisk(const Key& key, std::vector<float>& out) {
+    uint64_t offset;
+    {
+        std::lock_guard<std::mutex> lock(disk_mutex);
+        auto it = disk_index.find(key);
+        if (it == disk_index.end()) return false;
+        offset = it->second;
+    }
+    DiskRecordHeader header{};
+    if (::pread(disk_fd, &header, sizeof(header), static_cast<off_t>(offset)) != sizeof(header)) return false;
+    out.resize(header.dimension);
+    size_t bytes = out.size() * sizeof(float);
+    return ::pread(disk_fd, out.data(), bytes, static_cast<off_t>(offset + sizeof(header))) ==
+           static_cast<ssize_t>(bytes);
+}
+
+// ---------------------------------------------------------------------------
+// EmbeddingClient
+
+EmbeddingClient::EmbeddingClient(const std::string& api_key, const std::string& base_url, const std::string& model,
+                                 EmbeddingCacheOptions cache)
+    : api_key(api_key), base_url(base_url), model(model), transport(makeCurlTransport()),
+      vectors(std::make_unique<EmbeddingCache>(std::move(cache))), scheduler(&RequestScheduler::global()) {}
+
+void EmbeddingClient::setTransport(HttpTransport t) {
+    transport = std::move(t);
+}
+
+void EmbeddingClient::setBatchPolicy(const EmbeddingBatchPolicy& p) {
+    std::lock_guard<std::mutex> lock(mutex);
+    policy = p;
+    policy.max_batch = std::max<size_t>(1, policy.max_batch);
+}
+
+void EmbeddingClient::setScheduler(RequestScheduler& s) {
+    scheduler = &s;
+}
+
+void EmbeddingClient::setSchedulingContext(const std::string& id, RequestPriority p) {
+    agent_id = id;
+    priority = p;
+}
+
+EmbeddingBackend EmbeddingClient::backend() {
+    return [this](const std::vector<std::string_view>& texts) { return embed(texts); };
+}
+
+std::vector<float> EmbeddingClient::embed(std::string_view text) {
+    return embed(std::vector<std::string_view>{text}).front();
+}
+
+std::vector<std::vector<float>> EmbeddingClient::embed(const std::vector<std::string_view>& texts) {
+    std::vector<std::vector<float>> out(texts.size());
+    std::vector<std::pair<size_t, EmbeddingCache::Key>> missing;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        EmbeddingCache::Key key = EmbeddingCache::key(model, texts[i]);
+        if (vectors->get(key, out[i])) {
+            cache_hits++;
+        } else {
+            missing.emplace_back(i, key);
+        }
+    }
+    if (missing.empty()) return out;
+    cache_misses += missing.size();
+
+    std::vector<std::pair<size_t, std::shared_ptr<Slot>>> waits;
+    std::vector<std::shared_ptr<Batch>> led; // batches this call opened and sends
+    std::unique_lock<std::mutex> lock(mutex);
+    for (const auto& [i, key] : missing) {
+        auto it = in_flight.find(key);
+        if (it != in_flight.end()) {
+            waits.emplace_back(i, it->second);
+            continue;
+        }
+        if (!forming || forming->texts.size() >= policy.max_batch) {
+            forming = std::make_shared<Batch>();
+            forming->opened = std::chrono::steady_clock::now();
+            led.push_back(forming);
+        }
+        auto slot = std::make_shared<Slot>();
+        forming->texts.emplace_back(texts[i]);
+        forming->keys.push_back(key);
+        forming->slots.push_back(slot);
+        in_flight[key] = slot;
+        waits.emplace_back(i, slot);
+        if (forming->texts.size() >= policy.max_batch) changed.notify_all(); // wake its leader
+    }
+
+    for (const auto& batch : led) {
+        changed.wait_until(lock, batch->opened + policy.window,
+                           [&] { return batch->texts.size() >= policy.max_batch; });
+        if (forming == batch) forming = nullptr;
+        lock.unlock();
+        send(*batch);
+        lock.lock();
+    }
+    changed.wait(lock, [&] {
+        return std::all_of(waits.begin(), waits.end(), [](const auto& w) { return w.second->done; });
+    });
+    lock.unlock();
+
+    for (auto& [i, slot] : waits) {
+        if (!slot->error.empty()) throw std::runtime_error(slot->error);
+        out[i] = slot->vector;
+    }
+    return out;
+}
+
+void EmbeddingClient::send(Batch& batch) {
+    std::vector<std::vector<float>> results;
+    std::string error;
+    try {
+        results = request(batch.texts);
+    } catch (const std::exception& e) {
+        error = e.what();
+        LETTA_LOG_WARN("embedding", "Embedding request failed", {"model", model}, {"texts", batch.texts.size()},
+                       {"error", error});
+    }
+    // Cache first, so a caller that misses the in-flight entry below hits
+    if (error.empty()) {
+        for (size_t i = 0; i < results.size(); ++i) vectors->put(batch.keys[i], results[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < batch.slots.size(); ++i) {
+        Slot& slot = *batch.slots[i];
+        if (error.empty()) {
+            slot.vector = std::move(results[i]);
+        } else {
+            slot.error = error;
+        }
+        slot.done = true;
+        in_flight.erase(batch.keys[i]);
+    }
+    changed.notify_all();
+}
+
+std::vector<std::vector<float>> EmbeddingClient::request(const std::vector<std::string>& texts) {
+    ScopedSpan span("embedding.request");
+    span.setAttribute("embedding.model", model);
+    span.setAttribute("embedding.texts", static_cast<int64_t>(texts.size()));
+
+    bool gemini = isGemini(base_url);
+    HttpRequest req;
+    uint64_t estimated_tokens = 1;
+    for (const auto& text : texts) estimated_tokens += text.size() / 4 + 1;
+    if (gemini) {
+        json requests = json::array();
+        for (const auto& text : texts) {
+            requests.push_back({{"model", "models/" + model}, {"content", {{"parts", {{{"text", text}}}}}}});
+        }
+        req.url = base_url + "/models/" + model + ":batchEmbedContents?key=" + api_key;
+        req.headers = {{"Content-Type", "application/json"}};
+        req.body = json{{"requests", std::move(requests)}}.dump(-1, ' ', false, json::error_handler_t::replace);
+    } else {
+        req.url = base_url + "/embeddings";
+        req.headers = {{"Authorization", "Bearer " + api_key}, {"Content-Type", "application/json"}};
+        req.body = json{{"model", model}, {"input", texts}, {"encoding_format", "float"}}
+                       .dump(-1, ' ', false, json::error_handler_t::replace);
+    }
+
+    HttpResponse r;
+    for (int attempt = 0;; ++attempt) {
+        scheduler->acquire(model, agent_id, priority, estimated_tokens);
+        requests_sent++;
+        r = transport(req, kNeverCancelled);
+        if (r.status_code != 429 || attempt >= max_rate_limit_retries) break;
+        scheduler->backoff(model, retryAfter(r));
+    }
+    if (r.status_code != 200) {
+        std::string detail = r.status_code == 0 ? r.error : r.text.substr(0, 200);
+        span.setError("HTTP " + std::to_string(r.status_code));
+        throw std::runtime_error("embedding request failed (HTTP " + std::to_string(r.status_code) + "): " + detail);
+    }
+
+    json body = json::parse(r.text, nullptr, false);
+    std::vector<std::vector<float>> results;
+    if (gemini && body.is_object()) {
+        for (const auto& e : body.value("embeddings", json::array())) {
+            results.push_back(e.value("values", std::vector<float>{}));
+        }
+    } else if (body.is_object()) {
+        // OpenAI tags each vector with its input index
+        results.resize(texts.size());
+        for (const auto& d : body.value("data", json::array())) {
+            size_t index = d.value("index", results.size());
+            if (index < results.size()) results[index] = d.value("embedding", std::vector<float>{});
+        }
+        if (body.contains("usage") && body["usage"].value("total_tokens", json()).is_number_unsigned()) {
+            scheduler->reconcile(model, estimated_tokens, body["usage"]["total_tokens"].get<uint64_t>());
+        }
+    }
+    bool complete = results.size() == texts.size() &&
+                    std::none_of(results.begin(), results.end(), [](const auto& v) { return v.empty(); });
+    if (!complete) {
+        span.setError("malformed response");
+        throw std::runtime_error("embedding response did not hold one vector per input");
+    }
+    return results;
+}
@@ -0,0 +1,231 @@
+#include "HttpTransport.hpp"
+#include <curl/curl.h>
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// How often a caller waiting on a transfer checks its cancellation flag
+constexpr auto kCancelPoll = std::chrono::milliseconds(2);
+
+// Longest the driver sleeps in curl_multi_poll when nothing wakes it
+constexpr int kIdlePollMs = 1000;
+
+size_t onBody(char* data, size_t size, size_t count, void* user) {
+    static_cast<std::string*>(user)->append(data, size * count);
+    return size * count;
+}
+
+size_t onHeader(char* data, size_t size, size_t count, void* user) {
+    auto& headers = *static_cast<std::map<std::string, std::string>*>(user);
+    std::string line(data, size * count);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) line.pop_back();
+    if (line.rfind("HTTP/", 0) == 0) {
+        // A new status line (after a redirect or 100 Continue) starts over
+        headers.clear();
+    } else if (auto colon = line.find(':'); colon != std::string::npos) {
+        size_t start = line.find_first_not_of(" \t", colon + 1);
+        headers[line.substr(0, colon)] = start == std::string::npos ? "" : line.substr(start);
+    }
+    return size * count;
+}
+
+// One POST. The caller fills it in and waits on `cv`; the driver thread owns
+// the easy handle and the response until it sets `done`.
+struct Transfer {
+    CURL* easy = nullptr;
+    curl_slist* headers = nullptr;
+    std::string body;
+    char error[CURL_ERROR_SIZE] = {};
+    HttpResponse response;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    std::atomic<bool> abandoned{false};
+
+    explicit Transfer(const HttpRequest& request) : easy(curl_easy_init()), body(request.body) {
+        for (const auto& [key, value] : request.headers) {
+            headers = curl_slist_append(headers, (key + ": " + value).c_str());
+        }
+        curl_easy_setopt(easy, CURLOPT_URL, request.url.c_str());
+        curl_easy_setopt(easy, CURLOPT_POST, 1L);
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, body.data());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, onBody);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &response.text);
+        curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, onHeader);
+        curl_easy_setopt(easy, CURLOPT_HEADERDATA, &response.headers);
+        curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, error);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, this);
+    }
+
+    ~Transfer() {
+        curl_easy_cleanup(easy);
+        curl_slist_free_all(headers);
+    }
+
+    void finish(CURLcode result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (result == CURLE_OK) {
+            curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response.status_code);
+        } else {
+            response.status_code = 0;
+            response.error = error[0] ? error : curl_easy_strerror(result);
+        }
+        done = true;
+        cv.notify_all();
+    }
+};
+
+// A curl multi handle and the thread that drives it, shared by every copy of
+// one transport. Transfers on it reuse each other's connections, and an
+// abandoned one is removed from the multi handle, closing its connection, as
+// soon as the caller wakes the driver. The driver starts with the first
+// request and is joined when the last copy of the transport goes away.
+class CurlLoop {
+public:
+    CurlLoop() {
+        static std::once_flag global_init;
+        std::call_once(global_init, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+        multi = curl_multi_init();
+    }
+
+    ~CurlLoop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        curl_multi_wakeup(multi);
+        if (driver.joinable()) driver.join();
+        curl_multi_cleanup(multi);
+    }
+
+    CurlLoop(const CurlLoop&) = delete;
+    CurlLoop& operator=(const CurlLoop&) = delete;
+
+    void submit(std::shared_ptr<Transfer> transfer) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            incoming.push_back(std::move(transfer));
+            if (!driver.joinable()) driver = std::thread([this] { run(); });
+        }
+        curl_multi_wakeup(multi);
+    }
+
+    void abandon(Transfer& transfer) {
+        transfer.abandoned.store(true);
+        curl_multi_wakeup(multi);
+    }
+
+private:
+    CURLM* multi = nullptr;
+    std::thread driver;
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Transfer>> incoming;
+    bool stopping = false;
+
+    // Everything below is touched only by the driver thread
+    std::map<CURL*, std::shared_ptr<Transfer>> active;
+
+    void drop(CURL* easy) {
+        curl_multi_remove_handle(multi, easy);
+        active.erase(easy);
+    }
+
+    void run() {
+        while (true) {
+            std::vector<std::shared_ptr<Transfer>> added;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) break;
+                added.swap(incoming);
+            }
+            for (auto& transfer : added) {
+                curl_multi_add_handle(multi, transfer->easy);
+                active.emplace(transfer->easy, std::move(transfer));
+            }
+            for (auto it = active.begin(); it != active.end();) {
+                if (it->second->abandoned.load()) {
+                    curl_multi_remove_handle(multi, it->first);
+                    it = active.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            int running = 0;
+            curl_multi_perform(multi, &running);
+            int queued = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+                if (msg->msg != CURLMSG_DONE) continue;
+                CURL* easy = msg->easy_handle;
+                CURLcode result = msg->data.result;
+                if (auto it = active.find(easy); it != active.end()) {
+                    std::shared_ptr<Transfer> transfer = it->second;
+                    drop(easy);
+                    transfer->finish(result);
+                }
+            }
+            curl_multi_poll(multi, nullptr, 0, kIdlePollMs, nullptr);
+        }
+
+        // Shutting down: nobody can still be waiting, since every caller
+        // holds a copy of the transport, but release the handles cleanly
+        while (!active.empty()) drop(active.begin()->first);
+        std::lock_guard<std::mutex> lock(mutex);
+        incoming.clear();
+    }
+};
+
+} // namespace
+
+HttpTransport makeCurlTransport() {
+    auto loop = std::make_shared<CurlLoop>();
+    return [loop](const HttpRequest& request, const std::atomic<bool>& cancelled) {
+        if (cancelled.load()) return HttpResponse{0, "", "cancelled", {}};
+        auto transfer = std::make_shared<Transfer>(request);
+        loop->submit(transfer);
+
+        std::unique_lock<std::mutex> lock(transfer->mutex);
+        while (!transfer->cv.wait_for(lock, kCancelPoll, [&] { return transfer->done; })) {
+            if (cancelled.load(std::memory_order_relaxed)) {
+                lock.unlock();
+                loop->abandon(*transfer);
+                return HttpResponse{0, "", "cancelled", {}};
+            }
+        }
+        return std::move(transfer->response);
+    };
+}
+
+std::string headerValue(const HttpResponse& response, const std::string& name) {
+    for (const auto& [key, value] : response.headers) {
+        bool same = key.size() == name.size() &&
+                    std::equal(key.begin(), key.end(), name.begin(), [](unsigned char a, unsigned char b) {
+                        return std::tolower(a) == std::tolower(b);
+                    });
+        if (same) return value;
+    }
+    return "";
+}
+
+std::chrono::milliseconds retryAfter(const HttpResponse& response) {
+    std::string value = headerValue(response, "retry-after");
+    if (!value.empty()) {
+        try {
+            return std::chrono::milliseconds(static_cast<int64_t>(std::stod(value) * 1000));
+        } catch (...) {
+            // HTTP-date form; fall back to the default
+        }
+    }
+    return std::chrono::milliseconds(1000);
+}
@@ -0,0 +1,110 @@
+#include "InboundQueue.hpp"
+#include "Log.hpp"
+
+InboundQueue::InboundQueue(Agent& agent, InboundPolicy policy) : agent(agent), opts(std::move(policy)) {
+    if (opts.max_messages == 0) opts.max_messages = 1;
+    worker = std::thread([this] { run(); });
+}
+
+InboundQueue::~InboundQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    arrived.notify_all();
+    worker.join();
+}
+
+uint64_t InboundQueue::post(std::string message) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (pending.empty()) oldest_arrival = now;
+        latest_arrival = now;
+        pending.push_back(std::move(message));
+        id = next_id++;
+        counters.messages++;
+        if (running && opts.interrupt && !running->cancelled()) {
+            running->cancel();
+            counters.interrupted++;
+        }
+    }
+    arrived.notify_all();
+    return id;
+}
+
+void InboundQueue::waitFor(uint64_t id) {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return done_through >= id; });
+}
+
+void InboundQueue::drain() {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return done_through + 1 >= next_id; });
+}
+
+InboundStats InboundQueue::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+size_t InboundQueue::takeTurn(std::string& turn) {
+    size_t count = 0;
+    turn.clear();
+    while (!pending.empty() && count < opts.max_messages) {
+        const std::string& next = pending.front();
+        size_t added = (count ? opts.separator.size() : 0) + next.size();
+        if (count && turn.size() + added > opts.max_bytes) break;
+        if (count) turn += opts.separator;
+        turn += next;
+        pending.pop_front();
+        count++;
+    }
+    // What is left starts a fresh delay window
+    if (!pending.empty()) oldest_arrival = std::chrono::steady_clock::now();
+    return count;
+}
+
+void InboundQueue::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    std::string turn;
+    while (true) {
+        arrived.wait(lock, [&] { return stopping || !pending.empty(); });
+        if (pending.empty()) return;
+
+        // Debounce: wait for the burst to go quiet, or for the oldest message
+        // to have waited long enough. Once stopping, go at once.
+        while (!stopping) {
+            auto quiet = latest_arrival + opts.debounce;
+            auto deadline = oldest_arrival + opts.max_delay;
+            auto start_at = std::min(quiet, deadline);
+            if (std::chrono::steady_clock::now() >= start_at) break;
+            arrived.wait_until(lock, start_at);
+        }
+
+        size_t count = takeTurn(turn);
+        uint64_t last_id = done_through + count;
+        counters.turns++;
+        counters.coalesced += count - 1;
+        counters.largest_turn = std::max<uint64_t>(counters.largest_turn, count);
+        CancellationToken cancel;
+        running = cancel;
+        lock.unlock();
+
+        if (count > 1) {
+            LETTA_LOG_DEBUG("inbound", "Coalesced messages into one turn", {"agent", agent.getId()},
+                            {"messages", static_cast<int64_t>(count)});
+        }
+        try {
+            agent.step(turn, cancel);
+        } catch (const std::exception& e) {
+            LETTA_LOG_ERROR("inbound", "Step failed", {"agent", agent.getId()}, {"error", e.what()});
+        }
+
+        lock.lock();
+        running.reset();
+        done_through = last_id;
+        finished.notify_all();
+    }
+}
@@ -0,0 +1,570 @@
+#include "Ingestion.hpp"
+#include "Log.hpp"
+#include "Telemetry.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+size_t wordTokens(size_t bytes) {
+    return std::max<size_t>(1, (bytes + 3) / 4);
+}
+
+bool endsSentence(std::string_view word) {
+    while (!word.empty() && (word.back() == '"' || word.back() == '\'' || word.back() == ')')) word.remove_suffix(1);
+    return !word.empty() && (word.back() == '.' || word.back() == '!' || word.back() == '?');
+}
+
+// Back `pos` up to the start of a UTF-8 character, not below `floor`
+size_t characterStart(std::string_view text, size_t pos, size_t floor) {
+    while (pos > floor && pos < text.size() && (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80) --pos;
+    return pos;
+}
+
+// Read-only mapping of a whole file
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::string fingerprint; // size and mtime
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+        if (data) ::munmap(const_cast<char*>(data), size);
+    }
+
+    bool open(const std::string& path, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st {};
+        ::fstat(fd, &st);
+        size = static_cast<size_t>(st.st_size);
+        fingerprint = std::to_string(st.st_size) + "-" +
+                      std::to_string(static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+        if (size > 0) {
+            void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                error = path + ": " + std::strerror(errno);
+                ::close(fd);
+                return false;
+            }
+            ::madvise(p, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(p);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    std::string_view view() const { return {data, size}; }
+};
+
+const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string encodeEmbedding(const std::vector<float>& values) {
+    const auto* in = reinterpret_cast<const unsigned char*>(values.data());
+    size_t n = values.size() * sizeof(float);
+    std::string out;
+    out.reserve((n + 2) / 3 * 4);
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = static_cast<uint32_t>(in[i]) << 16;
+        if (i + 1 < n) v |= static_cast<uint32_t>(in[i + 1]) << 8;
+        if (i + 2 < n) v |= in[i + 2];
+        out += kBase64[(v >> 18) & 63];
+        out += kBase64[(v >> 12) & 63];
+        out += i + 1 < n ? kBase64[(v >> 6) & 63] : '=';
+        out += i + 2 < n ? kBase64[v & 63] : '=';
+    }
+    return out;
+}
+
+std::vector<float> decodeEmbedding(const std::string& text) {
+    static const auto table = [] {
+        std::array<int8_t, 256> t{};
+        t.fill(-1);
+        for (int i = 0; i < 64; ++i) t[static_cast<unsigned char>(kBase64[i])] = static_cast<int8_t>(i);
+        return t;
+    }();
+    std::string bytes;
+    bytes.reserve(text.size() / 4 * 3);
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : text) {
+        int8_t v = table[static_cast<unsigned char>(c)];
+        if (v < 0) continue; // padding
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            bytes += static_cast<char>((acc >> bits) & 0xFF);
+        }
+    }
+    std::vector<float> values(bytes.size() / sizeof(float));
+    std::memcpy(values.data(), bytes.data(), values.size() * sizeof(float));
+    return values;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// TextChunker
+
+TextChunker::TextChunker(ChunkerOptions options) : opts(options) {
+    opts.chunk_tokens = std::max<size_t>(1, opts.chunk_tokens);
+    opts.overlap_tokens = std::min(opts.overlap_tokens, opts.chunk_tokens / 2);
+    opts.segment_bytes = std::max<size_t>(4096, opts.segment_bytes);
+}
+
+std::vector<size_t> TextChunker::segments(std::string_view text) const {
+    std::vector<size_t> cuts = {0};
+    size_t target = opts.segment_bytes;
+    while (target < text.size()) {
+        std::string_view window = text.substr(target, opts.segment_bytes / 4);
+        size_t at;
+        size_t cut;
+        if ((at = window.find("\n\n")) != std::string_view::npos) {
+            cut = target + at + 2;
+        } else if ((at = window.find('\n')) != std::string_view::npos) {
+            cut = target + at + 1;
+        } else if ((at = window.find(' ')) != std::string_view::npos) {
+            cut = target + at + 1;
+        } else {
+            cut = characterStart(text, target, cuts.back() + 1);
+        }
+        if (cut >= text.size()) break;
+        cuts.push_back(cut);
+        target = cut + opts.segment_bytes;
+    }
+    cuts.push_back(text.size());
+    return cuts;
+}
+
+void TextChunker::chunkSegment(std::string_view text, size_t begin, size_t end, uint32_t document,
+                               std::vector<Chunk>& out) const {
+    struct Word {
+        size_t begin, end;
+        size_t tokens_before; // within the pending chunk
+        bool sentence, paragraph;
+    };
+    const size_t limit = opts.chunk_tokens;
+    std::vector<Word> words;
+    size_t tokens = 0;
+
+    auto before = [&](size_t i) { return i < words.size() ? words[i].tokens_before : tokens; };
+    auto emit = [&](size_t count) {
+        out.push_back({document, words[0].begin, static_cast<uint32_t>(words[count - 1].end - words[0].begin),
+                       static_cast<uint32_t>(before(count))});
+    };
+    // Emit a chunk from the front of `words`, cut at the last paragraph
+    // break or sentence end past the halfway mark if there is one, and keep
+    // the rest plus up to `overlap` tokens before the cut
+    auto cut = [&](size_t overlap) {
+        size_t n = words.size();
+        size_t half = tokens / 2;
+        size_t paragraph = 0, sentence = 0;
+        for (size_t i = n; i > 0 && before(i) > half; --i) {
+            if (words[i - 1].paragraph) {
+                paragraph = i;
+                break;
+            }
+            if (words[i - 1].sentence && !sentence) sentence = i;
+        }
+        size_t at = paragraph ? paragraph : sentence ? sentence : n;
+        emit(at);
+        size_t keep = at;
+        while (keep > 1 && before(at) - before(keep - 1) <= overlap) --keep;
+        size_t base = before(keep);
+        words.erase(words.begin(), words.begin() + static_cast<std::ptrdiff_t>(keep));
+        for (auto& w : words) w.tokens_before -= base;
+        tokens -= base;
+    };
+
+    size_t pos = begin;
+    while (pos < end && isSpace(text[pos])) ++pos;
+    while (pos < end) {
+        size_t word_begin = pos;
+        while (pos < end && !isSpace(text[pos])) ++pos;
+        size_t word_end = pos;
+        int newlines = 0;
+        while (pos < end && isSpace(text[pos])) newlines += text[pos++] == '\n';
+        size_t word_tokens = wordTokens(word_end - word_begin);
+
+        if (word_tokens > limit) {
+            // Flush what is pending, then cut the word itself into pieces
+            if (!words.empty()) emit(words.size());
+            words.clear();
+            tokens = 0;
+            size_t piece = limit * 4;
+            for (size_t at = word_begin; at < word_end;) {
+                size_t stop = at + piece >= word_end ? word_end : characterStart(text, at + piece, at + 1);
+                out.push_back({document, at, static_cast<uint32_t>(stop - at), static_cast<uint32_t>(wordTokens(stop - at))});
+                at = stop;
+            }
+            continue;
+        }
+
+        for (bool first = true; !words.empty() && tokens + word_tokens > limit; first = false) {
+            cut(first ? opts.overlap_tokens : 0);
+        }
+        words.push_back({word_begin, word_end, tokens, endsSentence(text.substr(word_begin, word_end - word_begin)),
+                         newlines >= 2});
+        tokens += word_tokens;
+    }
+    if (!words.empty()) emit(words.size());
+}
+
+std::vector<Chunk> TextChunker::chunk(std::string_view text, uint32_t document) const {
+    std::vector<Chunk> chunks;
+    std::vector<size_t> cuts = segments(text);
+    for (size_t i = 0; i + 1 < cuts.size(); ++i) chunkSegment(text, cuts[i], cuts[i + 1], document, chunks);
+    return chunks;
+}
+
+// ---------------------------------------------------------------------------
+// PassageStore
+
+PassageStore::~PassageStore() {
+    if (fd >= 0) ::close(fd);
+}
+
+std::string PassageStore::key(const std::string& document, const std::string& fingerprint, uint64_t offset) {
+    std::string k = document;
+    k += '\0';
+    k += fingerprint;
+    k += '\0';
+    k += std::to_string(offset);
+    return k;
+}
+
+bool PassageStore::open(const std::string& path, const json& settings, std::string& error) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    MappedFile existing;
+    if (!existing.open(path, error)) return false;
+    std::string_view text = existing.view();
+    if (text.empty()) {
+        std::string header = settings.dump() + "\n";
+        if (::write(fd, header.data(), header.size()) != static_cast<ssize_t>(header.size())) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    size_t line_end = text.find('\n');
+    json header = json::parse(text.substr(0, line_end), nullptr, false);
+    if (line_end == std::string_view::npos || header.is_discarded() || header != settings) {
+        error = path + " holds passages made with different settings: " +
+                (header.is_discarded() ? std::string("unreadable header") : header.dump());
+        return false;
+    }
+
+    size_t pos = line_end + 1;
+    while (pos < text.size()) {
+        size_t next = text.find('\n', pos);
+        if (next == std::string_view::npos) {
+            // A run died mid-write; drop the partial passage
+            LETTA_LOG_WARN("ingest", "Truncating torn passage", {"store", path}, {"bytes", text.size() - pos});
+            if (::ftruncate(fd, static_cast<off_t>(pos)) != 0) {
+                error = path + ": " + std::strerror(errno);
+                return false;
+            }
+            break;
+        }
+        json passage = json::parse(text.substr(pos, next - pos), nullptr, false);
+        if (!passage.is_discarded()) {
+            keys.insert(key(passage.value("document", ""), passage.value("fingerprint", ""),
+                            passage.value("offset", uint64_t{0})));
+            passage_count++;
+        }
+        pos = next + 1;
+    }
+    LETTA_LOG_INFO("ingest", "Resuming passage store", {"store", path}, {"passages", passage_count.load()});
+    return true;
+}
+
+bool PassageStore::contains(const std::string& document, const std::string& fingerprint, uint64_t offset) const {
+    // `keys` is only written in open(), so lookups need no lock
+    return keys.count(key(document, fingerprint, offset)) > 0;
+}
+
+bool PassageStore::append(const std::vector<Passage>& passages) {
+    std::string out;
+    for (const auto& p : passages) {
+        json line = {
+            {"document", p.document},
+            {"fingerprint", p.fingerprint},
+            {"offset", p.offset},
+            {"text", p.text},
+            {"embedding", encodeEmbedding(p.embedding)}
+        };
+        // Documents are not guaranteed to be valid UTF-8
+        out += line.dump(-1, ' ', false, json::error_handler_t::replace);
+        out += '\n';
+    }
+
+    // One write per batch keeps lines whole with respect to each other; a
+    // crash can only tear the last one, which open() cuts off
+    std::lock_guard<std::mutex> lock(write_mutex);
+    const char* p = out.data();
+    size_t n = out.size();
+    while (n > 0) {
+        ssize_t written = ::write(fd, p, n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            LETTA_LOG_ERROR("ingest", "Could not write passages", {"error", std::strerror(errno)});
+            return false;
+        }
+        p += written;
+        n -= static_cast<size_t>(written);
+    }
+    passage_count += passages.size();
+    return true;
+}
+
+void PassageStore::sync() {
+    if (fd >= 0) ::fdatasync(fd);
+}
+
+std::vector<PassageStore::Passage> PassageStore::readAll(const std::string& path) {
+    std::vector<Passage> passages;
+    MappedFile file;
+    std::string error;
+    if (!file.open(path, error)) return passages;
+    std::string_view text = file.view();
+    size_t pos = text.find('\n');
+    while (pos != std::string_view::npos && pos + 1 < text.size()) {
+        size_t start = pos + 1;
+        pos = text.find('\n', start);
+        if (pos == std::string_view::npos) break; // torn
+        json line = json::parse(text.substr(start, pos - start), nullptr, false);
+        if (line.is_discarded()) continue;
+        passages.push_back({line.value("document", ""), line.value("fingerprint", ""), line.value("offset", uint64_t{0}),
+                            line.value("text", ""), decodeEmbedding(line.value("embedding", ""))});
+    }
+    return passages;
+}
+
+// ---------------------------------------------------------------------------
+// IngestionPipeline
+
+IngestionPipeline::IngestionPipeline(EmbeddingBackend backend, IngestionOptions options)
+    : embed(std::move(backend)), opts(std::move(options)) {
+    opts.max_in_flight = std::max<size_t>(1, opts.max_in_flight);
+    opts.max_batch = std::max<size_t>(1, opts.max_batch);
+    opts.initial_batch = std::clamp<size_t>(opts.initial_batch, 1, opts.max_batch);
+}
+
+IngestionStats IngestionPipeline::run(const std::vector<std::string>& paths, const std::string& store_path) {
+    ScopedSpan span("ingest.run");
+    auto start = Clock::now();
+    IngestionStats stats;
+    TextChunker chunker(opts.chunker);
+
+    json settings = {
+        {"format", "letta-passages"},
+        {"version", 1},
+        {"embedding_model", opts.embedding_model},
+        {"chunk_tokens", chunker.options().chunk_tokens},
+        {"overlap_tokens", chunker.options().overlap_tokens},
+        {"segment_bytes", chunker.options().segment_bytes}
+    };
+    PassageStore store;
+    std::vector<MappedFile> files(paths.size());
+    if (!store.open(store_path, settings, stats.error)) {
+        LETTA_LOG_ERROR("ingest", "Could not open passage store", {"error", stats.error});
+        span.setError(stats.error);
+        return stats;
+    }
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!files[i].open(paths[i], stats.error)) {
+            LETTA_LOG_ERROR("ingest", "Could not read document", {"error", stats.error});
+            span.setError(stats.error);
+            return stats;
+        }
+        stats.bytes += files[i].size;
+    }
+    stats.documents = paths.size();
+
+    struct Segment {
+        uint32_t document;
+        size_t begin, end;
+    };
+    std::vector<Segment> work;
+    for (size_t d = 0; d < files.size(); ++d) {
+        std::vector<size_t> cuts = chunker.segments(files[d].view());
+        for (size_t i = 0; i + 1 < cuts.size(); ++i) work.push_back({static_cast<uint32_t>(d), cuts[i], cuts[i + 1]});
+    }
+
+    // Chunkers -> bounded queue -> embedding workers -> store
+    std::mutex mutex;
+    std::condition_variable queued, drained;
+    std::deque<Chunk> queue;
+    const size_t capacity = opts.max_batch * (opts.max_in_flight + 1);
+    size_t threads = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max<size_t>(1, work.size()));
+    size_t producers = threads;
+    size_t batch_size = opts.initial_batch;
+
+    std::atomic<size_t> next_segment{0};
+    std::atomic<uint64_t> chunks{0}, skipped{0}, embedded{0}, failed{0}, requests{0};
+    std::mutex progress_mutex;
+
+    auto snapshot = [&] {
+        IngestionStats s = stats;
+        s.chunks = chunks;
+        s.skipped = skipped;
+        s.embedded = embedded;
+        s.failed = failed;
+        s.requests = requests;
+        s.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::lock_guard<std::mutex> lock(mutex);
+        s.batch_size = batch_size;
+        return s;
+    };
+
+    auto chunkWorker = [&] {
+        std::vector<Chunk> local;
+        for (size_t s; (s = next_segment++) < work.size();) {
+            const Segment& segment = work[s];
+            const MappedFile& file = files[segment.document];
+            local.clear();
+            chunker.chunkSegment(file.view(), segment.begin, segment.end, segment.document, local);
+            chunks += local.size();
+            auto stored = [&](const Chunk& c) {
+                return store.contains(paths[c.document], file.fingerprint, c.offset);
+            };
+            size_t before = local.size();
+            local.erase(std::remove_if(local.begin(), local.end(), stored), local.end());
+            skipped += before - local.size();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            drained.wait(lock, [&] { return queue.size() < capacity; });
+            queue.insert(queue.end(), local.begin(), local.end());
+            queued.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        producers--;
+        queued.notify_all();
+    };
+
+    // Embed a batch and store it; a failure is split in half and retried
+    std::function<void(std::vector<Chunk>)> embedBatch = [&](std::vector<Chunk> batch) {
+        std::vector<std::string_view> texts;
+        texts.reserve(batch.size());
+        for (const auto& c : batch) texts.push_back(files[c.document].view().substr(c.offset, c.length));
+
+        requests++;
+        auto sent = Clock::now();
+        std::vector<std::vector<float>> vectors;
+        std::string failure;
+        try {
+            vectors = embed(texts);
+            if (vectors.size() != texts.size()) {
+                failure = "backend returned " + std::to_string(vectors.size()) + " embeddings for " +
+                          std::to_string(texts.size()) + " texts";
+            }
+        } catch (const std::exception& e) {
+            failure = e.what();
+        }
+        auto latency = Clock::now() - sent;
+
+        {
+            // Additive-ish increase while well under target, halve past it
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure.empty() || latency > opts.target_latency) {
+                batch_size = std::max<size_t>(1, batch_size / 2);
+            } else if (latency < opts.target_latency / 2) {
+                batch_size = std::min(opts.max_batch, batch_size + std::max<size_t>(1, batch_size / 4));
+            }
+        }
+
+        if (!failure.empty()) {
+            if (batch.size() == 1) {
+                failed++;
+                LETTA_LOG_WARN("ingest", "Giving up on chunk", {"document", paths[batch[0].document]},
+                               {"offset", batch[0].offset}, {"error", failure});
+                return;
+            }
+            LETTA_LOG_DEBUG("ingest", "Splitting failed batch", {"chunks", batch.size()}, {"error", failure});
+            size_t mid = batch.size() / 2;
+            embedBatch(std::vector<Chunk>(batch.begin(), batch.begin() + static_cast<std::ptrdiff_t>(mid)));
+            embedBatch(std::vector<Chunk>(batch.begin() + static_cast<std::ptrdiff_t>(mid), batch.end()));
+            return;
+        }
+
+        std::vector<PassageStore::Passage> passages;
+        passages.reserve(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            passages.push_back({paths[batch[i].document], files[batch[i].document].fingerprint, batch[i].offset,
+                                std::string(texts[i]), std::move(vectors[i])});
+        }
+        if (!store.append(passages)) {
+            failed += batch.size();
+            return;
+        }
+        embedded += batch.size();
+        if (opts.on_progress) {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            opts.on_progress(snapshot());
+        }
+    };
+
+    auto embedWorker = [&] {
+        while (true) {
+            std::vector<Chunk> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queued.wait(lock, [&] { return queue.size() >= batch_size || producers == 0; });
+                if (queue.empty()) return; // producers are done too
+                uint64_t batch_tokens = 0;
+                while (!queue.empty() && batch.size() < batch_size &&
+                       (batch.empty() || batch_tokens + queue.front().tokens <= opts.max_batch_tokens)) {
+                    batch_tokens += queue.front().tokens;
+                    batch.push_back(queue.front());
+                    queue.pop_front();
+                }
+                drained.notify_all();
+            }
+            embedBatch(std::move(batch));
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < threads; ++i) pool.emplace_back(chunkWorker);
+    for (size_t i = 0; i < opts.max_in_flight; ++i) pool.emplace_back(embedWorker);
+    for (auto& t : pool) t.join();
+    store.sync();
+
+    stats = snapshot();
+    span.setAttribute("ingest.bytes", static_cast<int64_t>(stats.bytes));
+    span.setAttribute("ingest.passages", static_cast<int64_t>(stats.embedded));
+    if (stats.failed) span.setError("some chunks were not embedded");
+    LETTA_LOG_INFO("ingest", "Ingestion finished", {"documents", stats.documents}, {"bytes", stats.bytes},
+                   {"chunks", stats.chunks}, {"skipped", stats.skipped}, {"embedded", stats.embedded},
+                   {"failed", stats.failed}, {"requests", stats.requests}, {"seconds", stats.seconds});
+    return stats;
+}
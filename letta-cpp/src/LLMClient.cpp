@@ -1,85 +1,525 @@
 #include "LLMClient.hpp"
-#include <cpr/cpr.h>
-#include <iostream>
+#include "Log.hpp"
+#include "Telemetry.hpp"
+#include "ToolSchema.hpp"
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+
+bool isGemini(const LLMClient::Target& target) {
+    return target.base_url.find("googleapis.com") != std::string::npos;
+}
+
+// A response is usable if it parsed, and - when tools were offered - carries at
+// least one tool call whose arguments are a well-formed JSON object.
+bool isValidCompletion(const json& response, bool expect_tool_call) {
+    if (response.contains("error") || !response.contains("choices") || response["choices"].empty()) {
+        return false;
+    }
+    if (!expect_tool_call) return true;
+
+    const json& message = response["choices"][0].value("message", json::object());
+    if (!message.contains("tool_calls") || !message["tool_calls"].is_array() || message["tool_calls"].empty()) {
+        return false;
+    }
+    for (const auto& tc : message["tool_calls"]) {
+        if (!tc.contains("function") || !tc["function"].contains("name") || !tc["function"]["name"].is_string()) {
+            return false;
+        }
+        const json& args = tc["function"].value("arguments", json());
+        if (!args.is_string()) return false;
+        json parsed = json::parse(args.get<std::string>(), nullptr, false);
+        if (parsed.is_discarded() || !parsed.is_object()) return false;
+    }
+    return true;
+}
+
+// An id for a tool call the provider did not name. Random rather than
+// counted, so ids stay unique across turns and across imported histories.
+std::string makeToolCallId(const std::string& name) {
+    static const char kHex[] = "0123456789abcdef";
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    uint64_t bits = rng();
+    std::string id = "call_" + name + "_";
+    for (int i = 0; i < 12; ++i, bits >>= 4) id += kHex[bits & 0xf];
+    return id;
+}
+
+// Under guided decoding the backend may hand the constrained call back as
+// plain content rather than parse it into tool_calls; do that here.
+void liftGuidedToolCall(json& response) {
+    if (!response.contains("choices") || !response["choices"].is_array() || response["choices"].empty()) return;
+    json& message = response["choices"][0]["message"];
+    if (!message.is_object() || (message.contains("tool_calls") && !message["tool_calls"].empty())) return;
+    const json& content = message.value("content", json());
+    if (!content.is_string()) return;
+    json call = json::parse(content.get<std::string>(), nullptr, false);
+    if (!call.is_object() || call.size() != 2 || !call.contains("name") || !call["name"].is_string() ||
+        !call.contains("arguments") || !call["arguments"].is_object()) {
+        return;
+    }
+    message["content"] = nullptr;
+    message["tool_calls"] = json::array({{
+        {"id", makeToolCallId(call["name"].get<std::string>())},
+        {"type", "function"},
+        {"function", {{"name", call["name"]}, {"arguments", call["arguments"].dump()}}}
+    }});
+}
+
+// Shared between the caller and the (detached) request threads of one race, so
+// a loser that outlives chatCompletion still has somewhere to report to.
+struct HedgeRace {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<bool> cancelled[2];
+    json result[2];
+    bool done[2] = {false, false};
+    bool answered[2] = {false, false}; // came back 200, usable or not
+    int launched = 0;
+    int finished = 0;
+    int winner = -1;
+
+    // The primary's admission by the scheduler. The hedge delay runs from the
+    // latest one while it is on the wire; latency is measured from the first.
+    bool primary_admitted = false;
+    bool primary_on_wire = false;
+    std::chrono::steady_clock::time_point primary_admitted_at;
+    std::chrono::steady_clock::time_point primary_on_wire_since;
+
+    HedgeRace() {
+        cancelled[0].store(false);
+        cancelled[1].store(false);
+    }
+};
+
+// What chatCompletion returns once its token is cancelled
+const json kCancelled = {{"error", "cancelled"}};
+
+// Rough prompt size used for token-bucket admission (~4 bytes per token)
+uint64_t estimateTokens(const HttpRequest& request) {
+    return (request.identity_size ? request.identity_size : request.body.size()) / 4 + 1;
+}
+
+void observeRequestBytes(const HttpRequest& request) {
+    if (!Telemetry::enabled()) return;
+    Telemetry::metrics().request_bytes->observe(
+        static_cast<double>(request.identity_size ? request.identity_size : request.body.size()));
+    Telemetry::metrics().request_wire_bytes->observe(static_cast<double>(request.body.size()));
+}
+
+// --- Compressed transport ---
+
+// Serialized bodies are handed to the encoder this much at a time
+constexpr size_t kBodyChunk = 64 * 1024;
+
+ContentCoding currentCoding(const HttpRequest& request) {
+    auto it = request.headers.find("Content-Encoding");
+    return it == request.headers.end() ? ContentCoding::Identity : parseCoding(it->second);
+}
+
+int levelFor(const CompressionPolicy& policy, ContentCoding coding, size_t bytes) {
+    if (policy.level > 0) return policy.level;
+    return adaptiveLevel(coding, bytes, cpuHeadroom(), policy.egress_bytes_per_sec);
+}
+
+// Request body written in pieces. Once it passes the policy's threshold it is
+// compressed as it grows, a chunk at a time, so the serialized payload and
+// its compressed form never both exist in full.
+class BodyWriter {
+public:
+    // `size_hint` is what the body is expected to come to (it picks the level)
+    BodyWriter(const CompressionPolicy& policy, ContentCoding coding, size_t size_hint)
+        : policy(policy), coding(policy.enabled ? coding : ContentCoding::Identity), size_hint(size_hint) {}
+
+    // Append here, calling flush() between pieces
+    std::string& text() { return pending; }
+
+    void flush() {
+        if (pending.size() < kBodyChunk || coding == ContentCoding::Identity) return;
+        if (!encoder && pending.size() < policy.min_bytes) return;
+        spill();
+    }
+
+    void finish(HttpRequest& request) {
+        if (coding != ContentCoding::Identity && (encoder || pending.size() >= policy.min_bytes)) spill();
+        if (!encoder) {
+            request.body = std::move(pending);
+            return;
+        }
+        encoder->finish(wire);
+        request.body = std::move(wire);
+        request.identity_size = encoder->bytesIn();
+        request.headers["Content-Encoding"] = codingName(coding);
+    }
+
+private:
+    const CompressionPolicy& policy;
+    ContentCoding coding;
+    size_t size_hint;
+    std::string pending;
+    std::string wire;
+    std::unique_ptr<Encoder> encoder;
+
+    void spill() {
+        if (!encoder) {
+            size_t expected = std::max(size_hint, pending.size());
+            int level = levelFor(policy, coding, expected);
+            if (level == 0) {
+                // The link is fast enough that compressing would only add time
+                coding = ContentCoding::Identity;
+                return;
+            }
+            encoder = std::make_unique<Encoder>(coding, level);
+            wire.reserve(expected / 4);
+        }
+        encoder->write(pending, wire);
+        pending.clear();
+    }
+};
+
+// The same request with its body in `coding` instead
+HttpRequest reencode(const HttpRequest& request, ContentCoding coding, const CompressionPolicy& policy) {
+    HttpRequest out;
+    out.url = request.url;
+    out.headers = request.headers;
+    out.headers.erase("Content-Encoding");
+    std::string identity = decode(currentCoding(request), request.body);
+    if (coding == ContentCoding::Identity) {
+        out.body = std::move(identity);
+        return out;
+    }
+    // The server only takes this coding, so it is used even where it does not pay
+    out.body = encode(coding, identity, std::max(1, levelFor(policy, coding, identity.size())));
+    out.identity_size = identity.size();
+    out.headers["Content-Encoding"] = codingName(coding);
+    return out;
+}
+
+// Undo the response's Content-Encoding in place. Transports that decode on
+// their own (libcurl with CURLOPT_ACCEPT_ENCODING) leave the header behind, so
+// a body without the coding's magic number is taken as already decoded.
+void decodeResponse(HttpResponse& r) {
+    std::string encoding = headerValue(r, "content-encoding");
+    if (encoding.empty() || r.status_code == 0) return;
+    if (Telemetry::enabled()) Telemetry::metrics().response_wire_bytes->observe(static_cast<double>(r.text.size()));
+    ContentCoding coding = parseCoding(encoding);
+    static const std::string_view gzip_magic("\x1f\x8b", 2), zstd_magic("\x28\xb5\x2f\xfd", 4);
+    std::string_view body = r.text;
+    bool encoded = (coding == ContentCoding::Gzip && body.substr(0, 2) == gzip_magic) ||
+                   (coding == ContentCoding::Zstd && body.substr(0, 4) == zstd_magic);
+    if (coding == ContentCoding::Identity && encoding != "identity") {
+        r.error = "unsupported Content-Encoding: " + encoding;
+        r.status_code = 0;
+        return;
+    }
+    if (!encoded) return;
+    try {
+        r.text = decode(coding, body);
+    } catch (const CompressionError& e) {
+        LETTA_LOG_ERROR("llm", "Could not decode response", {"encoding", encoding}, {"error", e.what()});
+        r.error = std::string("undecodable response: ") + e.what();
+        r.text.clear();
+        r.status_code = 0;
+    }
+}
+
+// Feed provider token usage and errors into the metrics
+void recordOutcome(const json& response) {
+    if (!Telemetry::enabled()) return;
+    const AgentMetrics& metrics = Telemetry::metrics();
+    if (response.contains("error")) {
+        metrics.llm_errors->add();
+        return;
+    }
+    if (response.contains("usage")) {
+        const json& usage = response["usage"];
+        metrics.prompt_tokens->add(usage.value("prompt_tokens", 0.0));
+        metrics.completion_tokens->add(usage.value("completion_tokens", 0.0));
+    }
+}
+
+// Append `text` as a JSON string literal. Runs that need no escaping (nearly
+// all of it) are copied in one go.
+void appendJsonString(std::string& out, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out.reserve(out.size() + text.size() + 2);
+    out += '"';
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xf];
+        }
+    }
+    out.append(text.data() + run, text.size() - run);
+    out += '"';
+}
+
+// Append `text` verbatim if it is a JSON object, else as {"<wrap_key>": "<text>"}
+void appendJsonObject(std::string& out, std::string_view text, const char* wrap_key) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first != std::string_view::npos && text[first] == '{' && json::accept(text.begin(), text.end())) {
+        out.append(text.data(), text.size());
+        return;
+    }
+    out += "{\"";
+    out += wrap_key;
+    out += "\":";
+    appendJsonString(out, text);
+    out += '}';
+}
+
+// OpenAI chat message; same shape as MessageStore::Message::toJson()
+void appendOpenAIMessage(std::string& out, const MessageStore::Message& msg) {
+    out += "{\"role\":\"";
+    out += roleName(msg.role());
+    out += '"';
+
+    if (msg.role() == MessageRole::Tool) {
+        out += ",\"tool_call_id\":";
+        appendJsonString(out, msg.toolCallId());
+        out += ",\"name\":";
+        appendJsonString(out, msg.toolName());
+        out += ",\"content\":";
+        appendJsonString(out, msg.content());
+        out += '}';
+        return;
+    }
+
+    size_t calls = msg.toolCallCount();
+    out += ",\"content\":";
+    if (calls > 0 && msg.content().empty()) {
+        out += "null";
+    } else {
+        appendJsonString(out, msg.content());
+    }
+    if (calls > 0) {
+        out += ",\"tool_calls\":[";
+        for (size_t c = 0; c < calls; ++c) {
+            ToolCallView tc = msg.toolCall(c);
+            if (c > 0) out += ',';
+            out += "{\"id\":";
+            appendJsonString(out, tc.id);
+            out += ",\"type\":\"function\",\"function\":{\"name\":";
+            appendJsonString(out, tc.name);
+            out += ",\"arguments\":";
+            appendJsonString(out, tc.arguments);
+            out += "}}";
+        }
+        out += ']';
+    }
+    out += '}';
+}
+
+} // namespace
 
 LLMClient::LLMClient(const std::string& api_key, const std::string& base_url, const std::string& model)
-    : api_key(api_key), base_url(base_url), model(model) {}
+    : api_key(api_key), base_url(base_url), model(model),
+      transport(makeCurlTransport()),
+      request_coding(std::make_shared<std::atomic<ContentCoding>>(ContentCoding::Identity)),
+      grammar_cache(std::make_shared<GrammarCache>()),
+      latency(std::make_shared<LatencyHistogram>()),
+      scheduler(&RequestScheduler::global()) {}
+
+LLMClient::LLMClient(const LLMClient& other)
+    : api_key(other.api_key), base_url(other.base_url), model(other.model),
+      transport(other.transport), hedging(other.hedging), guided(other.guided), compression(other.compression),
+      request_coding(other.request_coding), grammar_cache(other.grammar_cache), latency(other.latency),
+      scheduler(other.scheduler), agent_id(other.agent_id), priority(other.priority),
+      max_rate_limit_retries(other.max_rate_limit_retries) {}
 
 void LLMClient::printDebug(const std::string& label, const std::string& content) {
-    std::cout << "[DEBUG] " << label << ": " << content << std::endl;
+    LETTA_LOG_DEBUG("llm", label, {"content", content});
+}
+
+void LLMClient::setTransport(HttpTransport transport) {
+    this->transport = std::move(transport);
+}
+
+void LLMClient::setCompressionPolicy(const CompressionPolicy& policy) {
+    compression = policy;
+    ContentCoding coding = policy.coding;
+    if (!codingSupported(coding)) coding = ContentCoding::Gzip;
+    request_coding->store(policy.enabled ? coding : ContentCoding::Identity);
+}
+
+void LLMClient::setGuidedDecoding(const GuidedDecoding& policy) {
+    guided = policy;
+}
+
+void LLMClient::setHedgingPolicy(const HedgingPolicy& policy) {
+    hedging = policy;
+}
+
+void LLMClient::setScheduler(RequestScheduler& scheduler) {
+    this->scheduler = &scheduler;
+}
+
+void LLMClient::setSchedulingContext(const std::string& agent_id, RequestPriority priority) {
+    this->agent_id = agent_id;
+    this->priority = priority;
+}
+
+LLMClient::Dispatch LLMClient::makeDispatch() const {
+    return Dispatch{transport, scheduler, agent_id, priority, max_rate_limit_retries, compression, request_coding};
+}
+
+HttpResponse LLMClient::Dispatch::send(const Target& target, const HttpRequest& request, uint64_t estimated_tokens,
+                                       const std::atomic<bool>& cancelled, std::chrono::microseconds& transport_time,
+                                       const std::function<void(bool)>& on_wire) const {
+    const HttpRequest* current = &request;
+    HttpRequest reencoded;
+    bool renegotiated = false;
+    for (int attempt = 0; ; ++attempt) {
+        if (!scheduler->acquire(target.model, agent_id, priority, estimated_tokens, &cancelled)) {
+            return HttpResponse{0, "", "cancelled while queued"};
+        }
+        if (on_wire) on_wire(true);
+
+        auto start = std::chrono::steady_clock::now();
+        HttpResponse r = transport(*current, cancelled);
+        transport_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+        if (compression.enabled && r.status_code != 0) {
+            ContentCoding sent = currentCoding(*current);
+            std::string accepted = headerValue(r, "accept-encoding");
+            if (r.status_code == 415 && sent != ContentCoding::Identity && !renegotiated && !cancelled.load()) {
+                // The server does not take this coding; send it the way it asks
+                ContentCoding next = pickCoding(accepted, compression.coding);
+                if (next == sent) next = ContentCoding::Identity;
+                request_coding->store(next);
+                LETTA_LOG_WARN("llm", "Server refused the request encoding", {"encoding", codingName(sent)},
+                               {"retry_with", codingName(next)});
+                reencoded = reencode(*current, next, compression);
+                current = &reencoded;
+                renegotiated = true;
+                continue;
+            }
+            if (!accepted.empty()) request_coding->store(pickCoding(accepted, compression.coding));
+        }
+        decodeResponse(r);
+
+        if (r.status_code != 429 || attempt >= max_rate_limit_retries || cancelled.load()) {
+            return r;
+        }
+        // Hold every client on this model, not just us, then try again
+        if (on_wire) on_wire(false);
+        scheduler->backoff(target.model, retryAfter(r));
+    }
 }
 
-json LLMClient::chatCompletion(const std::vector<json>& messages, const std::vector<json>& tools) {
-    if (base_url.find("googleapis.com") != std::string::npos) {
+void LLMClient::Dispatch::reconcile(const Target& target, uint64_t estimated_tokens, const json& response) const {
+    if (response.contains("usage") && response["usage"].value("total_tokens", json()).is_number_unsigned()) {
+        scheduler->reconcile(target.model, estimated_tokens, response["usage"]["total_tokens"].get<uint64_t>());
+    }
+}
+
+std::shared_ptr<const std::string> LLMClient::guidedGrammar(const std::vector<json>& tools) const {
+    std::lock_guard<std::mutex> lock(grammar_cache->mutex);
+    if (!grammar_cache->grammar || grammar_cache->format != guided.format || grammar_cache->tools != tools) {
+        ToolSchemas schemas(tools);
+        grammar_cache->grammar = std::make_shared<const std::string>(
+            guided.format == GuidedDecoding::Format::Gbnf ? schemas.gbnf() : schemas.regex());
+        grammar_cache->format = guided.format;
+        grammar_cache->tools = tools;
+    }
+    return grammar_cache->grammar;
+}
+
+std::chrono::milliseconds LLMClient::hedgeDelay() const {
+    if (latency->count() < hedging.min_samples) {
+        return hedging.initial_delay;
+    }
+    auto threshold = std::chrono::ceil<std::chrono::milliseconds>(latency->percentile(hedging.percentile));
+    return std::max(threshold, hedging.min_delay);
+}
+
+HttpRequest LLMClient::buildRequest(const Target& target, const MessageStore& messages, const std::vector<json>& tools) const {
+    ScopedSpan span("llm.serialize_request", Telemetry::metrics().serialize_duration);
+    HttpRequest request;
+    BodyWriter writer(compression, request_coding->load(), compression.enabled ? messages.memoryBytes() : 0);
+    std::string& out = writer.text();
+
+    if (isGemini(target)) {
         // --- Gemini Native API Adapter ---
 
         // 1. Convert Messages
-        json contents = json::array();
-        json system_instruction;
-        bool has_system = false;
-
-        for (const auto& msg : messages) {
-            std::string role = msg.value("role", "");
-            if (role == "system") {
-                system_instruction = {
-                    {"role", "user"}, // System instruction often passed as parts, or specific field. v1beta supports system_instruction field.
-                    {"parts", {{{"text", msg.value("content", "")}}}}
-                };
-                // Gemini v1beta supports "system_instruction" at top level, but role must be "system"??
-                // Actually, "system_instruction" field is separate. content role should be "model" or "user".
-                // Let's use the explicit 'system_instruction' field.
-                system_instruction = {
-                    {"parts", {{{"text", msg.value("content", "")}}}}
-                };
-                has_system = true;
-            } else if (role == "user") {
-                contents.push_back({
-                    {"role", "user"},
-                    {"parts", {{{"text", msg.value("content", "")}}}}
-                });
-            } else if (role == "assistant") {
-                json parts = json::array();
-                if (msg.contains("tool_calls")) {
-                    for (const auto& tc : msg["tool_calls"]) {
-                        json func_call = {
-                            {"name", tc["function"]["name"]},
-                            {"args", json::parse(tc["function"]["arguments"].get<std::string>())}
-                        };
-                        parts.push_back({{"functionCall", func_call}});
-                    }
-                } else {
-                    parts.push_back({{"text", msg.value("content", "")}});
+        // Written straight from the message columns: tool arguments and results
+        // are already JSON text and are spliced in rather than re-parsed.
+        out += "{\"contents\":[";
+        size_t system_index = messages.size();
+        bool first = true;
+
+        for (size_t i = 0; i < messages.size(); ++i) {
+            MessageStore::Message msg = messages[i];
+            if (msg.role() == MessageRole::System) {
+                // Gemini v1beta takes the system prompt in the separate top-level
+                // 'system_instruction' field rather than as a content role.
+                system_index = i;
+                continue;
+            }
+            if (!first) out += ',';
+            first = false;
+            switch (msg.role()) {
+            case MessageRole::System:
+                break;
+            case MessageRole::User:
+                out += "{\"role\":\"user\",\"parts\":[{\"text\":";
+                appendJsonString(out, msg.content());
+                out += "}]}";
+                break;
+            case MessageRole::Assistant: {
+                out += "{\"role\":\"model\",\"parts\":[";
+                size_t calls = msg.toolCallCount();
+                for (size_t c = 0; c < calls; ++c) {
+                    ToolCallView tc = msg.toolCall(c);
+                    if (c > 0) out += ',';
+                    out += "{\"functionCall\":{\"name\":";
+                    appendJsonString(out, tc.name);
+                    out += ",\"args\":";
+                    appendJsonObject(out, tc.arguments, "arguments");
+                    out += "}}";
                 }
-                contents.push_back({
-                    {"role", "model"},
-                    {"parts", parts}
-                });
-            } else if (role == "tool") {
-                // Map to 'function' role
-                // Gemini expects 'functionResponse' object
-                json function_response = {
-                    {"name", msg.value("name", "")},
-                    {"response", {
-                        {"content", msg.value("content", "")} // Wrap simple content or parse if json? verify.
-                        // Gemini response args should be object. If content is json string, parse it. 
-                        // If it's just text, wrap it. Let's try to parse if looks like json, else wrap.
-                    }}
-                };
-                
-                // Try parsing content as JSON for better structured response
-                try {
-                     json content_json = json::parse(msg.value("content", ""));
-                     function_response["response"] = content_json;
-                } catch(...) {
-                     function_response["response"] = {{"result", msg.value("content", "")}};
+                if (calls == 0) {
+                    out += "{\"text\":";
+                    appendJsonString(out, msg.content());
+                    out += '}';
                 }
-
-                contents.push_back({
-                    {"role", "function"},
-                    {"parts", {{{"functionResponse", function_response}}}}
-                });
+                out += "]}";
+                break;
+            }
+            case MessageRole::Tool:
+                // Map to 'function' role
+                // Gemini expects a 'functionResponse' whose response is an object:
+                // use the content itself if it is one, else wrap it.
+                out += "{\"role\":\"function\",\"parts\":[{\"functionResponse\":{\"name\":";
+                appendJsonString(out, msg.toolName());
+                out += ",\"response\":";
+                appendJsonObject(out, msg.content(), "result");
+                out += "}}]}";
+                break;
             }
+            writer.flush();
         }
+        out += ']';
 
         // 2. Convert Tools
         json gemini_tools = json::array();
@@ -94,33 +534,81 @@ json LLMClient::chatCompletion(const std::vector<json>& messages, const std::vec
         }
 
         // 3. Construct Payload
-        json payload = {
-            {"contents", contents}
-        };
-        if (has_system) {
-            payload["system_instruction"] = system_instruction;
+        if (system_index < messages.size()) {
+            out += ",\"system_instruction\":{\"parts\":[{\"text\":";
+            appendJsonString(out, messages[system_index].content());
+            out += "}]}";
         }
         if (!gemini_tools.empty()) {
-            payload["tools"] = gemini_tools;
+            out += ",\"tools\":" + gemini_tools.dump();
         }
+        out += '}';
 
-        // 4. Send Request (Native URL)
+        // 4. Native URL
         // URL: base_url + "/models/" + model + ":generateContent?key=" + api_key
         // Note: base_url is https://generativelanguage.googleapis.com/v1beta
-        std::string full_url = base_url + "/models/" + model + ":generateContent?key=" + api_key;
+        request.url = target.base_url + "/models/" + target.model + ":generateContent?key=" + api_key;
+        request.headers = {{"Content-Type", "application/json"}};
+        if (compression.enabled && compression.accept_compressed) {
+            request.headers["Accept-Encoding"] = acceptEncodingHeader();
+        }
+        writer.finish(request);
+
+        // printDebug("Gemini Payload", request.body);
+        return request;
+    }
+
+    // --- Original OpenAI Logic ---
+    json payload = {
+        {"model", target.model}
+    };
+
+    bool constrained = guided.format != GuidedDecoding::Format::None && !tools.empty();
+    if (!tools.empty() && (!constrained || guided.send_tools)) {
+        payload["tools"] = tools;
+        payload["tool_choice"] = "auto";
+    }
+    if (constrained) {
+        payload[guided.field] = *guidedGrammar(tools);
+    }
+
+    // The history is written directly and spliced in front of the other fields
+    out += "{\"messages\":[";
+    for (size_t i = 0; i < messages.size(); ++i) {
+        if (i > 0) out += ',';
+        appendOpenAIMessage(out, messages[i]);
+        writer.flush();
+    }
+    out += "],";
+    std::string rest = payload.dump();
+    out.append(rest, 1, std::string::npos);
 
-        // printDebug("Gemini Payload", payload.dump(2));
+    // printDebug("Request Payload", body);
+
+    request.url = target.base_url + "/chat/completions";
+    request.headers = {
+        {"Authorization", "Bearer " + api_key},
+        {"Content-Type", "application/json"}
+    };
+    if (compression.enabled && compression.accept_compressed) {
+        request.headers["Accept-Encoding"] = acceptEncodingHeader();
+    }
+    writer.finish(request);
+    return request;
+}
 
-        cpr::Response r = cpr::Post(
-            cpr::Url{full_url},
-            cpr::Header{{"Content-Type", "application/json"}},
-            cpr::Body{payload.dump()}
-        );
+json LLMClient::parseResponse(const Target& target, const HttpResponse& r) {
+    ScopedSpan span("llm.parse_response", Telemetry::metrics().parse_duration);
+    if (Telemetry::enabled()) {
+        Telemetry::metrics().response_bytes->observe(static_cast<double>(r.text.size()));
+        span.setAttribute("http.status_code", static_cast<int64_t>(r.status_code));
+    }
 
+    if (isGemini(target)) {
         if (r.status_code != 200) {
-            std::cerr << "Error: Gemini API request failed with status " << r.status_code << std::endl;
-            std::cerr << "Response: " << r.text << std::endl;
-            return {{"error", r.text}};
+            LETTA_LOG_ERROR("llm", "Gemini API request failed", {"status", r.status_code},
+                            {"response", r.text}, {"error", r.error});
+            return {{"error", r.status_code == 0 ? r.error : r.text}};
         }
 
         // 5. Adapt Response
@@ -160,50 +648,230 @@ json LLMClient::chatCompletion(const std::vector<json>& messages, const std::vec
                 }
             }
 
-            return {
+            json adapted = {
                 {"choices", {
                     {{"message", choice_msg}}
                 }}
             };
 
+            // Normalise token accounting to the OpenAI shape
+            if (gemini_resp.contains("usageMetadata")) {
+                const auto& usage = gemini_resp["usageMetadata"];
+                adapted["usage"] = {
+                    {"prompt_tokens", usage.value("promptTokenCount", 0)},
+                    {"completion_tokens", usage.value("candidatesTokenCount", 0)},
+                    {"total_tokens", usage.value("totalTokenCount", 0)}
+                };
+            }
+            return adapted;
+
         } catch (json::parse_error& e) {
             return {{"error", "JSON parse error"}};
         }
     }
 
-    // --- Original OpenAI Logic ---
-    json payload = {
-        {"model", model},
-        {"messages", messages}
-    };
-
-    if (!tools.empty()) {
-        payload["tools"] = tools;
-        payload["tool_choice"] = "auto";
-    }
-
-    // printDebug("Request Payload", payload.dump(2));
-
-    cpr::Response r = cpr::Post(
-        cpr::Url{base_url + "/chat/completions"},
-        cpr::Header{
-            {"Authorization", "Bearer " + api_key},
-            {"Content-Type", "application/json"}
-        },
-        cpr::Body{payload.dump()}
-    );
-
     if (r.status_code != 200) {
-        std::cerr << "Error: API request failed with status " << r.status_code << std::endl;
-        std::cerr << "Response: " << r.text << std::endl;
-        return {{"error", r.text}};
+        LETTA_LOG_ERROR("llm", "API request failed", {"status", r.status_code},
+                        {"response", r.text}, {"error", r.error});
+        return {{"error", r.status_code == 0 ? r.error : r.text}};
     }
 
     try {
         json response = json::parse(r.text);
         return response;
     } catch (json::parse_error& e) {
-        std::cerr << "Error: Failed to parse JSON response: " << e.what() << std::endl;
+        LETTA_LOG_ERROR("llm", "Failed to parse JSON response", {"error", e.what()});
         return {{"error", "JSON parse error"}};
     }
 }
+
+HttpRequest LLMClient::prepareRequest(const MessageStore& messages, const std::vector<json>& tools) const {
+    return buildRequest(Target{base_url, model}, messages, tools);
+}
+
+json LLMClient::normalizeResponse(const HttpResponse& response) const {
+    return parseResponse(Target{base_url, model}, response);
+}
+
+json LLMClient::chatCompletion(const std::vector<json>& messages, const std::vector<json>& tools,
+                              const CancellationToken& cancel) {
+    return chatCompletion(MessageStore::fromJson(messages), tools, cancel);
+}
+
+json LLMClient::chatCompletion(const MessageStore& messages, const std::vector<json>& tools,
+                              const CancellationToken& cancel) {
+    ScopedSpan span("llm.chat_completion", Telemetry::metrics().llm_duration, 3);
+    if (span.active()) {
+        span.setAttribute("llm.model", model);
+        span.setAttribute("llm.hedging", static_cast<int64_t>(hedging.enabled));
+        Telemetry::metrics().history_length->observe(static_cast<double>(messages.size()));
+    }
+
+    if (hedging.enabled) {
+        json result = hedgedCompletion(messages, tools, cancel);
+        if (cancel.cancelled()) {
+            span.setAttribute("llm.cancelled", static_cast<int64_t>(1));
+            return kCancelled;
+        }
+        recordOutcome(result);
+        return result;
+    }
+
+    Target target{base_url, model};
+    HttpRequest request = buildRequest(target, messages, tools);
+    if (span.active()) observeRequestBytes(request);
+
+    Dispatch dispatch = makeDispatch();
+    uint64_t estimated_tokens = estimateTokens(request);
+    std::chrono::microseconds transport_time{0};
+    HttpResponse r;
+    {
+        // A cancel while queued should give up the scheduler slot now
+        auto wake = cancel.onCancel([scheduler = dispatch.scheduler] { scheduler->interrupt(); });
+        r = dispatch.send(target, request, estimated_tokens, cancel.flag(), transport_time);
+    }
+    if (cancel.cancelled()) {
+        span.setAttribute("llm.cancelled", static_cast<int64_t>(1));
+        return kCancelled;
+    }
+    if (r.status_code == 200) {
+        latency->record(transport_time);
+    }
+    json parsed = parseResponse(target, r);
+    if (guided.format != GuidedDecoding::Format::None && !isGemini(target)) liftGuidedToolCall(parsed);
+    dispatch.reconcile(target, estimated_tokens, parsed);
+    recordOutcome(parsed);
+    return parsed;
+}
+
+json LLMClient::hedgedCompletion(const MessageStore& messages, const std::vector<json>& tools,
+                                 const CancellationToken& cancel) {
+    auto race = std::make_shared<HedgeRace>();
+    const bool expect_tool_call = hedging.reask_without_tool_call && !tools.empty();
+    const bool lift = guided.format != GuidedDecoding::Format::None;
+
+    // Called with race->mutex held; the request is built beforehand
+    auto launch = [&](int slot, const Target& target, HttpRequest request) {
+        race->launched++;
+        std::thread([race, slot, target, expect_tool_call, lift, request = std::move(request),
+                     dispatch = makeDispatch(), histogram = latency, parent = ScopedSpan::current()]() {
+            ScopedSpan attempt("llm.attempt", parent, nullptr, 3);
+            attempt.setAttribute("llm.model", target.model);
+            attempt.setAttribute("llm.hedge", static_cast<int64_t>(slot));
+            uint64_t estimated_tokens = estimateTokens(request);
+            std::chrono::microseconds elapsed{0};
+            std::function<void(bool)> on_wire;
+            if (slot == 0) {
+                on_wire = [&race](bool on) {
+                    std::lock_guard<std::mutex> lock(race->mutex);
+                    auto now = std::chrono::steady_clock::now();
+                    if (!race->primary_admitted) race->primary_admitted_at = now;
+                    race->primary_admitted = true;
+                    race->primary_on_wire = on;
+                    race->primary_on_wire_since = now;
+                    race->cv.notify_all();
+                };
+            }
+            HttpResponse raw = dispatch.send(target, request, estimated_tokens, race->cancelled[slot], elapsed, on_wire);
+
+            // A cancelled loser has nothing useful to say; skip parsing it.
+            bool cancelled = race->cancelled[slot].load();
+            json parsed = cancelled ? json{{"error", "cancelled"}} : parseResponse(target, raw);
+            if (lift && !isGemini(target)) liftGuidedToolCall(parsed);
+            if (!cancelled) dispatch.reconcile(target, estimated_tokens, parsed);
+            bool valid = !cancelled && isValidCompletion(parsed, expect_tool_call);
+
+            {
+                std::lock_guard<std::mutex> lock(race->mutex);
+                race->result[slot] = std::move(parsed);
+                race->done[slot] = true;
+                race->answered[slot] = !cancelled && raw.status_code == 200;
+                race->finished++;
+                if (valid && race->winner < 0) {
+                    race->winner = slot;
+                    // End to end from the primary's admission, whichever
+                    // attempt won, so slow primaries are not left out
+                    histogram->record(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - race->primary_admitted_at));
+                }
+            }
+            race->cv.notify_all();
+        }).detach();
+    };
+
+    Target primary{base_url, model};
+    Target secondary{
+        hedging.secondary_base_url.empty() ? base_url : hedging.secondary_base_url,
+        hedging.secondary_model.empty() ? model : hedging.secondary_model
+    };
+    const bool same_target = secondary.base_url == primary.base_url && secondary.model == primary.model;
+
+    HttpRequest primary_request = buildRequest(primary, messages, tools);
+    observeRequestBytes(primary_request);
+
+    // Cancelling the caller cancels both attempts and wakes us
+    auto abandon = cancel.onCancel([race, scheduler = scheduler] {
+        race->cancelled[0].store(true);
+        race->cancelled[1].store(true);
+        scheduler->interrupt();
+        std::lock_guard<std::mutex> lock(race->mutex);
+        race->cv.notify_all();
+    });
+
+    std::unique_lock<std::mutex> lock(race->mutex);
+    if (same_target) {
+        launch(0, primary, primary_request); // kept for the hedge
+    } else {
+        launch(0, primary, std::move(primary_request));
+    }
+
+    // Hedge only when the primary is slow: once it has been on the wire for
+    // the hedge delay, not counting time queued in the scheduler or backing
+    // off after a 429. With reask_without_tool_call, a 200 with no usable
+    // tool call is also asked again at once.
+    const auto delay = hedgeDelay();
+    auto decided = [&] { return race->winner >= 0 || race->done[0] || cancel.cancelled(); };
+    while (!decided()) {
+        if (!race->primary_on_wire) {
+            race->cv.wait(lock);
+            continue;
+        }
+        auto deadline = race->primary_on_wire_since + delay;
+        if (std::chrono::steady_clock::now() >= deadline) break;
+        race->cv.wait_until(lock, deadline);
+    }
+
+    auto wanted = [&] {
+        return !cancel.cancelled() && race->winner < 0 && (!race->done[0] || (expect_tool_call && race->answered[0]));
+    };
+    bool hedge = wanted();
+    if (hedge && !same_target) {
+        // Serialize for the secondary without holding up the primary's thread
+        lock.unlock();
+        HttpRequest secondary_request = buildRequest(secondary, messages, tools);
+        observeRequestBytes(secondary_request);
+        lock.lock();
+        hedge = wanted();
+        if (hedge) {
+            hedges_fired++;
+            launch(1, secondary, std::move(secondary_request));
+        }
+    } else if (hedge) {
+        hedges_fired++;
+        launch(1, secondary, std::move(primary_request));
+    }
+
+    auto settled = [&] { return race->winner >= 0 || race->finished == race->launched || cancel.cancelled(); };
+    race->cv.wait(lock, settled);
+    if (cancel.cancelled()) return kCancelled;
+
+    if (race->winner < 0) {
+        // Neither attempt produced a usable answer; surface the primary's.
+        return race->result[0];
+    }
+
+    int loser = 1 - race->winner;
+    race->cancelled[loser].store(true);
+    if (race->winner == 1) hedges_won++;
+    return race->result[race->winner];
+}
@@ -0,0 +1,79 @@
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram(uint64_t window) : window(std::max<uint64_t>(window, 2)) {
+    for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketFor(uint64_t micros) {
+    if (micros < SUB_BUCKETS) return static_cast<int>(micros);
+
+    // Position of the highest set bit selects the power of two, the next
+    // SUB_BUCKET_BITS bits select the linear sub-bucket within it.
+    int msb = 63 - __builtin_clzll(micros);
+    int shift = msb - SUB_BUCKET_BITS;
+    int sub = static_cast<int>((micros >> shift) & (SUB_BUCKETS - 1));
+    int bucket = (shift + 1) * SUB_BUCKETS + sub;
+    return std::min(bucket, NUM_BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::upperBoundOf(int bucket) {
+    if (bucket < SUB_BUCKETS) return static_cast<uint64_t>(bucket);
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t sub = static_cast<uint64_t>(bucket % SUB_BUCKETS);
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::microseconds latency) {
+    uint64_t micros = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0;
+    buckets[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    if (total.fetch_add(1, std::memory_order_relaxed) + 1 >= window) {
+        decay();
+    }
+}
+
+void LatencyHistogram::decay() {
+    bool expected = false;
+    if (!decaying.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        return; // another thread is already halving
+    }
+    uint64_t remaining = 0;
+    for (auto& b : buckets) {
+        uint64_t v = b.load(std::memory_order_relaxed);
+        while (!b.compare_exchange_weak(v, v / 2, std::memory_order_relaxed)) {}
+        remaining += v / 2;
+    }
+    total.store(remaining, std::memory_order_relaxed);
+    decaying.store(false, std::memory_order_release);
+}
+
+std::chrono::microseconds LatencyHistogram::percentile(double q) const {
+    q = std::clamp(q, 0.0, 1.0);
+
+    uint64_t counts[NUM_BUCKETS];
+    uint64_t sum = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        sum += counts[i];
+    }
+    if (sum == 0) return std::chrono::microseconds{0};
+
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(sum - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::chrono::microseconds{static_cast<int64_t>(upperBoundOf(i))};
+        }
+    }
+    return std::chrono::microseconds{static_cast<int64_t>(upperBoundOf(NUM_BUCKETS - 1))};
+}
+
+uint64_t LatencyHistogram::count() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset() {
+    for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+}
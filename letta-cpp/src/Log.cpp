@@ -0,0 +1,515 @@
+#include "Log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+LogField::LogField(const char* key, double value) : key(key) {
+    int n = std::snprintf(buffer, sizeof(buffer), "%g", value);
+    owned = static_cast<uint8_t>(n > 0 && n < static_cast<int>(sizeof(buffer)) ? n : 0);
+}
+
+namespace {
+
+// Single-producer / single-consumer byte ring. The owning thread appends
+// records, the sink thread consumes them. Head and tail only ever grow; the
+// position in the buffer is taken modulo the (power of two) capacity.
+class LogRing {
+public:
+    explicit LogRing(size_t capacity, uint32_t thread_index)
+        : capacity(capacity), mask(capacity - 1), buffer(new char[capacity]), thread_index(thread_index) {}
+
+    // Reserve `size` contiguous bytes, or nullptr if the ring is full. A record
+    // never straddles the end of the buffer; the tail end is skipped instead.
+    char* reserve(size_t size, size_t& skipped) {
+        uint64_t head = write_pos.load(std::memory_order_relaxed);
+        uint64_t tail = read_pos.load(std::memory_order_acquire);
+        size_t offset = head & mask;
+        skipped = offset + size > capacity ? capacity - offset : 0;
+        if (head + skipped + size - tail > capacity) return nullptr;
+        if (skipped) {
+            // Marker so the consumer knows to jump to the start of the buffer
+            if (skipped >= sizeof(uint32_t)) std::memset(buffer.get() + offset, 0, sizeof(uint32_t));
+            offset = 0;
+        }
+        return buffer.get() + offset;
+    }
+
+    void commit(size_t size, size_t skipped) {
+        write_pos.store(write_pos.load(std::memory_order_relaxed) + skipped + size, std::memory_order_release);
+    }
+
+    // Consumer side: visit every complete record currently published
+    template <typename F>
+    void drain(F&& visit) {
+        uint64_t tail = read_pos.load(std::memory_order_relaxed);
+        uint64_t head = write_pos.load(std::memory_order_acquire);
+        while (tail < head) {
+            size_t offset = tail & mask;
+            size_t remaining = capacity - offset;
+            uint32_t size = 0;
+            if (remaining >= sizeof(uint32_t)) std::memcpy(&size, buffer.get() + offset, sizeof(uint32_t));
+            if (remaining < sizeof(uint32_t) || size == 0) {
+                tail += remaining; // skipped tail end
+                continue;
+            }
+            visit(buffer.get() + offset);
+            tail += size;
+        }
+        read_pos.store(tail, std::memory_order_release);
+    }
+
+    bool empty() const {
+        return read_pos.load(std::memory_order_acquire) == write_pos.load(std::memory_order_acquire);
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<char[]> buffer;
+    const uint32_t thread_index;
+    std::atomic<bool> retired{false};
+
+private:
+    alignas(64) std::atomic<uint64_t> write_pos{0};
+    alignas(64) std::atomic<uint64_t> read_pos{0};
+};
+
+// On-ring record layout: RecordHeader, component, message, then per field
+// FieldHeader + key + value. Everything is padded to 8 bytes.
+struct RecordHeader {
+    uint32_t size;
+    uint8_t level;
+    uint8_t field_count;
+    uint16_t component_len;
+    uint32_t message_len;
+    uint32_t reserved;
+    uint64_t unix_nanos;
+};
+
+struct FieldHeader {
+    uint16_t key_len;
+    uint16_t reserved;
+    uint32_t value_len;
+};
+
+constexpr size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+const char* levelName(uint8_t level) {
+    static const char* names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+    return level < 6 ? names[level] : "?";
+}
+
+void appendTimestamp(std::string& out, uint64_t unix_nanos) {
+    time_t seconds = static_cast<time_t>(unix_nanos / 1000000000ULL);
+    unsigned millis = static_cast<unsigned>((unix_nanos / 1000000ULL) % 1000);
+    std::tm tm{};
+    gmtime_r(&seconds, &tm);
+    char buf[40];
+    size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    n += std::snprintf(buf + n, sizeof(buf) - n, ".%03uZ", millis);
+    out.append(buf, n);
+}
+
+void appendJsonString(std::string& out, std::string_view s) {
+    out.push_back('"');
+    for (char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+// Render one record (already laid out as on the ring) as a line of text
+void formatRecord(std::string& out, const char* record, uint32_t thread_index, LogFormat format) {
+    RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+    const char* p = record + sizeof(RecordHeader);
+    std::string_view component(p, header.component_len);
+    p += header.component_len;
+    std::string_view message(p, header.message_len);
+    p += header.message_len;
+
+    if (format == LogFormat::Json) {
+        out += "{\"ts\":\"";
+        appendTimestamp(out, header.unix_nanos);
+        out += "\",\"level\":\"";
+        out += levelName(header.level);
+        out += "\",\"thread\":";
+        out += std::to_string(thread_index);
+        out += ",\"component\":";
+        appendJsonString(out, component);
+        out += ",\"msg\":";
+        appendJsonString(out, message);
+    } else {
+        appendTimestamp(out, header.unix_nanos);
+        out.push_back(' ');
+        const char* name = levelName(header.level);
+        out += name;
+        out.append(6 - std::strlen(name), ' ');
+        out.push_back('[');
+        out.append(component);
+        out += "] ";
+        out.append(message);
+    }
+
+    for (uint8_t i = 0; i < header.field_count; ++i) {
+        FieldHeader field;
+        std::memcpy(&field, p, sizeof(field));
+        p += sizeof(field);
+        std::string_view key(p, field.key_len);
+        p += field.key_len;
+        std::string_view value(p, field.value_len);
+        p += field.value_len;
+
+        if (format == LogFormat::Json) {
+            out.push_back(',');
+            appendJsonString(out, key);
+            out.push_back(':');
+            appendJsonString(out, value);
+        } else {
+            out.push_back(' ');
+            out.append(key);
+            out.push_back('=');
+            out.append(value);
+        }
+    }
+    out += format == LogFormat::Json ? "}\n" : "\n";
+}
+
+uint64_t unixNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+size_t roundUpPowerOfTwo(size_t n) {
+    size_t p = 1024;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+void writeToStderr(std::string_view text) {
+    std::fwrite(text.data(), 1, text.size(), stderr);
+    std::fflush(stderr);
+}
+
+// The sink's rare "about to sleep" barrier is made heavy so the producers'
+// per-record one can be a compiler barrier: membarrier() runs a full fence on
+// every thread of the process. Without it producers pay for a real fence.
+bool registerHeavyBarrier() {
+#if defined(__linux__) && defined(SYS_membarrier)
+    long supported = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    if (supported < 0 || !(supported & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) return false;
+    return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+void heavyBarrier() {
+#if defined(__linux__) && defined(SYS_membarrier)
+    syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+#endif
+}
+
+class LogCore {
+public:
+    static LogCore& instance() {
+        static LogCore core;
+        return core;
+    }
+
+    ~LogCore() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    std::atomic<uint8_t> level{static_cast<uint8_t>(LogLevel::Info)};
+    std::atomic<LogFormat> format{LogFormat::Text};
+    std::atomic<bool> synchronous{false};
+    std::atomic<size_t> ring_capacity{1 << 18};
+    std::atomic<uint64_t> dropped{0};
+
+    void setSink(Log::Sink new_sink) {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        sink = new_sink ? std::move(new_sink) : Log::Sink(writeToStderr);
+    }
+
+    void writeSync(std::string_view text) {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        sink(text);
+    }
+
+    std::shared_ptr<LogRing> registerRing() {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto ring = std::make_shared<LogRing>(roundUpPowerOfTwo(ring_capacity.load()), next_thread_index++);
+        rings.push_back(ring);
+        if (!worker.joinable()) {
+            worker = std::thread([this] { run(); });
+        }
+        return ring;
+    }
+
+    // Producer side, after every commit. Lock-free unless the sink has gone
+    // to sleep, and then only the first producer to see it takes the lock.
+    void wakeIfSleeping() {
+        // Pairs with the barrier in run(): either we see `sleeping`, or the
+        // sink's last look at the rings sees our record
+        if (heavy_barrier) {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        if (!sleeping.load(std::memory_order_relaxed) || !sleeping.exchange(false)) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_all();
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!worker.joinable()) return;
+        uint64_t ticket = ++flush_requested;
+        wake.notify_all();
+        flushed.wait(lock, [&] { return flush_completed >= ticket || stopping; });
+    }
+
+private:
+    LogCore() = default;
+
+    // Sink thread: drain every ring, format, write in one call per pass
+    void run() {
+        std::string out;
+        auto idle_sleep = std::chrono::microseconds(50);
+        while (true) {
+            uint64_t flush_target;
+            std::vector<std::shared_ptr<LogRing>> snapshot;
+            bool stop;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                flush_target = flush_requested;
+                snapshot = rings;
+                stop = stopping;
+            }
+
+            LogFormat fmt = format.load(std::memory_order_relaxed);
+            for (auto& ring : snapshot) {
+                ring->drain([&](const char* record) { formatRecord(out, record, ring->thread_index, fmt); });
+            }
+
+            if (!out.empty()) {
+                writeSync(out);
+                out.clear();
+                idle_sleep = std::chrono::microseconds(50);
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                // Forget rings whose thread has exited and that are fully drained
+                rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<LogRing>& r) {
+                    return r->retired.load() && r->empty();
+                }), rings.end());
+
+                if (flush_target > flush_completed) {
+                    flush_completed = flush_target;
+                    flushed.notify_all();
+                }
+                if (stop) return;
+                if (flush_requested == flush_completed && idle_sleep < kMaxIdleSleep) {
+                    // Poll with a backoff that stays short while there is
+                    // traffic, so a busy producer never has to signal
+                    wake.wait_for(lock, idle_sleep);
+                    idle_sleep = std::min(idle_sleep * 2, kMaxIdleSleep);
+                } else if (flush_requested == flush_completed) {
+                    // Quiet for a while: sleep until a producer commits a
+                    // record (wakeIfSleeping), a flush or shutdown
+                    sleeping.store(true);
+                    if (heavy_barrier) {
+                        heavyBarrier();
+                    } else {
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                    }
+                    bool idle = std::all_of(rings.begin(), rings.end(),
+                                            [](const std::shared_ptr<LogRing>& r) { return r->empty(); });
+                    if (idle) {
+                        wake.wait(lock, [&] {
+                            return !sleeping.load() || stopping || flush_requested != flush_completed;
+                        });
+                    }
+                    sleeping.store(false);
+                }
+            }
+        }
+    }
+
+    static constexpr std::chrono::microseconds kMaxIdleSleep{2000};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    std::thread worker;
+    uint32_t next_thread_index = 0;
+    uint64_t flush_requested = 0;
+    uint64_t flush_completed = 0;
+    bool stopping = false;
+
+    // Read by every producer: on a line of its own, away from what the sink
+    // writes on each pass
+    alignas(64) std::atomic<bool> sleeping{false}; // the sink is blocked on `wake` until a producer clears it
+    const bool heavy_barrier = registerHeavyBarrier();
+
+    alignas(64) std::mutex sink_mutex;
+    Log::Sink sink = writeToStderr;
+};
+
+// Owns the calling thread's ring; marks it retired when the thread exits so the
+// sink can drain and release it.
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+    ~ThreadRing() {
+        if (ring) ring->retired.store(true);
+    }
+};
+
+thread_local ThreadRing thread_ring;
+
+} // namespace
+
+void Log::setLevel(LogLevel level) {
+    LogCore::instance().level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+LogLevel Log::level() {
+    return static_cast<LogLevel>(LogCore::instance().level.load(std::memory_order_relaxed));
+}
+
+bool Log::enabled(LogLevel level) {
+    return static_cast<uint8_t>(level) >= LogCore::instance().level.load(std::memory_order_relaxed) &&
+           level != LogLevel::Off;
+}
+
+LogLevel Log::parseLevel(const std::string& name, LogLevel fallback) {
+    if (name == "trace") return LogLevel::Trace;
+    if (name == "debug") return LogLevel::Debug;
+    if (name == "info") return LogLevel::Info;
+    if (name == "warn" || name == "warning") return LogLevel::Warn;
+    if (name == "error") return LogLevel::Error;
+    if (name == "off") return LogLevel::Off;
+    return fallback;
+}
+
+void Log::setFormat(LogFormat format) {
+    LogCore::instance().format.store(format);
+}
+
+void Log::setSink(Sink sink) {
+    LogCore::instance().setSink(std::move(sink));
+}
+
+void Log::setSynchronous(bool synchronous) {
+    LogCore::instance().synchronous.store(synchronous);
+}
+
+void Log::setRingCapacity(size_t bytes) {
+    LogCore::instance().ring_capacity.store(bytes);
+}
+
+void Log::write(LogLevel level, const char* component, std::string_view message, std::initializer_list<LogField> fields) {
+    LogCore& core = LogCore::instance();
+    if (!thread_ring.ring) {
+        thread_ring.ring = core.registerRing();
+    }
+    LogRing& ring = *thread_ring.ring;
+
+    std::string_view component_view(component);
+    size_t size = sizeof(RecordHeader) + component_view.size() + message.size();
+    for (const auto& field : fields) {
+        size += sizeof(FieldHeader) + field.name().size() + field.value().size();
+    }
+    size = align8(size);
+
+    RecordHeader header{};
+    header.size = static_cast<uint32_t>(size);
+    header.level = static_cast<uint8_t>(level);
+    header.field_count = static_cast<uint8_t>(std::min<size_t>(fields.size(), 255));
+    header.component_len = static_cast<uint16_t>(component_view.size());
+    header.message_len = static_cast<uint32_t>(message.size());
+    header.unix_nanos = unixNanos();
+
+    auto serialize = [&](char* p) {
+        std::memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+        std::memcpy(p, component_view.data(), component_view.size());
+        p += component_view.size();
+        std::memcpy(p, message.data(), message.size());
+        p += message.size();
+        uint8_t written = 0;
+        for (const auto& field : fields) {
+            if (written++ == header.field_count) break;
+            FieldHeader fh{static_cast<uint16_t>(field.name().size()), 0, static_cast<uint32_t>(field.value().size())};
+            std::memcpy(p, &fh, sizeof(fh));
+            p += sizeof(fh);
+            std::memcpy(p, field.name().data(), field.name().size());
+            p += field.name().size();
+            std::memcpy(p, field.value().data(), field.value().size());
+            p += field.value().size();
+        }
+    };
+
+    if (core.synchronous.load(std::memory_order_relaxed) || size > ring.capacity / 2) {
+        // Format in place and write through (also the path for huge records)
+        std::vector<char> record(size);
+        serialize(record.data());
+        std::string out;
+        formatRecord(out, record.data(), ring.thread_index, core.format.load(std::memory_order_relaxed));
+        core.writeSync(out);
+        return;
+    }
+
+    size_t skipped = 0;
+    char* slot = ring.reserve(size, skipped);
+    if (!slot) {
+        core.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    serialize(slot);
+    ring.commit(size, skipped);
+    core.wakeIfSleeping();
+}
+
+void Log::flush() {
+    LogCore::instance().flush();
+}
+
+uint64_t Log::dropped() {
+    return LogCore::instance().dropped.load(std::memory_order_relaxed);
+}
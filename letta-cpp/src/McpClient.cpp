@@ -0,0 +1,391 @@
+#include "McpClient.hpp"
+#include "Log.hpp"
+#include "Telemetry.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <spawn.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kProtocolVersion = "2025-06-18";
+
+// How long a stdio server gets to exit on its own once its stdin closes
+constexpr auto kExitGrace = std::chrono::milliseconds(1000);
+
+// MCP describes a tool as {name, description, inputSchema}; the LLM clients
+// take OpenAI-style function tools
+json functionSchema(const json& tool) {
+    json parameters = tool.value("inputSchema", json{{"type", "object"}});
+    parameters.erase("$schema"); // not part of the subset Gemini accepts
+    if (!parameters.contains("properties")) parameters["properties"] = json::object();
+    json function = {{"name", tool.at("name")}, {"parameters", std::move(parameters)}};
+    if (tool.contains("description")) function["description"] = tool["description"];
+    return {{"type", "function"}, {"function", std::move(function)}};
+}
+
+// Text parts joined with spaces, like the Python client
+std::string flattenContent(const json& result) {
+    std::string text;
+    for (const auto& part : result.value("content", json::array())) {
+        if (!text.empty()) text += ' ';
+        if (part.value("type", "") == "text") {
+            text += part.value("text", "");
+        } else {
+            text += part.dump();
+        }
+    }
+    return text.empty() ? "Empty response from tool" : text;
+}
+
+bool writeAll(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t written = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += written;
+        n -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+} // namespace
+
+McpClient::McpClient(McpServerConfig config) : cfg(std::move(config)) {
+    if (cfg.command.empty() == cfg.socket_path.empty()) {
+        throw std::invalid_argument("McpServerConfig needs exactly one of command and socket_path");
+    }
+}
+
+McpClient::~McpClient() {
+    disconnect();
+}
+
+bool McpClient::connect() {
+    if (session_open.load()) return true;
+    std::lock_guard<std::mutex> lock(session_mutex);
+    if (session_open.load()) return true;
+    close(); // whatever is left of a session that dropped
+    return open();
+}
+
+void McpClient::disconnect() {
+    std::lock_guard<std::mutex> lock(session_mutex);
+    close();
+}
+
+std::vector<json> McpClient::tools() {
+    // Connect first: a new session marks the cache stale itself
+    if (connect() && tools_stale.exchange(false)) {
+        std::vector<json> fetched;
+        std::set<std::string> names;
+        bool listed = true;
+        try {
+            json params = json::object();
+            do {
+                json page = request("tools/list", params);
+                for (const auto& tool : page.value("tools", json::array())) {
+                    names.insert(tool.at("name").get<std::string>());
+                    fetched.push_back(functionSchema(tool));
+                }
+                params = json::object();
+                if (page.contains("nextCursor") && page["nextCursor"].is_string()) {
+                    params["cursor"] = page["nextCursor"];
+                }
+            } while (params.contains("cursor"));
+        } catch (const std::exception& e) {
+            listed = false;
+            tools_stale = true;
+            LETTA_LOG_WARN("mcp", "Could not list tools", {"server", cfg.name}, {"error", e.what()});
+        }
+        if (listed) {
+            std::lock_guard<std::mutex> lock(tools_mutex);
+            tool_schemas = std::move(fetched);
+            tool_names = std::move(names);
+            LETTA_LOG_INFO("mcp", "Cached tool list", {"server", cfg.name}, {"tools", tool_schemas.size()});
+        }
+    }
+    std::lock_guard<std::mutex> lock(tools_mutex);
+    return tool_schemas;
+}
+
+bool McpClient::hasTool(const std::string& name) {
+    if (tools_stale.load()) tools();
+    std::lock_guard<std::mutex> lock(tools_mutex);
+    return tool_names.count(name) > 0;
+}
+
+json McpClient::callTool(const std::string& name, const json& arguments) {
+    ScopedSpan span("mcp.call_tool");
+    span.setAttribute("tool.name", name);
+    span.setAttribute("mcp.server", cfg.name);
+    try {
+        json result = request("tools/call", {{"name", name}, {"arguments", arguments}});
+        bool failed = result.value("isError", false);
+        if (failed) span.setError("tool reported an error");
+        return {{"status", failed ? "ERROR" : "OK"}, {"message", flattenContent(result)}};
+    } catch (const std::exception& e) {
+        span.setError(e.what());
+        LETTA_LOG_WARN("mcp", "Tool call failed", {"server", cfg.name}, {"tool", name}, {"error", e.what()});
+        return {{"status", "ERROR"}, {"message", std::string("MCP server ") + cfg.name + ": " + e.what()}};
+    }
+}
+
+json McpClient::request(const std::string& method, const json& params) {
+    if (!connect()) {
+        throw std::runtime_error("could not connect to MCP server " + cfg.name);
+    }
+    return roundTrip(method, params);
+}
+
+bool McpClient::open() {
+    int new_fd = cfg.command.empty() ? connectSocket() : spawnServer();
+    if (new_fd < 0) return false;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        fd = new_fd;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        reader_alive = true;
+    }
+    reader = std::thread(&McpClient::readLoop, this, new_fd);
+
+    try {
+        json result = roundTrip("initialize", {
+            {"protocolVersion", kProtocolVersion},
+            {"capabilities", json::object()},
+            {"clientInfo", {{"name", "letta-cpp"}, {"version", "0.1.0"}}}
+        });
+        server_info = result.value("serverInfo", json::object());
+        if (!send({{"jsonrpc", "2.0"}, {"method", "notifications/initialized"}})) {
+            throw std::runtime_error("connection closed");
+        }
+    } catch (const std::exception& e) {
+        LETTA_LOG_ERROR("mcp", "Initialize failed", {"server", cfg.name}, {"error", e.what()});
+        close();
+        return false;
+    }
+
+    // A fresh session may be a different server build with different tools
+    tools_stale = true;
+    tools_version++;
+    sessions_started++;
+    {
+        // The reader may already have seen EOF; then the session is not open
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        session_open = reader_alive;
+    }
+    LETTA_LOG_INFO("mcp", "Session started", {"server", cfg.name},
+                   {"server_name", server_info.value("name", "")}, {"session", sessions_started.load()});
+    return session_open.load();
+}
+
+void McpClient::close() {
+    session_open = false;
+    if (fd >= 0) {
+        // Wakes the reader and any blocked writer; the fd stays valid until
+        // both are done with it
+        ::shutdown(fd, SHUT_RDWR);
+    }
+    if (reader.joinable()) reader.join();
+    int old_fd;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        old_fd = fd;
+        fd = -1;
+    }
+    if (old_fd >= 0) ::close(old_fd);
+
+    if (child > 0) {
+        // Closing stdin is how a stdio server is asked to exit
+        auto deadline = Clock::now() + kExitGrace;
+        int status = 0;
+        pid_t reaped = 0;
+        while ((reaped = ::waitpid(child, &status, WNOHANG)) == 0 && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (reaped == 0) {
+            ::kill(child, SIGKILL);
+            ::waitpid(child, &status, 0);
+        }
+        child = -1;
+    }
+}
+
+int McpClient::spawnServer() {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        LETTA_LOG_ERROR("mcp", "Could not create server socket", {"error", std::strerror(errno)});
+        return -1;
+    }
+
+    // The server's stdin and stdout are both our socket pair, so writes to a
+    // server that has died fail with EPIPE (MSG_NOSIGNAL) instead of raising
+    // SIGPIPE as a pipe would; stderr is inherited
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+
+    std::vector<std::string> env_storage;
+    for (char** e = environ; *e; ++e) {
+        std::string entry = *e;
+        if (!cfg.env.count(entry.substr(0, entry.find('=')))) env_storage.push_back(std::move(entry));
+    }
+    for (const auto& kv : cfg.env) env_storage.push_back(kv.first + "=" + kv.second);
+    std::vector<char*> envp;
+    for (auto& entry : env_storage) envp.push_back(&entry[0]);
+    envp.push_back(nullptr);
+    std::vector<char*> argv;
+    for (const auto& arg : cfg.command) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid = -1;
+    int rc = ::posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(fds[1]);
+    if (rc != 0) {
+        ::close(fds[0]);
+        LETTA_LOG_ERROR("mcp", "Could not start server", {"server", cfg.name}, {"command", cfg.command[0]},
+                        {"error", std::strerror(rc)});
+        return -1;
+    }
+    child = pid;
+    return fds[0];
+}
+
+int McpClient::connectSocket() {
+    sockaddr_un addr{};
+    if (cfg.socket_path.size() >= sizeof(addr.sun_path)) {
+        LETTA_LOG_ERROR("mcp", "Socket path too long", {"server", cfg.name}, {"path", cfg.socket_path});
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, cfg.socket_path.c_str(), cfg.socket_path.size() + 1);
+    int s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s < 0 || ::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        LETTA_LOG_ERROR("mcp", "Could not connect to server", {"server", cfg.name}, {"path", cfg.socket_path},
+                        {"error", std::strerror(errno)});
+        if (s >= 0) ::close(s);
+        return -1;
+    }
+    return s;
+}
+
+bool McpClient::send(const json& message) {
+    std::string line = message.dump();
+    line += '\n';
+    std::lock_guard<std::mutex> lock(write_mutex);
+    return fd >= 0 && writeAll(fd, line.data(), line.size());
+}
+
+json McpClient::roundTrip(const std::string& method, const json& params) {
+    int64_t id = next_id++;
+    Pending slot;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        if (!reader_alive) throw std::runtime_error("connection closed");
+        pending[id] = &slot;
+    }
+    requests_sent++;
+    LETTA_LOG_TRACE("mcp", "Request", {"server", cfg.name}, {"method", method}, {"id", id});
+
+    if (!send({{"jsonrpc", "2.0"}, {"id", id}, {"method", method}, {"params", params}})) {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        pending.erase(id);
+        throw std::runtime_error("connection closed");
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(pending_mutex);
+        if (!answered.wait_for(lock, cfg.timeout, [&] { return slot.done; })) {
+            pending.erase(id);
+            lock.unlock();
+            send({{"jsonrpc", "2.0"}, {"method", "notifications/cancelled"},
+                  {"params", {{"requestId", id}, {"reason", "timed out"}}}});
+            throw std::runtime_error(method + " timed out after " + std::to_string(cfg.timeout.count()) + " ms");
+        }
+    }
+
+    if (slot.message.contains("error")) {
+        const json& error = slot.message["error"];
+        throw std::runtime_error(error.value("message", "error") + " (" + std::to_string(error.value("code", 0)) + ")");
+    }
+    return slot.message.value("result", json::object());
+}
+
+void McpClient::readLoop(int read_fd) {
+    std::string buffer;
+    char chunk[64 * 1024];
+    while (true) {
+        ssize_t n = ::recv(read_fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        buffer.append(chunk, static_cast<size_t>(n));
+
+        size_t start = 0;
+        for (size_t nl; (nl = buffer.find('\n', start)) != std::string::npos; start = nl + 1) {
+            json message = json::parse(buffer.begin() + start, buffer.begin() + nl, nullptr, false);
+            if (message.is_discarded() || !message.is_object()) {
+                LETTA_LOG_WARN("mcp", "Ignoring malformed message", {"server", cfg.name});
+                continue;
+            }
+            if (message.contains("method")) {
+                if (message.contains("id")) {
+                    handleServerRequest(message);
+                } else if (message["method"] == "notifications/tools/list_changed") {
+                    tools_stale = true;
+                    tools_version++;
+                }
+                continue;
+            }
+            if (!message.contains("id") || !message["id"].is_number_integer()) continue;
+
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            auto it = pending.find(message["id"].get<int64_t>());
+            if (it == pending.end()) continue; // timed out and given up on
+            it->second->message = std::move(message);
+            it->second->done = true;
+            pending.erase(it);
+            answered.notify_all();
+        }
+        buffer.erase(0, start);
+    }
+
+    // Everything still waiting fails now rather than at its timeout
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    reader_alive = false;
+    session_open = false;
+    for (auto& entry : pending) {
+        entry.second->message = {{"error", {{"code", -32000}, {"message", "connection closed"}}}};
+        entry.second->done = true;
+    }
+    if (!pending.empty()) {
+        LETTA_LOG_WARN("mcp", "Session lost with requests in flight", {"server", cfg.name}, {"requests", pending.size()});
+    }
+    pending.clear();
+    answered.notify_all();
+}
+
+void McpClient::handleServerRequest(const json& message) {
+    json reply = {{"jsonrpc", "2.0"}, {"id", message["id"]}};
+    if (message["method"] == "ping") {
+        reply["result"] = json::object();
+    } else {
+        // We advertise no client capabilities (sampling, roots, elicitation)
+        reply["error"] = {{"code", -32601}, {"message", "Method not found"}};
+    }
+    send(reply);
+}
@@ -1,17 +1,65 @@
 #include "Memory.hpp"
-#include <sstream>
-#include <iostream>
+#include "Log.hpp"
+#include "Rcu.hpp"
+#include <algorithm>
+
+namespace {
+
+void warnIfOverLimit(const MemoryBlock& block, size_t new_length) {
+    // Check limit (soft enforcement for now, just warn)
+    if (new_length > static_cast<size_t>(block.limit)) {
+        LETTA_LOG_WARN("memory", "New block value exceeds limit", {"label", block.label},
+                       {"length", new_length}, {"limit", block.limit});
+    }
+}
+
+} // namespace
 
 json MemoryBlock::toJson() const {
     return {
         {"label", label},
-        {"value", value},
+        {"value", value.str()},
         {"limit", limit},
         {"read_only", read_only}
     };
 }
 
-Memory::Memory() {}
+SharedBlock::SharedBlock(MemoryBlock block)
+    : block_label(block.label), current(new MemoryBlock(std::move(block))) {}
+
+SharedBlock::~SharedBlock() {
+    // Agents that compiled it may still be inside a read section
+    Rcu::retire(current.load());
+}
+
+MemoryBlock SharedBlock::snapshot() const {
+    Rcu::ReadGuard guard;
+    return *read();
+}
+
+bool SharedBlock::update(const std::string& new_value) {
+    return edit([&](Rope& value) {
+        value = new_value;
+        return true;
+    }) == BlockEdit::Ok;
+}
+
+BlockEdit SharedBlock::edit(const std::function<bool(Rope& value)>& edit) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    const MemoryBlock* old = current.load(std::memory_order_relaxed);
+    if (old->read_only) return BlockEdit::ReadOnly;
+
+    auto next = std::make_unique<MemoryBlock>(*old);
+    if (!edit(next->value)) return BlockEdit::Rejected;
+    warnIfOverLimit(*next, next->value.size());
+
+    current.store(next.release());
+    current_version.fetch_add(1, std::memory_order_release);
+    Rcu::retire(old);
+    return BlockEdit::Ok;
+}
+
+Memory::Memory() : prompt_template(PromptTemplate::defaultTemplate()) {}
 
 void Memory::initializeDefault() {
     // Human block
@@ -31,53 +79,94 @@ void Memory::initializeDefault() {
     persona.read_only = false;
     blocks[persona.label] = persona;
     block_order.push_back("persona");
+    local_version++;
 }
 
 std::string Memory::compile() const {
-    std::stringstream ss;
-    ss << "You are a Letta agent. You have access to a set of tools and a memory system.\n";
-    ss << "You must use the `send_message` tool to communicate with the user.\n";
-    ss << "You must use the `core_memory_append` or `core_memory_replace` tools to update your memory when you learn new facts.\n\n";
-    
-    ss << "### Memory Blocks\n";
+    std::string out;
+    compileInto(out);
+    return out;
+}
+
+void Memory::compileInto(std::string& out) const {
+    out.clear();
+    PromptContext context;
+    context.now = std::chrono::system_clock::now();
+    context.blocks.reserve(block_order.size());
+
+    // Shared blocks are read in place; the guard keeps them alive until rendered
+    Rcu::ReadGuard guard;
     for (const auto& label : block_order) {
-        if (blocks.count(label)) {
-            const auto& block = blocks.at(label);
-            ss << "Block '" << block.label << "' (" << block.value.length() << "/" << block.limit << " chars):\n";
-            ss << block.value << "\n\n";
+        auto shared = shared_blocks.empty() ? shared_blocks.end() : shared_blocks.find(label);
+        if (shared != shared_blocks.end()) {
+            context.blocks.push_back(shared->second->read());
+        } else if (auto it = blocks.find(label); it != blocks.end()) {
+            context.blocks.push_back(&it->second);
         }
     }
-    
-    return ss.str();
+    prompt_template->render(context, out);
+}
+
+void Memory::setTemplate(std::shared_ptr<const PromptTemplate> tmpl) {
+    prompt_template = tmpl ? std::move(tmpl) : PromptTemplate::defaultTemplate();
+    local_version++;
 }
 
 MemoryBlock* Memory::getBlock(const std::string& label) {
     if (blocks.count(label)) {
+        // The caller may write through the pointer; assume it does
+        local_version++;
         return &blocks[label];
     }
     return nullptr;
 }
 
+std::optional<MemoryBlock> Memory::findBlock(const std::string& label) const {
+    auto shared = shared_blocks.find(label);
+    if (shared != shared_blocks.end()) {
+        return shared->second->snapshot();
+    }
+    auto it = blocks.find(label);
+    if (it != blocks.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
 bool Memory::updateBlock(const std::string& label, const std::string& new_value) {
-    if (blocks.count(label)) {
-        if (blocks[label].read_only) return false;
-        
-        // Check limit (soft enforcement for now, just warn)
-        if (new_value.length() > blocks[label].limit) {
-            std::cerr << "Warning: New value for block '" << label << "' exceeds limit (" 
-                      << new_value.length() << " > " << blocks[label].limit << ")" << std::endl;
-        }
-        
-        blocks[label].value = new_value;
+    return editBlock(label, [&](Rope& value) {
+        value = new_value;
         return true;
+    }) == BlockEdit::Ok;
+}
+
+BlockEdit Memory::editBlock(const std::string& label, const std::function<bool(Rope& value)>& edit) {
+    auto shared = shared_blocks.find(label);
+    if (shared != shared_blocks.end()) {
+        return shared->second->edit(edit);
     }
-    return false;
+
+    auto it = blocks.find(label);
+    if (it == blocks.end()) return BlockEdit::NotFound;
+    if (it->second.read_only) return BlockEdit::ReadOnly;
+
+    // O(1) copy: the edit only rebuilds the nodes it touches
+    Rope value = it->second.value;
+    if (!edit(value)) return BlockEdit::Rejected;
+    warnIfOverLimit(it->second, value.size());
+
+    it->second.value = std::move(value);
+    local_version++;
+    return BlockEdit::Ok;
 }
 
 std::vector<MemoryBlock> Memory::getBlocks() const {
     std::vector<MemoryBlock> result;
     for (const auto& label : block_order) {
-        if (blocks.count(label)) {
+        auto shared = shared_blocks.find(label);
+        if (shared != shared_blocks.end()) {
+            result.push_back(shared->second->snapshot());
+        } else if (blocks.count(label)) {
             result.push_back(blocks.at(label));
         }
     }
@@ -85,28 +174,98 @@ std::vector<MemoryBlock> Memory::getBlocks() const {
 }
 
 void Memory::addBlock(const MemoryBlock& block) {
-    if (blocks.count(block.label)) {
-        std::cerr << "Warning: Block '" << block.label << "' already exists. Overwriting." << std::endl;
+    auto shared = shared_blocks.find(block.label);
+    if (shared != shared_blocks.end()) {
+        LETTA_LOG_WARN("memory", "Shared block already attached, replacing with private block", {"label", block.label});
+        detached_versions += shared->second->version();
+        shared_blocks.erase(shared);
+        forgetShared(block.label);
+    } else if (blocks.count(block.label)) {
+        LETTA_LOG_WARN("memory", "Block already exists, overwriting", {"label", block.label});
         // If overwriting, remove from order first to re-add at end, or just keep position?
         // Let's keep position if exists, otherwise push back.
     } else {
         block_order.push_back(block.label);
     }
     blocks[block.label] = block;
+    local_version++;
 }
 
 void Memory::removeBlock(const std::string& label) {
-    if (blocks.count(label)) {
+    auto shared = shared_blocks.find(label);
+    if (shared != shared_blocks.end()) {
+        detached_versions += shared->second->version();
+        shared_blocks.erase(shared);
+        forgetShared(label);
+    } else if (blocks.count(label)) {
         blocks.erase(label);
-        // Remove from order vector
-        for (auto it = block_order.begin(); it != block_order.end(); ) {
-            if (*it == label) {
-                it = block_order.erase(it);
-            } else {
-                ++it;
-            }
-        }
     } else {
-        std::cerr << "Warning: Block '" << label << "' not found, cannot remove." << std::endl;
+        LETTA_LOG_WARN("memory", "Block not found, cannot remove", {"label", label});
+        return;
+    }
+    eraseFromOrder(label);
+    local_version++;
+}
+
+void Memory::attachShared(std::shared_ptr<SharedBlock> block) {
+    const std::string& label = block->label();
+    if (blocks.erase(label)) {
+        LETTA_LOG_WARN("memory", "Private block replaced by shared block", {"label", label});
+    } else if (shared_blocks.count(label)) {
+        detached_versions += shared_blocks[label]->version();
+    } else {
+        block_order.push_back(label);
+    }
+    forgetShared(label);
+    shared_blocks[label] = std::move(block);
+    local_version++;
+}
+
+std::shared_ptr<SharedBlock> Memory::share(const std::string& label) {
+    auto shared = shared_blocks.find(label);
+    if (shared != shared_blocks.end()) return shared->second;
+    auto it = blocks.find(label);
+    if (it == blocks.end()) return nullptr;
+
+    auto block = std::make_shared<SharedBlock>(std::move(it->second));
+    blocks.erase(it);
+    shared_blocks[label] = block;
+    shared_here.push_back(label);
+    local_version++;
+    return block;
+}
+
+Memory Memory::fork() const {
+    Memory copy(*this);
+    for (const auto& label : shared_here) {
+        auto shared = copy.shared_blocks.find(label);
+        copy.detached_versions += shared->second->version();
+        copy.blocks[label] = shared->second->snapshot();
+        copy.shared_blocks.erase(shared);
+    }
+    copy.shared_here.clear();
+    return copy;
+}
+
+uint64_t Memory::version() const {
+    // Every term only grows, so the sum changes iff something changed
+    uint64_t version = local_version + detached_versions;
+    for (const auto& [label, block] : shared_blocks) {
+        version += block->version();
+    }
+    return version;
+}
+
+void Memory::forgetShared(const std::string& label) {
+    shared_here.erase(std::remove(shared_here.begin(), shared_here.end(), label), shared_here.end());
+}
+
+void Memory::eraseFromOrder(const std::string& label) {
+    for (auto it = block_order.begin(); it != block_order.end(); ) {
+        if (*it == label) {
+            it = block_order.erase(it);
+        } else {
+            ++it;
+        }
     }
 }
@@ -0,0 +1,343 @@
+#include "MessageStore.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Forks of forks add a segment each; past this many the chain is copied into
+// one fresh segment so lookups stay cheap
+constexpr size_t kMaxSegments = 32;
+
+// Message content may be a string, null, or (rarely) structured parts
+std::string contentText(const json& message) {
+    auto it = message.find("content");
+    if (it == message.end() || it->is_null()) return "";
+    return it->is_string() ? it->get<std::string>() : it->dump();
+}
+
+std::string stringField(const json& object, const char* key) {
+    auto it = object.find(key);
+    return it != object.end() && it->is_string() ? it->get<std::string>() : "";
+}
+
+} // namespace
+
+const char* roleName(MessageRole role) {
+    switch (role) {
+        case MessageRole::System: return "system";
+        case MessageRole::User: return "user";
+        case MessageRole::Assistant: return "assistant";
+        case MessageRole::Tool: return "tool";
+    }
+    return "user";
+}
+
+bool parseRole(std::string_view name, MessageRole& role) {
+    if (name == "system") role = MessageRole::System;
+    else if (name == "user") role = MessageRole::User;
+    else if (name == "assistant") role = MessageRole::Assistant;
+    else if (name == "tool") role = MessageRole::Tool;
+    else return false;
+    return true;
+}
+
+ToolCallView MessageStore::Message::toolCall(size_t i) const {
+    const ToolCallRecord& record = columns->tool_calls[columns->call_begin[local] + i];
+    return ToolCallView{columns->text(record.id), columns->text(record.name), columns->text(record.arguments)};
+}
+
+json MessageStore::Message::toJson() const {
+    MessageRole r = role();
+    json out = {{"role", roleName(r)}};
+
+    if (r == MessageRole::Tool) {
+        out["tool_call_id"] = toolCallId();
+        out["name"] = toolName();
+        out["content"] = content();
+        return out;
+    }
+
+    size_t calls = toolCallCount();
+    if (r == MessageRole::Assistant && calls > 0) {
+        if (content().empty()) out["content"] = nullptr;
+        else out["content"] = content();
+        json tool_calls_json = json::array();
+        for (size_t i = 0; i < calls; ++i) {
+            ToolCallView call = toolCall(i);
+            tool_calls_json.push_back({
+                {"id", call.id},
+                {"type", "function"},
+                {"function", {{"name", call.name}, {"arguments", call.arguments}}}
+            });
+        }
+        out["tool_calls"] = std::move(tool_calls_json);
+        return out;
+    }
+
+    out["content"] = content();
+    return out;
+}
+
+MessageStore MessageStore::fromColumns(const uint8_t* roles, size_t count, const uint32_t* contents,
+                                       const uint32_t* call_begin, const uint32_t* tool_calls, size_t call_count,
+                                       std::string pool) {
+    static_assert(sizeof(Slice) == 2 * sizeof(uint32_t), "Slice is copied as two uint32_t");
+    static_assert(sizeof(ToolCallRecord) == 3 * sizeof(Slice), "ToolCallRecord is copied as three Slices");
+    static_assert(sizeof(MessageRole) == 1, "roles are copied as bytes");
+    if (pool.size() > std::numeric_limits<uint32_t>::max() || call_count > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument("message columns exceed 4 GiB");
+    }
+    auto inPool = [&](const uint32_t* slice) { return uint64_t{slice[0]} + slice[1] <= pool.size(); };
+    if (call_begin[0] != 0 || call_begin[count] != call_count) {
+        throw std::invalid_argument("tool call index does not cover the tool calls");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        // A tool result carries exactly the one call it answers
+        bool calls_ok = roles[i] == static_cast<uint8_t>(MessageRole::Tool) ? call_begin[i + 1] - call_begin[i] == 1
+                                                                             : call_begin[i] <= call_begin[i + 1];
+        if (roles[i] > static_cast<uint8_t>(MessageRole::Tool) || !inPool(contents + 2 * i) || !calls_ok) {
+            throw std::invalid_argument("message " + std::to_string(i) + " is malformed");
+        }
+    }
+    for (size_t i = 0; i < 3 * call_count; ++i) {
+        if (!inPool(tool_calls + 2 * i)) {
+            throw std::invalid_argument("tool call " + std::to_string(i / 3) + " is malformed");
+        }
+    }
+
+    MessageStore store;
+    Columns& tail = store.tail;
+    tail.roles.resize(count);
+    std::memcpy(tail.roles.data(), roles, count);
+    tail.contents.resize(count);
+    std::memcpy(static_cast<void*>(tail.contents.data()), contents, count * sizeof(Slice));
+    tail.call_begin.resize(count + 1);
+    std::memcpy(tail.call_begin.data(), call_begin, (count + 1) * sizeof(uint32_t));
+    tail.tool_calls.resize(call_count);
+    std::memcpy(static_cast<void*>(tail.tool_calls.data()), tool_calls, call_count * sizeof(ToolCallRecord));
+    tail.pool = std::move(pool);
+    return store;
+}
+
+size_t MessageStore::Columns::bytes() const {
+    return roles.capacity() * sizeof(MessageRole) +
+           contents.capacity() * sizeof(Slice) +
+           call_begin.capacity() * sizeof(uint32_t) +
+           tool_calls.capacity() * sizeof(ToolCallRecord) +
+           pool.capacity();
+}
+
+MessageStore::Message MessageStore::frozenMessage(size_t index) const {
+    // Last segment starting at or before `index`
+    auto it = std::upper_bound(segments.begin(), segments.end(), index,
+                               [](size_t i, const Segment* segment) { return i < segment->offset; });
+    const Segment* segment = *(it - 1);
+    return Message(this, &segment->columns, index - segment->offset, index);
+}
+
+std::string_view MessageStore::overriddenContent(const Message& message) const {
+    for (const auto& [index, content] : overrides) {
+        if (index == message.index) return content;
+    }
+    return message.columns->text(message.columns->contents[message.local]);
+}
+
+MessageStore::Slice MessageStore::intern(std::string_view value) {
+    if (tail.pool.size() + value.size() > std::numeric_limits<uint32_t>::max()) {
+        compact();
+        if (tail.pool.size() + value.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("MessageStore pool exceeds 4 GiB");
+        }
+    }
+    Slice slice{static_cast<uint32_t>(tail.pool.size()), static_cast<uint32_t>(value.size())};
+    tail.pool.append(value);
+    return slice;
+}
+
+void MessageStore::append(MessageRole role, std::string_view content) {
+    tail.roles.push_back(role);
+    tail.contents.push_back(intern(content));
+    tail.call_begin.push_back(tail.call_begin.back());
+}
+
+void MessageStore::appendAssistant(std::string_view content, const std::vector<ToolCallView>& calls) {
+    tail.roles.push_back(MessageRole::Assistant);
+    tail.contents.push_back(intern(content));
+    for (const auto& call : calls) {
+        tail.tool_calls.push_back(ToolCallRecord{intern(call.id), intern(call.name), intern(call.arguments)});
+    }
+    tail.call_begin.push_back(static_cast<uint32_t>(tail.tool_calls.size()));
+}
+
+void MessageStore::appendToolResult(std::string_view tool_call_id, std::string_view name, std::string_view content) {
+    tail.roles.push_back(MessageRole::Tool);
+    tail.contents.push_back(intern(content));
+    tail.tool_calls.push_back(ToolCallRecord{intern(tool_call_id), intern(name), Slice{}});
+    tail.call_begin.push_back(static_cast<uint32_t>(tail.tool_calls.size()));
+}
+
+void MessageStore::append(const Message& message) {
+    if (message.store == this) {
+        // intern() may reallocate the pool the views point into
+        MessageStore copy;
+        copy.append(message);
+        append(copy[0]);
+        return;
+    }
+
+    MessageRole role = message.role();
+    if (role == MessageRole::Tool) {
+        appendToolResult(message.toolCallId(), message.toolName(), message.content());
+        return;
+    }
+    size_t count = message.toolCallCount();
+    if (count == 0) {
+        append(role, message.content());
+        return;
+    }
+    std::vector<ToolCallView> calls;
+    calls.reserve(count);
+    for (size_t i = 0; i < count; ++i) calls.push_back(message.toolCall(i));
+    appendAssistant(message.content(), calls);
+}
+
+bool MessageStore::appendJson(const json& message) {
+    MessageRole role;
+    if (!message.is_object() || !parseRole(stringField(message, "role"), role)) {
+        return false;
+    }
+
+    std::string content = contentText(message);
+    if (role == MessageRole::Tool) {
+        appendToolResult(stringField(message, "tool_call_id"), stringField(message, "name"), content);
+        return true;
+    }
+    if (role != MessageRole::Assistant || !message.contains("tool_calls") || !message["tool_calls"].is_array()) {
+        append(role, content);
+        return true;
+    }
+
+    // Keep the strings alive until they have been copied into the pool
+    std::vector<std::string> owned;
+    owned.reserve(message["tool_calls"].size() * 3);
+    std::vector<ToolCallView> calls;
+    for (const auto& tc : message["tool_calls"]) {
+        json function = tc.value("function", json::object());
+        const json& arguments = function.value("arguments", json("{}"));
+        owned.push_back(stringField(tc, "id"));
+        owned.push_back(stringField(function, "name"));
+        owned.push_back(arguments.is_string() ? arguments.get<std::string>() : arguments.dump());
+        calls.push_back(ToolCallView{owned[owned.size() - 3], owned[owned.size() - 2], owned.back()});
+    }
+    appendAssistant(content, calls);
+    return true;
+}
+
+void MessageStore::insert(size_t index, MessageRole role, std::string_view content) {
+    if (index < frozen_size) flatten();
+    size_t local = index - frozen_size;
+    tail.roles.insert(tail.roles.begin() + local, role);
+    tail.contents.insert(tail.contents.begin() + local, intern(content));
+    tail.call_begin.insert(tail.call_begin.begin() + local, tail.call_begin[local]);
+}
+
+void MessageStore::setContent(size_t index, std::string_view content) {
+    if (index < frozen_size) {
+        for (auto& [i, text] : overrides) {
+            if (i == index) {
+                text.assign(content.data(), content.size());
+                return;
+            }
+        }
+        overrides.emplace_back(index, std::string(content));
+        return;
+    }
+    Slice& slice = tail.contents[index - frozen_size];
+    garbage_bytes += slice.length;
+    slice = intern(content);
+    // Rebuilt system prompts would otherwise pile up in the pool
+    if (garbage_bytes > tail.pool.size() / 2) compact();
+}
+
+void MessageStore::clear() {
+    *this = MessageStore();
+}
+
+MessageStore MessageStore::fork() {
+    if (!tail.roles.empty()) {
+        if (segments.size() >= kMaxSegments) flatten();
+        if (garbage_bytes > 0) compact();
+
+        auto segment = std::make_shared<Segment>();
+        segment->parent = std::move(frozen);
+        segment->offset = frozen_size;
+        segment->columns = std::move(tail);
+        tail = Columns();
+
+        frozen_size += segment->columns.size();
+        segments.push_back(segment.get());
+        frozen = std::move(segment);
+    }
+    return *this;
+}
+
+void MessageStore::compact() {
+    std::string fresh;
+    fresh.reserve(tail.pool.size() - garbage_bytes);
+    auto move = [&](Slice& slice) {
+        uint32_t offset = static_cast<uint32_t>(fresh.size());
+        fresh.append(tail.pool, slice.offset, slice.length);
+        slice.offset = offset;
+    };
+    for (auto& slice : tail.contents) move(slice);
+    for (auto& record : tail.tool_calls) {
+        move(record.id);
+        move(record.name);
+        move(record.arguments);
+    }
+    tail.pool.swap(fresh);
+    garbage_bytes = 0;
+}
+
+void MessageStore::flatten() {
+    MessageStore flat;
+    for (size_t i = 0; i < size(); ++i) {
+        flat.append((*this)[i]);
+    }
+    *this = std::move(flat);
+}
+
+json MessageStore::toJson() const {
+    json out = json::array();
+    for (size_t i = 0; i < size(); ++i) {
+        out.push_back((*this)[i].toJson());
+    }
+    return out;
+}
+
+MessageStore MessageStore::fromJson(const std::vector<json>& messages) {
+    MessageStore store;
+    for (const auto& message : messages) {
+        store.appendJson(message);
+    }
+    return store;
+}
+
+size_t MessageStore::memoryBytes() const {
+    size_t bytes = unsharedBytes();
+    for (const Segment* segment : segments) {
+        bytes += sizeof(Segment) + segment->columns.bytes();
+    }
+    return bytes;
+}
+
+size_t MessageStore::unsharedBytes() const {
+    size_t bytes = tail.bytes() + segments.capacity() * sizeof(const Segment*) +
+                   overrides.capacity() * sizeof(overrides[0]);
+    for (const auto& [index, content] : overrides) {
+        bytes += content.capacity();
+    }
+    return bytes;
+}
@@ -0,0 +1,445 @@
+#include "PromptTemplate.hpp"
+#include "Memory.hpp"
+#include <cctype>
+#include <charconv>
+#include <ctime>
+
+namespace {
+
+const char* kDefaultHeader =
+    "You are a Letta agent. You have access to a set of tools and a memory system.\n"
+    "You must use the `send_message` tool to communicate with the user.\n"
+    "You must use the `core_memory_append` or `core_memory_replace` tools to update your memory when you learn new facts.\n\n";
+
+const char* kSleepTimeHeader =
+    "You are a Letta agent. You have access to a set of tools and a memory system.\n"
+    "You must use the `send_message` tool to communicate with the user.\n"
+    "Your memory is updated in the background between turns; you do not need to edit it.\n\n";
+
+const char* kMemorySection =
+    "### Memory Blocks\n"
+    "{% for block in blocks %}"
+    "Block '{{ block.label }}' ({{ block.length }}/{{ block.limit }} chars):\n"
+    "{{ block.value }}\n\n"
+    "{% endfor %}";
+
+// Same ~4 bytes/token heuristic as the scheduler's admission estimate
+int64_t estimateTokens(size_t chars) {
+    return static_cast<int64_t>((chars + 3) / 4);
+}
+
+bool isSpace(char c) {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+} // namespace
+
+class TemplateCompiler {
+public:
+    using Field = PromptTemplate::Field;
+    using Op = PromptTemplate::Op;
+    using Condition = PromptTemplate::Condition;
+
+    TemplateCompiler(std::string_view source, PromptTemplate& out) : source(source), out(out) {}
+
+    void run() {
+        bool trim_leading = false;
+        while (pos < source.size()) {
+            size_t open = findTag(pos);
+            std::string_view text = source.substr(pos, open - pos);
+            if (trim_leading) {
+                while (!text.empty() && isSpace(text.front())) text.remove_prefix(1);
+            }
+            if (open < source.size() && open + 2 < source.size() && source[open + 2] == '-') {
+                while (!text.empty() && isSpace(text.back())) text.remove_suffix(1);
+            }
+            emitText(text);
+            advanceLines(source.substr(pos, open - pos));
+            if (open >= source.size()) break;
+
+            char kind = source[open + 1];
+            const char* close = kind == '{' ? "}}" : kind == '%' ? "%}" : "#}";
+            size_t end = source.find(close, open + 2);
+            if (end == std::string_view::npos) fail("unterminated tag");
+
+            std::string_view body = source.substr(open + 2, end - open - 2);
+            if (!body.empty() && body.front() == '-') body.remove_prefix(1);
+            trim_leading = !body.empty() && body.back() == '-';
+            if (trim_leading) body.remove_suffix(1);
+
+            if (kind == '{') {
+                text_open = false;
+                expression(body);
+            } else if (kind == '%') {
+                text_open = false;
+                statement(body);
+            }
+            advanceLines(source.substr(open, end + 2 - open));
+            pos = end + 2;
+        }
+        if (!open_blocks.empty()) {
+            line = open_blocks.back().line;
+            fail(open_blocks.back().kind == Open::For ? "unclosed {% for %}" : "unclosed {% if %}");
+        }
+    }
+
+private:
+    struct Open {
+        enum Kind { If, For } kind;
+        int line;
+        uint32_t start = 0;              // ForBegin index
+        int64_t branch_jump = -1;        // pending JumpIfFalse of the current if-branch
+        std::vector<uint32_t> end_jumps; // Jumps to patch with the endif position
+        bool seen_else = false;
+    };
+
+    std::string_view source;
+    PromptTemplate& out;
+    size_t pos = 0;
+    int line = 1;
+    std::vector<Open> open_blocks;
+    std::string loop_var; // empty outside a loop
+    bool text_open = false; // last instruction is Text and nothing may jump past it
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw TemplateError("template line " + std::to_string(line) + ": " + message);
+    }
+
+    size_t findTag(size_t from) const {
+        for (size_t i = source.find('{', from); i != std::string_view::npos; i = source.find('{', i + 1)) {
+            if (i + 1 < source.size() && (source[i + 1] == '{' || source[i + 1] == '%' || source[i + 1] == '#')) {
+                return i;
+            }
+        }
+        return source.size();
+    }
+
+    void advanceLines(std::string_view text) {
+        for (char c : text) line += c == '\n';
+    }
+
+    uint32_t here() const { return static_cast<uint32_t>(out.program.size()); }
+
+    void emit(Op op, uint32_t a = 0, uint32_t b = 0) {
+        out.program.push_back(PromptTemplate::Instruction{op, a, b});
+    }
+
+    void emitText(std::string_view text) {
+        if (text.empty()) return;
+        // Literals separated only by a comment become one instruction. Not
+        // across other tags: a jump may target the position after them.
+        if (text_open) {
+            out.literals.append(text);
+            out.program.back().b += static_cast<uint32_t>(text.size());
+            return;
+        }
+        emit(Op::Text, static_cast<uint32_t>(out.literals.size()), static_cast<uint32_t>(text.size()));
+        out.literals.append(text);
+        text_open = true;
+    }
+
+    static std::vector<std::string> tokenize(std::string_view body) {
+        std::vector<std::string> tokens;
+        size_t i = 0;
+        while (i < body.size()) {
+            char c = body[i];
+            if (isSpace(c)) {
+                ++i;
+            } else if (c == '"' || c == '\'') {
+                size_t end = body.find(c, i + 1);
+                if (end == std::string_view::npos) end = body.size();
+                tokens.emplace_back(body.substr(i, end + 1 - i));
+                i = end + 1;
+            } else if (c == '=' || c == '!' || c == '<' || c == '>') {
+                size_t n = i + 1 < body.size() && body[i + 1] == '=' ? 2 : 1;
+                tokens.emplace_back(body.substr(i, n));
+                i += n;
+            } else {
+                size_t start = i;
+                while (i < body.size() && !isSpace(body[i]) && body[i] != '=' && body[i] != '!' &&
+                       body[i] != '<' && body[i] != '>') {
+                    ++i;
+                }
+                tokens.emplace_back(body.substr(start, i - start));
+            }
+        }
+        return tokens;
+    }
+
+    Field resolve(const std::string& name) {
+        if (name == "block_count") return Field::BlockCount;
+        if (name == "total_chars") { out.uses_totals = true; return Field::TotalChars; }
+        if (name == "total_tokens") { out.uses_totals = true; return Field::TotalTokens; }
+        if (name == "now") { out.uses_now = true; return Field::Now; }
+        if (!loop_var.empty()) {
+            if (name == loop_var + ".label") return Field::BlockLabel;
+            if (name == loop_var + ".value") return Field::BlockValue;
+            if (name == loop_var + ".length") return Field::BlockLength;
+            if (name == loop_var + ".limit") return Field::BlockLimit;
+            if (name == loop_var + ".tokens") return Field::BlockTokens;
+            if (name == loop_var + ".read_only") return Field::BlockReadOnly;
+            if (name == "loop.index") return Field::LoopIndex;
+            if (name == "loop.first") return Field::LoopFirst;
+            if (name == "loop.last") return Field::LoopLast;
+        }
+        fail("unknown name '" + name + "'");
+    }
+
+    void expression(std::string_view body) {
+        std::vector<std::string> tokens = tokenize(body);
+        if (tokens.size() != 1) fail("expected a single name in {{ }}");
+        emit(Op::Emit, static_cast<uint32_t>(resolve(tokens[0])));
+    }
+
+    uint32_t condition(const std::vector<std::string>& tokens, size_t first) {
+        Condition cond;
+        size_t i = first;
+        if (i < tokens.size() && tokens[i] == "not") {
+            cond.negate = true;
+            ++i;
+        }
+        if (i >= tokens.size()) fail("missing condition");
+        cond.field = resolve(tokens[i++]);
+        if (i < tokens.size()) {
+            static const std::pair<const char*, Condition::Compare> ops[] = {
+                {"==", Condition::Compare::Eq}, {"!=", Condition::Compare::Ne}, {"<", Condition::Compare::Lt},
+                {"<=", Condition::Compare::Le}, {">", Condition::Compare::Gt}, {">=", Condition::Compare::Ge}};
+            bool known = false;
+            for (const auto& [text, compare] : ops) {
+                if (tokens[i] == text) {
+                    cond.compare = compare;
+                    known = true;
+                }
+            }
+            if (!known || i + 2 != tokens.size()) fail("expected `name <op> literal`");
+            const std::string& literal = tokens[i + 1];
+            if (literal.size() >= 2 && (literal.front() == '"' || literal.front() == '\'') && literal.back() == literal.front()) {
+                cond.text = literal.substr(1, literal.size() - 2);
+            } else {
+                auto result = std::from_chars(literal.data(), literal.data() + literal.size(), cond.number);
+                if (result.ec != std::errc() || result.ptr != literal.data() + literal.size()) {
+                    fail("bad literal " + literal);
+                }
+                cond.numeric = true;
+            }
+        }
+        out.conditions.push_back(std::move(cond));
+        return static_cast<uint32_t>(out.conditions.size() - 1);
+    }
+
+    void statement(std::string_view body) {
+        std::vector<std::string> tokens = tokenize(body);
+        if (tokens.empty()) fail("empty {% %}");
+        const std::string& keyword = tokens[0];
+
+        if (keyword == "for") {
+            if (tokens.size() != 4 || tokens[2] != "in" || tokens[3] != "blocks") fail("expected {% for <name> in blocks %}");
+            if (!loop_var.empty()) fail("nested loops are not supported");
+            loop_var = tokens[1];
+            open_blocks.push_back(Open{Open::For, line, here(), -1, {}, false});
+            emit(Op::ForBegin);
+        } else if (keyword == "endfor") {
+            if (open_blocks.empty() || open_blocks.back().kind != Open::For) fail("{% endfor %} without {% for %}");
+            uint32_t start = open_blocks.back().start;
+            emit(Op::ForEnd, 0, start + 1);
+            out.program[start].b = here();
+            open_blocks.pop_back();
+            loop_var.clear();
+        } else if (keyword == "if") {
+            open_blocks.push_back(Open{Open::If, line, 0, here(), {}, false});
+            emit(Op::JumpIfFalse, condition(tokens, 1));
+        } else if (keyword == "elif" || keyword == "else") {
+            if (open_blocks.empty() || open_blocks.back().kind != Open::If || open_blocks.back().seen_else) {
+                fail("{% " + keyword + " %} without {% if %}");
+            }
+            Open& block = open_blocks.back();
+            block.end_jumps.push_back(here());
+            emit(Op::Jump);
+            out.program[block.branch_jump].b = here();
+            if (keyword == "elif") {
+                block.branch_jump = here();
+                emit(Op::JumpIfFalse, condition(tokens, 1));
+            } else {
+                if (tokens.size() != 1) fail("unexpected tokens after else");
+                block.branch_jump = -1;
+                block.seen_else = true;
+            }
+        } else if (keyword == "endif") {
+            if (open_blocks.empty() || open_blocks.back().kind != Open::If) fail("{% endif %} without {% if %}");
+            Open& block = open_blocks.back();
+            if (block.branch_jump >= 0) out.program[block.branch_jump].b = here();
+            for (uint32_t jump : block.end_jumps) out.program[jump].b = here();
+            open_blocks.pop_back();
+        } else {
+            fail("unknown statement '" + keyword + "'");
+        }
+    }
+};
+
+class TemplateRenderer {
+public:
+    using Field = PromptTemplate::Field;
+    using Op = PromptTemplate::Op;
+    using Condition = PromptTemplate::Condition;
+
+    TemplateRenderer(const PromptTemplate& tmpl, const PromptContext& context, std::string& out)
+        : tmpl(tmpl), context(context), out(out) {
+        if (tmpl.uses_totals) {
+            for (const MemoryBlock* block : context.blocks) total_chars += block->value.size();
+        }
+    }
+
+    void run() {
+        const auto& program = tmpl.program;
+        size_t pc = 0;
+        while (pc < program.size()) {
+            const auto& ins = program[pc];
+            switch (ins.op) {
+                case Op::Text:
+                    out.append(tmpl.literals, ins.a, ins.b);
+                    break;
+                case Op::Emit:
+                    emit(static_cast<Field>(ins.a), out);
+                    break;
+                case Op::JumpIfFalse:
+                    if (!test(tmpl.conditions[ins.a])) {
+                        pc = ins.b;
+                        continue;
+                    }
+                    break;
+                case Op::Jump:
+                    pc = ins.b;
+                    continue;
+                case Op::ForBegin:
+                    if (context.blocks.empty()) {
+                        pc = ins.b;
+                        continue;
+                    }
+                    index = 0;
+                    break;
+                case Op::ForEnd:
+                    if (++index < context.blocks.size()) {
+                        pc = ins.b;
+                        continue;
+                    }
+                    break;
+            }
+            ++pc;
+        }
+    }
+
+private:
+    const PromptTemplate& tmpl;
+    const PromptContext& context;
+    std::string& out;
+    size_t index = 0;
+    size_t total_chars = 0;
+
+    const MemoryBlock& block() const { return *context.blocks[index]; }
+
+    static bool numeric(Field field) {
+        return field != Field::BlockLabel && field != Field::BlockValue && field != Field::Now;
+    }
+
+    int64_t number(Field field) const {
+        switch (field) {
+            case Field::BlockLength: return static_cast<int64_t>(block().value.size());
+            case Field::BlockLimit: return block().limit;
+            case Field::BlockTokens: return estimateTokens(block().value.size());
+            case Field::BlockReadOnly: return block().read_only;
+            case Field::LoopIndex: return static_cast<int64_t>(index + 1);
+            case Field::LoopFirst: return index == 0;
+            case Field::LoopLast: return index + 1 == context.blocks.size();
+            case Field::BlockCount: return static_cast<int64_t>(context.blocks.size());
+            case Field::TotalChars: return static_cast<int64_t>(total_chars);
+            case Field::TotalTokens: return estimateTokens(total_chars);
+            default: return 0;
+        }
+    }
+
+    void appendNow(std::string& target) const {
+        std::time_t t = std::chrono::system_clock::to_time_t(context.now);
+        std::tm tm{};
+        gmtime_r(&t, &tm);
+        char buffer[32];
+        size_t n = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        target.append(buffer, n);
+    }
+
+    void emit(Field field, std::string& target) const {
+        switch (field) {
+            case Field::BlockLabel: target += block().label; return;
+            case Field::BlockValue: block().value.appendTo(target); return;
+            case Field::Now: appendNow(target); return;
+            case Field::BlockReadOnly:
+            case Field::LoopFirst:
+            case Field::LoopLast:
+                target += number(field) ? "true" : "false";
+                return;
+            default: {
+                char buffer[24];
+                auto result = std::to_chars(buffer, buffer + sizeof(buffer), number(field));
+                target.append(buffer, result.ptr);
+            }
+        }
+    }
+
+    std::string text(Field field) const {
+        std::string s;
+        emit(field, s);
+        return s;
+    }
+
+    bool test(const Condition& cond) const {
+        bool result;
+        if (cond.compare == Condition::Compare::Truthy) {
+            if (numeric(cond.field)) result = number(cond.field) != 0;
+            else if (cond.field == Field::BlockValue) result = !block().value.empty();
+            else if (cond.field == Field::BlockLabel) result = !block().label.empty();
+            else result = true;
+        } else {
+            int order;
+            if (cond.numeric && numeric(cond.field)) {
+                int64_t v = number(cond.field);
+                order = v < cond.number ? -1 : v > cond.number ? 1 : 0;
+            } else if (cond.field == Field::BlockValue && (cond.compare == Condition::Compare::Eq ||
+                                                          cond.compare == Condition::Compare::Ne)) {
+                order = block().value == cond.text ? 0 : 1;
+            } else {
+                std::string lhs = text(cond.field);
+                std::string rhs = cond.numeric ? std::to_string(cond.number) : cond.text;
+                order = lhs.compare(rhs);
+                order = order < 0 ? -1 : order > 0 ? 1 : 0;
+            }
+            switch (cond.compare) {
+                case Condition::Compare::Eq: result = order == 0; break;
+                case Condition::Compare::Ne: result = order != 0; break;
+                case Condition::Compare::Lt: result = order < 0; break;
+                case Condition::Compare::Le: result = order <= 0; break;
+                case Condition::Compare::Gt: result = order > 0; break;
+                default: result = order >= 0; break;
+            }
+        }
+        return cond.negate ? !result : result;
+    }
+};
+
+std::shared_ptr<const PromptTemplate> PromptTemplate::compile(std::string_view source) {
+    auto tmpl = std::make_shared<PromptTemplate>();
+    TemplateCompiler(source, *tmpl).run();
+    return tmpl;
+}
+
+std::shared_ptr<const PromptTemplate> PromptTemplate::defaultTemplate() {
+    static const std::shared_ptr<const PromptTemplate> tmpl = compile(std::string(kDefaultHeader) + kMemorySection);
+    return tmpl;
+}
+
+std::shared_ptr<const PromptTemplate> PromptTemplate::sleepTimeTemplate() {
+    static const std::shared_ptr<const PromptTemplate> tmpl = compile(std::string(kSleepTimeHeader) + kMemorySection);
+    return tmpl;
+}
+
+void PromptTemplate::render(const PromptContext& context, std::string& out) const {
+    TemplateRenderer(*this, context, out).run();
+}
@@ -0,0 +1,125 @@
+#include "Rcu.hpp"
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// One per thread that has ever read; reused after the thread exits
+struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> epoch{0}; // 0: not in a critical section
+    std::atomic<bool> in_use{true};
+    ReaderSlot* next = nullptr;
+};
+
+struct Retired {
+    void* object;
+    void (*deleter)(void*);
+    uint64_t epoch;
+};
+
+std::atomic<uint64_t> global_epoch{1};
+std::atomic<ReaderSlot*> slots{nullptr};
+
+std::mutex& retiredMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<Retired>& retiredList() {
+    static std::vector<Retired> list;
+    return list;
+}
+
+ReaderSlot* acquireSlot() {
+    for (ReaderSlot* slot = slots.load(); slot; slot = slot->next) {
+        bool expected = false;
+        if (!slot->in_use.load(std::memory_order_relaxed) && slot->in_use.compare_exchange_strong(expected, true)) {
+            return slot;
+        }
+    }
+    // Slots are never freed, so the list can be walked without synchronisation
+    auto* slot = new ReaderSlot();
+    slot->next = slots.load();
+    while (!slots.compare_exchange_weak(slot->next, slot)) {}
+    return slot;
+}
+
+struct ThreadSlot {
+    ReaderSlot* slot = acquireSlot();
+    int depth = 0;
+    ~ThreadSlot() { slot->in_use.store(false); }
+};
+
+ThreadSlot& threadSlot() {
+    thread_local ThreadSlot holder;
+    return holder;
+}
+
+// Oldest epoch any reader may still be using
+uint64_t oldestActiveEpoch() {
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (ReaderSlot* slot = slots.load(); slot; slot = slot->next) {
+        uint64_t epoch = slot->epoch.load();
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+    return oldest;
+}
+
+} // namespace
+
+Rcu::ReadGuard::ReadGuard() {
+    ThreadSlot& holder = threadSlot();
+    if (holder.depth++ == 0) {
+        // seq_cst: the announcement must be visible before the protected load
+        holder.slot->epoch.store(global_epoch.load());
+    }
+}
+
+Rcu::ReadGuard::~ReadGuard() {
+    ThreadSlot& holder = threadSlot();
+    if (--holder.depth == 0) {
+        holder.slot->epoch.store(0, std::memory_order_release);
+    }
+}
+
+void Rcu::retire(void* object, void (*deleter)(void*)) {
+    // Readers that announced an epoch after this bump cannot see the object
+    uint64_t epoch = global_epoch.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(retiredMutex());
+        retiredList().push_back(Retired{object, deleter, epoch});
+    }
+    reclaim();
+}
+
+size_t Rcu::reclaim() {
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> lock(retiredMutex());
+        uint64_t oldest = oldestActiveEpoch();
+        auto& list = retiredList();
+        size_t kept = 0;
+        for (auto& r : list) {
+            if (r.epoch < oldest) ready.push_back(r);
+            else list[kept++] = r;
+        }
+        list.resize(kept);
+    }
+    for (auto& r : ready) r.deleter(r.object);
+    return ready.size();
+}
+
+void Rcu::synchronize() {
+    while (pending() > 0) {
+        if (reclaim() == 0) std::this_thread::yield();
+    }
+}
+
+size_t Rcu::pending() {
+    std::lock_guard<std::mutex> lock(retiredMutex());
+    return retiredList().size();
+}
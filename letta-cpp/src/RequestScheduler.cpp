@@ -0,0 +1,195 @@
+#include "RequestScheduler.hpp"
+#include <algorithm>
+
+namespace {
+// Upper bound on a single wait so cancellation is noticed promptly
+constexpr auto kMaxWaitSlice = std::chrono::milliseconds(50);
+}
+
+RequestScheduler& RequestScheduler::global() {
+    static RequestScheduler instance;
+    return instance;
+}
+
+void RequestScheduler::TokenBucket::refill(Clock::time_point now) {
+    if (!limited()) return;
+    double elapsed = std::chrono::duration<double>(now - last).count();
+    if (elapsed > 0) {
+        level = std::min(capacity, level + elapsed * rate_per_sec);
+        last = now;
+    }
+}
+
+RequestScheduler::Clock::duration RequestScheduler::TokenBucket::timeUntil(double amount) const {
+    if (!limited() || level >= amount) return Clock::duration::zero();
+    double seconds = (amount - level) / rate_per_sec;
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+void RequestScheduler::setLimits(const std::string& model, const RateLimits& limits) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = Clock::now();
+    ModelState& state = models[model];
+
+    auto configure = [&](TokenBucket& bucket, double per_minute) {
+        bucket.capacity = per_minute > 0 ? std::max(1.0, per_minute * limits.burst_fraction) : 0;
+        bucket.rate_per_sec = per_minute / 60.0;
+        bucket.level = bucket.capacity;
+        bucket.last = now;
+    };
+    configure(state.requests, limits.requests_per_minute);
+    configure(state.tokens, limits.tokens_per_minute);
+    cv.notify_all();
+}
+
+void RequestScheduler::setBatchAging(std::chrono::milliseconds aging) {
+    std::lock_guard<std::mutex> lock(mutex);
+    batch_aging = aging;
+}
+
+void RequestScheduler::enqueue(ModelState& state, Waiter* waiter) {
+    int cls = static_cast<int>(waiter->priority);
+    auto& queue = state.queues[cls][waiter->agent_id];
+    if (queue.empty()) {
+        state.round_robin[cls].push_back(waiter->agent_id);
+    }
+    queue.push_back(waiter);
+}
+
+void RequestScheduler::remove(ModelState& state, Waiter* waiter) {
+    int cls = static_cast<int>(waiter->priority);
+    auto it = state.queues[cls].find(waiter->agent_id);
+    if (it == state.queues[cls].end()) return;
+
+    auto& queue = it->second;
+    queue.erase(std::remove(queue.begin(), queue.end(), waiter), queue.end());
+    if (queue.empty()) {
+        state.queues[cls].erase(it);
+        auto& rr = state.round_robin[cls];
+        rr.erase(std::remove(rr.begin(), rr.end(), waiter->agent_id), rr.end());
+    }
+}
+
+int RequestScheduler::nextClass(const ModelState& state, Clock::time_point now) const {
+    const int interactive = static_cast<int>(RequestPriority::Interactive);
+    const int batch = static_cast<int>(RequestPriority::Batch);
+
+    if (!state.round_robin[batch].empty()) {
+        // Aging: a batch request that has waited too long jumps the queue
+        const std::string& agent = state.round_robin[batch].front();
+        const Waiter* head = state.queues[batch].at(agent).front();
+        if (now - head->enqueued >= batch_aging || state.round_robin[interactive].empty()) {
+            return batch;
+        }
+    }
+    return state.round_robin[interactive].empty() ? -1 : interactive;
+}
+
+RequestScheduler::Clock::time_point RequestScheduler::dispatch(ModelState& state, Clock::time_point now) {
+    state.requests.refill(now);
+    state.tokens.refill(now);
+
+    while (true) {
+        int cls = nextClass(state, now);
+        if (cls < 0) return now + kMaxWaitSlice;
+
+        if (now < state.paused_until) return state.paused_until;
+
+        std::string agent = state.round_robin[cls].front();
+        auto& queue = state.queues[cls][agent];
+        Waiter* head = queue.front();
+
+        // Head-of-line blocking is deliberate: letting smaller requests skip
+        // ahead would break both priority and per-agent fairness.
+        double need_tokens = std::min(head->tokens, state.tokens.capacity);
+        auto wait = std::max(state.requests.timeUntil(1.0), state.tokens.timeUntil(need_tokens));
+        if (wait > Clock::duration::zero()) return now + wait;
+
+        if (state.requests.limited()) state.requests.level -= 1.0;
+        if (state.tokens.limited()) state.tokens.level -= need_tokens;
+
+        queue.pop_front();
+        state.round_robin[cls].pop_front();
+        if (queue.empty()) {
+            state.queues[cls].erase(agent);
+        } else {
+            state.round_robin[cls].push_back(agent);
+        }
+
+        head->admitted = true;
+        if (head->priority == RequestPriority::Interactive) counters.admitted_interactive++;
+        else counters.admitted_batch++;
+        counters.total_wait_ms += std::chrono::duration<double, std::milli>(now - head->enqueued).count();
+        cv.notify_all();
+    }
+}
+
+bool RequestScheduler::acquire(const std::string& model, const std::string& agent_id, RequestPriority priority,
+                               uint64_t estimated_tokens, const std::atomic<bool>* cancelled) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ModelState& state = models[model];
+    auto now = Clock::now();
+
+    // Fast path: no quota configured and nobody paused or queued
+    if (!state.limited() && state.idle() && now >= state.paused_until) {
+        if (priority == RequestPriority::Interactive) counters.admitted_interactive++;
+        else counters.admitted_batch++;
+        return true;
+    }
+
+    Waiter waiter{agent_id, priority, static_cast<double>(estimated_tokens), now};
+    enqueue(state, &waiter);
+    counters.queued++;
+
+    while (true) {
+        auto wake = dispatch(state, Clock::now());
+        if (waiter.admitted) break;
+
+        if (cancelled && cancelled->load()) {
+            remove(state, &waiter);
+            counters.cancelled++;
+            counters.queued--;
+            // Our departure may unblock the next waiter in line
+            dispatch(state, Clock::now());
+            return false;
+        }
+        cv.wait_until(lock, std::min(wake, Clock::now() + kMaxWaitSlice));
+        if (waiter.admitted) break;
+    }
+    counters.queued--;
+    return true;
+}
+
+void RequestScheduler::interrupt() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cv.notify_all();
+}
+
+void RequestScheduler::reconcile(const std::string& model, uint64_t estimated_tokens, uint64_t actual_tokens) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = models.find(model);
+    if (it == models.end() || !it->second.tokens.limited()) return;
+
+    TokenBucket& bucket = it->second.tokens;
+    bucket.refill(Clock::now());
+    double charged = std::min(static_cast<double>(estimated_tokens), bucket.capacity);
+    // Under-estimates go into debt (negative level) so later requests wait
+    bucket.level = std::min(bucket.capacity, bucket.level + charged - static_cast<double>(actual_tokens));
+    cv.notify_all();
+}
+
+void RequestScheduler::backoff(const std::string& model, std::chrono::milliseconds retry_after) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ModelState& state = models[model];
+    auto now = Clock::now();
+    state.paused_until = std::max(state.paused_until, now + retry_after);
+    // Resume gently rather than with a full burst
+    state.requests.refill(now);
+    state.requests.level = std::min(state.requests.level, 1.0);
+    counters.rate_limited++;
+}
+
+RequestScheduler::Stats RequestScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
@@ -0,0 +1,304 @@
+#include "Rope.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using NodePtr = Rope::NodePtr;
+using Node = Rope::Node;
+
+namespace {
+
+// Chunks are built at the target size; small appends merge into the last
+// chunk until it reaches the maximum.
+constexpr size_t kLeafTarget = 1024;
+constexpr size_t kLeafMax = 2048;
+
+size_t lengthOf(const NodePtr& node) { return node ? node->length : 0; }
+int heightOf(const NodePtr& node) { return node ? node->height : 0; }
+
+NodePtr makeLeaf(std::string_view text) {
+    if (text.empty()) return nullptr;
+    auto node = std::make_shared<Node>();
+    node->text.assign(text.data(), text.size());
+    node->length = text.size();
+    return node;
+}
+
+NodePtr makeNode(NodePtr left, NodePtr right) {
+    auto node = std::make_shared<Node>();
+    node->length = left->length + right->length;
+    node->height = std::max(left->height, right->height) + 1;
+    node->left = std::move(left);
+    node->right = std::move(right);
+    return node;
+}
+
+// Join two trees whose heights differ by at most two, rotating to restore
+// the AVL invariant
+NodePtr balance(const NodePtr& a, const NodePtr& b) {
+    if (heightOf(a) > heightOf(b) + 1) {
+        if (heightOf(a->left) >= heightOf(a->right)) {
+            return makeNode(a->left, makeNode(a->right, b));
+        }
+        return makeNode(makeNode(a->left, a->right->left), makeNode(a->right->right, b));
+    }
+    if (heightOf(b) > heightOf(a) + 1) {
+        if (heightOf(b->right) >= heightOf(b->left)) {
+            return makeNode(makeNode(a, b->left), b->right);
+        }
+        return makeNode(makeNode(a, b->left->left), makeNode(b->left->right, b->right));
+    }
+    return makeNode(a, b);
+}
+
+// AVL join: walk down the spine of the taller tree, O(|height difference|)
+NodePtr join(const NodePtr& a, const NodePtr& b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (a->height > b->height + 1) return balance(a->left, join(a->right, b));
+    if (b->height > a->height + 1) return balance(join(a, b->left), b->right);
+    return makeNode(a, b);
+}
+
+const Node* rightmost(const NodePtr& node) {
+    const Node* n = node.get();
+    while (!n->leaf()) n = n->right.get();
+    return n;
+}
+
+const Node* leftmost(const NodePtr& node) {
+    const Node* n = node.get();
+    while (!n->leaf()) n = n->left.get();
+    return n;
+}
+
+// Path-copy the rightmost/leftmost leaf with `text` added to it
+NodePtr extendRight(const NodePtr& node, std::string_view text) {
+    if (node->leaf()) return makeLeaf(node->text + std::string(text));
+    return makeNode(node->left, extendRight(node->right, text));
+}
+
+NodePtr extendLeft(const NodePtr& node, std::string_view text) {
+    if (node->leaf()) return makeLeaf(std::string(text) + node->text);
+    return makeNode(extendLeft(node->left, text), node->right);
+}
+
+// join() that folds a small leaf into its neighbour, so streams of short
+// appends do not degrade into one node per edit
+NodePtr concat(const NodePtr& a, const NodePtr& b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (b->leaf() && rightmost(a)->length + b->length <= kLeafMax) return extendRight(a, b->text);
+    if (a->leaf() && leftmost(b)->length + a->length <= kLeafMax) return extendLeft(b, a->text);
+    return join(a, b);
+}
+
+std::pair<NodePtr, NodePtr> split(const NodePtr& node, size_t pos) {
+    if (!node) return {nullptr, nullptr};
+    if (pos == 0) return {nullptr, node};
+    if (pos >= node->length) return {node, nullptr};
+    if (node->leaf()) {
+        std::string_view text(node->text);
+        return {makeLeaf(text.substr(0, pos)), makeLeaf(text.substr(pos))};
+    }
+    size_t left_length = node->left->length;
+    if (pos < left_length) {
+        auto [a, b] = split(node->left, pos);
+        return {a, concat(b, node->right)};
+    }
+    if (pos > left_length) {
+        auto [a, b] = split(node->right, pos - left_length);
+        return {concat(node->left, a), b};
+    }
+    return {node->left, node->right};
+}
+
+// Balanced tree over `text` in kLeafTarget chunks
+NodePtr build(std::string_view text) {
+    if (text.size() <= kLeafMax) return makeLeaf(text);
+    size_t chunks = (text.size() + kLeafTarget - 1) / kLeafTarget;
+    size_t mid = (chunks / 2) * kLeafTarget;
+    return makeNode(build(text.substr(0, mid)), build(text.substr(mid)));
+}
+
+size_t countLeaves(const Node* node) {
+    if (!node) return 0;
+    if (node->leaf()) return 1;
+    return countLeaves(node->left.get()) + countLeaves(node->right.get());
+}
+
+// First occurrence of needle (m >= 2) in haystack. SSE2 version of the
+// "first and last byte" filter: compare 16 candidate positions at once against
+// the needle's first and last bytes and only memcmp where both match.
+size_t findInChunk(const char* hay, size_t n, const char* needle, size_t m) {
+    if (m > n) return Rope::npos;
+    size_t i = 0;
+    const size_t last = n - m; // last valid start
+#if defined(__SSE2__)
+    const __m128i first_byte = _mm_set1_epi8(needle[0]);
+    const __m128i last_byte = _mm_set1_epi8(needle[m - 1]);
+    for (; i + 16 <= last + 1; i += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first_byte), _mm_cmpeq_epi8(block_last, last_byte))));
+        while (mask) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (std::memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i <= last; ++i) {
+        const void* hit = std::memchr(hay + i, needle[0], last - i + 1);
+        if (!hit) return Rope::npos;
+        i = static_cast<const char*>(hit) - hay;
+        if (std::memcmp(hay + i + 1, needle + 1, m - 1) == 0) return i;
+    }
+    return Rope::npos;
+}
+
+size_t findInChunk(std::string_view hay, std::string_view needle) {
+    if (needle.size() == 1) {
+        const void* hit = std::memchr(hay.data(), needle[0], hay.size());
+        return hit ? static_cast<const char*>(hit) - hay.data() : Rope::npos;
+    }
+    return findInChunk(hay.data(), hay.size(), needle.data(), needle.size());
+}
+
+} // namespace
+
+Rope::Rope(std::string_view text) : root(build(text)) {}
+
+size_t Rope::size() const {
+    return lengthOf(root);
+}
+
+void Rope::append(std::string_view text) {
+    root = concat(root, build(text));
+}
+
+void Rope::insert(size_t pos, std::string_view text) {
+    auto [a, b] = split(root, std::min(pos, size()));
+    root = concat(concat(a, build(text)), b);
+}
+
+void Rope::erase(size_t pos, size_t count) {
+    replace(pos, count, {});
+}
+
+void Rope::replace(size_t pos, size_t count, std::string_view text) {
+    pos = std::min(pos, size());
+    count = std::min(count, size() - pos);
+    auto [a, rest] = split(root, pos);
+    auto [removed, b] = split(rest, count);
+    root = concat(concat(a, build(text)), b);
+}
+
+size_t Rope::find(std::string_view needle, size_t from) const {
+    size_t total = size();
+    if (from > total) return npos;
+    if (needle.empty()) return from;
+    if (needle.size() > total - from) return npos;
+
+    const size_t m = needle.size();
+    size_t offset = 0;       // absolute position of the current chunk
+    std::string carry;       // last m-1 bytes before the current chunk
+    size_t carry_start = 0;  // absolute position of carry[0]
+    size_t found = npos;
+
+    forEachChunk([&](std::string_view chunk) {
+        if (found != npos) return;
+        size_t chunk_start = offset;
+        offset += chunk.size();
+        if (offset <= from) return;
+        if (chunk_start < from) {
+            chunk.remove_prefix(from - chunk_start);
+            chunk_start = from;
+        }
+
+        // Matches straddling the previous boundary start inside `carry`
+        if (!carry.empty()) {
+            std::string window = carry;
+            window.append(chunk.substr(0, m - 1));
+            size_t hit = window.find(needle);
+            if (hit != std::string::npos && hit < carry.size()) {
+                found = carry_start + hit;
+                return;
+            }
+        }
+
+        size_t hit = findInChunk(chunk, needle);
+        if (hit != npos) {
+            found = chunk_start + hit;
+            return;
+        }
+
+        carry.append(chunk);
+        if (carry.size() > m - 1) carry.erase(0, carry.size() - (m - 1));
+        carry_start = offset - carry.size();
+    });
+    return found;
+}
+
+std::string Rope::substr(size_t pos, size_t count) const {
+    pos = std::min(pos, size());
+    count = std::min(count, size() - pos);
+    std::string out;
+    out.reserve(count);
+    size_t offset = 0;
+    forEachChunk([&](std::string_view chunk) {
+        size_t chunk_start = offset;
+        offset += chunk.size();
+        if (offset <= pos || chunk_start >= pos + count) return;
+        size_t begin = pos > chunk_start ? pos - chunk_start : 0;
+        size_t end = std::min(chunk.size(), pos + count - chunk_start);
+        out.append(chunk.substr(begin, end - begin));
+    });
+    return out;
+}
+
+std::string Rope::str() const {
+    std::string out;
+    appendTo(out);
+    return out;
+}
+
+void Rope::appendTo(std::string& out) const {
+    out.reserve(out.size() + size());
+    forEachChunk([&](std::string_view chunk) { out.append(chunk); });
+}
+
+size_t Rope::chunkCount() const {
+    return countLeaves(root.get());
+}
+
+int Rope::height() const {
+    return heightOf(root);
+}
+
+bool Rope::equals(std::string_view text) const {
+    if (text.size() != size()) return false;
+    size_t offset = 0;
+    bool equal = true;
+    forEachChunk([&](std::string_view chunk) {
+        if (equal && text.compare(offset, chunk.size(), chunk) != 0) equal = false;
+        offset += chunk.size();
+    });
+    return equal;
+}
+
+bool operator==(const Rope& a, const Rope& b) {
+    if (a.root == b.root) return true;
+    return a.size() == b.size() && a.equals(b.str());
+}
+
+std::ostream& operator<<(std::ostream& os, const Rope& rope) {
+    rope.forEachChunk([&](std::string_view chunk) { os.write(chunk.data(), static_cast<std::streamsize>(chunk.size())); });
+    return os;
+}
@@ -0,0 +1,240 @@
+#include "SleepTimeAgent.hpp"
+#include "Tools.hpp"
+#include "Log.hpp"
+#include "Telemetry.hpp"
+#include "ToolSchema.hpp"
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* kInstructions =
+    "You are a background memory agent. You never talk to the user. Below is the "
+    "latest part of a conversation between the user and the assistant whose memory "
+    "you maintain. Keep the memory blocks accurate and concise: record new facts "
+    "about the user and the assistant with core_memory_append, correct outdated ones "
+    "with core_memory_replace, and do not store anything twice. Call "
+    "finish_memory_edits when memory is up to date.\n\n";
+
+// Lower the calling thread's CPU priority. Linux applies the nice value per
+// thread; elsewhere the Batch request priority is all we get.
+void lowerThreadPriority(int nice) {
+#if defined(__linux__)
+    if (nice <= 0) return;
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) != 0) {
+        LETTA_LOG_DEBUG("sleeptime", "Could not lower worker priority", {"nice", nice});
+    }
+#else
+    (void)nice;
+#endif
+}
+
+} // namespace
+
+SleepTimeAgent::SleepTimeAgent(const std::string& primary_id, const std::string& api_key, const std::string& base_url,
+                               const std::string& model, SleepTimeOptions options)
+    : id(primary_id + "/sleeptime"),
+      opts(std::move(options)),
+      llm(api_key, base_url, opts.model.empty() ? model : opts.model)
+{
+    llm.setSchedulingContext(id, RequestPriority::Batch);
+    worker = std::thread([this] { run(); });
+}
+
+SleepTimeAgent::~SleepTimeAgent() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cancel.cancel(); // a run in flight gives up at its next request
+    work_cv.notify_all();
+    idle_cv.notify_all();
+    worker.join();
+}
+
+void SleepTimeAgent::attachBlock(std::shared_ptr<SharedBlock> block) {
+    memory.attachShared(std::move(block));
+}
+
+void SleepTimeAgent::replaceBlocks(std::vector<std::shared_ptr<SharedBlock>> blocks) {
+    std::unique_lock<std::mutex> lock(mutex);
+    pending.clear();
+    // The worker only touches `memory` while running, and cannot start a run
+    // while we hold the lock
+    idle_cv.wait(lock, [&] { return stopping || !running; });
+    for (const auto& block : memory.getBlocks()) memory.removeBlock(block.label);
+    for (auto& block : blocks) memory.attachShared(std::move(block));
+    idle_cv.notify_all();
+}
+
+void SleepTimeAgent::submit(const MessageStore& messages, size_t from) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = from; i < messages.size(); ++i) {
+            if (messages[i].role() != MessageRole::System) pending.append(messages[i]);
+        }
+    }
+    work_cv.notify_one();
+}
+
+void SleepTimeAgent::primaryBusy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    primary_busy = true;
+}
+
+void SleepTimeAgent::primaryIdle() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        primary_busy = false;
+    }
+    work_cv.notify_one();
+}
+
+void SleepTimeAgent::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_cv.wait(lock, [&] {
+        return stopping || (!running && (primary_busy || pending.size() < opts.min_new_messages));
+    });
+}
+
+void SleepTimeAgent::run() {
+    lowerThreadPriority(opts.nice);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        work_cv.wait(lock, [&] {
+            return stopping || (!primary_busy && !pending.empty() && pending.size() >= opts.min_new_messages);
+        });
+        if (stopping) return;
+
+        // Take the whole queue; the primary keeps appending to a fresh one
+        MessageStore transcript = std::move(pending);
+        pending.clear();
+        running = true;
+        lock.unlock();
+
+        try {
+            consolidate(transcript);
+        } catch (const std::exception& e) {
+            LETTA_LOG_ERROR("sleeptime", "Consolidation failed", {"agent", id}, {"error", e.what()});
+        }
+
+        lock.lock();
+        running = false;
+        idle_cv.notify_all();
+    }
+}
+
+void SleepTimeAgent::consolidate(const MessageStore& transcript) {
+    ScopedSpan span("sleeptime.consolidate");
+    span.setAttribute("agent.id", id);
+    LETTA_LOG_DEBUG("sleeptime", "Consolidating", {"agent", id}, {"messages", transcript.size()});
+
+    static const std::vector<json> tools = Tools::get_memory_tools();
+    static const ToolSchemas schemas(tools);
+    MessageStore conversation;
+    std::string prompt;
+    uint64_t rendered_version = 0;
+
+    for (int step = 0; step < opts.max_steps && !cancel.cancelled(); ++step) {
+        // Edits from the previous round (or from other agents) are visible
+        if (conversation.empty() || memory.version() != rendered_version) {
+            rendered_version = memory.version();
+            prompt.assign(kInstructions);
+            memory.compileInto(prompt);
+            if (conversation.empty()) {
+                conversation.append(MessageRole::System, prompt);
+                conversation.append(MessageRole::User, renderTranscript(transcript));
+            } else {
+                conversation.setContent(0, prompt);
+            }
+        }
+
+        json response = llm.chatCompletion(conversation, tools, cancel);
+        if (cancel.cancelled()) break;
+        if (response.contains("error")) {
+            LETTA_LOG_WARN("sleeptime", "LLM error", {"agent", id}, {"error", response["error"].dump()});
+            span.setError("LLM error");
+            break;
+        }
+
+        json message = response["choices"][0]["message"];
+        conversation.appendJson(message);
+        if (!message.contains("tool_calls") || message["tool_calls"].empty()) break;
+
+        bool finished = false;
+        for (const auto& tool_call : message["tool_calls"]) {
+            std::string call_id = tool_call.value("id", "");
+            std::string name = tool_call["function"].value("name", "");
+            // Providers send the arguments as JSON text; some local servers as an object
+            json raw = tool_call["function"].value("arguments", json());
+            std::string text = raw.is_string() ? raw.get<std::string>() : raw.is_null() ? "{}" : raw.dump();
+            json args = json::parse(text, nullptr, false);
+
+            json result;
+            std::string error;
+            const ToolSchema* schema = schemas.find(name);
+            if (name == "finish_memory_edits") {
+                finished = true;
+                result = {{"status", "OK"}};
+            } else if (args.is_discarded()) {
+                result = {{"status", "ERROR"}, {"message", "Arguments are not valid JSON."}};
+            } else if (schema && !schema->validate(text, &error)) {
+                result = {{"status", "ERROR"}, {"message", "Invalid arguments for " + name + ": " + error}};
+            } else {
+                result = Tools::execute_memory_tool(memory, name, args);
+                if (result.value("status", "") == "OK") edits_applied++;
+            }
+            conversation.appendToolResult(call_id, name, result.dump());
+        }
+        if (finished) break;
+    }
+    runs_completed++;
+}
+
+std::string SleepTimeAgent::renderTranscript(const MessageStore& transcript) {
+    std::string out = "Conversation since the last consolidation:\n";
+    for (size_t i = 0; i < transcript.size(); ++i) {
+        auto message = transcript[i];
+        switch (message.role()) {
+            case MessageRole::User:
+                out += "user: ";
+                out += message.content();
+                out += "\n";
+                break;
+            case MessageRole::Assistant:
+                if (!message.content().empty()) {
+                    out += "assistant: ";
+                    out += message.content();
+                    out += "\n";
+                }
+                for (size_t c = 0; c < message.toolCallCount(); ++c) {
+                    ToolCallView call = message.toolCall(c);
+                    if (call.name == "send_message") {
+                        json args = json::parse(call.arguments, nullptr, false);
+                        if (!args.is_discarded() && args.contains("message") && args["message"].is_string()) {
+                            out += "assistant: ";
+                            out += args["message"].get<std::string>();
+                            out += "\n";
+                            continue;
+                        }
+                    }
+                    out += "assistant called ";
+                    out += call.name;
+                    out += " ";
+                    out += call.arguments;
+                    out += "\n";
+                }
+                break;
+            case MessageRole::Tool:
+            case MessageRole::System:
+                // Tool results are status objects; nothing to remember there
+                break;
+        }
+    }
+    return out;
+}
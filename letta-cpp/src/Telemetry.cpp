@@ -0,0 +1,230 @@
+#include "Telemetry.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+std::atomic<bool> Telemetry::enabled_flag{false};
+
+namespace {
+
+// std::atomic<double>::fetch_add is C++20
+void atomicAdd(std::atomic<double>& target, double value) {
+    double current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {}
+}
+
+thread_local ScopedSpan* current_span = nullptr;
+
+uint64_t randomId() {
+    thread_local std::mt19937_64 rng(std::random_device{}() ^ reinterpret_cast<uintptr_t>(&rng));
+    uint64_t id = 0;
+    while (id == 0) id = rng();
+    return id;
+}
+
+uint64_t unixNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+std::string formatValue(double value) {
+    if (std::isinf(value)) return value > 0 ? "+Inf" : "-Inf";
+    std::ostringstream ss;
+    ss << value;
+    return ss.str();
+}
+
+// Join a metric's own labels with an extra one (used for histogram "le")
+std::string joinLabels(const std::string& labels, const std::string& extra) {
+    if (labels.empty() && extra.empty()) return "";
+    if (labels.empty()) return "{" + extra + "}";
+    if (extra.empty()) return "{" + labels + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+const std::vector<double> kSecondsBuckets = {0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+const std::vector<double> kBytesBuckets = {256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216};
+const std::vector<double> kCountBuckets = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 4096};
+
+} // namespace
+
+void Counter::add(double value) {
+    atomicAdd(total, value);
+}
+
+Histogram::Histogram(std::vector<double> bounds) : upper_bounds(std::move(bounds)) {
+    std::sort(upper_bounds.begin(), upper_bounds.end());
+    counts.reset(new std::atomic<uint64_t>[upper_bounds.size() + 1]);
+    for (size_t i = 0; i <= upper_bounds.size(); ++i) counts[i].store(0, std::memory_order_relaxed);
+}
+
+void Histogram::observe(double value) {
+    size_t bucket = std::lower_bound(upper_bounds.begin(), upper_bounds.end(), value) - upper_bounds.begin();
+    counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    observations.fetch_add(1, std::memory_order_relaxed);
+    atomicAdd(total, value);
+}
+
+Telemetry& Telemetry::instance() {
+    static Telemetry telemetry;
+    return telemetry;
+}
+
+Telemetry::Telemetry() {
+    agent_metrics.step_duration = &histogram("letta_agent_step_duration_seconds", "Wall time of Agent::step.", kSecondsBuckets);
+    agent_metrics.llm_duration = &histogram("letta_llm_request_duration_seconds", "LLM round-trip time including queueing and hedging.", kSecondsBuckets);
+    agent_metrics.serialize_duration = &histogram("letta_llm_serialize_duration_seconds", "Time spent building request payloads.", kSecondsBuckets);
+    agent_metrics.parse_duration = &histogram("letta_llm_parse_duration_seconds", "Time spent parsing and normalising responses.", kSecondsBuckets);
+    agent_metrics.request_bytes = &histogram("letta_llm_request_bytes", "Serialized request payload size.", kBytesBuckets);
+    agent_metrics.response_bytes = &histogram("letta_llm_response_bytes", "Response body size.", kBytesBuckets);
+    agent_metrics.request_wire_bytes = &histogram("letta_llm_request_wire_bytes",
+                                                  "Request body size as sent, after Content-Encoding.", kBytesBuckets);
+    agent_metrics.response_wire_bytes = &histogram("letta_llm_response_wire_bytes",
+                                                   "Encoded response body size, before decoding.", kBytesBuckets);
+    agent_metrics.history_length = &histogram("letta_agent_history_messages", "Messages sent to the LLM per call.", kCountBuckets);
+    agent_metrics.tool_calls_per_step = &histogram("letta_agent_tool_calls_per_step", "Tool calls executed per Agent::step.", kCountBuckets);
+    agent_metrics.tool_duration = &histogram("letta_agent_tool_duration_seconds", "Wall time of executeTool.", kSecondsBuckets);
+    agent_metrics.prompt_tokens = &counter("letta_llm_tokens_total", "Provider-reported token usage.", "kind=\"prompt\"");
+    agent_metrics.completion_tokens = &counter("letta_llm_tokens_total", "Provider-reported token usage.", "kind=\"completion\"");
+    agent_metrics.steps = &counter("letta_agent_steps_total", "Agent steps started.");
+    agent_metrics.steps_cancelled = &counter("letta_agent_steps_cancelled_total", "Agent steps cut short by cancellation.");
+    agent_metrics.llm_errors = &counter("letta_llm_errors_total", "LLM calls that returned an error.");
+}
+
+Counter& Telemetry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    Family& family = families[name];
+    if (family.type.empty()) {
+        family.help = help;
+        family.type = "counter";
+    }
+    auto& slot = family.counters[labels];
+    if (!slot) slot = std::make_unique<Counter>();
+    return *slot;
+}
+
+Histogram& Telemetry::histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                                const std::string& labels) {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    Family& family = families[name];
+    if (family.type.empty()) {
+        family.help = help;
+        family.type = "histogram";
+    }
+    auto& slot = family.histograms[labels];
+    if (!slot) slot = std::make_unique<Histogram>(bounds);
+    return *slot;
+}
+
+std::string Telemetry::renderPrometheus() const {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    std::ostringstream out;
+    for (const auto& [name, family] : families) {
+        out << "# HELP " << name << " " << family.help << "\n";
+        out << "# TYPE " << name << " " << family.type << "\n";
+        for (const auto& [labels, counter] : family.counters) {
+            out << name << joinLabels(labels, "") << " " << formatValue(counter->value()) << "\n";
+        }
+        for (const auto& [labels, histogram] : family.histograms) {
+            uint64_t cumulative = 0;
+            const auto& bounds = histogram->bounds();
+            for (size_t i = 0; i <= bounds.size(); ++i) {
+                cumulative += histogram->bucketCount(i);
+                double le = i < bounds.size() ? bounds[i] : INFINITY;
+                out << name << "_bucket" << joinLabels(labels, "le=\"" + formatValue(le) + "\"") << " " << cumulative << "\n";
+            }
+            out << name << "_sum" << joinLabels(labels, "") << " " << formatValue(histogram->sum()) << "\n";
+            out << name << "_count" << joinLabels(labels, "") << " " << histogram->count() << "\n";
+        }
+    }
+    return out.str();
+}
+
+void Telemetry::recordSpan(SpanData&& span) {
+    std::lock_guard<std::mutex> lock(span_mutex);
+    if (spans.size() >= span_limit) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    spans.push_back(std::move(span));
+}
+
+std::vector<SpanData> Telemetry::drainSpans() {
+    std::lock_guard<std::mutex> lock(span_mutex);
+    std::vector<SpanData> out;
+    out.swap(spans);
+    return out;
+}
+
+void Telemetry::setSpanBufferLimit(size_t limit) {
+    std::lock_guard<std::mutex> lock(span_mutex);
+    span_limit = limit;
+}
+
+ScopedSpan::ScopedSpan(const char* name, Histogram* duration, int kind) : duration_histogram(duration) {
+    if (!Telemetry::enabled()) return;
+    start(name, current(), kind);
+}
+
+ScopedSpan::ScopedSpan(const char* name, const SpanContext& parent, Histogram* duration, int kind)
+    : duration_histogram(duration) {
+    if (!Telemetry::enabled()) return;
+    start(name, parent, kind);
+}
+
+void ScopedSpan::start(const char* name, const SpanContext& parent, int kind) {
+    data = std::make_unique<SpanData>();
+    data->name = name;
+    data->kind = kind;
+    data->span_id = randomId();
+    if (parent.valid()) {
+        data->trace_id = parent.trace_id;
+        data->parent_span_id = parent.span_id;
+    } else {
+        uint64_t hi = randomId(), lo = randomId();
+        for (int i = 0; i < 8; ++i) {
+            data->trace_id[i] = static_cast<uint8_t>(hi >> (56 - 8 * i));
+            data->trace_id[8 + i] = static_cast<uint8_t>(lo >> (56 - 8 * i));
+        }
+    }
+    data->start_unix_nanos = unixNanos();
+    started = std::chrono::steady_clock::now();
+    previous = current_span;
+    current_span = this;
+}
+
+ScopedSpan::~ScopedSpan() {
+    if (!data) return;
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    data->end_unix_nanos = data->start_unix_nanos + static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    if (duration_histogram) {
+        duration_histogram->observe(std::chrono::duration<double>(elapsed).count());
+    }
+    if (current_span == this) current_span = previous;
+    Telemetry::instance().recordSpan(std::move(*data));
+}
+
+void ScopedSpan::setAttribute(const char* key, const std::string& value) {
+    if (data) data->attributes.emplace_back(key, value);
+}
+
+void ScopedSpan::setAttribute(const char* key, int64_t value) {
+    if (data) data->attributes.emplace_back(key, std::to_string(value));
+}
+
+void ScopedSpan::setError(const std::string& message) {
+    if (!data) return;
+    data->error = true;
+    data->attributes.emplace_back("error.message", message);
+}
+
+SpanContext ScopedSpan::context() const {
+    if (!data) return {};
+    return SpanContext{data->trace_id, data->span_id};
+}
+
+SpanContext ScopedSpan::current() {
+    return current_span ? current_span->context() : SpanContext{};
+}
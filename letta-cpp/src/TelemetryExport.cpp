@@ -0,0 +1,196 @@
+#include "TelemetryExport.hpp"
+#include "Log.hpp"
+#include <arpa/inet.h>
+#include <fstream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+std::string hex(const uint8_t* bytes, size_t n) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(n * 2, '0');
+    for (size_t i = 0; i < n; ++i) {
+        out[2 * i] = digits[bytes[i] >> 4];
+        out[2 * i + 1] = digits[bytes[i] & 0xf];
+    }
+    return out;
+}
+
+std::string hex(uint64_t id) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; ++i) bytes[i] = static_cast<uint8_t>(id >> (56 - 8 * i));
+    return hex(bytes, 8);
+}
+
+json stringAttribute(const std::string& key, const std::string& value) {
+    return {{"key", key}, {"value", {{"stringValue", value}}}};
+}
+
+} // namespace
+
+std::string toOtlpJson(const std::vector<SpanData>& spans, const std::string& service_name) {
+    json otlp_spans = json::array();
+    for (const auto& span : spans) {
+        json attributes = json::array();
+        for (const auto& [key, value] : span.attributes) {
+            attributes.push_back(stringAttribute(key, value));
+        }
+        json s = {
+            {"traceId", hex(span.trace_id.data(), span.trace_id.size())},
+            {"spanId", hex(span.span_id)},
+            {"name", span.name},
+            {"kind", span.kind},
+            // 64-bit nanos are strings in OTLP/JSON
+            {"startTimeUnixNano", std::to_string(span.start_unix_nanos)},
+            {"endTimeUnixNano", std::to_string(span.end_unix_nanos)},
+            {"attributes", attributes},
+            {"status", {{"code", span.error ? 2 : 1}}}
+        };
+        if (span.parent_span_id != 0) {
+            s["parentSpanId"] = hex(span.parent_span_id);
+        }
+        otlp_spans.push_back(std::move(s));
+    }
+
+    json request = {
+        {"resourceSpans", {{
+            {"resource", {{"attributes", {stringAttribute("service.name", service_name)}}}},
+            {"scopeSpans", {{
+                {"scope", {{"name", "letta-cpp"}}},
+                {"spans", otlp_spans}
+            }}}
+        }}}
+    };
+    return request.dump();
+}
+
+OtlpExporter::OtlpExporter(OtlpExporterOptions options, HttpTransport transport)
+    : options(std::move(options)), transport(std::move(transport)) {}
+
+OtlpExporter::~OtlpExporter() {
+    stop();
+}
+
+void OtlpExporter::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) return;
+    running = true;
+    worker = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (running) {
+            cv.wait_for(lock, options.interval, [this] { return !running; });
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    });
+}
+
+void OtlpExporter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) return;
+        running = false;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+size_t OtlpExporter::flush() {
+    std::vector<SpanData> spans = Telemetry::instance().drainSpans();
+    if (spans.empty()) return 0;
+
+    std::string payload = toOtlpJson(spans, options.service_name);
+
+    if (!options.file_path.empty()) {
+        std::ofstream out(options.file_path, std::ios::app);
+        out << payload << '\n';
+        return out ? spans.size() : 0;
+    }
+
+    HttpRequest request{options.endpoint, {{"Content-Type", "application/json"}}, std::move(payload)};
+    std::atomic<bool> never_cancelled{false};
+    HttpResponse r = transport(request, never_cancelled);
+    if (r.status_code < 200 || r.status_code >= 300) {
+        LETTA_LOG_WARN("telemetry", "OTLP export failed", {"status", r.status_code}, {"error", r.error});
+        return 0;
+    }
+    return spans.size();
+}
+
+PrometheusEndpoint::~PrometheusEndpoint() {
+    stop();
+}
+
+bool PrometheusEndpoint::start(int port, const std::string& bind_address) {
+    if (running) return true;
+
+    listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) return false;
+    int one = 1;
+    ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::inet_pton(AF_INET, bind_address.c_str(), &addr.sin_addr) != 1 ||
+        ::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd, 16) != 0) {
+        ::close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    ::getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    bound_port = ntohs(addr.sin_port);
+
+    running = true;
+    worker = std::thread([this] { serve(); });
+    return true;
+}
+
+void PrometheusEndpoint::stop() {
+    if (!running.exchange(false)) return;
+    if (worker.joinable()) worker.join();
+    ::close(listen_fd);
+    listen_fd = -1;
+}
+
+void PrometheusEndpoint::serve() {
+    while (running) {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 100) <= 0) continue;
+
+        int client = ::accept(listen_fd, nullptr, nullptr);
+        if (client < 0) continue;
+
+        // Scrapers send a small GET; read it and answer regardless of path
+        char buffer[2048];
+        pollfd cfd{client, POLLIN, 0};
+        if (::poll(&cfd, 1, 1000) > 0) {
+            (void)::recv(client, buffer, sizeof(buffer), 0);
+        }
+
+        std::string body = Telemetry::instance().renderPrometheus();
+        std::string response =
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "Connection: close\r\n\r\n" + body;
+
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += static_cast<size_t>(n);
+        }
+        ::close(client);
+    }
+}
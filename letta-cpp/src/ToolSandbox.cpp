@@ -0,0 +1,620 @@
+#include "ToolSandbox.hpp"
+#include "Log.hpp"
+#include "Telemetry.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/syscall.h>
+#define LETTA_HAVE_SECCOMP 1
+#endif
+
+struct ToolSandbox::Worker {
+    pid_t pid = -1;         // a child of the zygote, not of this process
+    int fd = -1;            // our end of the socket pair
+    int arena_fd = -1;      // memfd behind the arena, handed to each incarnation
+    char* arena = nullptr;  // our MAP_SHARED view of it
+    size_t arena_bytes = 0;
+};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Frame : uint32_t {
+    Inline = 1, // payload follows the header on the socket
+    Arena = 2   // payload is at the start of the worker's arena
+};
+
+struct FrameHeader {
+    uint32_t frame = 0;
+    uint32_t tool = 0; // requests only
+    uint64_t length = 0;
+};
+static_assert(sizeof(FrameHeader) == 16, "wire format");
+
+constexpr int kWorkerFd = 3;
+
+// Requests to the zygote travel as single datagrams on a SOCK_SEQPACKET pair,
+// with the worker's socket and arena attached as SCM_RIGHTS
+enum class ZygoteOp : uint32_t {
+    Spawn = 1,      // fork a worker on the attached socket (and arena)
+    Reap = 2,       // wait for `pid` and report its status
+    KillAndReap = 3 // SIGKILL `pid` first
+};
+
+struct ZygoteRequest {
+    uint32_t op = 0;
+    int32_t pid = 0;
+};
+
+struct ZygoteReply {
+    int32_t pid = -1; // the new worker, or -errno
+    int32_t status = 0;
+};
+
+constexpr size_t kMaxPassedFds = 2;
+
+bool sendRequest(int fd, const ZygoteRequest& request, const int* fds, size_t count) {
+    iovec iov{const_cast<ZygoteRequest*>(&request), sizeof(request)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(kMaxPassedFds * sizeof(int))] = {};
+    if (count > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+    }
+    while (true) {
+        ssize_t sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        return sent == static_cast<ssize_t>(sizeof(request));
+    }
+}
+
+// Number of descriptors received into `fds`, or -1 once the host is gone
+int receiveRequest(int fd, ZygoteRequest& request, int* fds) {
+    iovec iov{&request, sizeof(request)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(kMaxPassedFds * sizeof(int))];
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t got;
+    while ((got = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {}
+    if (got != static_cast<ssize_t>(sizeof(request))) return -1;
+
+    int count = 0;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < n; ++i) {
+            int passed;
+            std::memcpy(&passed, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (count < static_cast<int>(kMaxPassedFds)) fds[count++] = passed;
+            else close(passed);
+        }
+    }
+    return count;
+}
+
+// One request/reply round trip; the caller serializes them
+bool askZygote(int fd, const ZygoteRequest& request, const int* fds, size_t count, ZygoteReply& reply) {
+    if (fd < 0 || !sendRequest(fd, request, fds, count)) return false;
+    ssize_t got;
+    while ((got = ::recv(fd, &reply, sizeof(reply), 0)) < 0 && errno == EINTR) {}
+    return got == static_cast<ssize_t>(sizeof(reply));
+}
+
+json errorResult(const std::string& message) {
+    return {{"status", "ERROR"}, {"message", message}};
+}
+
+bool writeAll(int fd, const void* data, size_t n) {
+    const char* p = static_cast<const char*>(data);
+    while (n > 0) {
+        ssize_t written = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += written;
+        n -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+enum class ReadResult { Ok, Closed, TimedOut, Oversized };
+
+// Read exactly n bytes, giving up at `deadline` if there is one
+ReadResult readAll(int fd, void* data, size_t n, const Clock::time_point* deadline) {
+    char* p = static_cast<char*>(data);
+    while (n > 0) {
+        if (deadline) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(*deadline - Clock::now()).count();
+            if (remaining <= 0) return ReadResult::TimedOut;
+            pollfd pfd{fd, POLLIN, 0};
+            int ready = ::poll(&pfd, 1, static_cast<int>(remaining));
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0) return ReadResult::Closed;
+            if (ready == 0) return ReadResult::TimedOut;
+        }
+        ssize_t got = ::read(fd, p, n);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return ReadResult::Closed;
+        p += got;
+        n -= static_cast<size_t>(got);
+    }
+    return ReadResult::Ok;
+}
+
+// Send `payload` through the arena when it fits, inline otherwise
+bool sendPayload(int fd, char* arena, size_t arena_bytes, uint32_t tool, const std::string& payload) {
+    FrameHeader header;
+    header.tool = tool;
+    header.length = payload.size();
+    if (payload.size() <= arena_bytes) {
+        header.frame = static_cast<uint32_t>(Frame::Arena);
+        std::memcpy(arena, payload.data(), payload.size());
+        return writeAll(fd, &header, sizeof(header));
+    }
+    header.frame = static_cast<uint32_t>(Frame::Inline);
+    return writeAll(fd, &header, sizeof(header)) && writeAll(fd, payload.data(), payload.size());
+}
+
+// Receive a payload announced by `header` and parse it (discarded on bad JSON).
+// An inline payload longer than `max_length` is refused before anything is
+// allocated for it.
+ReadResult receivePayload(int fd, const char* arena, size_t arena_bytes, size_t max_length,
+                          const FrameHeader& header, const Clock::time_point* deadline, json& out) {
+    if (header.frame == static_cast<uint32_t>(Frame::Arena)) {
+        if (header.length > arena_bytes) return ReadResult::Closed;
+        out = json::parse(arena, arena + header.length, nullptr, false);
+        return ReadResult::Ok;
+    }
+    if (header.frame != static_cast<uint32_t>(Frame::Inline)) return ReadResult::Closed;
+    if (header.length > max_length) return ReadResult::Oversized;
+    std::string buffer(header.length, '\0');
+    ReadResult result = readAll(fd, buffer.data(), buffer.size(), deadline);
+    if (result == ReadResult::Ok) out = json::parse(buffer, nullptr, false);
+    return result;
+}
+
+// Largest inline payload either side accepts: nothing bigger than the arena
+// or the worker's memory allowance can be legitimately produced
+size_t maxPayload(const SandboxOptions& opts) {
+    if (opts.limits.memory_bytes == 0) return SIZE_MAX;
+    return std::max(opts.arena_bytes, opts.limits.memory_bytes);
+}
+
+std::string dumpLossy(const json& value) {
+    return value.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+// Virtual memory already mapped, so memory_bytes is headroom on top of it.
+// Plain open/read: the zygote calls this and keeps to async-signal-safe calls.
+size_t currentAddressSpace(size_t page_size) {
+    int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    char text[64];
+    ssize_t got = read(fd, text, sizeof(text));
+    close(fd);
+    size_t pages = 0;
+    for (ssize_t i = 0; i < got && text[i] >= '0' && text[i] <= '9'; ++i) pages = pages * 10 + (text[i] - '0');
+    return pages * page_size;
+}
+
+// Close every descriptor above `keep_below` except `keep`
+void closeDescriptorsFrom(int keep_below, int keep) {
+    rlimit files{};
+    rlim_t max_fd = getrlimit(RLIMIT_NOFILE, &files) == 0 ? files.rlim_cur : 1024;
+    if (max_fd == RLIM_INFINITY || max_fd > 65536) max_fd = 65536;
+    for (int fd = keep_below; fd < static_cast<int>(max_fd); ++fd) {
+        if (fd != keep) close(fd);
+    }
+}
+
+void setLimit(int resource, rlim_t value) {
+    rlimit limit{value, value};
+    setrlimit(resource, &limit);
+}
+
+// Allow this call `cpu_seconds` on top of what the worker has used so far
+void armCpuLimit(int cpu_seconds) {
+    if (cpu_seconds <= 0) return;
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    rlimit limit{};
+    getrlimit(RLIMIT_CPU, &limit);
+    rlim_t soft = static_cast<rlim_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1 + cpu_seconds);
+    limit.rlim_cur = limit.rlim_max == RLIM_INFINITY ? soft : std::min(soft, limit.rlim_max);
+    setrlimit(RLIMIT_CPU, &limit);
+}
+
+#if defined(LETTA_HAVE_SECCOMP)
+#if defined(__x86_64__)
+constexpr uint32_t kAuditArch = AUDIT_ARCH_X86_64;
+#else
+constexpr uint32_t kAuditArch = AUDIT_ARCH_AARCH64;
+#endif
+
+// Enough for the serve loop, allocation, clocks and sleeping - no open,
+// socket, connect, clone or exec
+const int kAllowedSyscalls[] = {
+    SYS_read, SYS_write, SYS_readv, SYS_writev, SYS_sendto, SYS_recvfrom, SYS_close,
+    SYS_fstat, SYS_newfstatat, SYS_lseek,
+    SYS_mmap, SYS_munmap, SYS_mremap, SYS_mprotect, SYS_madvise, SYS_brk,
+    SYS_futex, SYS_rt_sigreturn, SYS_rt_sigprocmask, SYS_sigaltstack,
+    SYS_exit, SYS_exit_group, SYS_getpid, SYS_gettid, SYS_tgkill,
+    SYS_clock_gettime, SYS_clock_nanosleep, SYS_nanosleep, SYS_sched_yield,
+    SYS_getrandom, SYS_getrusage, SYS_prlimit64, SYS_restart_syscall,
+};
+
+bool installSeccomp() {
+    std::vector<sock_filter> filter;
+    const sock_filter kill = BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS);
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)));
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, kAuditArch, 1, 0));
+    filter.push_back(kill);
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)));
+#if defined(__x86_64__)
+    // x32 syscalls share the architecture tag
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0x40000000, 0, 1));
+    filter.push_back(kill);
+#endif
+    for (int nr : kAllowedSyscalls) {
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(nr), 0, 1));
+        filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    }
+    filter.push_back(kill);
+
+    sock_fprog program{static_cast<unsigned short>(filter.size()), filter.data()};
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0) return false;
+    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+}
+#else
+bool installSeccomp() {
+    return false;
+}
+#endif
+
+void releaseArena(ToolSandbox::Worker& worker) {
+    if (worker.arena) munmap(worker.arena, worker.arena_bytes);
+    if (worker.arena_fd >= 0) close(worker.arena_fd);
+    worker.arena = nullptr;
+    worker.arena_fd = -1;
+}
+
+} // namespace
+
+ToolSandbox::ToolSandbox(SandboxOptions options) : opts(std::move(options)) {}
+
+ToolSandbox::~ToolSandbox() {
+    for (auto& worker : pool) {
+        if (worker->pid > 0) reap(*worker, false);
+        releaseArena(*worker);
+    }
+    if (zygote_pid > 0) {
+        // EOF is the zygote's cue to exit
+        close(zygote_fd);
+        int status = 0;
+        while (waitpid(zygote_pid, &status, 0) < 0 && errno == EINTR) {}
+    }
+}
+
+void ToolSandbox::registerTool(const json& schema, ToolFunction function) {
+    std::string name = schema["function"].value("name", "");
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started) {
+        LETTA_LOG_WARN("sandbox", "Tool registered after start, workers will not have it", {"tool", name});
+        return;
+    }
+    tool_index[name] = static_cast<uint32_t>(tools.size());
+    tools.push_back(Tool{schema, std::move(function)});
+}
+
+std::vector<json> ToolSandbox::schemas() const {
+    std::vector<json> out;
+    for (const auto& tool : tools) out.push_back(tool.schema);
+    return out;
+}
+
+void ToolSandbox::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started) return;
+    started = true;
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0) {
+        LETTA_LOG_ERROR("sandbox", "Could not create zygote socket", {"error", std::strerror(errno)});
+        return;
+    }
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        zygote(fds[1], page_size);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        LETTA_LOG_ERROR("sandbox", "Could not fork zygote", {"error", std::strerror(errno)});
+        close(fds[0]);
+        return;
+    }
+    zygote_pid = pid;
+    zygote_fd = fds[0];
+
+    for (size_t i = 0; i < opts.workers; ++i) {
+        auto worker = std::make_unique<Worker>();
+        if (spawn(*worker)) idle.push_back(worker.get());
+        pool.push_back(std::move(worker));
+    }
+    LETTA_LOG_INFO("sandbox", "Started tool workers", {"workers", idle.size()}, {"tools", tools.size()});
+}
+
+json ToolSandbox::execute(const std::string& name, const json& arguments) {
+    auto it = tool_index.find(name);
+    if (it == tool_index.end()) return errorResult("Unknown tool: " + name);
+    if (!started) return errorResult("Tool sandbox not started");
+
+    ScopedSpan span("sandbox.execute");
+    span.setAttribute("tool.name", name);
+
+    if (opts.workers == 0) {
+        // One-shot worker: same sandbox, paid for on every call
+        Worker worker;
+        json result = spawn(worker) ? call(worker, it->second, arguments)
+                                    : errorResult("Could not start a sandbox worker");
+        if (worker.pid > 0) reap(worker, false);
+        releaseArena(worker);
+        return result;
+    }
+
+    Worker* worker = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        worker_free.wait(lock, [&] { return !idle.empty() || pool.empty(); });
+        if (idle.empty()) return errorResult("No sandbox workers");
+        worker = idle.back();
+        idle.pop_back();
+    }
+
+    json result = worker->pid > 0 ? call(*worker, it->second, arguments)
+                                  : errorResult("Sandbox worker unavailable");
+    if (worker->pid <= 0 && spawn(*worker)) workers_replaced++;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(worker);
+    }
+    worker_free.notify_one();
+    return result;
+}
+
+json ToolSandbox::call(Worker& worker, uint32_t tool, const json& arguments) {
+    const std::string& name = tools[tool].schema["function"]["name"].get_ref<const std::string&>();
+    auto deadline = Clock::now() + opts.limits.timeout;
+
+    FrameHeader header;
+    json result;
+    ReadResult status = ReadResult::Closed;
+    if (sendPayload(worker.fd, worker.arena, worker.arena_bytes, tool, dumpLossy(arguments))) {
+        status = readAll(worker.fd, &header, sizeof(header), &deadline);
+        if (status == ReadResult::Ok) {
+            status = receivePayload(worker.fd, worker.arena, worker.arena_bytes, maxPayload(opts), header,
+                                    &deadline, result);
+        }
+    }
+
+    if (status == ReadResult::Ok) {
+        calls_served++;
+        if (result.is_discarded()) return errorResult("Tool '" + name + "' returned invalid JSON");
+        return result;
+    }
+
+    std::string how;
+    if (status == ReadResult::TimedOut) {
+        how = "timed out after " + std::to_string(opts.limits.timeout.count()) + " ms";
+        reap(worker, true);
+    } else if (status == ReadResult::Oversized) {
+        how = "sent an oversized result (" + std::to_string(header.length) + " bytes)";
+        reap(worker, true);
+    } else {
+        how = reap(worker, false);
+    }
+    LETTA_LOG_WARN("sandbox", "Tool worker failed", {"tool", name}, {"reason", how});
+    return errorResult("Tool '" + name + "' " + how);
+}
+
+bool ToolSandbox::spawn(Worker& worker) {
+    if (worker.arena_fd < 0 && opts.arena_bytes > 0) {
+        int arena_fd = memfd_create("letta-sandbox-arena", MFD_CLOEXEC);
+        void* arena = MAP_FAILED;
+        if (arena_fd >= 0 && ftruncate(arena_fd, static_cast<off_t>(opts.arena_bytes)) == 0) {
+            arena = mmap(nullptr, opts.arena_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, arena_fd, 0);
+        }
+        if (arena == MAP_FAILED) {
+            LETTA_LOG_ERROR("sandbox", "Could not map worker arena", {"error", std::strerror(errno)});
+            if (arena_fd >= 0) close(arena_fd);
+            return false;
+        }
+        worker.arena_fd = arena_fd;
+        worker.arena = static_cast<char*>(arena);
+        worker.arena_bytes = opts.arena_bytes;
+    }
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        LETTA_LOG_ERROR("sandbox", "Could not create worker socket", {"error", std::strerror(errno)});
+        return false;
+    }
+    ZygoteRequest request;
+    request.op = static_cast<uint32_t>(ZygoteOp::Spawn);
+    const int passed[kMaxPassedFds] = {fds[1], worker.arena_fd};
+    ZygoteReply reply;
+    bool answered;
+    {
+        std::lock_guard<std::mutex> lock(zygote_mutex);
+        answered = askZygote(zygote_fd, request, passed, worker.arena_fd >= 0 ? 2 : 1, reply);
+    }
+    close(fds[1]);
+    if (!answered || reply.pid <= 0) {
+        std::string error = answered ? std::strerror(-reply.pid) : "zygote is gone";
+        LETTA_LOG_ERROR("sandbox", "Could not fork worker", {"error", error});
+        close(fds[0]);
+        return false;
+    }
+    worker.pid = reply.pid;
+    worker.fd = fds[0];
+    return true;
+}
+
+std::string ToolSandbox::reap(Worker& worker, bool kill_first) {
+    // Closing our end first lets an idle worker see EOF and exit on its own
+    close(worker.fd);
+    worker.fd = -1;
+    ZygoteRequest request;
+    request.op = static_cast<uint32_t>(kill_first ? ZygoteOp::KillAndReap : ZygoteOp::Reap);
+    request.pid = worker.pid;
+    ZygoteReply reply;
+    bool answered;
+    {
+        std::lock_guard<std::mutex> lock(zygote_mutex);
+        answered = askZygote(zygote_fd, request, nullptr, 0, reply);
+    }
+    worker.pid = -1;
+    if (!answered || reply.pid < 0) return "was lost with the sandbox zygote";
+
+    int status = reply.status;
+    if (WIFEXITED(status)) return "exited with status " + std::to_string(WEXITSTATUS(status));
+    if (!WIFSIGNALED(status)) return "stopped";
+    int signal = WTERMSIG(status);
+    if (signal == SIGSYS) return "was stopped by the sandbox (disallowed system call)";
+    if (signal == SIGXCPU) return "exceeded its CPU limit";
+    return "was killed by signal " + std::to_string(signal);
+}
+
+void ToolSandbox::zygote(int fd, size_t page_size) {
+    // Forked from the host, which may already have threads: only
+    // async-signal-safe calls and no allocation from here on. Workers are
+    // forked from this process, which has a single thread.
+    pid_t parent = getppid();
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) _exit(0);
+    closeDescriptorsFrom(STDERR_FILENO + 1, fd);
+
+    while (true) {
+        ZygoteRequest request;
+        int fds[kMaxPassedFds] = {-1, -1};
+        int received = receiveRequest(fd, request, fds);
+        if (received < 0) _exit(0); // the host closed its end
+
+        ZygoteReply reply;
+        if (request.op == static_cast<uint32_t>(ZygoteOp::Spawn)) {
+            if (received == 0) {
+                reply.pid = -EBADF;
+            } else {
+                size_t address_space = currentAddressSpace(page_size);
+                pid_t pid = fork();
+                if (pid == 0) {
+                    close(fd);
+                    serve(fds[0], fds[1], address_space);
+                }
+                reply.pid = pid < 0 ? -errno : pid;
+            }
+        } else if (request.pid > 0) {
+            if (request.op == static_cast<uint32_t>(ZygoteOp::KillAndReap)) kill(request.pid, SIGKILL);
+            int status = 0;
+            pid_t reaped;
+            while ((reaped = waitpid(request.pid, &status, 0)) < 0 && errno == EINTR) {}
+            reply.pid = reaped;
+            reply.status = status;
+        }
+        for (int i = 0; i < received; ++i) close(fds[i]);
+        if (::send(fd, &reply, sizeof(reply), MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(reply))) _exit(0);
+    }
+}
+
+void ToolSandbox::serve(int socket_fd, int arena_fd, size_t address_space) {
+    // Forked from the single-threaded zygote, so no lock is left held by a
+    // thread that did not come along; allocating and parsing are safe here
+    pid_t parent = getppid();
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) _exit(0);
+
+    char* arena = nullptr;
+    size_t arena_bytes = 0;
+    if (arena_fd >= 0) {
+        void* mapped = mmap(nullptr, opts.arena_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, arena_fd, 0);
+        if (mapped == MAP_FAILED) _exit(122);
+        arena = static_cast<char*>(mapped);
+        arena_bytes = opts.arena_bytes;
+    }
+    int devnull = open("/dev/null", O_RDWR);
+    if (devnull >= 0) {
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+    }
+    if (dup2(socket_fd, kWorkerFd) < 0) _exit(120);
+    closeDescriptorsFrom(kWorkerFd + 1, -1);
+
+    const SandboxLimits& limits = opts.limits;
+    setLimit(RLIMIT_CORE, 0);
+    setLimit(RLIMIT_FSIZE, 0);
+    if (limits.max_open_files > 0) setLimit(RLIMIT_NOFILE, static_cast<rlim_t>(limits.max_open_files));
+    if (limits.memory_bytes > 0) setLimit(RLIMIT_AS, address_space + arena_bytes + limits.memory_bytes);
+    if (limits.seccomp && !installSeccomp()) _exit(121); // fail closed
+
+    const int fd = kWorkerFd;
+    while (true) {
+        FrameHeader header;
+        if (readAll(fd, &header, sizeof(header), nullptr) != ReadResult::Ok) _exit(0);
+
+        std::string output;
+        try {
+            json arguments;
+            if (receivePayload(fd, arena, arena_bytes, maxPayload(opts), header, nullptr, arguments) !=
+                ReadResult::Ok) {
+                _exit(0);
+            }
+            json result;
+            if (header.tool >= tools.size()) {
+                result = errorResult("Unknown tool");
+            } else if (arguments.is_discarded()) {
+                result = errorResult("Arguments are not valid JSON");
+            } else {
+                armCpuLimit(limits.cpu_seconds);
+                result = tools[header.tool].function(arguments);
+            }
+            output = dumpLossy(result);
+        } catch (const std::bad_alloc&) {
+            output = dumpLossy(errorResult("Tool exceeded its memory limit"));
+        } catch (const std::exception& e) {
+            output = dumpLossy(errorResult(std::string("Tool threw: ") + e.what()));
+        } catch (...) {
+            output = dumpLossy(errorResult("Tool threw an unknown exception"));
+        }
+        if (!sendPayload(fd, arena, arena_bytes, 0, output)) _exit(0);
+    }
+}
@@ -0,0 +1,856 @@
+#include "ToolSchema.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <set>
+
+namespace {
+
+constexpr int kMaxSchemaDepth = 32;
+
+uint8_t typeBit(const json& name) {
+    if (!name.is_string()) throw SchemaError("\"type\" must be a string or a list of strings");
+    const std::string& type = name.get_ref<const std::string&>();
+    if (type == "null") return 1;
+    if (type == "boolean") return 2;
+    if (type == "integer") return 4;
+    if (type == "number") return 8;
+    if (type == "string") return 16;
+    if (type == "array") return 32;
+    if (type == "object") return 64;
+    throw SchemaError("unknown type \"" + type + "\"");
+}
+
+std::string typeNames(uint8_t types) {
+    static const char* names[] = {"null", "boolean", "integer", "number", "string", "array", "object"};
+    std::string out;
+    for (int bit = 0; bit < 7; ++bit) {
+        if (!(types & (1 << bit))) continue;
+        if (!out.empty()) out += " or ";
+        out += names[bit];
+    }
+    return out;
+}
+
+// Bytes a string can contain with nothing to track: printable ASCII except
+// the quote and the backslash
+struct PlainTable {
+    bool plain[256];
+    PlainTable() {
+        for (int c = 0; c < 256; ++c) plain[c] = c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+    }
+};
+const PlainTable kPlain;
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// --- Grammar text -----------------------------------------------------------
+
+// A GBNF string literal matching `text` exactly
+std::string gbnfLiteral(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// GBNF rule names are [a-zA-Z0-9-]+
+std::string ruleName(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || isDigit(c);
+        out += ok ? c : '-';
+    }
+    return out.empty() ? "x" : out;
+}
+
+std::string regexLiteral(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (std::string_view("\\^$.|?*+()[]{}/").find(c) != std::string_view::npos) out += '\\';
+        if (c == '\n') { out += "\\n"; continue; }
+        out += c;
+    }
+    return out;
+}
+
+// Shared by both grammar forms: what JSON text whitespace may be generated
+// between tokens (none, a space, or a newline and some indentation)
+const char* kPrimitiveGbnf[][2] = {
+    {"ws", "| \" \" | \"\\n\" [ \\t]{0,20}"},
+    {"null", "\"null\""},
+    {"boolean", "\"true\" | \"false\""},
+    {"integer", "\"-\"? ([0-9] | [1-9] [0-9]{0,15})"},
+    {"number", "\"-\"? ([0-9] | [1-9] [0-9]{0,15}) (\".\" [0-9]+)? ([eE] [-+]? [0-9]+)?"},
+    {"char", "[^\"\\\\\\x7F\\x00-\\x1F] | [\\\\] ([\"\\\\/bfnrt] | \"u\" [0-9a-fA-F]{4})"},
+    {"string", "\"\\\"\" char* \"\\\"\""},
+    {"value", "object | array | string | number | boolean | null"},
+    {"object", "\"{\" ws (string ws \":\" ws value ws (\",\" ws string ws \":\" ws value ws)*)? \"}\""},
+    {"array", "\"[\" ws (value ws (\",\" ws value ws)*)? \"]\""},
+};
+
+const char* kWsRegex = "( |\\n[ \\t]{0,20})?";
+const char* kStringRegex = "\"([^\"\\\\\\x00-\\x1f\\x7f]|\\\\([\"\\\\/bfnrt]|u[0-9a-fA-F]{4}))*\"";
+const char* kIntegerRegex = "-?(0|[1-9][0-9]{0,15})";
+const char* kNumberRegex = "-?(0|[1-9][0-9]{0,15})(\\.[0-9]+)?([eE][-+]?[0-9]+)?";
+
+std::string scalarRegex() {
+    return std::string("(") + kStringRegex + "|" + kNumberRegex + "|true|false|null)";
+}
+
+// Regexes cannot recurse: open values are scalars or flat containers of them
+std::string anyRegex() {
+    std::string ws = kWsRegex, scalar = scalarRegex();
+    std::string array = "\\[" + ws + "(" + scalar + ws + "(," + ws + scalar + ws + ")*)?\\]";
+    std::string member = std::string(kStringRegex) + ws + ":" + ws + scalar + ws;
+    std::string object = "\\{" + ws + "(" + member + "(," + ws + member + ")*)?\\}";
+    return "(" + scalar + "|" + array + "|" + object + ")";
+}
+
+// Optional members o[i..] in order, any subset, at least one: o[i] followed
+// by each later one optionally, or a later one first
+template <typename F>
+std::string anySubset(size_t count, const std::string& sep, const std::string& space, F member) {
+    std::string out = "(";
+    for (size_t first = 0; first < count; ++first) {
+        if (first > 0) out += space + "|" + space;
+        out += member(first);
+        for (size_t j = first + 1; j < count; ++j) out += space + "(" + sep + member(j) + ")?";
+    }
+    return out + ")";
+}
+
+} // namespace
+
+// --- Compilation ------------------------------------------------------------
+
+ToolSchema::ToolSchema() : nodes(1) {}
+
+ToolSchema ToolSchema::compile(const json& parameters) {
+    ToolSchema schema;
+    schema.nodes.clear();
+    schema.compileNode(parameters, 0);
+    return schema;
+}
+
+int ToolSchema::compileNode(const json& schema, int depth) {
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    if (schema.is_boolean()) return index;
+    if (!schema.is_object()) throw SchemaError("a schema must be an object");
+    if (depth > kMaxSchemaDepth) return index; // unchecked below this
+
+    Node node;
+    if (schema.contains("type")) {
+        const json& type = schema["type"];
+        if (type.is_array()) {
+            node.types = 0;
+            for (const auto& t : type) node.types |= typeBit(t);
+        } else {
+            node.types = typeBit(type);
+        }
+    } else if (schema.contains("properties")) {
+        node.types = Object;
+    }
+
+    auto addEnum = [&](const json& value) {
+        node.enum_values.push_back(value.dump());
+        if (value.is_string()) node.enum_strings.push_back(value.get<std::string>());
+    };
+    if (schema.contains("const")) {
+        addEnum(schema["const"]);
+    } else if (schema.contains("enum")) {
+        if (!schema["enum"].is_array() || schema["enum"].empty()) throw SchemaError("\"enum\" must be a non-empty array");
+        for (const auto& value : schema["enum"]) addEnum(value);
+    }
+
+    if (schema.contains("properties")) {
+        const json& properties = schema["properties"];
+        if (!properties.is_object()) throw SchemaError("\"properties\" must be an object");
+        node.declared_properties = true;
+        for (auto it = properties.begin(); it != properties.end(); ++it) {
+            node.properties.push_back({it.key(), compileNode(it.value(), depth + 1), -1});
+        }
+    }
+    auto byName = [](const Property& p, const std::string& name) { return p.name < name; };
+    if (schema.contains("required")) {
+        if (!schema["required"].is_array()) throw SchemaError("\"required\" must be an array");
+        int bit = 0;
+        for (const auto& name : schema["required"]) {
+            if (!name.is_string()) throw SchemaError("\"required\" must list property names");
+            const std::string& key = name.get_ref<const std::string&>();
+            auto it = std::lower_bound(node.properties.begin(), node.properties.end(), key, byName);
+            if (it == node.properties.end() || it->name != key) {
+                // Required but undescribed: present with any value
+                int any = static_cast<int>(nodes.size());
+                nodes.emplace_back();
+                it = node.properties.insert(it, {key, any, -1});
+            }
+            if (it->required_bit >= 0 || bit >= 64) continue; // duplicate / past what a mask can hold
+            it->required_bit = bit;
+            node.required_mask |= uint64_t{1} << bit;
+            node.grammar_order.push_back(-1 - bit); // resolved below
+            ++bit;
+        }
+    }
+    // Required properties in "required" order, then the optional ones
+    for (int& entry : node.grammar_order) {
+        int bit = -1 - entry;
+        for (size_t p = 0; p < node.properties.size(); ++p) {
+            if (node.properties[p].required_bit == bit) entry = static_cast<int>(p);
+        }
+    }
+    for (size_t p = 0; p < node.properties.size(); ++p) {
+        if (node.properties[p].required_bit < 0) node.grammar_order.push_back(static_cast<int>(p));
+    }
+
+    if (schema.contains("additionalProperties")) {
+        const json& additional = schema["additionalProperties"];
+        if (additional.is_boolean()) {
+            node.additional_allowed = additional.get<bool>();
+        } else {
+            node.additional = compileNode(additional, depth + 1);
+        }
+    }
+    if (schema.contains("items") && schema["items"].is_object()) {
+        node.items = compileNode(schema["items"], depth + 1);
+    }
+
+    nodes[index] = std::move(node);
+    return index;
+}
+
+bool ToolSchema::validate(std::string_view arguments, std::string* error) const {
+    ArgumentValidator validator(*this);
+    validator.feed(arguments);
+    if (validator.finish()) return true;
+    if (error) *error = validator.error();
+    return false;
+}
+
+// --- Validation -------------------------------------------------------------
+
+ArgumentValidator::ArgumentValidator(const ToolSchema& schema) : schema(&schema) {
+    stack.reserve(8);
+}
+
+void ArgumentValidator::reset() {
+    stack.clear();
+    state = State::Value;
+    value_node = 0;
+    in_key = capture = false;
+    text.clear();
+    consumed = 0;
+    error_message.clear();
+}
+
+bool ArgumentValidator::feed(std::string_view chunk) {
+    if (failed()) return false;
+    const char* p = chunk.data();
+    const char* end = p + chunk.size();
+    while (p < end) {
+        if (state == State::String && !capture) {
+            // Runs of plain characters need no per-byte bookkeeping
+            const char* run = p;
+            while (run < end && kPlain.plain[static_cast<unsigned char>(*run)]) ++run;
+            consumed += static_cast<size_t>(run - p);
+            p = run;
+            if (p == end) break;
+        }
+        if (!step(*p)) return false;
+        ++consumed;
+        ++p;
+    }
+    return true;
+}
+
+bool ArgumentValidator::finish() {
+    if (failed()) return false;
+    switch (state) {
+    case State::NumZero: case State::NumInt: case State::NumFrac: case State::NumExpInt:
+        if (!endScalar()) return false;
+        break;
+    default:
+        break;
+    }
+    if (state != State::Done) return fail("incomplete JSON: input ended inside " + path());
+    return true;
+}
+
+bool ArgumentValidator::fail(const std::string& message) {
+    error_message = message + " (at byte " + std::to_string(consumed) + ")";
+    return false;
+}
+
+std::string ArgumentValidator::path(bool member) const {
+    std::string out = "$";
+    for (size_t i = 0; i < stack.size(); ++i) {
+        const Frame& frame = stack[i];
+        if (!member && i + 1 == stack.size()) break;
+        if (frame.object) {
+            if (!frame.key.empty()) out += "." + frame.key;
+        } else {
+            out += "[" + std::to_string(frame.index) + "]";
+        }
+    }
+    return out;
+}
+
+bool ArgumentValidator::prefixAllowed() const {
+    auto startsWith = [&](const std::string& candidate) { return candidate.compare(0, text.size(), text) == 0; };
+    if (in_key) {
+        int node = stack.back().node;
+        if (node < 0 || schema->nodes[node].additional_allowed) return true;
+        const auto& properties = schema->nodes[node].properties;
+        return std::any_of(properties.begin(), properties.end(),
+                           [&](const ToolSchema::Property& p) { return startsWith(p.name); });
+    }
+    const auto& strings = schema->nodes[value_node].enum_strings;
+    return std::any_of(strings.begin(), strings.end(), startsWith);
+}
+
+bool ArgumentValidator::beginValue(char c) {
+    uint8_t types = value_node < 0 ? uint8_t{ToolSchema::Any} : schema->nodes[value_node].types;
+    bool has_enum = value_node >= 0 && !schema->nodes[value_node].enum_values.empty();
+    uint8_t got;
+    switch (c) {
+    case '"': got = ToolSchema::String; break;
+    case '{': got = ToolSchema::Object; break;
+    case '[': got = ToolSchema::Array; break;
+    case 't': case 'f': got = ToolSchema::Boolean; break;
+    case 'n': got = ToolSchema::Null; break;
+    default:
+        if (c != '-' && !isDigit(c)) {
+            return fail(std::string("unexpected '") + c + "' where a value was expected at " + path());
+        }
+        got = ToolSchema::Integer | ToolSchema::Number;
+    }
+    if (!(types & got)) {
+        return fail("expected " + typeNames(types) + " at " + path() + ", got " +
+                    typeNames(got == (ToolSchema::Integer | ToolSchema::Number) ? uint8_t{ToolSchema::Number} : got));
+    }
+
+    capture = has_enum;
+    text.clear();
+    switch (c) {
+    case '"':
+        in_key = false;
+        state = State::String;
+        if (capture && schema->nodes[value_node].enum_strings.empty()) {
+            return fail("value at " + path() + " is not one of the allowed values");
+        }
+        return true;
+    case '{': case '[':
+        if (stack.size() >= kMaxDepth) return fail("nesting deeper than " + std::to_string(kMaxDepth) + " levels");
+        stack.emplace_back();
+        stack.back().node = value_node;
+        stack.back().object = c == '{';
+        state = c == '{' ? State::ObjectFirst : State::ArrayFirst;
+        return true;
+    case 't': case 'f': case 'n':
+        literal = c == 't' ? "rue" : c == 'f' ? "alse" : "ull";
+        text += c;
+        state = State::Literal;
+        return true;
+    default:
+        integer_only = !(types & ToolSchema::Number);
+        text += c;
+        state = c == '-' ? State::NumMinus : c == '0' ? State::NumZero : State::NumInt;
+        return true;
+    }
+}
+
+bool ArgumentValidator::endValue() {
+    if (stack.empty()) {
+        state = State::Done;
+    } else {
+        state = stack.back().object ? State::ObjectNext : State::ArrayNext;
+    }
+    return true;
+}
+
+bool ArgumentValidator::endScalar() {
+    if (capture) {
+        const auto& allowed = schema->nodes[value_node].enum_values;
+        if (std::find(allowed.begin(), allowed.end(), text) == allowed.end()) {
+            return fail("value at " + path() + " is not one of the allowed values");
+        }
+    }
+    capture = false;
+    return endValue();
+}
+
+bool ArgumentValidator::endString() {
+    if (!in_key) {
+        if (capture) {
+            const auto& allowed = schema->nodes[value_node].enum_strings;
+            if (std::find(allowed.begin(), allowed.end(), text) == allowed.end()) {
+                return fail("value at " + path() + " is not one of the allowed values");
+            }
+        }
+        capture = false;
+        return endValue();
+    }
+
+    Frame& frame = stack.back();
+    frame.key = text;
+    in_key = capture = false;
+    state = State::Colon;
+    if (frame.node < 0) {
+        value_node = -1;
+        return true;
+    }
+    const ToolSchema::Node& node = schema->nodes[frame.node];
+    auto it = std::lower_bound(node.properties.begin(), node.properties.end(), frame.key,
+                               [](const ToolSchema::Property& p, const std::string& name) { return p.name < name; });
+    if (it != node.properties.end() && it->name == frame.key) {
+        value_node = it->node;
+        if (it->required_bit >= 0) frame.seen |= uint64_t{1} << it->required_bit;
+        return true;
+    }
+    if (!node.additional_allowed) return fail("unknown property '" + frame.key + "' at " + path(false));
+    value_node = node.additional;
+    return true;
+}
+
+bool ArgumentValidator::closeContainer() {
+    Frame& frame = stack.back();
+    if (frame.object && frame.node >= 0) {
+        const ToolSchema::Node& node = schema->nodes[frame.node];
+        uint64_t missing = node.required_mask & ~frame.seen;
+        if (missing) {
+            for (const auto& property : node.properties) {
+                if (property.required_bit >= 0 && (missing >> property.required_bit) & 1) {
+                    return fail("missing required property '" + property.name + "' at " + path(false));
+                }
+            }
+        }
+    }
+    stack.pop_back();
+    return endValue();
+}
+
+bool ArgumentValidator::step(char c) {
+    switch (state) {
+    case State::Value:
+        if (isSpace(c)) return true;
+        return beginValue(c);
+
+    case State::ObjectFirst:
+    case State::ObjectKey:
+        if (isSpace(c)) return true;
+        if (c == '"') {
+            in_key = true;
+            capture = true;
+            text.clear();
+            state = State::String;
+            return true;
+        }
+        if (c == '}' && state == State::ObjectFirst) return closeContainer();
+        return fail(std::string("expected a property name at ") + path(false) + ", got '" + c + "'");
+
+    case State::Colon:
+        if (isSpace(c)) return true;
+        if (c == ':') {
+            state = State::Value;
+            return true;
+        }
+        return fail("expected ':' after '" + stack.back().key + "'");
+
+    case State::ObjectNext:
+        if (isSpace(c)) return true;
+        if (c == ',') {
+            state = State::ObjectKey;
+            return true;
+        }
+        if (c == '}') return closeContainer();
+        return fail(std::string("expected ',' or '}' after ") + path() + ", got '" + c + "'");
+
+    case State::ArrayFirst:
+        if (isSpace(c)) return true;
+        if (c == ']') return closeContainer();
+        value_node = stack.back().node < 0 ? -1 : schema->nodes[stack.back().node].items;
+        return beginValue(c);
+
+    case State::ArrayNext:
+        if (isSpace(c)) return true;
+        if (c == ',') {
+            stack.back().index++;
+            value_node = stack.back().node < 0 ? -1 : schema->nodes[stack.back().node].items;
+            state = State::Value;
+            return true;
+        }
+        if (c == ']') return closeContainer();
+        return fail(std::string("expected ',' or ']' after ") + path() + ", got '" + c + "'");
+
+    case State::String: {
+        auto u = static_cast<unsigned char>(c);
+        if (c == '"') return endString();
+        if (c == '\\') {
+            state = State::Escape;
+            return true;
+        }
+        if (u < 0x20) return fail("unescaped control character in a string at " + path());
+        if (u >= 0x80) {
+            if (u >= 0xC2 && u <= 0xDF) pending = 1;
+            else if (u >= 0xE0 && u <= 0xEF) pending = 2;
+            else if (u >= 0xF0 && u <= 0xF4) pending = 3;
+            else return fail("invalid UTF-8 in a string at " + path());
+            state = State::Utf8;
+        }
+        if (!capture) return true;
+        text += c;
+        if (pending == 0 && !prefixAllowed()) break;
+        return true;
+    }
+
+    case State::Utf8:
+        if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) return fail("invalid UTF-8 in a string at " + path());
+        if (--pending == 0) state = State::String;
+        if (!capture) return true;
+        text += c;
+        if (pending == 0 && !prefixAllowed()) break;
+        return true;
+
+    case State::Escape: {
+        static const std::string_view escapes = "\"\\/bfnrt";
+        static const char decoded[] = "\"\\/\b\f\n\r\t";
+        if (c == 'u') {
+            pending = 4;
+            code_point = 0;
+            state = State::Unicode;
+            return true;
+        }
+        size_t at = escapes.find(c);
+        if (at == std::string_view::npos) return fail(std::string("invalid escape '\\") + c + "' at " + path());
+        state = State::String;
+        if (!capture) return true;
+        text += decoded[at];
+        if (!prefixAllowed()) break;
+        return true;
+    }
+
+    case State::Unicode: {
+        int digit = isDigit(c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (digit < 0) return fail("invalid \\u escape at " + path());
+        code_point = code_point << 4 | static_cast<uint32_t>(digit);
+        if (--pending > 0) return true;
+        state = State::String;
+        if (!capture) return true;
+        appendUtf8(text, code_point);
+        if (!prefixAllowed()) break;
+        return true;
+    }
+
+    case State::Literal:
+        if (c != *literal) return fail("invalid literal at " + path());
+        if (capture) text += c;
+        if (*++literal == '\0') return endScalar();
+        return true;
+
+    case State::NumMinus:
+        if (!isDigit(c)) return fail("invalid number at " + path());
+        state = c == '0' ? State::NumZero : State::NumInt;
+        if (capture) text += c;
+        return true;
+
+    case State::NumZero:
+    case State::NumInt:
+    case State::NumFrac:
+    case State::NumExpInt:
+        if (isDigit(c) && state != State::NumZero) {
+            if (capture) text += c;
+            return true;
+        }
+        if ((c == '.' && (state == State::NumZero || state == State::NumInt)) ||
+            ((c == 'e' || c == 'E') && state != State::NumExpInt)) {
+            if (integer_only) return fail("expected integer at " + path() + ", got number");
+            state = c == '.' ? State::NumDot : State::NumExp;
+            if (capture) text += c;
+            return true;
+        }
+        // The number ended one byte ago; this byte belongs to what follows
+        if (!endScalar()) return false;
+        return step(c);
+
+    case State::NumDot:
+        if (!isDigit(c)) return fail("invalid number at " + path());
+        state = State::NumFrac;
+        if (capture) text += c;
+        return true;
+
+    case State::NumExp:
+        if (c == '+' || c == '-') {
+            state = State::NumExpSign;
+            if (capture) text += c;
+            return true;
+        }
+        [[fallthrough]];
+    case State::NumExpSign:
+        if (!isDigit(c)) return fail("invalid number at " + path());
+        state = State::NumExpInt;
+        if (capture) text += c;
+        return true;
+
+    case State::Done:
+        if (isSpace(c)) return true;
+        return fail("unexpected data after the arguments");
+    }
+
+    // A captured key or enum string that no allowed value starts with
+    if (in_key) return fail("unknown property '" + text + "...' at " + path(false));
+    return fail("value at " + path() + " is not one of the allowed values");
+}
+
+// --- Grammars ---------------------------------------------------------------
+
+struct ToolSchema::GrammarWriter {
+    std::string rules;                // defined rules, in definition order
+    std::set<std::string> names;      // rule names taken
+    std::set<std::string> primitives; // primitive rules referenced
+
+    void use(const std::string& primitive) {
+        if (!primitives.insert(primitive).second) return;
+        // What each primitive is written in terms of
+        if (primitive == "string") use("char");
+        if (primitive == "value") {
+            for (const char* p : {"object", "array", "string", "number", "boolean", "null"}) use(p);
+        }
+        if (primitive == "object" || primitive == "array") {
+            use("value");
+            use("ws");
+        }
+        if (primitive == "object") use("string");
+    }
+
+    std::string define(const std::string& wanted, const std::string& body) {
+        std::string name = wanted;
+        for (int n = 2; names.count(name); ++n) name = wanted + "-" + std::to_string(n);
+        names.insert(name);
+        rules += name + " ::= " + body + "\n";
+        return name;
+    }
+
+    std::string finish() {
+        std::string out = rules;
+        for (const auto& primitive : kPrimitiveGbnf) {
+            if (primitives.count(primitive[0])) out += std::string(primitive[0]) + " ::= " + primitive[1] + "\n";
+        }
+        return out;
+    }
+};
+
+std::string ToolSchema::refGbnf(int node, const std::string& rule, GrammarWriter& out) const {
+    std::string expr = nodeGbnf(node, rule, out);
+    bool simple = expr.find_first_of(" |()\"") == std::string::npos;
+    return simple ? expr : out.define(rule, expr);
+}
+
+std::string ToolSchema::nodeGbnf(int index, const std::string& rule, GrammarWriter& out) const {
+    if (index < 0) {
+        out.use("value");
+        return "value";
+    }
+    const Node& node = nodes[index];
+    if (!node.enum_values.empty()) {
+        std::string alternatives;
+        for (const auto& value : node.enum_values) {
+            if (!alternatives.empty()) alternatives += " | ";
+            alternatives += gbnfLiteral(value);
+        }
+        return node.enum_values.size() == 1 ? alternatives : "(" + alternatives + ")";
+    }
+    if (node.types == Any) {
+        out.use("value");
+        return "value";
+    }
+
+    std::vector<std::string> alternatives;
+    if (node.types & Null) alternatives.push_back("null");
+    if (node.types & Boolean) alternatives.push_back("boolean");
+    if (node.types & Number) alternatives.push_back("number");
+    else if (node.types & Integer) alternatives.push_back("integer");
+    if (node.types & String) alternatives.push_back("string");
+    for (const auto& primitive : alternatives) out.use(primitive);
+
+    if (node.types & Array) {
+        if (node.items < 0) {
+            out.use("array");
+            alternatives.push_back("array");
+        } else {
+            out.use("ws");
+            std::string item = refGbnf(node.items, rule + "-item", out);
+            alternatives.push_back("\"[\" ws (" + item + " ws (\",\" ws " + item + " ws)*)? \"]\"");
+        }
+    }
+    if (node.types & Object) {
+        if (!node.declared_properties) {
+            out.use("object");
+            alternatives.push_back("object");
+        } else {
+            out.use("ws");
+            std::vector<std::string> members;
+            size_t required = 0;
+            for (int p : node.grammar_order) {
+                const Property& property = node.properties[p];
+                if (property.required_bit >= 0) required++;
+                members.push_back(gbnfLiteral(json(property.name).dump()) + " ws \":\" ws " +
+                                  refGbnf(property.node, rule + "-" + ruleName(property.name), out) + " ws");
+            }
+            std::string body;
+            for (size_t i = 0; i < required; ++i) body += (i ? " \",\" ws " : " ") + members[i];
+            if (required > 0) {
+                for (size_t i = required; i < members.size(); ++i) body += " (\",\" ws " + members[i] + ")?";
+            } else if (!members.empty()) {
+                body = " " + anySubset(members.size(), "\",\" ws ", " ", [&](size_t i) { return members[i]; }) + "?";
+            }
+            alternatives.push_back("\"{\" ws" + body + " \"}\"");
+        }
+    }
+
+    if (alternatives.size() == 1) return alternatives[0];
+    std::string expr = "(";
+    for (size_t i = 0; i < alternatives.size(); ++i) expr += (i ? " | " : "") + alternatives[i];
+    return expr + ")";
+}
+
+std::string ToolSchema::gbnf(const std::string& name) const {
+    GrammarWriter out;
+    out.names.insert(name);
+    std::string root = nodeGbnf(0, name, out);
+    return name + " ::= " + root + "\n" + out.finish();
+}
+
+std::string ToolSchema::nodeRegex(int index) const {
+    if (index < 0) return anyRegex();
+    const Node& node = nodes[index];
+    if (!node.enum_values.empty()) {
+        std::string out = "(";
+        for (size_t i = 0; i < node.enum_values.size(); ++i) {
+            out += (i ? "|" : "") + regexLiteral(node.enum_values[i]);
+        }
+        return out + ")";
+    }
+    if (node.types == Any) return anyRegex();
+
+    std::string ws = kWsRegex;
+    std::vector<std::string> alternatives;
+    if (node.types & Null) alternatives.push_back("null");
+    if (node.types & Boolean) alternatives.push_back("(true|false)");
+    if (node.types & Number) alternatives.push_back(kNumberRegex);
+    else if (node.types & Integer) alternatives.push_back(kIntegerRegex);
+    if (node.types & String) alternatives.push_back(kStringRegex);
+    if (node.types & Array) {
+        std::string item = nodeRegex(node.items);
+        alternatives.push_back("\\[" + ws + "(" + item + ws + "(," + ws + item + ws + ")*)?\\]");
+    }
+    if (node.types & Object) {
+        if (!node.declared_properties) {
+            std::string scalar = scalarRegex();
+            std::string member = std::string(kStringRegex) + ws + ":" + ws + scalar + ws;
+            alternatives.push_back("\\{" + ws + "(" + member + "(," + ws + member + ")*)?\\}");
+        } else {
+            std::vector<std::string> members;
+            size_t required = 0;
+            for (int p : node.grammar_order) {
+                const Property& property = node.properties[p];
+                if (property.required_bit >= 0) required++;
+                members.push_back(regexLiteral(json(property.name).dump()) + ws + ":" + ws +
+                                  nodeRegex(property.node) + ws);
+            }
+            std::string body;
+            for (size_t i = 0; i < required; ++i) body += (i ? "," + ws : "") + members[i];
+            if (required > 0) {
+                for (size_t i = required; i < members.size(); ++i) body += "(," + ws + members[i] + ")?";
+            } else if (!members.empty()) {
+                body = anySubset(members.size(), "," + ws, "", [&](size_t i) { return members[i]; }) + "?";
+            }
+            alternatives.push_back("\\{" + ws + body + "\\}");
+        }
+    }
+
+    if (alternatives.size() == 1) return alternatives[0];
+    std::string out = "(";
+    for (size_t i = 0; i < alternatives.size(); ++i) out += (i ? "|" : "") + alternatives[i];
+    return out + ")";
+}
+
+std::string ToolSchema::regex() const {
+    return nodeRegex(0);
+}
+
+// --- Tool lists -------------------------------------------------------------
+
+ToolSchemas::ToolSchemas(const std::vector<json>& tools) {
+    for (const auto& tool : tools) {
+        if (!tool.contains("function") || !tool["function"].contains("name")) continue;
+        const json& function = tool["function"];
+        std::string name = function["name"].get<std::string>();
+        try {
+            json parameters = function.value("parameters", json{{"type", "object"}});
+            schemas.emplace_back(name, ToolSchema::compile(parameters));
+        } catch (const std::exception& e) {
+            LETTA_LOG_WARN("tools", "Tool schema not checked", {"tool", name}, {"error", e.what()});
+        }
+    }
+}
+
+const ToolSchema* ToolSchemas::find(const std::string& name) const {
+    for (const auto& entry : schemas) {
+        if (entry.first == name) return &entry.second;
+    }
+    return nullptr;
+}
+
+std::string ToolSchemas::gbnf() const {
+    ToolSchema::GrammarWriter out;
+    out.names.insert("root");
+    out.use("ws");
+    std::string calls;
+    for (const auto& [name, schema] : schemas) {
+        std::string rule = ruleName(name);
+        std::string args = schema.refGbnf(0, rule + "-args", out);
+        std::string call = out.define(rule + "-call", gbnfLiteral(json(name).dump()) + " ws \",\" ws " +
+                                      gbnfLiteral("\"arguments\"") + " ws \":\" ws " + args);
+        calls += (calls.empty() ? "" : " | ") + call;
+    }
+    if (calls.empty()) calls = "\"\\\"\\\"\""; // nothing to call: only an empty name
+    return "root ::= \"{\" ws " + gbnfLiteral("\"name\"") + " ws \":\" ws (" + calls + ") ws \"}\"\n" +
+           out.finish();
+}
+
+std::string ToolSchemas::regex() const {
+    std::string ws = kWsRegex;
+    std::string calls;
+    for (const auto& [name, schema] : schemas) {
+        if (!calls.empty()) calls += "|";
+        calls += regexLiteral(json(name).dump()) + ws + "," + ws + "\"arguments\"" + ws + ":" + ws + schema.regex();
+    }
+    return "\\{" + ws + "\"name\"" + ws + ":" + ws + "(" + calls + ")" + ws + "\\}";
+}
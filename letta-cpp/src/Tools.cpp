@@ -0,0 +1,55 @@
+#include "Tools.hpp"
+#include "Memory.hpp"
+
+bool Tools::is_memory_tool(const std::string& name) {
+    return name == "core_memory_append" || name == "core_memory_replace";
+}
+
+json Tools::execute_memory_tool(Memory& memory, const std::string& name, const json& arguments) {
+    if (name == "core_memory_append") {
+        std::string label = arguments.value("label", "");
+        std::string content = arguments.value("content", "");
+
+        // Shared blocks are edited under their writer lock, so appends from
+        // other agents are not lost. The prompt is re-rendered before the next
+        // LLM call (see Agent::refreshSystemPrompt).
+        BlockEdit result = memory.editBlock(label, [&](Rope& value) {
+            value += "\n";
+            value += content;
+            return true;
+        });
+        if (result == BlockEdit::NotFound) {
+            return {{"status", "ERROR"}, {"message", "Block not found: " + label}};
+        }
+        if (result != BlockEdit::Ok) {
+            return {{"status", "ERROR"}, {"message", "Failed to update block (maybe read-only?)"}};
+        }
+        return {{"status", "OK"}, {"message", "Memory block '" + label + "' updated."}};
+    }
+
+    if (name == "core_memory_replace") {
+        std::string label = arguments.value("label", "");
+        std::string old_content = arguments.value("old_content", "");
+        std::string new_content = arguments.value("new_content", "");
+
+        BlockEdit result = memory.editBlock(label, [&](Rope& value) {
+            size_t pos = value.find(old_content);
+            if (pos == std::string::npos) return false;
+            value.replace(pos, old_content.length(), new_content);
+            return true;
+        });
+        switch (result) {
+            case BlockEdit::Ok:
+                return {{"status", "OK"}, {"message", "Memory block '" + label + "' updated."}};
+            case BlockEdit::NotFound:
+                return {{"status", "ERROR"}, {"message", "Block not found: " + label}};
+            case BlockEdit::Rejected:
+                return {{"status", "ERROR"}, {"message", "Old content not found in block."}};
+            case BlockEdit::ReadOnly:
+                break;
+        }
+        return {{"status", "ERROR"}, {"message", "Failed to update block."}};
+    }
+
+    return {{"status", "ERROR"}, {"message", "Unknown tool: " + name}};
+}
@@ -0,0 +1,395 @@
+#include "letta_core.h"
+#include "Agent.hpp"
+#include "AgentFile.hpp"
+#include "AgentSnapshot.hpp"
+#include "LLMClient.hpp"
+#include "Memory.hpp"
+#include "MessageStore.hpp"
+#include "PromptTemplate.hpp"
+#include <string>
+#include <vector>
+
+struct letta_memory {
+    Memory memory;
+    std::string rendered;
+};
+
+struct letta_messages {
+    MessageStore store;
+    std::string serialized;
+};
+
+struct letta_client {
+    LLMClient client;
+    std::string url;
+    std::string headers;
+    std::string body;
+    std::string parsed;
+
+    letta_client(const std::string& key, const std::string& base_url, const std::string& model)
+        : client(key, base_url, model) {}
+};
+
+struct letta_agent {
+    Agent agent;
+    std::vector<std::string> replies;
+    std::string out;
+
+    letta_agent(const std::string& key, const std::string& model) : agent(key, model) {
+        agent.setMessageHandler([this](const std::string& reply) { replies.push_back(reply); });
+    }
+};
+
+struct letta_response {
+    HttpResponse response;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+std::string str(letta_str s) {
+    return s.data ? std::string(s.data, s.size) : std::string();
+}
+
+letta_str view(const std::string& s) {
+    return letta_str{s.data(), s.size()};
+}
+
+letta_status fail(letta_status status, std::string message) {
+    last_error = std::move(message);
+    return status;
+}
+
+// Run `body`, turning anything it throws into a status
+template <typename F>
+letta_status guard(F&& body) {
+    try {
+        letta_status status = body();
+        if (status == LETTA_OK) last_error.clear();
+        return status;
+    } catch (const json::parse_error& e) {
+        return fail(LETTA_ERROR_PARSE, e.what());
+    } catch (const TemplateError& e) {
+        return fail(LETTA_ERROR_PARSE, e.what());
+    } catch (const AgentFileError& e) {
+        return fail(LETTA_ERROR_IO, e.what());
+    } catch (const AgentSnapshotError& e) {
+        return fail(LETTA_ERROR_IO, e.what());
+    } catch (const json::exception& e) {
+        return fail(LETTA_ERROR_INVALID_ARGUMENT, e.what());
+    } catch (const std::invalid_argument& e) {
+        return fail(LETTA_ERROR_INVALID_ARGUMENT, e.what());
+    } catch (const std::exception& e) {
+        return fail(LETTA_ERROR_INTERNAL, e.what());
+    } catch (...) {
+        return fail(LETTA_ERROR_INTERNAL, "unknown error");
+    }
+}
+
+// Constructors that may throw return null with the reason recorded
+template <typename T, typename F>
+T* construct(F&& make) {
+    try {
+        T* object = make();
+        last_error.clear();
+        return object;
+    } catch (const std::exception& e) {
+        last_error = e.what();
+    } catch (...) {
+        last_error = "unknown error";
+    }
+    return nullptr;
+}
+
+letta_status nullHandle() {
+    return fail(LETTA_ERROR_INVALID_ARGUMENT, "null handle");
+}
+
+MemoryBlock makeBlock(letta_str label, letta_str value, int32_t limit, int read_only) {
+    MemoryBlock block;
+    block.label = str(label);
+    block.value = str(value);
+    block.limit = limit;
+    block.read_only = read_only != 0;
+    return block;
+}
+
+} // namespace
+
+extern "C" {
+
+uint32_t letta_core_abi_version(void) {
+    return LETTA_CORE_ABI_VERSION;
+}
+
+const char* letta_last_error(void) {
+    return last_error.c_str();
+}
+
+// --- Memory ---
+
+letta_memory* letta_memory_new(void) {
+    return construct<letta_memory>([] { return new letta_memory(); });
+}
+
+void letta_memory_free(letta_memory* memory) {
+    delete memory;
+}
+
+letta_status letta_memory_set_block(letta_memory* memory, letta_str label, letta_str value, int32_t limit,
+                                    int read_only) {
+    if (!memory) return nullHandle();
+    if (label.size == 0) return fail(LETTA_ERROR_INVALID_ARGUMENT, "empty block label");
+    return guard([&] {
+        memory->memory.addBlock(makeBlock(label, value, limit, read_only));
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_memory_remove_block(letta_memory* memory, letta_str label) {
+    if (!memory) return nullHandle();
+    return guard([&] {
+        std::string name = str(label);
+        if (!memory->memory.findBlock(name)) return fail(LETTA_ERROR_NOT_FOUND, "no block labelled " + name);
+        memory->memory.removeBlock(name);
+        return LETTA_OK;
+    });
+}
+
+size_t letta_memory_block_count(const letta_memory* memory) {
+    return memory ? memory->memory.getBlocks().size() : 0;
+}
+
+letta_status letta_memory_set_template(letta_memory* memory, letta_str source) {
+    if (!memory) return nullHandle();
+    return guard([&] {
+        memory->memory.setTemplate(source.size ? PromptTemplate::compile(std::string_view(source.data, source.size))
+                                               : nullptr);
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_memory_compile(letta_memory* memory, letta_str* out) {
+    if (!memory || !out) return nullHandle();
+    return guard([&] {
+        memory->memory.compileInto(memory->rendered);
+        *out = view(memory->rendered);
+        return LETTA_OK;
+    });
+}
+
+// --- Messages ---
+
+letta_messages* letta_messages_new(void) {
+    return construct<letta_messages>([] { return new letta_messages(); });
+}
+
+void letta_messages_free(letta_messages* messages) {
+    delete messages;
+}
+
+letta_status letta_messages_append_json(letta_messages* messages, letta_str text) {
+    if (!messages) return nullHandle();
+    return guard([&] {
+        json parsed = json::parse(text.data, text.data + text.size);
+        if (parsed.is_object()) parsed = json::array({std::move(parsed)});
+        if (!parsed.is_array()) return fail(LETTA_ERROR_INVALID_ARGUMENT, "expected a message object or array");
+        // Check every role first so a bad message appends nothing
+        for (size_t i = 0; i < parsed.size(); ++i) {
+            MessageRole role;
+            const json& m = parsed[i];
+            if (!m.is_object() || !m.contains("role") || !m["role"].is_string() ||
+                !parseRole(m["role"].get_ref<const std::string&>(), role)) {
+                return fail(LETTA_ERROR_INVALID_ARGUMENT, "message " + std::to_string(i) + " has no valid role");
+            }
+        }
+        for (const auto& m : parsed) messages->store.appendJson(m);
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_messages_append(letta_messages* messages, letta_role role, letta_str content) {
+    if (!messages) return nullHandle();
+    if (role < LETTA_ROLE_SYSTEM || role > LETTA_ROLE_TOOL) return fail(LETTA_ERROR_INVALID_ARGUMENT, "bad role");
+    return guard([&] {
+        messages->store.append(static_cast<MessageRole>(role), std::string_view(content.data, content.size));
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_messages_set_content(letta_messages* messages, size_t index, letta_str content) {
+    if (!messages) return nullHandle();
+    if (index >= messages->store.size()) return fail(LETTA_ERROR_INVALID_ARGUMENT, "message index out of range");
+    return guard([&] {
+        messages->store.setContent(index, std::string_view(content.data, content.size));
+        return LETTA_OK;
+    });
+}
+
+size_t letta_messages_size(const letta_messages* messages) {
+    return messages ? messages->store.size() : 0;
+}
+
+void letta_messages_clear(letta_messages* messages) {
+    if (messages) messages->store.clear();
+}
+
+letta_status letta_messages_to_json(letta_messages* messages, letta_str* out) {
+    if (!messages || !out) return nullHandle();
+    return guard([&] {
+        messages->serialized = messages->store.toJson().dump(-1, ' ', false, json::error_handler_t::replace);
+        *out = view(messages->serialized);
+        return LETTA_OK;
+    });
+}
+
+// --- Provider adapters ---
+
+letta_client* letta_client_new(letta_str api_key, letta_str base_url, letta_str model) {
+    return construct<letta_client>([&] { return new letta_client(str(api_key), str(base_url), str(model)); });
+}
+
+void letta_client_free(letta_client* client) {
+    delete client;
+}
+
+letta_status letta_client_build_request(letta_client* client, const letta_messages* messages, letta_str tools_json,
+                                        letta_str* url, letta_str* headers_json, letta_str* body) {
+    if (!client || !messages || !url || !headers_json || !body) return nullHandle();
+    return guard([&] {
+        std::vector<json> tools;
+        if (tools_json.size) {
+            json parsed = json::parse(tools_json.data, tools_json.data + tools_json.size);
+            if (!parsed.is_array()) return fail(LETTA_ERROR_INVALID_ARGUMENT, "tools must be a JSON array");
+            tools = parsed.get<std::vector<json>>();
+        }
+        HttpRequest request = client->client.prepareRequest(messages->store, tools);
+        client->url = std::move(request.url);
+        client->headers = json(request.headers).dump();
+        client->body = std::move(request.body);
+        *url = view(client->url);
+        *headers_json = view(client->headers);
+        *body = view(client->body);
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_client_parse_response(letta_client* client, long status_code, letta_str body, letta_str* out) {
+    if (!client || !out) return nullHandle();
+    return guard([&] {
+        HttpResponse response{status_code, str(body), "", {}};
+        client->parsed = client->client.normalizeResponse(response).dump(-1, ' ', false, json::error_handler_t::replace);
+        *out = view(client->parsed);
+        return LETTA_OK;
+    });
+}
+
+// --- Agent ---
+
+void letta_response_set(letta_response* response, long status_code, letta_str body) {
+    if (!response) return;
+    response->response.status_code = status_code;
+    response->response.text = str(body);
+}
+
+letta_agent* letta_agent_new(letta_str api_key, letta_str model) {
+    return construct<letta_agent>([&] {
+        std::string name = str(model);
+        return new letta_agent(str(api_key), name.empty() ? "gemini-2.5-flash" : name);
+    });
+}
+
+void letta_agent_free(letta_agent* agent) {
+    delete agent;
+}
+
+letta_status letta_agent_set_transport(letta_agent* agent, letta_transport_fn transport, void* user) {
+    if (!agent) return nullHandle();
+    if (!transport) return fail(LETTA_ERROR_INVALID_ARGUMENT, "null transport");
+    return guard([&] {
+        agent->agent.getLLMClient().setTransport([transport, user](const HttpRequest& request,
+                                                                    const std::atomic<bool>&) {
+            std::string headers = json(request.headers).dump();
+            letta_response response;
+            response.response.error = "transport left the response unset";
+            transport(user, view(request.url), view(headers), view(request.body), &response);
+            if (response.response.status_code != 0) response.response.error.clear();
+            return response.response;
+        });
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_agent_set_block(letta_agent* agent, letta_str label, letta_str value, int32_t limit,
+                                   int read_only) {
+    if (!agent) return nullHandle();
+    if (label.size == 0) return fail(LETTA_ERROR_INVALID_ARGUMENT, "empty block label");
+    return guard([&] {
+        agent->agent.addMemoryBlock(str(label), str(value), limit, read_only != 0);
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_agent_step(letta_agent* agent, letta_str user_message, letta_str* replies_json) {
+    if (!agent || !replies_json) return nullHandle();
+    return guard([&] {
+        agent->replies.clear();
+        agent->agent.step(str(user_message));
+        agent->out = json(agent->replies).dump(-1, ' ', false, json::error_handler_t::replace);
+        *replies_json = view(agent->out);
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_agent_memory(letta_agent* agent, letta_str* out) {
+    if (!agent || !out) return nullHandle();
+    return guard([&] {
+        agent->out = agent->agent.getMemoryDump();
+        *out = view(agent->out);
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_agent_messages_json(letta_agent* agent, letta_str* out) {
+    if (!agent || !out) return nullHandle();
+    return guard([&] {
+        agent->out = agent->agent.getMessages().toJson().dump(-1, ' ', false, json::error_handler_t::replace);
+        *out = view(agent->out);
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_agent_import(letta_agent* agent, const char* path) {
+    if (!agent || !path) return nullHandle();
+    return guard([&] {
+        agent->agent.restore(AgentFile::read(std::string(path)));
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_agent_export(letta_agent* agent, const char* path) {
+    if (!agent || !path) return nullHandle();
+    return guard([&] {
+        AgentFile::write(std::string(path), agent->agent.snapshot());
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_agent_load_snapshot(letta_agent* agent, const char* path) {
+    if (!agent || !path) return nullHandle();
+    return guard([&] {
+        agent->agent.restore(AgentSnapshot::read(path));
+        return LETTA_OK;
+    });
+}
+
+letta_status letta_agent_save_snapshot(letta_agent* agent, const char* path) {
+    if (!agent || !path) return nullHandle();
+    return guard([&] {
+        AgentSnapshot::write(path, agent->agent.snapshot());
+        return LETTA_OK;
+    });
+}
+
+} // extern "C"
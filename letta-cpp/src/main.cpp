@@ -1,9 +1,103 @@
 #include "Agent.hpp"
+#include "Log.hpp"
+#include "TelemetryExport.hpp"
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <memory>
 #include <string>
 #include <cstdlib>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <csignal>
+#include <pthread.h>
+
+namespace {
+
+// The REPL's input side: lines typed at any time, plus Ctrl-C, which is
+// taken synchronously by a signal thread rather than by a handler
+class ReplInput {
+public:
+    ReplInput() {
+        // Blocked here, before any other thread exists, so every thread
+        // inherits the mask and only sigwait() sees the signal
+        sigemptyset(&interrupts);
+        sigaddset(&interrupts, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &interrupts, nullptr);
+    }
+
+    void readLines() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            // A new message supersedes the step in progress; other commands
+            // wait their turn
+            bool interrupts_step = line == "/cancel" || line == "quit" || line == "exit" ||
+                                   (!line.empty() && line[0] != '/');
+            if (running && interrupts_step) running->cancel();
+            lines.push_back(std::move(line));
+            changed.notify_all();
+        }
+        // End of input lets queued work finish, so piped scripts still run
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        changed.notify_all();
+    }
+
+    void watchInterrupts() {
+        int signal = 0;
+        while (sigwait(&interrupts, &signal) == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (running) {
+                running->cancel();
+                continue;
+            }
+            // Ctrl-C at the prompt leaves, as it did before input was threaded
+            lines.push_back("quit");
+            changed.notify_all();
+        }
+    }
+
+    // Next line to act on; false once input is closed and drained
+    bool next(std::string& line) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (lines.empty() && !closed) prompt();
+        changed.wait(lock, [this] { return !lines.empty() || closed; });
+        if (lines.empty()) return false;
+        line = std::move(lines.front());
+        lines.pop_front();
+        return true;
+    }
+
+    CancellationToken beginStep() {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = CancellationToken();
+        return *running;
+    }
+
+    void endStep() {
+        std::lock_guard<std::mutex> lock(mutex);
+        running.reset();
+    }
+
+private:
+    sigset_t interrupts;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::string> lines;
+    bool closed = false;
+    std::optional<CancellationToken> running;
+
+    static void prompt() { std::cout << "\033[1;34mYou: \033[0m" << std::flush; }
+};
+
+} // namespace
 
 int main() {
+    ReplInput input; // first, so every thread started below masks SIGINT
     const char* api_key_env = std::getenv("GEMINI_API_KEY");
     if (!api_key_env) {
         std::cerr << "Error: GEMINI_API_KEY environment variable not set." << std::endl;
@@ -11,19 +105,62 @@ int main() {
     }
     std::string api_key = api_key_env;
 
+    if (const char* log_level = std::getenv("LETTA_LOG_LEVEL")) {
+        Log::setLevel(Log::parseLevel(log_level));
+    }
+
+    // Optional telemetry: LETTA_METRICS_PORT serves Prometheus text on /metrics,
+    // LETTA_OTLP_ENDPOINT / LETTA_OTLP_FILE export spans (see otel/ for a collector).
+    PrometheusEndpoint metrics_endpoint;
+    std::unique_ptr<OtlpExporter> otlp_exporter;
+    const char* metrics_port = std::getenv("LETTA_METRICS_PORT");
+    const char* otlp_endpoint = std::getenv("LETTA_OTLP_ENDPOINT");
+    const char* otlp_file = std::getenv("LETTA_OTLP_FILE");
+    if (metrics_port || otlp_endpoint || otlp_file) {
+        Telemetry::setEnabled(true);
+    }
+    if (metrics_port && !metrics_endpoint.start(std::atoi(metrics_port))) {
+        std::cerr << "Warning: could not serve metrics on port " << metrics_port << std::endl;
+    }
+    if (otlp_endpoint || otlp_file) {
+        OtlpExporterOptions options;
+        if (otlp_endpoint) options.endpoint = otlp_endpoint;
+        if (otlp_file) options.file_path = otlp_file;
+        otlp_exporter = std::make_unique<OtlpExporter>(options);
+        otlp_exporter->start();
+    }
+
     std::cout << "Initializing Letta C++ Agent..." << std::endl;
     Agent agent(api_key);
+
+    // LETTA_PROMPT_TEMPLATE: file with a custom system prompt template
+    if (const char* template_path = std::getenv("LETTA_PROMPT_TEMPLATE")) {
+        std::ifstream file(template_path);
+        std::stringstream source;
+        source << file.rdbuf();
+        try {
+            if (!file) throw TemplateError(std::string("cannot read ") + template_path);
+            agent.setPromptTemplate(PromptTemplate::compile(source.str()));
+        } catch (const TemplateError& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
     
     std::cout << "Agent Initialized.\n" << std::endl;
     std::cout << "Current Memory:\n" << "----------------\n" << agent.getMemoryDump() << "\n----------------\n" << std::endl;
-    std::cout << "Starting chat. Type 'quit' or 'exit' to leave.\n" << std::endl;
+    std::cout << "Starting chat. Type 'quit' or 'exit' to leave.\n"
+              << "Typing while the agent works interrupts it and sends the new message instead;\n"
+              << "'/cancel' or Ctrl-C just stops it.\n" << std::endl;
 
-    std::string user_input;
-    while (true) {
-        std::cout << "\033[1;34mYou: \033[0m";
-        std::getline(std::cin, user_input);
+    // Input is read on its own thread so it can cancel a step that is still
+    // running; lines are handed to this thread, which runs the steps
+    std::thread([&input] { input.readLines(); }).detach();
+    std::thread([&input] { input.watchInterrupts(); }).detach();
 
-        if (user_input == "quit" || user_input == "exit") {
+    while (true) {
+        std::string user_input;
+        if (!input.next(user_input) || user_input == "quit" || user_input == "exit") {
             break;
         }
 
@@ -39,12 +176,19 @@ int main() {
             continue;
         }
 
-        if (user_input.empty()) continue;
+        if (user_input.empty() || user_input == "/cancel") continue;
 
-        agent.step(user_input);
-        
-        // Debug dump memory occasionally or on request?
-        // std::cout << "[Debug] Memory State:\n" << agent.getMemoryDump() << std::endl;
+        CancellationToken cancel = input.beginStep();
+        bool finished = agent.step(user_input, cancel);
+        input.endStep();
+        // Let the step's diagnostics land before the next prompt
+        Log::flush();
+        if (!finished) {
+            auto latency = std::chrono::steady_clock::now() - cancel.cancelledAt();
+            std::cout << "[step cancelled; stopped "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(latency).count() << " ms after the request]\n"
+                      << std::endl;
+        }
     }
 
     return 0;
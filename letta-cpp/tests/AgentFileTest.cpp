@@ -0,0 +1,252 @@
+#include "AgentFile.hpp"
+#include "AgentSnapshot.hpp"
+#include "Agent.hpp"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+
+std::string tempPath(const std::string& name) {
+    return "/tmp/letta-agentfile-test-" + std::to_string(getpid()) + "-" + name;
+}
+
+json textParts(const std::string& text) {
+    return json::array({{{"type", "text"}, {"text", text}}});
+}
+
+// A trimmed-down export from the Python server, keys sorted as it writes them
+json lettaExport() {
+    json send_message_schema = {{"name", "send_message"},
+                                {"description", "Sends a message to the human user."},
+                                {"parameters", {{"type", "object"}, {"properties", {{"message", {{"type", "string"}}}}}}}};
+    json search_schema = {{"name", "web_search"},
+                          {"description", "Search the web."},
+                          {"parameters", {{"type", "object"}, {"properties", {{"query", {{"type", "string"}}}}}}}};
+    return {
+        {"agent_type", "memgpt_agent"},
+        {"core_memory", {{{"label", "persona"}, {"value", "I am Sam."}, {"limit", 5000}, {"read_only", false}},
+                         {{"label", "human"}, {"value", "Name: Chad"}, {"limit", 2000}, {"read_only", true}}}},
+        {"description", "exported"},
+        {"in_context_message_indices", {0, 2, 3, 4}},
+        {"llm_config", {{"model", "gpt-4o-mini"}, {"context_window", 128000}}},
+        {"messages",
+         {{{"role", "system"}, {"content", textParts("You are Sam.")}, {"id", "message-0"}},
+          {{"role", "user"}, {"content", textParts("evicted long ago")}},
+          {{"role", "user"}, {"content", textParts("hello")}, {"created_at", "2025-01-01T00:00:00Z"}},
+          {{"role", "assistant"},
+           {"content", json::array()},
+           {"tool_calls",
+            {{{"id", "call_1"}, {"type", "function"},
+              {"function", {{"name", "send_message"}, {"arguments", "{\"message\":\"hi Chad\"}"}}}}}}},
+          {{"role", "tool"}, {"text", "{\"status\":\"OK\"}"}, {"tool_call_id", "call_1"}, {"name", "send_message"}}}},
+        {"name", "sam"},
+        {"system", "You are Sam."},
+        {"tags", {"demo"}},
+        {"tools",
+         {{{"name", "send_message"}, {"json_schema", send_message_schema}, {"tool_type", "letta_core"}},
+          {{"name", "web_search"}, {"json_schema", search_schema}, {"source_code", "def web_search(query): ..."},
+           {"tool_type", "custom"}}}},
+    };
+}
+
+AgentState importJson(const json& document, AgentFileStats* stats = nullptr) {
+    std::istringstream in(document.dump());
+    return AgentFile::read(in, stats);
+}
+
+} // namespace
+
+TEST(AgentFileTest, ImportsLettaExport) {
+    AgentFileStats stats;
+    AgentState state = importJson(lettaExport(), &stats);
+
+    EXPECT_EQ(state.name, "sam");
+    EXPECT_EQ(state.model, "gpt-4o-mini");
+    EXPECT_EQ(state.system, "You are Sam.");
+    ASSERT_EQ(state.blocks.size(), 2u);
+    EXPECT_EQ(state.blocks[1].label, "human");
+    EXPECT_EQ(state.blocks[1].value.str(), "Name: Chad");
+    EXPECT_EQ(state.blocks[1].limit, 2000);
+    EXPECT_TRUE(state.blocks[1].read_only);
+
+    // The evicted message was dropped as it streamed past
+    EXPECT_EQ(stats.messages_read, 5u);
+    EXPECT_EQ(stats.messages_kept, 4u);
+    ASSERT_EQ(state.messages.size(), 4u);
+    EXPECT_EQ(state.messages[1].content(), "hello");
+    ASSERT_EQ(state.messages[2].toolCallCount(), 1u);
+    EXPECT_EQ(state.messages[2].toolCall(0).arguments, "{\"message\":\"hi Chad\"}");
+    EXPECT_EQ(state.messages[3].toolCallId(), "call_1");
+    EXPECT_EQ(state.messages[3].content(), "{\"status\":\"OK\"}");
+
+    ASSERT_EQ(state.tools.size(), 2u);
+    EXPECT_EQ(state.tools[1]["function"]["name"], "web_search");
+    EXPECT_EQ(state.tool_records[1]["source_code"], "def web_search(query): ...");
+    EXPECT_EQ(state.extra["tags"], json::array({"demo"}));
+    EXPECT_EQ(state.extra["llm_config"]["context_window"], 128000);
+}
+
+TEST(AgentFileTest, IndicesAfterMessagesSelectAndOrder) {
+    json document = lettaExport();
+    json indices = json::array({2, 0});
+    document.erase("in_context_message_indices");
+    std::string text = document.dump();
+    text.back() = ',';
+    text += "\"in_context_message_indices\":" + indices.dump() + "}";
+
+    std::istringstream in(text);
+    AgentState state = AgentFile::read(in);
+    ASSERT_EQ(state.messages.size(), 2u);
+    EXPECT_EQ(state.messages[0].content(), "hello");
+    EXPECT_EQ(state.messages[1].role(), MessageRole::System);
+
+    document.erase("in_context_message_indices");
+    EXPECT_EQ(importJson(document).messages.size(), 5u); // no indices: everything is in context
+}
+
+TEST(AgentFileTest, ExportReimportsAndRestores) {
+    AgentState original = importJson(lettaExport());
+    std::ostringstream out;
+    AgentFile::write(out, original);
+
+    json exported = json::parse(out.str());
+    EXPECT_EQ(exported["in_context_message_indices"], json::array({0, 1, 2, 3}));
+    EXPECT_EQ(exported["messages"][1]["content"], textParts("hello"));
+    EXPECT_EQ(exported["tags"], json::array({"demo"}));
+    EXPECT_EQ(exported["tools"][1]["source_code"], "def web_search(query): ...");
+
+    std::istringstream in(out.str());
+    AgentState again = AgentFile::read(in);
+    EXPECT_EQ(again.messages.toJson(), original.messages.toJson());
+    EXPECT_EQ(again.tools, original.tools);
+    EXPECT_EQ(again.extra["llm_config"], original.extra["llm_config"]);
+    ASSERT_EQ(again.blocks.size(), 2u);
+    EXPECT_EQ(again.blocks[0].value.str(), "I am Sam.");
+
+    Agent agent("key");
+    agent.restore(std::move(again));
+    EXPECT_NE(agent.getMemoryDump().find("Name: Chad"), std::string::npos);
+    ASSERT_EQ(agent.getMessages().size(), 4u);
+    EXPECT_EQ(agent.getMessages()[1].content(), "hello");
+
+    // The restored agent exports what it was given, plus its own tools
+    AgentState round = agent.snapshot();
+    EXPECT_EQ(round.name, "sam");
+    EXPECT_EQ(round.tool_records.size(), 2u);
+    EXPECT_EQ(round.messages.size(), 4u);
+    std::ostringstream reexported;
+    AgentFile::write(reexported, round);
+    json tools = json::parse(reexported.str())["tools"];
+    bool has_memory_tool = false;
+    for (const auto& tool : tools) has_memory_tool |= tool["name"] == "core_memory_append";
+    EXPECT_TRUE(has_memory_tool);
+}
+
+TEST(AgentFileTest, MalformedFilesThrow) {
+    std::string good = lettaExport().dump();
+    std::vector<std::string> bad = {
+        good.substr(0, good.size() / 2),
+        "[]",
+        "{\"messages\":{}}",
+        "{\"messages\":[{\"role\":\"narrator\"}]}",
+        "{\"messages\":[1]}",
+        "{\"in_context_message_indices\":[7],\"messages\":[]}",
+        "{\"in_context_message_indices\":[-1]}",
+        "{\"core_memory\":[{\"value\":\"x\"}]}",
+        // Indices far past any message must not be allocated for
+        "{\"in_context_message_indices\":[4000000000],\"messages\":[{\"role\":\"user\",\"text\":\"hi\"}]}",
+        "{\"in_context_message_indices\":[18446744073709551615],\"messages\":[]}",
+        "{} {}",
+    };
+    for (const auto& text : bad) {
+        std::istringstream in(text);
+        EXPECT_THROW(AgentFile::read(in), AgentFileError) << text;
+    }
+    EXPECT_THROW(AgentFile::read(tempPath("missing.af")), AgentFileError);
+}
+
+TEST(AgentFileTest, MalformedSnapshotsThrow) {
+    AgentState state;
+    state.blocks.push_back(MemoryBlock{"human", "Name: Ada", 2000, false});
+    state.messages.appendAssistant("", {ToolCallView{"call_1", "send_message", "{}"}});
+    state.messages.appendToolResult("call_1", "send_message", "{\"status\":\"OK\"}");
+    std::string path = tempPath("corrupt.snap");
+    AgentSnapshot::write(path, state);
+    std::string good;
+    {
+        std::ifstream in(path, std::ios::binary);
+        good.assign(std::istreambuf_iterator<char>(in), {});
+    }
+
+    // Overwrite a uint32_t `index` entries into section `kind`
+    auto corrupt = [&](uint32_t kind, size_t index, uint32_t value) {
+        std::string bytes = good;
+        uint32_t sections;
+        std::memcpy(&sections, &bytes[16], sizeof(sections));
+        for (uint32_t i = 0; i < sections; ++i) {
+            const char* entry = &bytes[32 + 24 * i];
+            uint32_t section_kind;
+            uint64_t offset;
+            std::memcpy(&section_kind, entry, sizeof(section_kind));
+            std::memcpy(&offset, entry + 8, sizeof(offset));
+            if (section_kind == kind) std::memcpy(&bytes[offset + 4 * index], &value, sizeof(value));
+        }
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    };
+
+    corrupt(2, 0, 0xFFFFFFFFu); // blocks: a count no section could hold
+    EXPECT_THROW(AgentSnapshot::read(path), AgentSnapshotError);
+    corrupt(5, 1, 2); // call index: both calls to the assistant, none to the tool result
+    EXPECT_THROW(AgentSnapshot::read(path), AgentSnapshotError);
+    corrupt(5, 1, 1); // unchanged
+    EXPECT_EQ(AgentSnapshot::read(path).messages.toJson(), state.messages.toJson());
+    std::remove(path.c_str());
+}
+
+TEST(AgentFileTest, SnapshotRoundTrip) {
+    AgentState state = importJson(lettaExport());
+    state.messages.append(MessageRole::User, std::string(100000, 'x'));
+    std::string path = tempPath("agent.snap");
+    AgentSnapshot::write(path, state);
+
+    AgentState loaded = AgentSnapshot::read(path);
+    EXPECT_EQ(loaded.messages.toJson(), state.messages.toJson());
+    EXPECT_EQ(loaded.name, state.name);
+    EXPECT_EQ(loaded.model, state.model);
+    EXPECT_EQ(loaded.tools, state.tools);
+    EXPECT_EQ(loaded.tool_records, state.tool_records);
+    EXPECT_EQ(loaded.extra, state.extra);
+    ASSERT_EQ(loaded.blocks.size(), 2u);
+    EXPECT_EQ(loaded.blocks[1].value.str(), "Name: Chad");
+    EXPECT_TRUE(loaded.blocks[1].read_only);
+
+    // Forked and edited histories serialise their current content
+    Agent agent("key");
+    agent.restore(std::move(loaded));
+    AgentState snap = agent.snapshot();
+    AgentSnapshot::write(path, snap);
+    EXPECT_EQ(AgentSnapshot::read(path).messages.toJson(), agent.getMessages().toJson());
+
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    auto corrupt = [&](size_t at, char value, size_t keep) {
+        std::string copy = bytes.substr(0, keep);
+        if (at < copy.size()) copy[at] = value;
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << copy;
+        EXPECT_THROW(AgentSnapshot::read(path), AgentSnapshotError) << at << " " << keep;
+    };
+    corrupt(0, 'X', bytes.size());                    // magic
+    corrupt(8, 9, bytes.size());                      // version
+    corrupt(bytes.size(), 0, bytes.size() - 8);       // truncated
+    corrupt(32 + 2 * 24 + 8, 1, bytes.size());        // misaligned roles section
+    corrupt(32 + 2 * 24 + 23, 0x7f, bytes.size());    // roles length past the end
+    std::remove(path.c_str());
+}
@@ -1,5 +1,6 @@
 #include "Agent.hpp"
 #include <gtest/gtest.h>
+#include <thread>
 
 class AgentTest : public ::testing::Test {
 protected:
@@ -33,3 +34,104 @@ TEST_F(AgentTest, RemoveMemoryBlock) {
     std::string dump2 = agent.getMemoryDump();
     EXPECT_EQ(dump2.find("temp_block"), std::string::npos);
 }
+
+TEST(AgentSharedMemoryTest, EditThroughOneAgentReachesAnother) {
+    auto policy = std::make_shared<SharedBlock>(MemoryBlock{"policy", "Be polite.", 2000, false});
+    Agent writer("key");
+    Agent reader("key");
+    writer.attachSharedBlock(policy);
+    reader.attachSharedBlock(policy);
+
+    writer.setMessageHandler([](const std::string&) {});
+    reader.setMessageHandler([](const std::string&) {});
+    int writer_calls = 0;
+    writer.getLLMClient().setTransport([&](const HttpRequest&, const std::atomic<bool>&) {
+        json call = writer_calls++ == 0
+            ? json{{"name", "core_memory_append"}, {"args", {{"label", "policy"}, {"content", "Never share secrets."}}}}
+            : json{{"name", "send_message"}, {"args", {{"message", "done"}}}};
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+    std::string reader_request;
+    reader.getLLMClient().setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        reader_request = req.body;
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", {{"name", "send_message"}, {"args", {{"message", "ok"}}}}}}}}}}}}}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+
+    writer.step("remember the new rule");
+    reader.step("hi");
+
+    EXPECT_NE(reader_request.find("Never share secrets."), std::string::npos);
+    EXPECT_NE(reader.getMessages()[0].content().find("Never share secrets."), std::string_view::npos);
+}
+
+TEST(AgentForkTest, ForksDivergeAndStepConcurrently) {
+    Agent parent("key");
+    parent.setMessageHandler([](const std::string&) {});
+    parent.addMemoryBlock("notes", "base", 2000, false);
+    std::atomic<int> calls{0};
+    parent.getLLMClient().setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        calls++;
+        // Remember whatever variant the user message names, then answer
+        size_t last_user = req.body.rfind("\"role\":\"user\"");
+        size_t last_result = req.body.rfind("functionResponse");
+        bool answered = last_result != std::string::npos && last_result > last_user;
+        size_t at = req.body.find("variant ", last_user);
+        std::string variant = req.body.substr(at, 9);
+        json call = answered
+            ? json{{"name", "send_message"}, {"args", {{"message", variant}}}}
+            : json{{"name", "core_memory_append"}, {"args", {{"label", "notes"}, {"content", variant}}}};
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+    parent.step("variant 0");
+    size_t base_size = parent.getMessages().size();
+
+    std::vector<std::unique_ptr<Agent>> forks;
+    for (int i = 1; i <= 4; ++i) forks.push_back(parent.fork());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i] { forks[i]->step("variant " + std::to_string(i + 1)); });
+    }
+    for (auto& t : threads) t.join();
+
+    EXPECT_EQ(parent.getMessages().size(), base_size);
+    EXPECT_EQ(parent.getMemoryDump().find("variant 1"), std::string::npos);
+    for (int i = 0; i < 4; ++i) {
+        std::string dump = forks[i]->getMemoryDump();
+        EXPECT_NE(dump.find("variant 0"), std::string::npos);
+        EXPECT_NE(dump.find("variant " + std::to_string(i + 1)), std::string::npos);
+        for (int j = 1; j <= 4; ++j) {
+            if (j != i + 1) {
+                EXPECT_EQ(dump.find("variant " + std::to_string(j)), std::string::npos);
+            }
+        }
+        EXPECT_NE(forks[i]->getId(), parent.getId());
+        EXPECT_EQ(forks[i]->getMessages()[1].content(), "variant 0");
+    }
+}
+
+TEST(AgentForkTest, ForkOfSleepTimeAgentOwnsItsBlocks) {
+    Agent parent("key");
+    parent.enableSleepTime();
+    auto child = parent.fork();
+    EXPECT_EQ(child->getSleepTimeAgent(), nullptr);
+
+    child->setMessageHandler([](const std::string&) {});
+    std::string request;
+    child->getLLMClient().setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        request = req.body;
+        json call = request.find("functionResponse") == std::string::npos
+            ? json{{"name", "core_memory_append"}, {"args", {{"label", "human"}, {"content", "fork fact"}}}}
+            : json{{"name", "send_message"}, {"args", {{"message", "ok"}}}};
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+    child->step("hi");
+
+    // The fork edits memory itself again, and not through the parent's blocks
+    EXPECT_NE(request.find("core_memory_append"), std::string::npos);
+    EXPECT_NE(child->getMemoryDump().find("fork fact"), std::string::npos);
+    EXPECT_EQ(parent.getMemoryDump().find("fork fact"), std::string::npos);
+}
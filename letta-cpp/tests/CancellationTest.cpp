@@ -0,0 +1,274 @@
+#include "Agent.hpp"
+#include "Cancellation.hpp"
+#include "LLMClient.hpp"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A provider that takes `delay` to answer and, like the curl transport,
+// notices cancellation within a millisecond or so
+HttpTransport slowProvider(std::chrono::milliseconds delay, std::atomic<int>& calls, json call) {
+    return [delay, &calls, call](const HttpRequest&, const std::atomic<bool>& cancelled) {
+        calls++;
+        auto until = Clock::now() + delay;
+        while (Clock::now() < until) {
+            if (cancelled.load()) return HttpResponse{0, "", "cancelled", {}};
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+        return HttpResponse{200, body.dump(), "", {}};
+    };
+}
+
+json sendMessage() {
+    return {{"name", "send_message"}, {"args", {{"message", "done"}}}};
+}
+
+// Cancel `token` after `after`, from another thread
+std::thread cancelLater(CancellationToken token, std::chrono::milliseconds after) {
+    return std::thread([token, after]() mutable {
+        std::this_thread::sleep_for(after);
+        token.cancel();
+    });
+}
+
+// How long after cancel() the call gave control back, in ms; shown in the
+// test output and recorded as a property
+double reportLatency(const char* what, const CancellationToken& token, Clock::time_point returned) {
+    double ms = std::chrono::duration<double, std::milli>(returned - token.cancelledAt()).count();
+    std::printf("[  LATENCY ] %s: %.2f ms after cancel()\n", what, ms);
+    ::testing::Test::RecordProperty(what, std::to_string(ms));
+    return ms;
+}
+
+// A one-connection HTTP server on localhost. It reads the request, then
+// answers with `reply` (or, if that is empty, never answers) and records how
+// long after accepting it saw the client close the connection.
+class LoopbackServer {
+public:
+    explicit LoopbackServer(std::string reply) : reply(std::move(reply)) {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+        port = ntohs(addr.sin_port);
+        listen(listener, 1);
+        server = std::thread([this] { serve(); });
+    }
+
+    ~LoopbackServer() {
+        shutdown(listener, SHUT_RDWR);
+        close(listener);
+        server.join();
+    }
+
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(port) + "/"; }
+
+    // Set once the client has hung up
+    std::atomic<bool> closed{false};
+    Clock::time_point closed_at;
+
+private:
+    std::string reply;
+    int listener = -1;
+    int port = 0;
+    std::thread server;
+
+    void serve() {
+        int conn = accept(listener, nullptr, nullptr);
+        if (conn < 0) return;
+        std::string request;
+        char buffer[4096];
+        ssize_t n;
+        while (request.find("\r\n\r\n") == std::string::npos && (n = recv(conn, buffer, sizeof(buffer), 0)) > 0) {
+            request.append(buffer, n);
+        }
+        if (!reply.empty()) send(conn, reply.data(), reply.size(), 0);
+        while ((n = recv(conn, buffer, sizeof(buffer), 0)) > 0) {
+        }
+        closed_at = Clock::now();
+        closed.store(true);
+        close(conn);
+    }
+};
+
+} // namespace
+
+TEST(CancellationTokenTest, CallbacksRunOnceAndUnregister) {
+    CancellationToken token;
+    CancellationToken copy = token;
+    int fired = 0, dropped = 0;
+    auto keep = token.onCancel([&] { fired++; });
+    { auto gone = token.onCancel([&] { dropped++; }); }
+    EXPECT_FALSE(copy.cancelled());
+
+    copy.cancel();
+    copy.cancel();
+    EXPECT_TRUE(token.cancelled());
+    EXPECT_EQ(fired, 1);
+    EXPECT_EQ(dropped, 0);
+
+    // Registering on a cancelled token runs the callback at once
+    auto late = token.onCancel([&] { fired++; });
+    EXPECT_EQ(fired, 2);
+}
+
+TEST(CancellationTokenTest, SleepWakesOnCancel) {
+    CancellationToken token;
+    EXPECT_TRUE(token.sleepFor(std::chrono::milliseconds(1)));
+    std::thread canceller = cancelLater(token, std::chrono::milliseconds(20));
+    EXPECT_FALSE(token.sleepFor(std::chrono::seconds(10)));
+    canceller.join();
+    EXPECT_LT(reportLatency("sleep", token, Clock::now()), 20.0);
+}
+
+TEST(CancellationTest, RequestOnTheWireIsAbandoned) {
+    std::atomic<int> calls{0};
+    RequestScheduler scheduler;
+    LLMClient client("key", "https://generativelanguage.googleapis.com/v1beta", "gemini-test");
+    client.setScheduler(scheduler);
+    client.setTransport(slowProvider(std::chrono::seconds(10), calls, sendMessage()));
+
+    CancellationToken token;
+    std::thread canceller = cancelLater(token, std::chrono::milliseconds(30));
+    json response = client.chatCompletion(std::vector<json>{{{"role", "user"}, {"content", "hi"}}}, {}, token);
+    auto returned = Clock::now();
+    canceller.join();
+
+    EXPECT_EQ(response, (json{{"error", "cancelled"}}));
+    EXPECT_EQ(calls, 1);
+    EXPECT_LT(reportLatency("in flight", token, returned), 20.0);
+}
+
+TEST(CancellationTest, QueuedRequestGivesUpItsPlaceAtOnce) {
+    std::atomic<int> calls{0};
+    RequestScheduler scheduler;
+    scheduler.setLimits("gemini-test", RateLimits{1, 0, 1.0}); // one request a minute
+    LLMClient client("key", "https://generativelanguage.googleapis.com/v1beta", "gemini-test");
+    client.setScheduler(scheduler);
+    client.setTransport(slowProvider(std::chrono::milliseconds(0), calls, sendMessage()));
+    std::vector<json> messages = {{{"role", "user"}, {"content", "hi"}}};
+    client.chatCompletion(messages); // spends the quota
+
+    CancellationToken token;
+    std::thread canceller = cancelLater(token, std::chrono::milliseconds(30));
+    json response = client.chatCompletion(messages, {}, token);
+    auto returned = Clock::now();
+    canceller.join();
+
+    EXPECT_EQ(response, (json{{"error", "cancelled"}}));
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(scheduler.stats().cancelled, 1u);
+    EXPECT_EQ(scheduler.stats().queued, 0u);
+    // Well inside the scheduler's own 50 ms polling slice
+    EXPECT_LT(reportLatency("queued", token, returned), 20.0);
+}
+
+TEST(CancellationTest, HedgedRequestsAreBothTornDown) {
+    std::atomic<int> calls{0};
+    std::atomic<int> in_flight{0};
+    RequestScheduler scheduler;
+    LLMClient client("key", "https://generativelanguage.googleapis.com/v1beta", "gemini-test");
+    client.setScheduler(scheduler);
+    HedgingPolicy policy;
+    policy.enabled = true;
+    policy.initial_delay = std::chrono::milliseconds(10);
+    policy.min_delay = std::chrono::milliseconds(10);
+    client.setHedgingPolicy(policy);
+    HttpTransport slow = slowProvider(std::chrono::seconds(10), calls, sendMessage());
+    client.setTransport([&](const HttpRequest& req, const std::atomic<bool>& cancelled) {
+        in_flight++;
+        HttpResponse r = slow(req, cancelled);
+        in_flight--;
+        return r;
+    });
+
+    CancellationToken token;
+    std::thread canceller = cancelLater(token, std::chrono::milliseconds(50));
+    json response = client.chatCompletion(std::vector<json>{{{"role", "user"}, {"content", "hi"}}}, {}, token);
+    auto returned = Clock::now();
+    canceller.join();
+
+    EXPECT_EQ(response, (json{{"error", "cancelled"}}));
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(client.hedgesFired(), 1u);
+    EXPECT_LT(reportLatency("hedged", token, returned), 20.0);
+    // The detached attempts see their flags and wind down too
+    for (int i = 0; i < 200 && in_flight > 0; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(in_flight, 0);
+}
+
+TEST(CancellationTest, CurlTransportReadsAResponse) {
+    LoopbackServer server("HTTP/1.1 200 OK\r\nContent-Length: 2\r\nX-Test: yes\r\n\r\nok");
+    std::atomic<bool> never{false};
+    HttpResponse r = makeCurlTransport()(HttpRequest{server.url(), {{"Content-Type", "text/plain"}}, "hi", 0}, never);
+    EXPECT_EQ(r.status_code, 200);
+    EXPECT_EQ(r.text, "ok");
+    EXPECT_EQ(headerValue(r, "x-test"), "yes");
+    EXPECT_EQ(r.error, "");
+}
+
+TEST(CancellationTest, CurlTransportClosesAnAbandonedConnection) {
+    LoopbackServer server(""); // never answers
+    HttpTransport transport = makeCurlTransport();
+    CancellationToken token;
+    std::thread canceller = cancelLater(token, std::chrono::milliseconds(30));
+    HttpResponse r = transport(HttpRequest{server.url(), {}, "hi", 0}, token.flag());
+    auto returned = Clock::now();
+    canceller.join();
+
+    EXPECT_EQ(r.error, "cancelled");
+    EXPECT_LT(reportLatency("curl transport", token, returned), 20.0);
+    // The connection is torn down right away, not at libcurl's next progress
+    // callback, with the transport still alive
+    for (int i = 0; i < 200 && !server.closed; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ASSERT_TRUE(server.closed);
+    EXPECT_LT(reportLatency("curl connection", token, server.closed_at), 20.0);
+}
+
+TEST(CancellationTest, StepStopsBetweenToolRounds) {
+    Agent agent("key");
+    agent.setMessageHandler([](const std::string&) {});
+    std::atomic<int> calls{0};
+    json append = {{"name", "core_memory_append"}, {"args", {{"label", "human"}, {"content", "Likes tea."}}}};
+    HttpTransport first = slowProvider(std::chrono::milliseconds(0), calls, append);
+    HttpTransport rest = slowProvider(std::chrono::seconds(10), calls, sendMessage());
+    agent.getLLMClient().setTransport([&](const HttpRequest& req, const std::atomic<bool>& cancelled) {
+        return calls == 0 ? first(req, cancelled) : rest(req, cancelled);
+    });
+
+    CancellationToken token;
+    std::thread canceller = cancelLater(token, std::chrono::milliseconds(50));
+    auto start = Clock::now();
+    bool finished = agent.step("remember that I like tea", token);
+    auto returned = Clock::now();
+    canceller.join();
+
+    EXPECT_FALSE(finished);
+    EXPECT_EQ(calls, 2);
+    EXPECT_LT(returned - start, std::chrono::seconds(1)); // not MAX_STEPS rounds of 10 s
+    EXPECT_LT(reportLatency("agent step", token, returned), 20.0);
+
+    // The first round landed whole: its tool call and its result
+    const MessageStore& history = agent.getMessages();
+    ASSERT_GE(history.size(), 4u);
+    EXPECT_EQ(history[history.size() - 1].role(), MessageRole::Tool);
+    EXPECT_NE(agent.getMemoryDump().find("Likes tea."), std::string::npos);
+
+    // A token cancelled up front stops the next turn before it calls out
+    CancellationToken cancelled;
+    cancelled.cancel();
+    EXPECT_FALSE(agent.step("never mind", cancelled));
+    EXPECT_EQ(calls, 2);
+}
@@ -0,0 +1,210 @@
+#include "Compression.hpp"
+#include "LLMClient.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+
+// Chat-like text of roughly `bytes`: repetitive enough to compress, not trivially
+std::string prose(size_t bytes, uint32_t seed) {
+    static const char* words[] = {"the", "user", "said", "memory", "archival", "Zürich", "\"tool\"", "call",
+                                  "result", "{\"status\":\"OK\"}", "line\n", "prefers", "tea", "42", "café"};
+    std::mt19937 rng(seed);
+    std::string out;
+    while (out.size() < bytes) {
+        if (!out.empty()) out += ' ';
+        out += words[rng() % (sizeof(words) / sizeof(words[0]))];
+    }
+    return out;
+}
+
+std::vector<ContentCoding> supportedCodings() {
+    std::vector<ContentCoding> codings = {ContentCoding::Gzip};
+    if (codingSupported(ContentCoding::Zstd)) codings.push_back(ContentCoding::Zstd);
+    return codings;
+}
+
+// A history well past the default compression threshold
+std::vector<json> longHistory() {
+    std::vector<json> messages = {{{"role", "system"}, {"content", prose(20000, 1)}}};
+    for (uint32_t i = 0; i < 40; ++i) {
+        messages.push_back({{"role", i % 2 ? "assistant" : "user"}, {"content", prose(2000, i + 2)}});
+    }
+    return messages;
+}
+
+const std::string kReply = R"({"choices":[{"message":{"role":"assistant","content":"ok"}}]})";
+
+} // namespace
+
+TEST(CompressionTest, RoundTripsWholeAndStreamed) {
+    std::string text = prose(300000, 7);
+    for (ContentCoding coding : supportedCodings()) {
+        std::string packed = encode(coding, text);
+        EXPECT_LT(packed.size(), text.size() / 3) << codingName(coding);
+        EXPECT_EQ(decode(coding, packed), text) << codingName(coding);
+
+        // Fed in uneven pieces, the stream decodes to the same bytes
+        Encoder encoder(coding, 3);
+        std::string streamed;
+        for (size_t at = 0, step = 1; at < text.size(); at += step, step = step * 3 % 70001 + 1) {
+            encoder.write(std::string_view(text).substr(at, step), streamed);
+        }
+        encoder.finish(streamed);
+        EXPECT_EQ(encoder.bytesIn(), text.size());
+        EXPECT_EQ(decode(coding, streamed), text) << codingName(coding);
+
+        EXPECT_EQ(decode(coding, encode(coding, "")), "");
+        EXPECT_THROW(decode(coding, packed.substr(0, packed.size() / 2)), CompressionError);
+        EXPECT_THROW(decode(coding, "definitely not compressed"), CompressionError);
+        EXPECT_THROW(decode(coding, packed, text.size() / 2), CompressionError);
+    }
+    EXPECT_EQ(decode(ContentCoding::Identity, "as is"), "as is");
+}
+
+TEST(CompressionTest, NegotiatesCodings) {
+    EXPECT_EQ(parseCoding("GZIP"), ContentCoding::Gzip);
+    EXPECT_EQ(parseCoding(" x-gzip "), ContentCoding::Gzip);
+    EXPECT_EQ(parseCoding("zstd"), ContentCoding::Zstd);
+    EXPECT_EQ(parseCoding("br"), ContentCoding::Identity);
+    EXPECT_NE(acceptEncodingHeader().find("gzip"), std::string::npos);
+
+    EXPECT_EQ(pickCoding("gzip, zstd", ContentCoding::Gzip), ContentCoding::Gzip);
+    EXPECT_EQ(pickCoding("br, gzip;q=0.5", ContentCoding::Zstd), ContentCoding::Gzip);
+    EXPECT_EQ(pickCoding("gzip;q=0, br", ContentCoding::Gzip), ContentCoding::Identity);
+    EXPECT_EQ(pickCoding("identity", ContentCoding::Gzip), ContentCoding::Identity);
+    EXPECT_EQ(pickCoding("", ContentCoding::Gzip), ContentCoding::Identity);
+    if (codingSupported(ContentCoding::Zstd)) {
+        EXPECT_EQ(pickCoding("gzip, ZSTD", ContentCoding::Zstd), ContentCoding::Zstd);
+        EXPECT_EQ(pickCoding("zstd;q=0.0, gzip", ContentCoding::Zstd), ContentCoding::Gzip);
+    }
+}
+
+TEST(CompressionTest, LevelFollowsLinkAndCpu) {
+    for (ContentCoding coding : supportedCodings()) {
+        size_t bytes = 4 << 20;
+        int slow_link = adaptiveLevel(coding, bytes, 1.0, 1e5);
+        int egress = adaptiveLevel(coding, bytes, 1.0, 2.5e6);
+        int busy_cpu = adaptiveLevel(coding, bytes, 0.05, 2.5e6);
+        EXPECT_GT(slow_link, egress) << codingName(coding);
+        EXPECT_GE(egress, busy_cpu) << codingName(coding);
+        EXPECT_GE(busy_cpu, 1);
+        EXPECT_LE(slow_link, coding == ContentCoding::Gzip ? 9 : 19);
+        // On a link faster than the codec, the body goes as is
+        EXPECT_EQ(adaptiveLevel(coding, bytes, 1.0, 1e10), 0) << codingName(coding);
+    }
+    double headroom = cpuHeadroom();
+    EXPECT_GE(headroom, 0.0);
+    EXPECT_LE(headroom, 1.0);
+}
+
+TEST(CompressionTest, ClientCompressesLargeRequestsAgainstAStandIn) {
+    for (ContentCoding coding : supportedCodings()) {
+        for (const char* base : {"http://stand-in/v1", "https://generativelanguage.googleapis.com/v1beta"}) {
+            LLMClient client("key", base, "test-model");
+            RequestScheduler scheduler;
+            client.setScheduler(scheduler);
+            CompressionPolicy policy;
+            policy.enabled = true;
+            policy.coding = coding;
+            client.setCompressionPolicy(policy);
+
+            // The stand-in decodes what it is sent and answers gzip-compressed
+            std::vector<HttpRequest> seen;
+            json decoded;
+            client.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+                seen.push_back(req);
+                auto encoding = req.headers.find("Content-Encoding");
+                ContentCoding sent = encoding == req.headers.end() ? ContentCoding::Identity : parseCoding(encoding->second);
+                decoded = json::parse(decode(sent, req.body));
+                std::string reply = kReply;
+                if (std::string(base).find("googleapis") != std::string::npos) {
+                    reply = R"({"candidates":[{"content":{"parts":[{"text":"ok"}]}}]})";
+                }
+                return HttpResponse{200, encode(ContentCoding::Gzip, reply), "", {{"Content-Encoding", "gzip"}}};
+            });
+
+            std::vector<json> history = longHistory();
+            json response = client.chatCompletion(history, {});
+            ASSERT_EQ(seen.size(), 1u);
+            const HttpRequest& sent = seen[0];
+            EXPECT_EQ(sent.headers.at("Content-Encoding"), codingName(coding));
+            EXPECT_EQ(sent.headers.at("Accept-Encoding"), acceptEncodingHeader());
+            EXPECT_LT(sent.body.size() * 3, sent.identity_size);
+            EXPECT_EQ(decode(coding, sent.body).size(), sent.identity_size);
+            if (decoded.contains("messages")) {
+                EXPECT_EQ(decoded["messages"].size(), history.size());
+                EXPECT_EQ(decoded["messages"].back()["content"], history.back()["content"]);
+            } else {
+                EXPECT_EQ(decoded["contents"].size(), history.size() - 1);
+                EXPECT_EQ(decoded["system_instruction"]["parts"][0]["text"], history[0]["content"]);
+            }
+            EXPECT_EQ(response["choices"][0]["message"]["content"], "ok") << response.dump();
+
+            // Short requests are not worth compressing, nor are any on a fast enough link
+            client.chatCompletion(std::vector<json>{{{"role", "user"}, {"content", "hi"}}}, {});
+            policy.egress_bytes_per_sec = 1e12;
+            client.setCompressionPolicy(policy);
+            client.chatCompletion(history, {});
+            ASSERT_EQ(seen.size(), 3u);
+            for (size_t i : {1, 2}) {
+                EXPECT_EQ(seen[i].headers.count("Content-Encoding"), 0u);
+                EXPECT_EQ(seen[i].identity_size, 0u);
+            }
+            EXPECT_EQ(seen[2].headers.at("Accept-Encoding"), acceptEncodingHeader());
+        }
+    }
+}
+
+TEST(CompressionTest, FallsBackWhenTheServerRefusesTheEncoding) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    RequestScheduler scheduler;
+    client.setScheduler(scheduler);
+    CompressionPolicy policy;
+    policy.enabled = true;
+    policy.coding = codingSupported(ContentCoding::Zstd) ? ContentCoding::Zstd : ContentCoding::Gzip;
+    client.setCompressionPolicy(policy);
+    EXPECT_EQ(client.requestCoding(), policy.coding);
+
+    // First a server that only takes gzip, then one that takes nothing encoded
+    std::string accepts = "gzip";
+    std::vector<std::string> encodings;
+    client.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        auto it = req.headers.find("Content-Encoding");
+        std::string encoding = it == req.headers.end() ? "identity" : it->second;
+        encodings.push_back(encoding);
+        if (encoding != "identity" && encoding != accepts) {
+            HttpResponse refused{415, "Unsupported Media Type", "", {}};
+            if (!accepts.empty()) refused.headers["Accept-Encoding"] = accepts;
+            return refused;
+        }
+        json body = json::parse(decode(parseCoding(encoding), req.body));
+        EXPECT_EQ(body["messages"].size(), 41u);
+        return HttpResponse{200, kReply, "", {}};
+    });
+
+    std::vector<json> history = longHistory();
+    EXPECT_EQ(client.chatCompletion(history, {})["choices"][0]["message"]["content"], "ok");
+    std::vector<std::string> expected;
+    if (policy.coding == ContentCoding::Zstd) expected = {"zstd", "gzip"};
+    else expected = {"gzip"};
+    EXPECT_EQ(encodings, expected);
+    EXPECT_EQ(client.requestCoding(), ContentCoding::Gzip);
+
+    // Later requests start out in the coding the server asked for
+    encodings.clear();
+    client.chatCompletion(history, {});
+    EXPECT_EQ(encodings, std::vector<std::string>{"gzip"});
+
+    accepts.clear();
+    encodings.clear();
+    EXPECT_EQ(client.chatCompletion(history, {})["choices"][0]["message"]["content"], "ok");
+    EXPECT_EQ(encodings, (std::vector<std::string>{"gzip", "identity"}));
+    EXPECT_EQ(client.requestCoding(), ContentCoding::Identity);
+
+    // A response that cannot be decoded is an error, not garbage JSON
+    client.setTransport([](const HttpRequest&, const std::atomic<bool>&) {
+        return HttpResponse{200, std::string("\x1f\x8b") + "truncated", "", {{"Content-Encoding", "gzip"}}};
+    });
+    EXPECT_TRUE(client.chatCompletion(history, {}).contains("error"));
+}
@@ -0,0 +1,227 @@
+#include "EmbeddingClient.hpp"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+// OpenAI-style /embeddings stand-in: [length, first byte] per input, listed
+// in reverse to check that results are put back in input order
+struct StandInServer {
+    std::atomic<int> requests{0};
+    std::atomic<int> inputs{0};
+    std::vector<int> batch_sizes;
+    std::mutex mutex;
+    std::vector<long> statuses; // served in order, then 200s
+
+    HttpTransport transport() {
+        return [this](const HttpRequest& req, const std::atomic<bool>&) {
+            requests++;
+            long status = 200;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!statuses.empty()) {
+                    status = statuses.front();
+                    statuses.erase(statuses.begin());
+                }
+            }
+            if (status != 200) return HttpResponse{status, "{\"error\":\"nope\"}", "", {{"Retry-After", "0"}}};
+
+            json body = json::parse(req.body);
+            json data = json::array();
+            const json& input = body["input"];
+            inputs += static_cast<int>(input.size());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                batch_sizes.push_back(static_cast<int>(input.size()));
+            }
+            for (size_t i = input.size(); i-- > 0;) {
+                std::string text = input[i];
+                data.push_back({{"index", i}, {"embedding", {text.size(), text.empty() ? 0 : text[0]}}});
+            }
+            return HttpResponse{200, json{{"data", data}, {"model", body["model"]}}.dump(), "", {}};
+        };
+    }
+};
+
+std::string tempPath(const std::string& name) {
+    return "/tmp/letta-embedding-test-" + std::to_string(getpid()) + "-" + name;
+}
+
+} // namespace
+
+TEST(EmbeddingClientTest, OpenAIRequestsAndResultOrder) {
+    StandInServer server;
+    std::string url, body;
+    EmbeddingClient client("sk-test");
+    client.setTransport([&](const HttpRequest& req, const std::atomic<bool>& cancelled) {
+        url = req.url;
+        body = req.body;
+        return server.transport()(req, cancelled);
+    });
+    auto vectors = client.embed(std::vector<std::string_view>{"alpha", "be", "c"});
+    ASSERT_EQ(vectors.size(), 3u);
+    EXPECT_EQ(vectors[0], (std::vector<float>{5, 'a'}));
+    EXPECT_EQ(vectors[1], (std::vector<float>{2, 'b'}));
+    EXPECT_EQ(vectors[2], (std::vector<float>{1, 'c'}));
+    EXPECT_EQ(url, "https://api.openai.com/v1/embeddings");
+    EXPECT_EQ(json::parse(body)["model"], "text-embedding-3-small");
+}
+
+TEST(EmbeddingClientTest, GeminiBatchEmbedContents) {
+    EmbeddingClient client("key", "https://generativelanguage.googleapis.com/v1beta", "text-embedding-004");
+    std::string url;
+    client.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        url = req.url;
+        json body = json::parse(req.body);
+        json embeddings = json::array();
+        for (const auto& r : body["requests"]) {
+            EXPECT_EQ(r["model"], "models/text-embedding-004");
+            size_t length = r["content"]["parts"][0]["text"].get<std::string>().size();
+            embeddings.push_back({{"values", json::array({length})}});
+        }
+        return HttpResponse{200, json{{"embeddings", embeddings}}.dump(), "", {}};
+    });
+    EXPECT_EQ(client.embed("four"), std::vector<float>{4});
+    EXPECT_NE(url.find("/models/text-embedding-004:batchEmbedContents?key=key"), std::string::npos);
+}
+
+TEST(EmbeddingClientTest, CacheAnswersRepeatedTexts) {
+    StandInServer server;
+    EmbeddingClient client("sk-test");
+    client.setTransport(server.transport());
+    client.embed(std::vector<std::string_view>{"one", "two"});
+    auto again = client.embed(std::vector<std::string_view>{"two", "one", "three"});
+    EXPECT_EQ(again[0], (std::vector<float>{3, 't'}));
+    EXPECT_EQ(server.requests, 2);
+    EXPECT_EQ(server.inputs, 3); // only "three" was new
+    EXPECT_EQ(client.hits(), 2u);
+    EXPECT_EQ(client.misses(), 3u);
+
+    // The model is part of the key
+    EXPECT_FALSE(EmbeddingCache::key("model-a", "one") == EmbeddingCache::key("model-b", "one"));
+    EXPECT_FALSE(EmbeddingCache::key("ab", "c") == EmbeddingCache::key("a", "bc"));
+}
+
+TEST(EmbeddingClientTest, ConcurrentCallsShareABatch) {
+    StandInServer server;
+    EmbeddingClient client("sk-test", "https://api.openai.com/v1", "text-embedding-3-small", {0, 1, ""});
+    client.setTransport(server.transport());
+    EmbeddingBatchPolicy policy;
+    policy.window = std::chrono::milliseconds(200);
+    policy.max_batch = 8;
+    client.setBatchPolicy(policy);
+
+    // Eight callers with distinct texts fill one batch, which then goes
+    // without waiting out the window; four more share a single text
+    std::vector<std::thread> threads;
+    std::vector<std::vector<float>> results(12);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&, i] { results[i] = client.embed("text " + std::to_string(i)); });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(150));
+    EXPECT_EQ(server.requests, 1);
+
+    threads.clear();
+    for (int i = 8; i < 12; ++i) {
+        threads.emplace_back([&, i] { results[i] = client.embed("shared"); });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(server.requests, 2);
+    EXPECT_EQ(server.inputs, 9);
+    for (int i = 0; i < 8; ++i) EXPECT_EQ(results[i][0], 6.0f);
+    for (int i = 8; i < 12; ++i) EXPECT_EQ(results[i], (std::vector<float>{6, 's'}));
+}
+
+TEST(EmbeddingClientTest, LargeCallsSplitIntoMaxBatchRequests) {
+    StandInServer server;
+    EmbeddingClient client("sk-test");
+    client.setTransport(server.transport());
+    EmbeddingBatchPolicy policy;
+    policy.window = std::chrono::microseconds(0);
+    policy.max_batch = 4;
+    client.setBatchPolicy(policy);
+
+    std::vector<std::string> texts;
+    for (int i = 0; i < 10; ++i) texts.push_back("t" + std::to_string(i));
+    auto vectors = client.embed(std::vector<std::string_view>(texts.begin(), texts.end()));
+    ASSERT_EQ(vectors.size(), 10u);
+    EXPECT_EQ(vectors[9], (std::vector<float>{2, 't'}));
+    EXPECT_EQ(server.batch_sizes, (std::vector<int>{4, 4, 2}));
+}
+
+TEST(EmbeddingClientTest, ErrorsAndRateLimits) {
+    StandInServer server;
+    RequestScheduler scheduler;
+    EmbeddingClient client("sk-test");
+    client.setScheduler(scheduler);
+    client.setTransport(server.transport());
+
+    server.statuses = {429, 200};
+    EXPECT_EQ(client.embed("retry"), (std::vector<float>{5, 'r'}));
+    EXPECT_EQ(server.requests, 2);
+
+    server.statuses = {500};
+    EXPECT_THROW(client.embed("broken"), std::runtime_error);
+    EXPECT_EQ(client.embed("broken"), (std::vector<float>{6, 'b'})); // failures are not cached
+}
+
+TEST(EmbeddingCacheTest, ShardedLruEvictsOldest) {
+    EmbeddingCache cache({4, 1, ""});
+    for (int i = 0; i < 4; ++i) cache.put(EmbeddingCache::key("m", std::to_string(i)), {float(i)});
+    std::vector<float> v;
+    EXPECT_TRUE(cache.get(EmbeddingCache::key("m", "0"), v)); // now most recent
+    cache.put(EmbeddingCache::key("m", "4"), {4});
+    EXPECT_TRUE(cache.get(EmbeddingCache::key("m", "0"), v));
+    EXPECT_FALSE(cache.get(EmbeddingCache::key("m", "1"), v));
+    EXPECT_EQ(cache.size(), 4u);
+}
+
+TEST(EmbeddingCacheTest, DiskTierOutlivesTheProcessCache) {
+    std::string path = tempPath("cache.bin");
+    ::unlink(path.c_str());
+    {
+        EmbeddingCache cache({1, 1, path});
+        cache.put(EmbeddingCache::key("m", "a"), {1, 2, 3});
+        cache.put(EmbeddingCache::key("m", "b"), {4, 5});
+        EXPECT_EQ(cache.size(), 1u);
+        std::vector<float> v;
+        ASSERT_TRUE(cache.get(EmbeddingCache::key("m", "a"), v)); // evicted from memory, read back
+        EXPECT_EQ(v, (std::vector<float>{1, 2, 3}));
+        EXPECT_EQ(cache.diskHits(), 1u);
+    }
+    std::ofstream(path, std::ios::app | std::ios::binary) << "torn record";
+
+    EmbeddingCache reopened({16, 1, path});
+    EXPECT_EQ(reopened.diskSize(), 2u);
+    std::vector<float> v;
+    ASSERT_TRUE(reopened.get(EmbeddingCache::key("m", "b"), v));
+    EXPECT_EQ(v, (std::vector<float>{4, 5}));
+    reopened.put(EmbeddingCache::key("m", "c"), {6});
+    EXPECT_EQ(EmbeddingCache({16, 1, path}).diskSize(), 3u);
+    ::unlink(path.c_str());
+}
+
+TEST(EmbeddingClientTest, BacksAnIngestionPipeline) {
+    std::string doc = tempPath("doc.txt");
+    std::string store = tempPath("store.jsonl");
+    ::unlink(store.c_str());
+    std::string text;
+    for (int i = 0; i < 400; ++i) text += "Sentence number " + std::to_string(i % 50) + " repeats. ";
+    std::ofstream(doc) << text;
+
+    StandInServer server;
+    EmbeddingClient client("sk-test");
+    client.setTransport(server.transport());
+    IngestionOptions options;
+    options.chunker.chunk_tokens = 8;
+    IngestionStats stats = IngestionPipeline(client.backend(), options).run({doc}, store);
+    EXPECT_TRUE(stats.ok()) << stats.error;
+    EXPECT_EQ(stats.embedded, stats.chunks);
+    EXPECT_GT(client.hits(), 0u); // the text repeats every 50 sentences
+    ::unlink(doc.c_str());
+    ::unlink(store.c_str());
+}
@@ -0,0 +1,195 @@
+#include "InboundQueue.hpp"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Mock LLM: answers every request with send_message after `latency_ms`
+// (abandoning it if cancelled) and records the user turn it was asked about
+struct MockLLM {
+    std::atomic<int> latency_ms{0};
+    std::atomic<int> calls{0};
+    std::mutex mutex;
+    std::vector<std::string> turns; // text of the newest user message per call
+    std::vector<std::string> bodies;
+
+    void attach(Agent& agent) {
+        agent.setMessageHandler([](const std::string&) {});
+        agent.getLLMClient().setTransport([this](const HttpRequest& req, const std::atomic<bool>& cancelled) {
+            calls++;
+            json body = json::parse(req.body);
+            std::string text;
+            for (const auto& content : body["contents"]) {
+                if (content.value("role", "") == "user" && content["parts"][0].contains("text")) {
+                    text = content["parts"][0]["text"];
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                turns.push_back(text);
+                bodies.push_back(req.body);
+            }
+            auto until = Clock::now() + std::chrono::milliseconds(latency_ms.load());
+            while (Clock::now() < until) {
+                if (cancelled.load()) return HttpResponse{0, "", "cancelled", {}};
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            json call = {{"name", "send_message"}, {"args", {{"message", "ok"}}}};
+            json reply = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+            return HttpResponse{200, reply.dump(), "", {}};
+        });
+    }
+};
+
+void report(const char* script, const InboundStats& s) {
+    std::printf("[ COALESCE ] %s: %llu messages -> %llu turns, %llu LLM calls saved\n", script,
+                static_cast<unsigned long long>(s.messages), static_cast<unsigned long long>(s.turns),
+                static_cast<unsigned long long>(s.llmCallsSaved()));
+}
+
+} // namespace
+
+TEST(InboundQueueTest, BurstWithinDebounceBecomesOneTurn) {
+    Agent agent("key");
+    MockLLM llm;
+    llm.attach(agent);
+    InboundPolicy policy;
+    policy.debounce = std::chrono::milliseconds(60);
+    InboundQueue queue(agent, policy);
+
+    for (int i = 1; i <= 5; ++i) {
+        EXPECT_EQ(queue.post("part " + std::to_string(i)), static_cast<uint64_t>(i));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    queue.drain();
+
+    InboundStats stats = queue.stats();
+    report("typing burst", stats);
+    EXPECT_EQ(llm.calls, 1);
+    EXPECT_EQ(stats.turns, 1u);
+    EXPECT_EQ(stats.llmCallsSaved(), 4u);
+    EXPECT_EQ(stats.largest_turn, 5u);
+    EXPECT_EQ(llm.turns[0], "part 1\n\npart 2\n\npart 3\n\npart 4\n\npart 5");
+}
+
+TEST(InboundQueueTest, MessagesDuringAStepJoinTheNextTurn) {
+    Agent agent("key");
+    MockLLM llm;
+    llm.latency_ms = 100;
+    llm.attach(agent);
+    InboundPolicy policy;
+    policy.debounce = std::chrono::milliseconds(0);
+    InboundQueue queue(agent, policy);
+
+    uint64_t first = queue.post("what's the weather?");
+    std::this_thread::sleep_for(std::chrono::milliseconds(30)); // the step is on the wire
+    queue.post("in Paris");
+    queue.post("tomorrow");
+    uint64_t last = queue.post("in celsius please");
+    queue.waitFor(first);
+    queue.waitFor(last);
+
+    InboundStats stats = queue.stats();
+    report("follow-ups mid-step", stats);
+    EXPECT_EQ(stats.turns, 2u);
+    EXPECT_EQ(stats.coalesced, 2u);
+    ASSERT_EQ(llm.turns.size(), 2u);
+    EXPECT_EQ(llm.turns[1], "in Paris\n\ntomorrow\n\nin celsius please");
+}
+
+TEST(InboundQueueTest, LimitsSplitTurnsWithoutReordering) {
+    Agent agent("key");
+    MockLLM llm;
+    llm.attach(agent);
+    InboundPolicy policy;
+    policy.debounce = std::chrono::milliseconds(30);
+    policy.max_messages = 3;
+    policy.max_bytes = 40;
+    policy.separator = "|";
+    InboundQueue queue(agent, policy);
+
+    std::string big(100, 'x'); // over max_bytes: goes alone, unsplit
+    std::vector<std::string> script = {"m1", "m2", "m3", "m4", big, "m6", "m7", "m8"};
+    for (const auto& m : script) queue.post(m);
+    queue.drain();
+
+    EXPECT_EQ(llm.turns, (std::vector<std::string>{"m1|m2|m3", "m4", big, "m6|m7|m8"}));
+    EXPECT_EQ(queue.stats().turns, 4u);
+    EXPECT_EQ(queue.stats().coalesced, 4u);
+}
+
+TEST(InboundQueueTest, MaxDelayBoundsAnEndlessBurst) {
+    Agent agent("key");
+    MockLLM llm;
+    llm.attach(agent);
+    InboundPolicy policy;
+    policy.debounce = std::chrono::milliseconds(1000);
+    policy.max_delay = std::chrono::milliseconds(50);
+    InboundQueue queue(agent, policy);
+
+    // A message every 10 ms never leaves a quiet gap for the debounce
+    auto start = Clock::now();
+    uint64_t first = queue.post("0");
+    std::thread sender([&] {
+        for (int i = 1; i < 20; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            queue.post(std::to_string(i));
+        }
+    });
+    queue.waitFor(first);
+    auto first_turn = Clock::now() - start;
+    sender.join();
+    queue.drain();
+
+    EXPECT_LT(first_turn, std::chrono::milliseconds(150));
+    InboundStats stats = queue.stats();
+    report("endless burst", stats);
+    EXPECT_GE(stats.turns, 2u);
+    EXPECT_LE(stats.turns, 8u);
+    EXPECT_EQ(stats.messages, 20u);
+}
+
+TEST(InboundQueueTest, InterruptCancelsTheStepForTheCorrection) {
+    Agent agent("key");
+    MockLLM llm;
+    llm.latency_ms = 10000;
+    llm.attach(agent);
+    InboundPolicy policy;
+    policy.debounce = std::chrono::milliseconds(0);
+    policy.interrupt = true;
+    InboundQueue queue(agent, policy);
+
+    queue.post("book a table for two");
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    llm.latency_ms = 0;
+    auto corrected = Clock::now();
+    queue.post("actually, for three");
+    queue.drain();
+
+    EXPECT_LT(Clock::now() - corrected, std::chrono::milliseconds(500));
+    InboundStats stats = queue.stats();
+    EXPECT_EQ(stats.interrupted, 1u);
+    EXPECT_EQ(stats.turns, 2u);
+    ASSERT_EQ(llm.calls, 2);
+    // The abandoned message stays in the history the correction is sent with
+    EXPECT_NE(llm.bodies[1].find("book a table for two"), std::string::npos);
+    EXPECT_EQ(llm.turns[1], "actually, for three");
+}
+
+TEST(InboundQueueTest, DestructorRunsWhatWasPosted) {
+    Agent agent("key");
+    MockLLM llm;
+    llm.attach(agent);
+    {
+        InboundPolicy policy;
+        policy.debounce = std::chrono::seconds(10);
+        InboundQueue queue(agent, policy);
+        queue.post("one");
+        queue.post("two");
+    }
+    EXPECT_EQ(llm.calls, 1);
+    EXPECT_EQ(llm.turns[0], "one\n\ntwo");
+}
@@ -0,0 +1,278 @@
+#include "Ingestion.hpp"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+std::string tempPath(const std::string& name) {
+    return "/tmp/letta-ingest-test-" + std::to_string(getpid()) + "-" + name;
+}
+
+void writeFile(const std::string& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+}
+
+// Paragraphs of sentences of short words, `bytes` long or a little over
+std::string corpus(size_t bytes) {
+    static const char* words[] = {"agent", "memory", "block", "the", "archival", "passage", "of", "embedding",
+                                  "token", "a", "context", "window", "tool", "call", "summary", "recall"};
+    std::string text;
+    uint32_t state = 7;
+    int in_sentence = 0, in_paragraph = 0;
+    while (text.size() < bytes) {
+        state = state * 1103515245 + 12345;
+        text += words[(state >> 16) % 16];
+        if (++in_sentence == 12) {
+            in_sentence = 0;
+            text += ++in_paragraph == 6 ? ".\n\n" : ". ";
+            if (in_paragraph == 6) in_paragraph = 0;
+        } else {
+            text += ' ';
+        }
+    }
+    return text;
+}
+
+// Deterministic vectors; counts calls and the widest concurrency seen
+struct StandInEmbedder {
+    std::atomic<int> calls{0};
+    std::atomic<int> in_flight{0};
+    std::atomic<int> max_in_flight{0};
+    std::atomic<int> fail_after{-1};       // calls after this many throw
+    size_t max_texts = 0;                   // larger batches throw
+    std::chrono::milliseconds latency{0};
+
+    EmbeddingBackend backend() {
+        return [this](const std::vector<std::string_view>& texts) {
+            int now = ++in_flight;
+            int seen = max_in_flight.load();
+            while (now > seen && !max_in_flight.compare_exchange_weak(seen, now)) {}
+            struct Leave {
+                std::atomic<int>& n;
+                ~Leave() { --n; }
+            } leave{in_flight};
+
+            int call = calls++;
+            if (latency.count()) std::this_thread::sleep_for(latency);
+            if (fail_after >= 0 && call >= fail_after) throw std::runtime_error("backend unavailable");
+            if (max_texts && texts.size() > max_texts) throw std::runtime_error("too many inputs");
+            std::vector<std::vector<float>> out;
+            for (auto text : texts) {
+                uint32_t h = 2166136261u;
+                for (char c : text) h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+                out.push_back({static_cast<float>(h % 1000) / 1000.0f, static_cast<float>(text.size())});
+            }
+            return out;
+        };
+    }
+};
+
+std::set<uint64_t> storedOffsets(const std::string& store) {
+    std::set<uint64_t> offsets;
+    for (const auto& p : PassageStore::readAll(store)) offsets.insert(p.offset);
+    return offsets;
+}
+
+} // namespace
+
+TEST(TextChunkerTest, ChunksStayUnderTheLimitAndCutBetweenWords) {
+    std::string text = corpus(200000);
+    ChunkerOptions options;
+    options.chunk_tokens = 100;
+    options.segment_bytes = 16384;
+    TextChunker chunker(options);
+    auto chunks = chunker.chunk(text);
+    ASSERT_GT(chunks.size(), 100u);
+
+    size_t covered_end = 0;
+    size_t sentence_ends = 0;
+    for (const auto& c : chunks) {
+        EXPECT_LE(c.tokens, 100u);
+        EXPECT_GE(c.offset, covered_end); // no overlap asked for
+        EXPECT_FALSE(c.offset > 0 && text[c.offset - 1] != ' ' && text[c.offset - 1] != '\n');
+        size_t end = c.offset + c.length;
+        EXPECT_TRUE(end == text.size() || text[end] == ' ' || text[end] == '\n');
+        sentence_ends += text[end - 1] == '.';
+        covered_end = end;
+    }
+    // Sentences are 12 words, so there is nearly always one to cut at
+    EXPECT_GT(sentence_ends, chunks.size() * 9 / 10);
+}
+
+TEST(TextChunkerTest, PrefersParagraphBreaks) {
+    std::string text;
+    for (int p = 0; p < 20; ++p) {
+        for (int s = 0; s < 3; ++s) text += "Short sentence number " + std::to_string(s) + " here. ";
+        text += "\n\n";
+    }
+    ChunkerOptions options;
+    options.chunk_tokens = 40; // a paragraph is 21 tokens
+    auto chunks = TextChunker(options).chunk(text);
+    for (const auto& c : chunks) {
+        size_t end = c.offset + c.length;
+        EXPECT_TRUE(end == text.size() || text.compare(end, 3, " \n\n") == 0) << text.substr(c.offset, c.length);
+    }
+}
+
+TEST(TextChunkerTest, OverlapRepeatsTheTailOfThePreviousChunk) {
+    std::string text = corpus(20000);
+    ChunkerOptions options;
+    options.chunk_tokens = 64;
+    options.overlap_tokens = 16;
+    auto chunks = TextChunker(options).chunk(text);
+    ASSERT_GT(chunks.size(), 10u);
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        size_t previous_end = chunks[i - 1].offset + chunks[i - 1].length;
+        EXPECT_LT(chunks[i].offset, previous_end);
+        EXPECT_GT(chunks[i].offset, chunks[i - 1].offset);
+        EXPECT_LE(chunks[i].tokens, 64u);
+    }
+}
+
+TEST(TextChunkerTest, OversizedWordsSplitOnCharacterBoundaries) {
+    std::string word;
+    for (int i = 0; i < 3000; ++i) word += "\xc3\xa9"; // é
+    std::string text = "before " + word + " after";
+    ChunkerOptions options;
+    options.chunk_tokens = 100;
+    auto chunks = TextChunker(options).chunk(text);
+    ASSERT_GE(chunks.size(), 4u);
+    EXPECT_EQ(text.substr(chunks.front().offset, chunks.front().length), "before");
+    EXPECT_EQ(text.substr(chunks.back().offset, chunks.back().length), "after");
+    size_t total = 0;
+    for (size_t i = 1; i + 1 < chunks.size(); ++i) {
+        EXPECT_NE(static_cast<unsigned char>(text[chunks[i].offset]) & 0xC0, 0x80u);
+        EXPECT_LE(chunks[i].length, 400u);
+        total += chunks[i].length;
+    }
+    EXPECT_EQ(total, word.size());
+}
+
+TEST(TextChunkerTest, SegmentCutsDoNotDependOnThreads) {
+    std::string text = corpus(300000);
+    std::string doc = tempPath("threads.txt");
+    writeFile(doc, text);
+    ChunkerOptions chunker;
+    chunker.segment_bytes = 8192;
+
+    std::set<uint64_t> expected;
+    for (const auto& c : TextChunker(chunker).chunk(text)) expected.insert(c.offset);
+
+    for (size_t threads : {1, 4}) {
+        std::string store = tempPath("threads-" + std::to_string(threads) + ".jsonl");
+        ::unlink(store.c_str());
+        StandInEmbedder embedder;
+        IngestionOptions options;
+        options.chunker = chunker;
+        options.threads = threads;
+        IngestionStats stats = IngestionPipeline(embedder.backend(), options).run({doc}, store);
+        EXPECT_TRUE(stats.ok()) << stats.error;
+        EXPECT_EQ(stats.chunks, expected.size());
+        EXPECT_EQ(storedOffsets(store), expected);
+        ::unlink(store.c_str());
+    }
+    ::unlink(doc.c_str());
+}
+
+TEST(IngestionPipelineTest, StoresTextAndEmbeddings) {
+    std::string doc = tempPath("store.txt");
+    std::string store = tempPath("store.jsonl");
+    ::unlink(store.c_str());
+    std::string text = corpus(50000);
+    writeFile(doc, text);
+
+    StandInEmbedder embedder;
+    int progress_calls = 0;
+    IngestionOptions options;
+    options.embedding_model = "stand-in";
+    options.on_progress = [&](const IngestionStats& s) {
+        progress_calls++;
+        EXPECT_LE(s.embedded, s.chunks);
+    };
+    IngestionStats stats = IngestionPipeline(embedder.backend(), options).run({doc}, store);
+    ASSERT_TRUE(stats.ok()) << stats.error;
+    EXPECT_EQ(stats.documents, 1u);
+    EXPECT_EQ(stats.bytes, text.size());
+    EXPECT_EQ(stats.embedded, stats.chunks);
+    EXPECT_GT(progress_calls, 0);
+
+    auto passages = PassageStore::readAll(store);
+    ASSERT_EQ(passages.size(), stats.chunks);
+    for (const auto& p : passages) {
+        EXPECT_EQ(p.document, doc);
+        EXPECT_EQ(p.text, text.substr(p.offset, p.text.size()));
+        ASSERT_EQ(p.embedding.size(), 2u);
+        EXPECT_EQ(p.embedding[1], static_cast<float>(p.text.size()));
+    }
+    ::unlink(doc.c_str());
+    ::unlink(store.c_str());
+}
+
+TEST(IngestionPipelineTest, ResumesAfterFailuresAndTornWrites) {
+    std::string doc = tempPath("resume.txt");
+    std::string store = tempPath("resume.jsonl");
+    ::unlink(store.c_str());
+    writeFile(doc, corpus(100000));
+
+    IngestionOptions options;
+    options.initial_batch = 8;
+    options.max_batch = 8;
+    options.max_in_flight = 1;
+
+    StandInEmbedder flaky;
+    flaky.fail_after = 5;
+    IngestionStats first = IngestionPipeline(flaky.backend(), options).run({doc}, store);
+    EXPECT_FALSE(first.ok());
+    EXPECT_EQ(first.embedded, 40u);
+    EXPECT_EQ(first.failed, first.chunks - 40);
+
+    // A run that died mid-write leaves half a line behind
+    std::ofstream(store, std::ios::app) << "{\"document\":\"" << doc << "\",\"off";
+
+    StandInEmbedder healthy;
+    IngestionStats second = IngestionPipeline(healthy.backend(), options).run({doc}, store);
+    EXPECT_TRUE(second.ok());
+    EXPECT_EQ(second.skipped, 40u);
+    EXPECT_EQ(second.embedded, first.failed);
+    EXPECT_EQ(PassageStore::readAll(store).size(), first.chunks);
+    EXPECT_EQ(storedOffsets(store).size(), first.chunks);
+
+    // Nothing left to do
+    IngestionStats third = IngestionPipeline(healthy.backend(), options).run({doc}, store);
+    EXPECT_EQ(third.embedded, 0u);
+    EXPECT_EQ(third.skipped, first.chunks);
+
+    // Other settings would produce other chunks; refuse to mix them
+    options.chunker.chunk_tokens = 100;
+    IngestionStats mismatched = IngestionPipeline(healthy.backend(), options).run({doc}, store);
+    EXPECT_NE(mismatched.error.find("different settings"), std::string::npos);
+    ::unlink(doc.c_str());
+    ::unlink(store.c_str());
+}
+
+TEST(IngestionPipelineTest, BatchesAdaptAndInFlightIsBounded) {
+    std::string doc = tempPath("batches.txt");
+    std::string store = tempPath("batches.jsonl");
+    ::unlink(store.c_str());
+    writeFile(doc, corpus(200000));
+
+    StandInEmbedder embedder;
+    embedder.max_texts = 16; // the backend rejects anything bigger
+    embedder.latency = std::chrono::milliseconds(1);
+    IngestionOptions options;
+    options.initial_batch = 64;
+    options.max_in_flight = 2;
+    IngestionStats stats = IngestionPipeline(embedder.backend(), options).run({doc}, store);
+
+    EXPECT_TRUE(stats.ok());
+    EXPECT_EQ(stats.embedded, stats.chunks);
+    EXPECT_LE(embedder.max_in_flight.load(), 2);
+    EXPECT_GT(stats.requests, stats.chunks / 16);
+    EXPECT_LE(stats.batch_size, 40u); // fell back from 64 after the rejections
+    EXPECT_FALSE(IngestionPipeline(embedder.backend(), options).run({tempPath("missing.txt")}, store).error.empty());
+    ::unlink(doc.c_str());
+    ::unlink(store.c_str());
+}
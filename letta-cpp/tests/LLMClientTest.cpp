@@ -0,0 +1,360 @@
+#include "LLMClient.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace {
+
+// Build an OpenAI-style response body carrying a single tool call
+std::string toolCallBody(const std::string& name, const std::string& arguments) {
+    json body = {
+        {"choices", {{
+            {"message", {
+                {"role", "assistant"},
+                {"content", nullptr},
+                {"tool_calls", {{
+                    {"id", "call_1"},
+                    {"type", "function"},
+                    {"function", {{"name", name}, {"arguments", arguments}}}
+                }}}
+            }}
+        }}}
+    };
+    return body.dump();
+}
+
+// Sleep in small slices so a cancelled request returns promptly
+bool sleepUnlessCancelled(std::chrono::milliseconds duration, const std::atomic<bool>& cancelled) {
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (cancelled.load()) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+const std::vector<json> kMessages = {
+    {{"role", "system"}, {"content", "sys"}},
+    {{"role", "user"}, {"content", "hi"}}
+};
+
+const std::vector<json> kTools = {
+    {{"type", "function"}, {"function", {{"name", "send_message"}, {"parameters", {{"type", "object"}}}}}}
+};
+
+} // namespace
+
+TEST(LLMClientTest, OpenAIRequestShape) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    HttpRequest seen;
+    client.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        seen = req;
+        return HttpResponse{200, toolCallBody("send_message", "{\"message\":\"hello\"}"), ""};
+    });
+
+    json response = client.chatCompletion(kMessages, kTools);
+
+    EXPECT_EQ(seen.url, "http://stand-in/v1/chat/completions");
+    EXPECT_EQ(seen.headers["Authorization"], "Bearer key");
+    json body = json::parse(seen.body);
+    EXPECT_EQ(body["model"], "test-model");
+    EXPECT_EQ(body["tool_choice"], "auto");
+    EXPECT_EQ(response["choices"][0]["message"]["tool_calls"][0]["function"]["name"], "send_message");
+    EXPECT_EQ(client.latencyHistogram().count(), 1u);
+}
+
+TEST(LLMClientTest, GeminiAdapterRoundTrip) {
+    LLMClient client("key", "https://generativelanguage.googleapis.com/v1beta", "gemini-test");
+    HttpRequest seen;
+    client.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        seen = req;
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", {{"name", "send_message"}, {"args", {{"message", "hey"}}}}}}}}}}}}}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+
+    json response = client.chatCompletion(kMessages, kTools);
+
+    EXPECT_NE(seen.url.find("/models/gemini-test:generateContent?key=key"), std::string::npos);
+    json body = json::parse(seen.body);
+    EXPECT_EQ(body["system_instruction"]["parts"][0]["text"], "sys");
+    EXPECT_EQ(body["contents"][0]["role"], "user");
+    json call = response["choices"][0]["message"]["tool_calls"][0]["function"];
+    EXPECT_EQ(call["name"], "send_message");
+    EXPECT_EQ(json::parse(call["arguments"].get<std::string>())["message"], "hey");
+}
+
+TEST(LLMClientTest, ErrorStatusIsReported) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    client.setTransport([](const HttpRequest&, const std::atomic<bool>&) {
+        return HttpResponse{500, "boom", ""};
+    });
+
+    json response = client.chatCompletion(kMessages, kTools);
+    EXPECT_TRUE(response.contains("error"));
+    EXPECT_EQ(client.latencyHistogram().count(), 0u);
+}
+
+TEST(LLMClientTest, HedgeWinsAgainstSlowPrimaryAndCancelsIt) {
+    LLMClient client("key", "http://primary/v1", "primary-model");
+    HedgingPolicy policy;
+    policy.enabled = true;
+    policy.initial_delay = std::chrono::milliseconds(20);
+    policy.min_delay = std::chrono::milliseconds(1);
+    policy.secondary_base_url = "http://secondary/v1";
+    policy.secondary_model = "secondary-model";
+    client.setHedgingPolicy(policy);
+
+    auto primary_cancelled = std::make_shared<std::atomic<bool>>(false);
+    client.setTransport([primary_cancelled](const HttpRequest& req, const std::atomic<bool>& cancelled) {
+        if (req.url.find("primary") != std::string::npos) {
+            if (!sleepUnlessCancelled(std::chrono::seconds(5), cancelled)) {
+                primary_cancelled->store(true);
+                return HttpResponse{0, "", "cancelled"};
+            }
+            return HttpResponse{200, toolCallBody("send_message", "{\"message\":\"slow\"}"), ""};
+        }
+        EXPECT_EQ(json::parse(req.body)["model"], "secondary-model");
+        return HttpResponse{200, toolCallBody("send_message", "{\"message\":\"fast\"}"), ""};
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    json response = client.chatCompletion(kMessages, kTools);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    json args = json::parse(response["choices"][0]["message"]["tool_calls"][0]["function"]["arguments"].get<std::string>());
+    EXPECT_EQ(args["message"], "fast");
+    EXPECT_LT(elapsed, std::chrono::seconds(1));
+    EXPECT_EQ(client.hedgesFired(), 1u);
+    EXPECT_EQ(client.hedgesWon(), 1u);
+    // The sample is the wait from the primary's admission, not the hedge's own time
+    EXPECT_EQ(client.latencyHistogram().count(), 1u);
+    EXPECT_GE(client.latencyHistogram().percentile(1.0), std::chrono::milliseconds(20));
+
+    // The losing primary observes cancellation shortly after the race is decided
+    for (int i = 0; i < 500 && !primary_cancelled->load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(primary_cancelled->load());
+}
+
+TEST(LLMClientTest, PlainTextReplyIsReturnedWithoutHedging) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    HedgingPolicy policy;
+    policy.enabled = true;
+    policy.initial_delay = std::chrono::seconds(10);
+    client.setHedgingPolicy(policy);
+
+    std::atomic<int> calls{0};
+    client.setTransport([&](const HttpRequest&, const std::atomic<bool>&) {
+        calls++;
+        json body = {{"choices", {{{"message", {{"role", "assistant"}, {"content", "Just text."}}}}}}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+
+    json response = client.chatCompletion(kMessages, kTools);
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(client.hedgesFired(), 0u);
+    EXPECT_EQ(response["choices"][0]["message"]["content"], "Just text.");
+}
+
+TEST(LLMClientTest, MalformedToolCallIsReaskedWhenOptedIn) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    HedgingPolicy policy;
+    policy.enabled = true;
+    policy.initial_delay = std::chrono::seconds(10);
+    policy.reask_without_tool_call = true;
+    client.setHedgingPolicy(policy);
+
+    std::atomic<int> calls{0};
+    client.setTransport([&](const HttpRequest&, const std::atomic<bool>&) {
+        if (calls++ == 0) {
+            return HttpResponse{200, toolCallBody("send_message", "{not json"), ""};
+        }
+        return HttpResponse{200, toolCallBody("send_message", "{\"message\":\"ok\"}"), ""};
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    json response = client.chatCompletion(kMessages, kTools);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_EQ(calls.load(), 2);
+    EXPECT_EQ(client.hedgesWon(), 1u);
+    EXPECT_EQ(response["choices"][0]["message"]["tool_calls"][0]["function"]["arguments"], "{\"message\":\"ok\"}");
+}
+
+TEST(LLMClientTest, FastPrimaryDoesNotHedge) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    HedgingPolicy policy;
+    policy.enabled = true;
+    policy.initial_delay = std::chrono::seconds(2);
+    client.setHedgingPolicy(policy);
+
+    std::atomic<int> calls{0};
+    client.setTransport([&](const HttpRequest&, const std::atomic<bool>&) {
+        calls++;
+        return HttpResponse{200, toolCallBody("send_message", "{\"message\":\"ok\"}"), ""};
+    });
+
+    client.chatCompletion(kMessages, kTools);
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(client.hedgesFired(), 0u);
+}
+
+TEST(LLMClientTest, FailedPrimaryIsReturnedWithoutHedging) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    RequestScheduler scheduler;
+    client.setScheduler(scheduler);
+    client.setMaxRateLimitRetries(0);
+    HedgingPolicy policy;
+    policy.enabled = true;
+    policy.initial_delay = std::chrono::seconds(10);
+    client.setHedgingPolicy(policy);
+
+    for (long status : {0L, 400L, 429L, 503L}) {
+        std::atomic<int> calls{0};
+        client.setTransport([&](const HttpRequest&, const std::atomic<bool>&) {
+            calls++;
+            return HttpResponse{status, status ? "overloaded" : "", status ? "" : "connection refused", {}};
+        });
+        json response = client.chatCompletion(kMessages, kTools);
+        EXPECT_TRUE(response.contains("error")) << status;
+        EXPECT_EQ(calls.load(), 1) << status;
+    }
+    EXPECT_EQ(client.hedgesFired(), 0u);
+}
+
+TEST(LLMClientTest, HedgeDelayExcludesTimeQueued) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    RequestScheduler scheduler;
+    client.setScheduler(scheduler);
+    HedgingPolicy policy;
+    policy.enabled = true;
+    policy.initial_delay = std::chrono::milliseconds(20);
+    client.setHedgingPolicy(policy);
+
+    std::atomic<int> calls{0};
+    client.setTransport([&](const HttpRequest&, const std::atomic<bool>& cancelled) {
+        calls++;
+        sleepUnlessCancelled(std::chrono::milliseconds(5), cancelled);
+        return HttpResponse{200, toolCallBody("send_message", "{\"message\":\"ok\"}"), "", {}};
+    });
+
+    // Held in the scheduler well past the hedge delay, then quick on the wire
+    scheduler.backoff("test-model", std::chrono::milliseconds(100));
+    json response = client.chatCompletion(kMessages, kTools);
+    EXPECT_FALSE(response.contains("error"));
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(client.hedgesFired(), 0u);
+}
+
+TEST(LLMClientTest, HedgeDelayTracksLatencyPercentile) {
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    HedgingPolicy policy;
+    policy.enabled = true;
+    policy.percentile = 0.9;
+    policy.min_samples = 10;
+    policy.min_delay = std::chrono::milliseconds(1);
+    policy.initial_delay = std::chrono::milliseconds(777);
+    client.setHedgingPolicy(policy);
+
+    EXPECT_EQ(client.hedgeDelay(), std::chrono::milliseconds(777));
+
+    client.setTransport([](const HttpRequest&, const std::atomic<bool>&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        return HttpResponse{200, toolCallBody("send_message", "{}"), ""};
+    });
+    for (int i = 0; i < 10; ++i) client.chatCompletion(kMessages, kTools);
+
+    EXPECT_GE(client.hedgeDelay(), std::chrono::milliseconds(4));
+    EXPECT_LT(client.hedgeDelay(), std::chrono::milliseconds(100));
+}
+
+TEST(LatencyHistogramTest, PercentilesWithinBucketError) {
+    LatencyHistogram histogram(100000);
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.record(std::chrono::microseconds(i * 100));
+    }
+    auto p50 = histogram.percentile(0.5).count();
+    auto p99 = histogram.percentile(0.99).count();
+    EXPECT_NEAR(p50, 50000, 50000 * 0.13);
+    EXPECT_NEAR(p99, 99000, 99000 * 0.13);
+    EXPECT_EQ(histogram.count(), 1000u);
+}
+
+TEST(LatencyHistogramTest, DecayFavoursRecentSamples) {
+    LatencyHistogram histogram(64);
+    for (int i = 0; i < 1000; ++i) histogram.record(std::chrono::milliseconds(100));
+    for (int i = 0; i < 1000; ++i) histogram.record(std::chrono::milliseconds(1));
+    EXPECT_LT(histogram.count(), 64u);
+    EXPECT_LT(histogram.percentile(0.9), std::chrono::milliseconds(2));
+}
+
+TEST(LLMClientTest, RateLimitedRequestBacksOffAndRetries) {
+    RequestScheduler scheduler;
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    client.setScheduler(scheduler);
+    client.setSchedulingContext("agent-under-test", RequestPriority::Interactive);
+
+    std::atomic<int> calls{0};
+    client.setTransport([&](const HttpRequest&, const std::atomic<bool>&) {
+        if (calls++ == 0) {
+            HttpResponse limited{429, "slow down", ""};
+            limited.headers["retry-after"] = "0.05";
+            return limited;
+        }
+        json body = json::parse(toolCallBody("send_message", "{}"));
+        body["usage"] = {{"total_tokens", 42}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    json response = client.chatCompletion(kMessages, kTools);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(45));
+    EXPECT_FALSE(response.contains("error"));
+    EXPECT_EQ(calls.load(), 2);
+    EXPECT_EQ(scheduler.stats().rate_limited, 1u);
+    EXPECT_EQ(scheduler.stats().admitted_interactive, 2u);
+}
+
+TEST(LLMClientTest, RequestBodyEscapesHistory) {
+    MessageStore history;
+    history.append(MessageRole::System, "line\none \"quoted\" \\ tab\t bell\x07 caf\xc3\xa9");
+    history.append(MessageRole::User, "hi");
+    history.appendAssistant("", {{"call_1", "send_message", "{\"message\":\"a\\nb\"}"}});
+    history.appendToolResult("call_1", "send_message", "{\"status\":\"OK\"}");
+
+    LLMClient client("key", "http://stand-in/v1", "test-model");
+    HttpRequest seen;
+    client.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        seen = req;
+        return HttpResponse{200, toolCallBody("send_message", "{}"), ""};
+    });
+    client.chatCompletion(history, kTools);
+
+    json body = json::parse(seen.body);
+    EXPECT_EQ(body["messages"], history.toJson());
+    EXPECT_EQ(body["model"], "test-model");
+    EXPECT_EQ(body["tools"], json(kTools));
+}
+
+TEST(LLMClientTest, GeminiWrapsNonObjectToolOutput) {
+    MessageStore history;
+    history.append(MessageRole::System, "sys");
+    history.append(MessageRole::User, "hi");
+    history.appendAssistant("", {{"call_1", "lookup", "{\"q\":1}"}});
+    history.appendToolResult("call_1", "lookup", "plain \"text\"");
+
+    LLMClient client("key", "https://generativelanguage.googleapis.com/v1beta", "gemini-test");
+    HttpRequest seen;
+    client.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        seen = req;
+        return HttpResponse{500, "", ""};
+    });
+    client.chatCompletion(history);
+
+    json body = json::parse(seen.body);
+    EXPECT_EQ(body["system_instruction"]["parts"][0]["text"], "sys");
+    ASSERT_EQ(body["contents"].size(), 3u);
+    EXPECT_EQ(body["contents"][1]["parts"][0]["functionCall"]["args"]["q"], 1);
+    EXPECT_EQ(body["contents"][2]["role"], "function");
+    EXPECT_EQ(body["contents"][2]["parts"][0]["functionResponse"]["response"]["result"], "plain \"text\"");
+    EXPECT_FALSE(body.contains("tools"));
+}
@@ -0,0 +1,154 @@
+#include "letta_core.h"
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace {
+
+letta_str s(const std::string& text) {
+    return letta_str{text.data(), text.size()};
+}
+
+std::string str(letta_str view) {
+    return std::string(view.data, view.size);
+}
+
+// Answers every request with a Gemini send_message call
+void geminiStandIn(void* user, letta_str, letta_str, letta_str body, letta_response* response) {
+    auto* requests = static_cast<std::vector<std::string>*>(user);
+    requests->push_back(str(body));
+    json call = {{"name", "send_message"}, {"args", {{"message", "hello from the stand-in"}}}};
+    json reply = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+    std::string text = reply.dump();
+    letta_response_set(response, 200, s(text));
+}
+
+} // namespace
+
+TEST(LettaCoreTest, MemoryCompilesWithTemplates) {
+    EXPECT_EQ(letta_core_abi_version() >> 16, 1u);
+    letta_memory* memory = letta_memory_new();
+    ASSERT_NE(memory, nullptr);
+    EXPECT_EQ(letta_memory_set_block(memory, s("persona"), s("I am Sam."), 5000, 0), LETTA_OK);
+    EXPECT_EQ(letta_memory_set_block(memory, s("human"), s("Name: Chad"), 2000, 1), LETTA_OK);
+    EXPECT_EQ(letta_memory_block_count(memory), 2u);
+
+    letta_str out{};
+    ASSERT_EQ(letta_memory_compile(memory, &out), LETTA_OK);
+    EXPECT_NE(str(out).find("Block 'human' (10/2000 chars):\nName: Chad"), std::string::npos);
+
+    ASSERT_EQ(letta_memory_set_template(memory, s("{% for block in blocks %}<{{ block.label }}>{% endfor %}")),
+              LETTA_OK);
+    ASSERT_EQ(letta_memory_compile(memory, &out), LETTA_OK);
+    EXPECT_EQ(str(out), "<persona><human>");
+
+    EXPECT_EQ(letta_memory_set_template(memory, s("{% for block in blocks %}")), LETTA_ERROR_PARSE);
+    EXPECT_NE(std::string(letta_last_error()), "");
+    EXPECT_EQ(letta_memory_remove_block(memory, s("persona")), LETTA_OK);
+    EXPECT_EQ(std::string(letta_last_error()), "");
+    EXPECT_EQ(letta_memory_remove_block(memory, s("persona")), LETTA_ERROR_NOT_FOUND);
+    EXPECT_EQ(letta_memory_set_block(memory, s(""), s("x"), 10, 0), LETTA_ERROR_INVALID_ARGUMENT);
+    EXPECT_EQ(letta_memory_compile(nullptr, &out), LETTA_ERROR_INVALID_ARGUMENT);
+    letta_memory_free(memory);
+}
+
+TEST(LettaCoreTest, MessagesAndProviderAdapters) {
+    letta_messages* messages = letta_messages_new();
+    json history = json::array({
+        {{"role", "system"}, {"content", "sys"}},
+        {{"role", "user"}, {"content", "hi"}},
+        {{"role", "assistant"}, {"content", nullptr},
+         {"tool_calls", {{{"id", "call_1"}, {"type", "function"},
+                          {"function", {{"name", "send_message"}, {"arguments", "{\"message\":\"hello\"}"}}}}}}},
+        {{"role", "tool"}, {"tool_call_id", "call_1"}, {"name", "send_message"}, {"content", "{\"status\":\"OK\"}"}},
+    });
+    ASSERT_EQ(letta_messages_append_json(messages, s(history.dump())), LETTA_OK);
+    ASSERT_EQ(letta_messages_append(messages, LETTA_ROLE_USER, s("and again")), LETTA_OK);
+    EXPECT_EQ(letta_messages_size(messages), 5u);
+
+    // All or nothing
+    EXPECT_EQ(letta_messages_append_json(messages, s("[{\"role\":\"user\"},{\"role\":\"narrator\"}]")),
+              LETTA_ERROR_INVALID_ARGUMENT);
+    EXPECT_EQ(letta_messages_append_json(messages, s("[{")), LETTA_ERROR_PARSE);
+    EXPECT_EQ(letta_messages_size(messages), 5u);
+
+    letta_str out{};
+    ASSERT_EQ(letta_messages_to_json(messages, &out), LETTA_OK);
+    json round = json::parse(str(out));
+    EXPECT_EQ(round[2]["tool_calls"][0]["function"]["arguments"], "{\"message\":\"hello\"}");
+    EXPECT_EQ(round[4]["content"], "and again");
+
+    letta_client* openai = letta_client_new(s("sk-test"), s("http://localhost:8000/v1"), s("gpt-4o-mini"));
+    letta_str url{}, headers{}, body{};
+    ASSERT_EQ(letta_client_build_request(openai, messages, s(""), &url, &headers, &body), LETTA_OK);
+    EXPECT_EQ(str(url), "http://localhost:8000/v1/chat/completions");
+    EXPECT_EQ(json::parse(str(headers))["Authorization"], "Bearer sk-test");
+    json payload = json::parse(str(body));
+    EXPECT_EQ(payload["model"], "gpt-4o-mini");
+    EXPECT_EQ(payload["messages"].size(), 5u);
+    EXPECT_EQ(letta_client_build_request(openai, messages, s("{}"), &url, &headers, &body),
+              LETTA_ERROR_INVALID_ARGUMENT);
+
+    letta_client* gemini = letta_client_new(s("key"), s("https://generativelanguage.googleapis.com/v1beta"),
+                                            s("gemini-2.5-flash"));
+    std::string tools = json::array({{{"type", "function"}, {"function", {{"name", "send_message"}}}}}).dump();
+    ASSERT_EQ(letta_client_build_request(gemini, messages, s(tools), &url, &headers, &body), LETTA_OK);
+    payload = json::parse(str(body));
+    EXPECT_EQ(payload["system_instruction"]["parts"][0]["text"], "sys");
+    EXPECT_EQ(payload["contents"][1]["parts"][0]["functionCall"]["args"]["message"], "hello");
+    EXPECT_EQ(payload["tools"][0]["function_declarations"][0]["name"], "send_message");
+
+    std::string reply = R"({"candidates":[{"content":{"parts":[{"text":"hey"}]}}],
+                            "usageMetadata":{"promptTokenCount":5,"candidatesTokenCount":1,"totalTokenCount":6}})";
+    ASSERT_EQ(letta_client_parse_response(gemini, 200, s(reply), &out), LETTA_OK);
+    json normalized = json::parse(str(out));
+    EXPECT_EQ(normalized["choices"][0]["message"]["content"], "hey");
+    EXPECT_EQ(normalized["usage"]["total_tokens"], 6);
+    ASSERT_EQ(letta_client_parse_response(gemini, 503, s("busy"), &out), LETTA_OK);
+    EXPECT_EQ(json::parse(str(out))["error"], "busy");
+
+    letta_client_free(openai);
+    letta_client_free(gemini);
+    letta_messages_free(messages);
+}
+
+TEST(LettaCoreTest, AgentStepsThroughACallbackTransport) {
+    letta_agent* agent = letta_agent_new(s("key"), s(""));
+    std::vector<std::string> requests;
+    ASSERT_EQ(letta_agent_set_transport(agent, geminiStandIn, &requests), LETTA_OK);
+    ASSERT_EQ(letta_agent_set_block(agent, s("human"), s("Name: Chad"), 2000, 0), LETTA_OK);
+
+    letta_str replies{};
+    ASSERT_EQ(letta_agent_step(agent, s("hello"), &replies), LETTA_OK);
+    EXPECT_EQ(json::parse(str(replies)), json::array({"hello from the stand-in"}));
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_NE(requests[0].find("Name: Chad"), std::string::npos);
+
+    letta_str out{};
+    ASSERT_EQ(letta_agent_messages_json(agent, &out), LETTA_OK);
+    size_t history = json::parse(str(out)).size();
+    EXPECT_GE(history, 3u);
+
+    // Round trip through an agent file and a snapshot into fresh agents
+    std::string af = "/tmp/letta-core-test-" + std::to_string(getpid()) + ".af";
+    std::string snap = af + ".snap";
+    ASSERT_EQ(letta_agent_export(agent, af.c_str()), LETTA_OK);
+    ASSERT_EQ(letta_agent_save_snapshot(agent, snap.c_str()), LETTA_OK);
+    for (auto load : {letta_agent_import, letta_agent_load_snapshot}) {
+        letta_agent* copy = letta_agent_new(s("key"), s(""));
+        ASSERT_EQ(load(copy, load == letta_agent_import ? af.c_str() : snap.c_str()), LETTA_OK);
+        ASSERT_EQ(letta_agent_memory(copy, &out), LETTA_OK);
+        EXPECT_NE(str(out).find("Name: Chad"), std::string::npos);
+        ASSERT_EQ(letta_agent_messages_json(copy, &out), LETTA_OK);
+        EXPECT_EQ(json::parse(str(out)).size(), history);
+        letta_agent_free(copy);
+    }
+    EXPECT_EQ(letta_agent_import(agent, "/nonexistent.af"), LETTA_ERROR_IO);
+    std::remove(af.c_str());
+    std::remove(snap.c_str());
+    letta_agent_free(agent);
+}
@@ -0,0 +1,201 @@
+#include "McpClient.hpp"
+#include "Agent.hpp"
+#include "support/McpStandIn.hpp"
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#ifndef LETTA_MCP_STAND_IN
+#define LETTA_MCP_STAND_IN "mcp-stand-in"
+#endif
+
+namespace {
+
+McpServerConfig stdioServer() {
+    McpServerConfig config;
+    config.name = "stand-in";
+    config.command = {LETTA_MCP_STAND_IN};
+    return config;
+}
+
+std::vector<std::string> toolNames(const std::vector<json>& tools) {
+    std::vector<std::string> names;
+    for (const auto& tool : tools) names.push_back(tool["function"]["name"]);
+    return names;
+}
+
+// Serves the stand-in on a Unix socket, one connection at a time
+class SocketServer {
+public:
+    SocketServer() : path("/tmp/letta-mcp-test-" + std::to_string(getpid()) + ".sock") {
+        ::unlink(path.c_str());
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+        ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        ::listen(listener, 4);
+        thread = std::thread([this] {
+            int conn;
+            while ((conn = ::accept(listener, nullptr, nullptr)) >= 0) {
+                mcp_stand_in::serve(conn, conn);
+                ::close(conn);
+            }
+        });
+    }
+    ~SocketServer() {
+        ::shutdown(listener, SHUT_RDWR);
+        thread.join();
+        ::close(listener);
+        ::unlink(path.c_str());
+    }
+
+    std::string path;
+
+private:
+    int listener = -1;
+    std::thread thread;
+};
+
+} // namespace
+
+TEST(McpClientTest, CachesToolsAcrossPages) {
+    McpClient client(stdioServer());
+    ASSERT_TRUE(client.connect());
+    EXPECT_EQ(client.serverInfo()["name"], "stand-in");
+
+    auto tools = client.tools();
+    EXPECT_EQ(toolNames(tools), (std::vector<std::string>{"add", "sleep", "pid", "fail", "grow", "exit"}));
+    EXPECT_EQ(tools[0]["type"], "function");
+    EXPECT_EQ(tools[0]["function"]["parameters"]["properties"]["a"]["type"], "number");
+    EXPECT_FALSE(tools[0]["function"]["parameters"].contains("$schema"));
+
+    uint64_t sent = client.requests();
+    client.tools();
+    EXPECT_TRUE(client.hasTool("add"));
+    EXPECT_FALSE(client.hasTool("missing"));
+    EXPECT_EQ(client.requests(), sent); // served from the cache
+}
+
+TEST(McpClientTest, CallsToolsAndFlattensResults) {
+    McpClient client(stdioServer());
+    json sum = client.callTool("add", {{"a", 2}, {"b", 3}});
+    EXPECT_EQ(sum["status"], "OK");
+    EXPECT_EQ(sum["message"], "5");
+
+    json failed = client.callTool("fail", json::object());
+    EXPECT_EQ(failed["status"], "ERROR");
+    EXPECT_EQ(failed["message"], "it failed");
+
+    json unknown = client.callTool("missing", json::object());
+    EXPECT_EQ(unknown["status"], "ERROR");
+    EXPECT_NE(unknown["message"].get<std::string>().find("Unknown tool"), std::string::npos);
+    EXPECT_THROW(client.request("resources/list"), std::runtime_error);
+}
+
+TEST(McpClientTest, ConcurrentCallsShareOneSession) {
+    McpClient client(stdioServer());
+    std::string pid = client.callTool("pid", json::object())["message"];
+
+    // Earlier callers sleep longer, so answers arrive in reverse order
+    const int callers = 8;
+    std::vector<json> results(callers);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < callers; ++i) {
+        threads.emplace_back([&, i] {
+            results[i] = client.callTool("sleep", {{"ms", 50 * (callers - i)}});
+        });
+    }
+    for (auto& t : threads) t.join();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    for (int i = 0; i < callers; ++i) {
+        EXPECT_EQ(results[i]["message"], "slept " + std::to_string(50 * (callers - i)));
+    }
+    EXPECT_LT(elapsed, std::chrono::milliseconds(50 * callers * (callers + 1) / 2));
+    EXPECT_EQ(client.callTool("pid", json::object())["message"], pid);
+    EXPECT_EQ(client.reconnects(), 0u);
+}
+
+TEST(McpClientTest, ListChangedRefreshesTheCache) {
+    McpClient client(stdioServer());
+    EXPECT_FALSE(client.hasTool("extra"));
+    uint64_t version = client.toolsVersion();
+
+    EXPECT_EQ(client.callTool("grow", json::object())["message"], "grown");
+    for (int i = 0; i < 200 && client.toolsVersion() == version; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_GT(client.toolsVersion(), version);
+    EXPECT_TRUE(client.hasTool("extra"));
+    EXPECT_EQ(client.callTool("extra", json::object())["message"], "extra tool");
+}
+
+TEST(McpClientTest, ReconnectsAfterTheServerExits) {
+    McpClient client(stdioServer());
+    std::string first = client.callTool("pid", json::object())["message"];
+
+    json lost = client.callTool("exit", json::object());
+    EXPECT_EQ(lost["status"], "ERROR");
+    EXPECT_NE(lost["message"].get<std::string>().find("connection closed"), std::string::npos);
+
+    std::string second = client.callTool("pid", json::object())["message"];
+    EXPECT_NE(first, second);
+    EXPECT_EQ(client.reconnects(), 1u);
+}
+
+TEST(McpClientTest, TimeoutFailsOnlyThatCall) {
+    McpServerConfig config = stdioServer();
+    config.timeout = std::chrono::milliseconds(100);
+    McpClient client(config);
+    json slow = client.callTool("sleep", {{"ms", 500}});
+    EXPECT_EQ(slow["status"], "ERROR");
+    EXPECT_NE(slow["message"].get<std::string>().find("timed out"), std::string::npos);
+    EXPECT_EQ(client.callTool("add", {{"a", 1}, {"b", 1}})["message"], "2");
+    EXPECT_EQ(client.reconnects(), 0u);
+}
+
+TEST(McpClientTest, UnixSocketServer) {
+    SocketServer server;
+    McpServerConfig config;
+    config.name = "socket";
+    config.socket_path = server.path;
+    McpClient client(config);
+    EXPECT_TRUE(client.hasTool("add"));
+    EXPECT_EQ(client.callTool("add", {{"a", 40}, {"b", 2}})["message"], "42");
+
+    McpServerConfig missing;
+    missing.socket_path = "/tmp/letta-mcp-test-missing.sock";
+    McpClient unreachable(missing);
+    EXPECT_FALSE(unreachable.connect());
+    EXPECT_TRUE(unreachable.tools().empty());
+    EXPECT_EQ(unreachable.callTool("add", json::object())["status"], "ERROR");
+}
+
+TEST(McpClientTest, AgentOffersAndCallsServerTools) {
+    auto client = std::make_shared<McpClient>(stdioServer());
+    Agent agent("key");
+    agent.addMcpServer(client);
+    agent.setMessageHandler([](const std::string&) {});
+
+    std::string first_request;
+    int calls = 0;
+    agent.getLLMClient().setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        if (calls == 0) first_request = req.body;
+        json call = calls++ == 0
+            ? json{{"name", "add"}, {"args", {{"a", 20}, {"b", 22}}}}
+            : json{{"name", "send_message"}, {"args", {{"message", "42"}}}};
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+        return HttpResponse{200, body.dump(), "", {}};
+    });
+    agent.step("what is 20 + 22?");
+
+    EXPECT_NE(first_request.find("\"add\""), std::string::npos);
+    const MessageStore& history = agent.getMessages();
+    ASSERT_GE(history.size(), 4u);
+    EXPECT_EQ(history[3].toolName(), "add");
+    EXPECT_NE(history[3].content().find("42"), std::string_view::npos);
+}
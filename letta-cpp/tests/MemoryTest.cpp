@@ -1,5 +1,7 @@
 #include "Memory.hpp"
+#include "Rcu.hpp"
 #include <gtest/gtest.h>
+#include <thread>
 
 class MemoryTest : public ::testing::Test {
 protected:
@@ -66,3 +68,89 @@ TEST_F(MemoryTest, CompileContainsBlockValues) {
     EXPECT_NE(compiled.find("Chad"), std::string::npos); // Default human name
     EXPECT_NE(compiled.find("Sam"), std::string::npos); // Default persona name
 }
+
+namespace {
+
+std::shared_ptr<SharedBlock> makeShared(const std::string& label, const std::string& value, bool read_only = false) {
+    return std::make_shared<SharedBlock>(MemoryBlock{label, value, 2000, read_only});
+}
+
+} // namespace
+
+TEST_F(MemoryTest, SharedBlockUpdateVisibleToAllAttached) {
+    auto policy = makeShared("policy", "Refunds within 30 days.");
+    Memory other;
+    memory.attachShared(policy);
+    other.attachShared(policy);
+
+    uint64_t mine = memory.version();
+    uint64_t theirs = other.version();
+    ASSERT_TRUE(other.updateBlock("policy", "Refunds within 14 days."));
+
+    EXPECT_NE(memory.version(), mine);
+    EXPECT_NE(other.version(), theirs);
+    EXPECT_NE(memory.compile().find("14 days"), std::string::npos);
+    EXPECT_EQ(memory.findBlock("policy")->value, "Refunds within 14 days.");
+    // Shared blocks are not handed out for in-place mutation
+    EXPECT_EQ(memory.getBlock("policy"), nullptr);
+}
+
+TEST_F(MemoryTest, VersionStableWithoutChanges) {
+    auto policy = makeShared("policy", "v1");
+    memory.attachShared(policy);
+    uint64_t before = memory.version();
+    memory.compile();
+    memory.findBlock("policy");
+    EXPECT_EQ(memory.version(), before);
+
+    // Detaching must not make the version collide with an earlier one
+    memory.removeBlock("policy");
+    EXPECT_GT(memory.version(), before);
+    EXPECT_EQ(memory.compile().find("policy"), std::string::npos);
+}
+
+TEST_F(MemoryTest, SharedBlockEditsAreSerialised) {
+    auto log = makeShared("log", "");
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&] {
+            for (int i = 0; i < 250; ++i) log->edit([](Rope& v) { v += "x"; return true; });
+        });
+    }
+    for (auto& w : writers) w.join();
+    EXPECT_EQ(log->snapshot().value.size(), 1000u);
+    EXPECT_EQ(log->version(), 1001u);
+}
+
+TEST_F(MemoryTest, ReadOnlySharedBlockRejectsEdits) {
+    auto facts = makeShared("facts", "fixed", true);
+    memory.attachShared(facts);
+    EXPECT_EQ(memory.editBlock("facts", [](Rope&) { return true; }), BlockEdit::ReadOnly);
+    EXPECT_EQ(facts->version(), 1u);
+}
+
+TEST(RcuTest, RetiredObjectOutlivesReaders) {
+    struct Tracked {
+        std::atomic<bool>* freed;
+        ~Tracked() { freed->store(true); }
+    };
+    std::atomic<bool> freed{false};
+    std::atomic<bool> in_section{false};
+    std::atomic<bool> release{false};
+
+    std::thread reader([&] {
+        Rcu::ReadGuard guard;
+        in_section = true;
+        while (!release) std::this_thread::yield();
+    });
+    while (!in_section) std::this_thread::yield();
+
+    Rcu::retire(new Tracked{&freed});
+    Rcu::reclaim();
+    EXPECT_FALSE(freed.load());
+
+    release = true;
+    reader.join();
+    Rcu::synchronize();
+    EXPECT_TRUE(freed.load());
+}
@@ -0,0 +1,158 @@
+#include "MessageStore.hpp"
+#include "Agent.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+json assistantToolCall(const std::string& id, const std::string& name, const std::string& arguments) {
+    return {
+        {"role", "assistant"},
+        {"content", nullptr},
+        {"tool_calls", {{
+            {"id", id},
+            {"type", "function"},
+            {"function", {{"name", name}, {"arguments", arguments}}}
+        }}}
+    };
+}
+
+} // namespace
+
+TEST(MessageStoreTest, AppendsAndReadsColumns) {
+    MessageStore store;
+    store.append(MessageRole::System, "sys");
+    store.append(MessageRole::User, "hi");
+    store.appendAssistant("", {{"call_1", "send_message", "{\"message\":\"hello\"}"}});
+    store.appendToolResult("call_1", "send_message", "{\"status\":\"OK\"}");
+
+    ASSERT_EQ(store.size(), 4u);
+    EXPECT_EQ(store[0].role(), MessageRole::System);
+    EXPECT_EQ(store[1].content(), "hi");
+    EXPECT_EQ(store[1].toolCallCount(), 0u);
+    ASSERT_EQ(store[2].toolCallCount(), 1u);
+    EXPECT_EQ(store[2].toolCall(0).name, "send_message");
+    EXPECT_EQ(store[2].toolCall(0).arguments, "{\"message\":\"hello\"}");
+    EXPECT_EQ(store[3].role(), MessageRole::Tool);
+    EXPECT_EQ(store[3].toolCallId(), "call_1");
+    EXPECT_EQ(store[3].toolName(), "send_message");
+}
+
+TEST(MessageStoreTest, JsonRoundTrip) {
+    std::vector<json> messages = {
+        {{"role", "system"}, {"content", "sys"}},
+        {{"role", "user"}, {"content", "hi"}},
+        assistantToolCall("call_1", "core_memory_append", "{\"label\":\"human\",\"content\":\"x\"}"),
+        {{"role", "tool"}, {"tool_call_id", "call_1"}, {"name", "core_memory_append"}, {"content", "{}"}},
+        {{"role", "assistant"}, {"content", "plain reply"}}
+    };
+
+    MessageStore store = MessageStore::fromJson(messages);
+    ASSERT_EQ(store.size(), messages.size());
+    EXPECT_EQ(store.toJson(), json(messages));
+}
+
+TEST(MessageStoreTest, UnknownRoleIsRejected) {
+    MessageStore store;
+    EXPECT_FALSE(store.appendJson({{"role", "narrator"}, {"content", "x"}}));
+    EXPECT_TRUE(store.empty());
+}
+
+TEST(MessageStoreTest, SetContentCompactsReplacedText) {
+    MessageStore store;
+    store.append(MessageRole::System, std::string(1000, 'a'));
+    store.append(MessageRole::User, "keep me");
+    for (int i = 0; i < 100; ++i) {
+        store.setContent(0, std::string(1000, static_cast<char>('a' + i % 26)));
+    }
+    EXPECT_EQ(store[0].content(), std::string(1000, static_cast<char>('a' + 99 % 26)));
+    EXPECT_EQ(store[1].content(), "keep me");
+    // Replaced prompts are reclaimed instead of accumulating in the pool
+    EXPECT_LT(store.memoryBytes(), 8000u);
+}
+
+TEST(MessageStoreTest, InsertKeepsToolCallsAligned) {
+    MessageStore store;
+    store.append(MessageRole::User, "hi");
+    store.appendAssistant("", {{"call_1", "send_message", "{}"}});
+    store.insert(0, MessageRole::System, "sys");
+
+    EXPECT_EQ(store[0].role(), MessageRole::System);
+    EXPECT_EQ(store[0].toolCallCount(), 0u);
+    EXPECT_EQ(store[1].toolCallCount(), 0u);
+    ASSERT_EQ(store[2].toolCallCount(), 1u);
+    EXPECT_EQ(store[2].toolCall(0).id, "call_1");
+}
+
+TEST(MessageStoreTest, AgentHistoryUsesStore) {
+    Agent agent("key");
+    agent.setMessageHandler([](const std::string&) {});
+    agent.getLLMClient().setTransport([](const HttpRequest&, const std::atomic<bool>&) {
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", {{"name", "send_message"}, {"args", {{"message", "hey"}}}}}}}}}}}}}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+
+    agent.step("hello");
+
+    const MessageStore& history = agent.getMessages();
+    ASSERT_EQ(history.size(), 4u);
+    EXPECT_EQ(history[0].role(), MessageRole::System);
+    EXPECT_EQ(history[1].content(), "hello");
+    EXPECT_EQ(history[2].toolCall(0).name, "send_message");
+    EXPECT_EQ(history[3].role(), MessageRole::Tool);
+    EXPECT_NE(history[3].content().find("OK"), std::string_view::npos);
+}
+
+TEST(MessageStoreTest, ForkSharesHistoryUntilDivergence) {
+    MessageStore parent;
+    parent.append(MessageRole::System, "sys");
+    for (int i = 0; i < 100; ++i) parent.append(MessageRole::User, "message " + std::to_string(i));
+
+    MessageStore child = parent.fork();
+    EXPECT_EQ(child.size(), 101u);
+    EXPECT_EQ(parent.segmentCount(), 1u);
+    // Nothing but bookkeeping is owned until one side appends
+    EXPECT_LT(child.unsharedBytes(), 256u);
+    EXPECT_GT(child.memoryBytes(), 1000u);
+
+    parent.append(MessageRole::User, "parent only");
+    child.appendAssistant("", {{"call_1", "send_message", "{}"}});
+    child.setContent(0, "child sys");
+
+    ASSERT_EQ(parent.size(), 102u);
+    ASSERT_EQ(child.size(), 102u);
+    EXPECT_EQ(parent.back().content(), "parent only");
+    EXPECT_EQ(child.back().toolCall(0).id, "call_1");
+    EXPECT_EQ(parent[0].content(), "sys");
+    EXPECT_EQ(child[0].content(), "child sys");
+    EXPECT_EQ(child[50].content(), "message 49");
+    EXPECT_EQ(child.toJson()[0]["content"], "child sys");
+}
+
+TEST(MessageStoreTest, ForkChainsStayShallow) {
+    MessageStore store;
+    store.append(MessageRole::System, "sys");
+    for (int i = 0; i < 100; ++i) {
+        store.append(MessageRole::User, std::to_string(i));
+        store = store.fork();
+    }
+    EXPECT_LE(store.segmentCount(), 32u);
+    ASSERT_EQ(store.size(), 101u);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(store[i + 1].content(), std::to_string(i));
+    }
+}
+
+TEST(MessageStoreTest, InsertBeforeFrozenMessages) {
+    MessageStore store;
+    store.append(MessageRole::User, "hi");
+    store.appendAssistant("", {{"call_1", "send_message", "{}"}});
+    MessageStore child = store.fork();
+    child.setContent(0, "hello");
+    child.insert(0, MessageRole::System, "sys");
+
+    ASSERT_EQ(child.size(), 3u);
+    EXPECT_EQ(child[0].content(), "sys");
+    EXPECT_EQ(child[1].content(), "hello");
+    EXPECT_EQ(child[2].toolCall(0).id, "call_1");
+    EXPECT_EQ(store[0].content(), "hi");
+}
@@ -0,0 +1,83 @@
+#include "PromptTemplate.hpp"
+#include "Memory.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+std::string render(const std::string& source, const std::vector<MemoryBlock>& blocks) {
+    PromptContext context;
+    for (const auto& block : blocks) context.blocks.push_back(&block);
+    context.now = std::chrono::system_clock::from_time_t(1767225600); // 2026-01-01T00:00:00Z
+    std::string out;
+    PromptTemplate::compile(source)->render(context, out);
+    return out;
+}
+
+const std::vector<MemoryBlock> kBlocks = {
+    {"human", "Name: Chad", 2000, false},
+    {"policy", "Be kind.", 100, true},
+};
+
+} // namespace
+
+TEST(PromptTemplateTest, DefaultTemplateMatchesLegacyFormat) {
+    Memory memory;
+    memory.initializeDefault();
+    std::string expected =
+        "You are a Letta agent. You have access to a set of tools and a memory system.\n"
+        "You must use the `send_message` tool to communicate with the user.\n"
+        "You must use the `core_memory_append` or `core_memory_replace` tools to update your memory when you learn new facts.\n\n"
+        "### Memory Blocks\n"
+        "Block 'human' (46/2000 chars):\nName: Chad\nPersonality: Likes 10x vibe coding.\n\n"
+        "Block 'persona' (105/2000 chars):\nName: Sam\nRole: You are a helpful AI assistant called Sam. You are keeping track of facts in your memory.\n\n";
+    EXPECT_EQ(memory.compile(), expected);
+}
+
+TEST(PromptTemplateTest, LoopsConditionalsAndMetadata) {
+    std::string out = render(
+        "{{ block_count }} blocks, ~{{ total_tokens }} tokens, at {{ now }}\n"
+        "{%- for b in blocks %}\n"
+        "{{ loop.index }}. {{ b.label }}{% if b.read_only %} (read-only){% endif %}"
+        "{% if b.label == \"human\" %} [user]{% elif b.limit < 500 %} [small]{% else %} [other]{% endif %}"
+        ": {{ b.value }} ({{ b.tokens }}t){% if not loop.last %},{% endif %}"
+        "{%- endfor %}",
+        kBlocks);
+    EXPECT_EQ(out,
+              "2 blocks, ~5 tokens, at 2026-01-01T00:00:00Z\n"
+              "1. human [user]: Name: Chad (3t),\n"
+              "2. policy (read-only) [small]: Be kind. (2t)");
+}
+
+TEST(PromptTemplateTest, EmptyLoopAndCommentsAndTrim) {
+    EXPECT_EQ(render("a{# note #}b{% for b in blocks %}x{% endfor %}c", {}), "abc");
+    EXPECT_EQ(render("  x  {{- block_count -}}  y", {}), "  x0y");
+    EXPECT_EQ(render("{% if block_count >= 2 %}many{% else %}few{% endif %}!", kBlocks), "many!");
+}
+
+TEST(PromptTemplateTest, CompileErrorsCarryLineNumbers) {
+    auto expectError = [](const std::string& source, const std::string& fragment) {
+        try {
+            PromptTemplate::compile(source);
+            ADD_FAILURE() << "no error for " << source;
+        } catch (const TemplateError& e) {
+            EXPECT_NE(std::string(e.what()).find(fragment), std::string::npos) << e.what();
+        }
+    };
+    expectError("ok\n{{ nope }}", "line 2: unknown name 'nope'");
+    expectError("{% for b in blocks %}\n\n", "line 1: unclosed {% for %}");
+    expectError("{{ block.label }}", "unknown name");
+    expectError("{% endif %}", "without {% if %}");
+    expectError("{% for a in blocks %}{% for b in blocks %}{% endfor %}{% endfor %}", "nested loops");
+    expectError("{{ block_count", "unterminated tag");
+}
+
+TEST(PromptTemplateTest, MemoryUsesCustomTemplate) {
+    Memory memory;
+    memory.initializeDefault();
+    uint64_t before = memory.version();
+    memory.setTemplate(PromptTemplate::compile("{% for b in blocks %}[{{ b.label }}]{% endfor %}"));
+    EXPECT_NE(memory.version(), before);
+    EXPECT_EQ(memory.compile(), "[human][persona]");
+    memory.setTemplate(nullptr);
+    EXPECT_NE(memory.compile().find("### Memory Blocks"), std::string::npos);
+}
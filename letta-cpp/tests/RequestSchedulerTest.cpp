@@ -0,0 +1,135 @@
+#include "RequestScheduler.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Start `count` waiters for one agent; each records its agent id when admitted
+void spawn(std::vector<std::thread>& threads, RequestScheduler& scheduler, const std::string& model,
+           const std::string& agent, RequestPriority priority, int count,
+           std::mutex& order_mutex, std::vector<std::string>& order) {
+    for (int i = 0; i < count; ++i) {
+        threads.emplace_back([&, agent, priority] {
+            ASSERT_TRUE(scheduler.acquire(model, agent, priority, 1));
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(agent);
+        });
+    }
+}
+
+// Wait until the scheduler reports `n` queued requests
+void waitForQueued(const RequestScheduler& scheduler, size_t n) {
+    for (int i = 0; i < 2000 && scheduler.stats().queued < n; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(scheduler.stats().queued, n);
+}
+
+} // namespace
+
+TEST(RequestSchedulerTest, UnlimitedModelAdmitsImmediately) {
+    RequestScheduler scheduler;
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(scheduler.acquire("free-model", "a", RequestPriority::Interactive, 1000));
+    }
+    EXPECT_EQ(scheduler.stats().admitted_interactive, 100u);
+}
+
+TEST(RequestSchedulerTest, RequestBucketLimitsRate) {
+    RequestScheduler scheduler;
+    RateLimits limits;
+    limits.requests_per_minute = 6000; // 100 per second
+    limits.burst_fraction = 5.0 / 6000; // bucket of 5
+    scheduler.setLimits("m", limits);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 15; ++i) {
+        ASSERT_TRUE(scheduler.acquire("m", "a", RequestPriority::Interactive, 1));
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // 5 from the burst, the remaining 10 at 10ms each
+    EXPECT_GE(elapsed, std::chrono::milliseconds(90));
+    EXPECT_LT(elapsed, std::chrono::milliseconds(500));
+}
+
+TEST(RequestSchedulerTest, TokenBucketChargesEstimateAndReconciles) {
+    RequestScheduler scheduler;
+    RateLimits limits;
+    limits.tokens_per_minute = 60000; // 1000 tokens per second
+    limits.burst_fraction = 1.0 / 60; // bucket of 1000 tokens
+    scheduler.setLimits("m", limits);
+
+    ASSERT_TRUE(scheduler.acquire("m", "a", RequestPriority::Interactive, 1000));
+    // Actual usage was far below the estimate: the refund admits the next one at once
+    scheduler.reconcile("m", 1000, 100);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(scheduler.acquire("m", "a", RequestPriority::Interactive, 800));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+TEST(RequestSchedulerTest, InteractiveBeatsBatchAndAgentsShareFairly) {
+    RequestScheduler scheduler;
+    RateLimits limits;
+    limits.requests_per_minute = 600; // one every 100ms
+    limits.burst_fraction = 1.0 / 600;
+    scheduler.setLimits("m", limits);
+    ASSERT_TRUE(scheduler.acquire("m", "warmup", RequestPriority::Interactive, 1)); // drain the burst
+
+    std::mutex order_mutex;
+    std::vector<std::string> order;
+    std::vector<std::thread> threads;
+
+    spawn(threads, scheduler, "m", "batch", RequestPriority::Batch, 2, order_mutex, order);
+    waitForQueued(scheduler, 2);
+    spawn(threads, scheduler, "m", "chatty", RequestPriority::Interactive, 3, order_mutex, order);
+    waitForQueued(scheduler, 5);
+    spawn(threads, scheduler, "m", "quiet", RequestPriority::Interactive, 1, order_mutex, order);
+    waitForQueued(scheduler, 6);
+
+    for (auto& t : threads) t.join();
+
+    ASSERT_EQ(order.size(), 6u);
+    // The quiet agent is served within the first round, not after all of chatty's requests
+    auto quiet_pos = std::find(order.begin(), order.end(), "quiet") - order.begin();
+    EXPECT_LE(quiet_pos, 1);
+    // Batch work only runs once interactive traffic has drained
+    EXPECT_EQ(order[4], "batch");
+    EXPECT_EQ(order[5], "batch");
+}
+
+TEST(RequestSchedulerTest, BackoffPausesModel) {
+    RequestScheduler scheduler;
+    scheduler.backoff("m", std::chrono::milliseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(scheduler.acquire("m", "a", RequestPriority::Interactive, 1));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(90));
+    EXPECT_EQ(scheduler.stats().rate_limited, 1u);
+
+    // Other models are unaffected
+    start = std::chrono::steady_clock::now();
+    scheduler.backoff("m", std::chrono::milliseconds(1000));
+    ASSERT_TRUE(scheduler.acquire("other", "a", RequestPriority::Interactive, 1));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+TEST(RequestSchedulerTest, CancelledWaiterLeavesQueue) {
+    RequestScheduler scheduler;
+    scheduler.backoff("m", std::chrono::seconds(10));
+
+    std::atomic<bool> cancelled{false};
+    std::thread waiter([&] {
+        EXPECT_FALSE(scheduler.acquire("m", "a", RequestPriority::Interactive, 1, &cancelled));
+    });
+    waitForQueued(scheduler, 1);
+    cancelled = true;
+    waiter.join();
+
+    EXPECT_EQ(scheduler.stats().queued, 0u);
+    EXPECT_EQ(scheduler.stats().cancelled, 1u);
+}
@@ -0,0 +1,91 @@
+#include "Rope.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+TEST(RopeTest, BasicEdits) {
+    Rope rope("hello world");
+    rope.append("!");
+    rope.insert(5, ",");
+    rope.replace(7, 5, "there");
+    EXPECT_EQ(rope, "hello, there!");
+    rope.erase(5, 1);
+    EXPECT_EQ(rope.str(), "hello there!");
+    EXPECT_EQ(rope.size(), 12u);
+    EXPECT_EQ(rope.substr(6, 5), "there");
+}
+
+TEST(RopeTest, CopiesShareStructure) {
+    Rope original(std::string(100000, 'a'));
+    Rope copy = original;
+    copy.append("tail");
+    EXPECT_EQ(original.size(), 100000u);
+    EXPECT_EQ(copy.size(), 100004u);
+    EXPECT_EQ(copy.substr(99998), "aatail");
+}
+
+TEST(RopeTest, SmallAppendsMergeIntoChunks) {
+    Rope rope;
+    for (int i = 0; i < 10000; ++i) rope.append("0123456789");
+    EXPECT_EQ(rope.size(), 100000u);
+    // ~1-2 KB chunks, not one node per append
+    EXPECT_LT(rope.chunkCount(), 200u);
+    EXPECT_LE(rope.height(), 12);
+}
+
+TEST(RopeTest, FindAcrossChunkBoundaries) {
+    std::string text;
+    for (int i = 0; i < 5000; ++i) text += "line " + std::to_string(i) + "\n";
+    Rope rope;
+    // Uneven appends so chunk edges fall at arbitrary places
+    for (size_t pos = 0; pos < text.size(); pos += 37) rope.append(text.substr(pos, 37));
+
+    for (const char* needle : {"line 0\n", "line 4999\n", "\nline 2500\n", "9\nline 3", "x", "line 5000"}) {
+        EXPECT_EQ(rope.find(needle), text.find(needle)) << needle;
+    }
+    size_t first = text.find("line 1");
+    EXPECT_EQ(rope.find("line 1", first + 1), text.find("line 1", first + 1));
+    EXPECT_EQ(rope.find("", 10), 10u);
+    EXPECT_EQ(rope.find("line", text.size()), Rope::npos);
+}
+
+TEST(RopeTest, RandomEditsMatchString) {
+    std::mt19937 rng(42);
+    std::string expected;
+    Rope rope;
+    auto randomText = [&](size_t max) {
+        std::string s(rng() % max + 1, ' ');
+        for (auto& c : s) c = static_cast<char>('a' + rng() % 4);
+        return s;
+    };
+    for (int step = 0; step < 3000; ++step) {
+        size_t pos = expected.empty() ? 0 : rng() % (expected.size() + 1);
+        switch (rng() % 4) {
+            case 0: {
+                std::string t = randomText(step % 50 == 0 ? 5000 : 40);
+                expected += t;
+                rope.append(t);
+                break;
+            }
+            case 1: {
+                std::string t = randomText(40);
+                expected.insert(pos, t);
+                rope.insert(pos, t);
+                break;
+            }
+            case 2: {
+                size_t n = rng() % 60;
+                expected.erase(pos, n);
+                rope.erase(pos, n);
+                break;
+            }
+            case 3: {
+                std::string needle = randomText(6);
+                ASSERT_EQ(rope.find(needle, pos), expected.find(needle, pos));
+                break;
+            }
+        }
+        ASSERT_EQ(rope.size(), expected.size());
+    }
+    EXPECT_EQ(rope.str(), expected);
+    EXPECT_LE(rope.height(), 2 * 64);
+}
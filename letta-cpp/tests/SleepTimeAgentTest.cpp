@@ -0,0 +1,204 @@
+#include "Agent.hpp"
+#include "SleepTimeAgent.hpp"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+HttpResponse geminiCall(const std::string& name, const json& args) {
+    json call = {{"name", name}, {"args", args}};
+    json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+    return HttpResponse{200, body.dump(), "", {}};
+}
+
+// Mock sleep-time LLM: one append per run, then finish_memory_edits
+struct MockConsolidator {
+    std::mutex mutex;
+    std::vector<std::string> requests;
+    std::string label = "human";
+    std::string fact;
+
+    HttpTransport transport() {
+        return [this](const HttpRequest& req, const std::atomic<bool>&) {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(req.body);
+            bool first_round = req.body.find("functionResponse") == std::string::npos;
+            if (first_round) return geminiCall("core_memory_append", {{"label", label}, {"content", fact}});
+            return geminiCall("finish_memory_edits", json::object());
+        };
+    }
+};
+
+} // namespace
+
+class SleepTimeAgentTest : public ::testing::Test {
+protected:
+    // The agent goes first on teardown: its sleeper may still be using the mocks
+    std::vector<std::string> primary_requests;
+    MockConsolidator consolidator;
+    Agent agent{"key"};
+
+    void SetUp() override {
+        agent.setMessageHandler([](const std::string&) {});
+        agent.getLLMClient().setTransport([this](const HttpRequest& req, const std::atomic<bool>&) {
+            primary_requests.push_back(req.body);
+            return geminiCall("send_message", {{"message", "Nice to meet you!"}});
+        });
+        agent.enableSleepTime();
+        agent.getSleepTimeAgent()->getLLMClient().setTransport(consolidator.transport());
+    }
+};
+
+TEST_F(SleepTimeAgentTest, ForegroundOnlyGetsSendMessage) {
+    consolidator.fact = "unused";
+    agent.step("hello");
+    agent.getSleepTimeAgent()->waitIdle();
+
+    ASSERT_EQ(primary_requests.size(), 1u);
+    EXPECT_NE(primary_requests[0].find("send_message"), std::string::npos);
+    EXPECT_EQ(primary_requests[0].find("core_memory_append"), std::string::npos);
+    EXPECT_EQ(primary_requests[0].find("core_memory_replace"), std::string::npos);
+}
+
+TEST_F(SleepTimeAgentTest, EditsReachThePrimarysNextPrompt) {
+    consolidator.fact = "Name: Ada";
+    agent.step("Hi, I'm Ada");
+    agent.getSleepTimeAgent()->waitIdle();
+
+    EXPECT_EQ(agent.getSleepTimeAgent()->runs(), 1u);
+    EXPECT_EQ(agent.getSleepTimeAgent()->editsApplied(), 1u);
+    ASSERT_FALSE(consolidator.requests.empty());
+    EXPECT_NE(consolidator.requests[0].find("user: Hi, I'm Ada"), std::string::npos);
+    EXPECT_NE(consolidator.requests[0].find("assistant: Nice to meet you!"), std::string::npos);
+    // The second round sees its own edit in the rendered memory
+    ASSERT_EQ(consolidator.requests.size(), 2u);
+    EXPECT_NE(consolidator.requests[1].find("Name: Ada"), std::string::npos);
+
+    agent.step("what's my name?");
+    ASSERT_EQ(primary_requests.size(), 2u);
+    EXPECT_EQ(primary_requests[0].find("Name: Ada"), std::string::npos);
+    EXPECT_NE(primary_requests[1].find("Name: Ada"), std::string::npos);
+    EXPECT_NE(agent.getMemoryDump().find("Name: Ada"), std::string::npos);
+}
+
+TEST_F(SleepTimeAgentTest, EachRunSeesOnlyNewMessages) {
+    consolidator.fact = "likes tea";
+    agent.step("first turn");
+    agent.getSleepTimeAgent()->waitIdle();
+    agent.step("second turn");
+    agent.getSleepTimeAgent()->waitIdle();
+
+    ASSERT_EQ(consolidator.requests.size(), 4u);
+    const std::string& second_run = consolidator.requests[2];
+    EXPECT_NE(second_run.find("user: second turn"), std::string::npos);
+    EXPECT_EQ(second_run.find("user: first turn"), std::string::npos);
+}
+
+TEST(SleepTimeAgentStandaloneTest, WaitsForThePrimaryToGoIdle) {
+    auto human = std::make_shared<SharedBlock>(MemoryBlock{"human", "", 2000, false});
+    MockConsolidator consolidator;
+    SleepTimeAgent sleeper("primary", "key", "https://generativelanguage.googleapis.com/v1beta", "gemini-2.5-flash");
+    consolidator.fact = "prefers short answers";
+    sleeper.getLLMClient().setTransport(consolidator.transport());
+    sleeper.attachBlock(human);
+
+    MessageStore history;
+    history.append(MessageRole::System, "system prompt");
+    history.append(MessageRole::User, "keep it short please");
+
+    sleeper.primaryBusy();
+    sleeper.submit(history, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(sleeper.runs(), 0u);
+    EXPECT_EQ(human->version(), 1u);
+
+    sleeper.primaryIdle();
+    sleeper.waitIdle();
+    EXPECT_EQ(sleeper.runs(), 1u);
+    EXPECT_NE(human->snapshot().value.str().find("prefers short answers"), std::string::npos);
+    // System messages are not part of the transcript
+    EXPECT_EQ(consolidator.requests[0].find("user: system prompt"), std::string::npos);
+}
+
+TEST(SleepTimeAgentStandaloneTest, AcceptsArgumentsAsAnObject) {
+    auto human = std::make_shared<SharedBlock>(MemoryBlock{"human", "", 2000, false});
+    SleepTimeAgent sleeper("primary", "key", "http://stand-in/v1", "local-model");
+    sleeper.attachBlock(human);
+    // Some local servers send the arguments already parsed
+    sleeper.getLLMClient().setTransport([](const HttpRequest& req, const std::atomic<bool>&) {
+        bool first_round = req.body.find("\"role\":\"tool\"") == std::string::npos;
+        json call = first_round
+            ? json{{"name", "core_memory_append"}, {"arguments", {{"label", "human"}, {"content", "likes tea"}}}}
+            : json{{"name", "finish_memory_edits"}, {"arguments", json::object()}};
+        json message = {{"role", "assistant"}, {"content", nullptr},
+                        {"tool_calls", {{{"id", "call_1"}, {"type", "function"}, {"function", call}}}}};
+        return HttpResponse{200, json{{"choices", {{{"message", message}}}}}.dump(), ""};
+    });
+
+    MessageStore history;
+    history.append(MessageRole::User, "I like tea");
+    sleeper.submit(history, 0);
+    sleeper.waitIdle();
+    EXPECT_EQ(sleeper.editsApplied(), 1u);
+    EXPECT_NE(human->snapshot().value.str().find("likes tea"), std::string::npos);
+}
+
+TEST(SleepTimeAgentStandaloneTest, DestructorCancelsARunInFlight) {
+    std::atomic<int> requests{0};
+    std::atomic<bool> in_flight{false};
+    {
+        SleepTimeAgent sleeper("primary", "key", "https://generativelanguage.googleapis.com/v1beta",
+                               "gemini-2.5-flash");
+        sleeper.attachBlock(std::make_shared<SharedBlock>(MemoryBlock{"human", "", 2000, false}));
+        sleeper.getLLMClient().setTransport([&](const HttpRequest&, const std::atomic<bool>& cancelled) {
+            requests++;
+            in_flight = true;
+            while (!cancelled.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return HttpResponse{0, "", "cancelled"};
+        });
+
+        MessageStore history;
+        history.append(MessageRole::User, "remember this");
+        sleeper.submit(history, 0);
+        while (!in_flight) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // The run stopped at the cancelled request instead of taking more steps
+    EXPECT_EQ(requests.load(), 1);
+}
+
+TEST(SleepTimeAgentStandaloneTest, ReadOnlyBlocksAreNotShared) {
+    Agent agent("key");
+    agent.addMemoryBlock("policy", "Be polite.", 2000, true);
+    agent.enableSleepTime();
+    agent.getSleepTimeAgent()->getLLMClient().setTransport([](const HttpRequest&, const std::atomic<bool>&) {
+        return geminiCall("core_memory_append", {{"label", "policy"}, {"content", "Be rude."}});
+    });
+    agent.setMessageHandler([](const std::string&) {});
+    agent.getLLMClient().setTransport([](const HttpRequest&, const std::atomic<bool>&) {
+        return geminiCall("send_message", {{"message", "ok"}});
+    });
+
+    agent.step("hi");
+    agent.getSleepTimeAgent()->waitIdle();
+    EXPECT_EQ(agent.getSleepTimeAgent()->editsApplied(), 0u);
+    EXPECT_EQ(agent.getMemoryDump().find("Be rude."), std::string::npos);
+}
+
+TEST_F(SleepTimeAgentTest, RestoredBlocksStaySharedWithTheSleeper) {
+    Agent source("key");
+    source.addMemoryBlock("notes", "Restored notes.", 2000, false);
+    agent.restore(source.snapshot());
+
+    consolidator.fact = "Name: Grace";
+    agent.step("Hi, I'm Grace");
+    agent.getSleepTimeAgent()->waitIdle();
+
+    EXPECT_EQ(agent.getSleepTimeAgent()->editsApplied(), 1u);
+    std::string dump = agent.getMemoryDump();
+    EXPECT_NE(dump.find("Restored notes."), std::string::npos);
+    EXPECT_NE(dump.find("Name: Grace"), std::string::npos);
+    // The foreground still leaves memory edits to the sleeper
+    EXPECT_EQ(primary_requests.back().find("core_memory_append"), std::string::npos);
+}
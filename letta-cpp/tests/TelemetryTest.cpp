@@ -0,0 +1,175 @@
+#include "Agent.hpp"
+#include "Telemetry.hpp"
+#include "TelemetryExport.hpp"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <fstream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class TelemetryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        Telemetry::instance().drainSpans();
+        Telemetry::setEnabled(true);
+    }
+
+    void TearDown() override {
+        Telemetry::setEnabled(false);
+        Telemetry::instance().drainSpans();
+    }
+
+    static const SpanData* find(const std::vector<SpanData>& spans, const std::string& name) {
+        for (const auto& s : spans) {
+            if (s.name == name) return &s;
+        }
+        return nullptr;
+    }
+};
+
+TEST_F(TelemetryTest, DisabledSpansRecordNothing) {
+    Telemetry::setEnabled(false);
+    {
+        ScopedSpan span("noop");
+        span.setAttribute("k", "v");
+        EXPECT_FALSE(span.active());
+    }
+    EXPECT_TRUE(Telemetry::instance().drainSpans().empty());
+}
+
+TEST_F(TelemetryTest, NestedSpansShareTraceAndLinkParent) {
+    {
+        ScopedSpan outer("outer");
+        ScopedSpan inner("inner");
+        inner.setAttribute("answer", static_cast<int64_t>(42));
+    }
+    auto spans = Telemetry::instance().drainSpans();
+    ASSERT_EQ(spans.size(), 2u);
+    const SpanData* outer = find(spans, "outer");
+    const SpanData* inner = find(spans, "inner");
+    ASSERT_TRUE(outer && inner);
+    EXPECT_EQ(inner->trace_id, outer->trace_id);
+    EXPECT_EQ(inner->parent_span_id, outer->span_id);
+    EXPECT_EQ(outer->parent_span_id, 0u);
+    EXPECT_LE(inner->end_unix_nanos, outer->end_unix_nanos);
+    EXPECT_EQ(inner->attributes[0].second, "42");
+}
+
+TEST_F(TelemetryTest, PrometheusRendersCountersAndHistograms) {
+    Telemetry::instance().counter("letta_test_events_total", "Test events.", "kind=\"a\"").add(3);
+    Histogram& h = Telemetry::instance().histogram("letta_test_latency_seconds", "Test latency.", {0.1, 1});
+    h.observe(0.05);
+    h.observe(0.5);
+    h.observe(5);
+
+    std::string text = Telemetry::instance().renderPrometheus();
+    EXPECT_NE(text.find("# TYPE letta_test_events_total counter"), std::string::npos);
+    EXPECT_NE(text.find("letta_test_events_total{kind=\"a\"} 3"), std::string::npos);
+    EXPECT_NE(text.find("letta_test_latency_seconds_bucket{le=\"0.1\"} 1"), std::string::npos);
+    EXPECT_NE(text.find("letta_test_latency_seconds_bucket{le=\"1\"} 2"), std::string::npos);
+    EXPECT_NE(text.find("letta_test_latency_seconds_bucket{le=\"+Inf\"} 3"), std::string::npos);
+    EXPECT_NE(text.find("letta_test_latency_seconds_count 3"), std::string::npos);
+}
+
+TEST_F(TelemetryTest, AgentStepProducesSpanTreeAndMetrics) {
+    Agent agent("dummy_key");
+    agent.getLLMClient().setTransport([](const HttpRequest&, const std::atomic<bool>&) {
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", {{"name", "send_message"}, {"args", {{"message", "hi"}}}}}}}}}}}}},
+                     {"usageMetadata", {{"promptTokenCount", 10}, {"candidatesTokenCount", 5}, {"totalTokenCount", 15}}}};
+        return HttpResponse{200, body.dump(), ""};
+    });
+
+    double steps_before = Telemetry::metrics().steps->value();
+    double prompt_before = Telemetry::metrics().prompt_tokens->value();
+    agent.step("hello");
+
+    auto spans = Telemetry::instance().drainSpans();
+    const SpanData* step = find(spans, "agent.step");
+    const SpanData* llm = find(spans, "llm.chat_completion");
+    const SpanData* serialize = find(spans, "llm.serialize_request");
+    const SpanData* parse = find(spans, "llm.parse_response");
+    const SpanData* tool = find(spans, "agent.execute_tool");
+    ASSERT_TRUE(step && llm && serialize && parse && tool);
+    EXPECT_EQ(llm->parent_span_id, step->span_id);
+    EXPECT_EQ(serialize->parent_span_id, llm->span_id);
+    EXPECT_EQ(parse->parent_span_id, llm->span_id);
+    EXPECT_EQ(tool->parent_span_id, step->span_id);
+    EXPECT_EQ(llm->kind, 3);
+
+    EXPECT_EQ(Telemetry::metrics().steps->value(), steps_before + 1);
+    EXPECT_EQ(Telemetry::metrics().prompt_tokens->value(), prompt_before + 10);
+    EXPECT_GE(Telemetry::metrics().tool_calls_per_step->count(), 1u);
+}
+
+TEST_F(TelemetryTest, OtlpJsonShape) {
+    { ScopedSpan span("otlp.test"); }
+    auto spans = Telemetry::instance().drainSpans();
+    json doc = json::parse(toOtlpJson(spans, "svc"));
+
+    auto& resource = doc["resourceSpans"][0];
+    EXPECT_EQ(resource["resource"]["attributes"][0]["value"]["stringValue"], "svc");
+    auto& span = resource["scopeSpans"][0]["spans"][0];
+    EXPECT_EQ(span["name"], "otlp.test");
+    EXPECT_EQ(span["traceId"].get<std::string>().size(), 32u);
+    EXPECT_EQ(span["spanId"].get<std::string>().size(), 16u);
+    EXPECT_TRUE(span["startTimeUnixNano"].is_string());
+}
+
+TEST_F(TelemetryTest, OtlpExporterPostsToCollector) {
+    HttpRequest seen;
+    OtlpExporterOptions options;
+    OtlpExporter exporter(options, [&](const HttpRequest& req, const std::atomic<bool>&) {
+        seen = req;
+        return HttpResponse{200, "{}", ""};
+    });
+
+    { ScopedSpan span("exported"); }
+    EXPECT_EQ(exporter.flush(), 1u);
+    EXPECT_EQ(seen.url, "http://localhost:4318/v1/traces");
+    EXPECT_NE(seen.body.find("\"exported\""), std::string::npos);
+}
+
+TEST_F(TelemetryTest, OtlpExporterAppendsToFile) {
+    std::string path = ::testing::TempDir() + "letta_otlp_test.jsonl";
+    std::remove(path.c_str());
+    OtlpExporterOptions options;
+    options.file_path = path;
+    OtlpExporter exporter(options);
+
+    { ScopedSpan span("to.file"); }
+    EXPECT_EQ(exporter.flush(), 1u);
+
+    std::ifstream in(path);
+    std::string line;
+    ASSERT_TRUE(std::getline(in, line));
+    EXPECT_EQ(json::parse(line)["resourceSpans"][0]["scopeSpans"][0]["spans"][0]["name"], "to.file");
+    std::remove(path.c_str());
+}
+
+TEST_F(TelemetryTest, PrometheusEndpointServesMetrics) {
+    PrometheusEndpoint endpoint;
+    ASSERT_TRUE(endpoint.start(0));
+    ASSERT_GT(endpoint.port(), 0);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(endpoint.port()));
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+
+    std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(::send(fd, request.data(), request.size(), 0), static_cast<ssize_t>(request.size()));
+
+    std::string response;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) response.append(buffer, n);
+    ::close(fd);
+    endpoint.stop();
+
+    EXPECT_EQ(response.rfind("HTTP/1.1 200 OK", 0), 0u);
+    EXPECT_NE(response.find("letta_agent_step_duration_seconds_bucket"), std::string::npos);
+}
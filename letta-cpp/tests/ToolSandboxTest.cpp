@@ -0,0 +1,203 @@
+#include "ToolSandbox.hpp"
+#include "Agent.hpp"
+#include <gtest/gtest.h>
+#include <csignal>
+#include <fstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+json functionSchema(const std::string& name) {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", name},
+            {"description", "Test tool " + name},
+            {"parameters", {{"type", "object"}, {"properties", json::object()}}}
+        }}
+    };
+}
+
+std::shared_ptr<ToolSandbox> makeSandbox(SandboxOptions options = {}) {
+    auto sandbox = std::make_shared<ToolSandbox>(options);
+    sandbox->registerTool(functionSchema("whoami"), [](const json&) {
+        return json{{"pid", getpid()}};
+    });
+    sandbox->registerTool(functionSchema("echo"), [](const json& args) {
+        return json{{"text", args.value("text", "")}, {"length", args.value("text", "").size()}};
+    });
+    sandbox->registerTool(functionSchema("crash"), [](const json&) -> json {
+        std::raise(SIGSEGV);
+        return nullptr;
+    });
+    sandbox->registerTool(functionSchema("spin"), [](const json&) -> json {
+        volatile uint64_t x = 0;
+        while (true) x = x + 1;
+    });
+    sandbox->registerTool(functionSchema("hog"), [](const json&) {
+        std::vector<std::string> chunks;
+        for (int i = 0; i < 64; ++i) chunks.emplace_back(64u << 20, 'x');
+        return json{{"allocated", chunks.size()}};
+    });
+    sandbox->registerTool(functionSchema("network"), [](const json&) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        return json{{"fd", fd}};
+    });
+    sandbox->registerTool(functionSchema("throws"), [](const json&) -> json {
+        throw std::runtime_error("bad input");
+    });
+    sandbox->registerTool(functionSchema("forge"), [](const json&) -> json {
+        // A compromised worker announcing a 1 TiB inline result on its socket
+        struct { uint32_t frame, tool; uint64_t length; } header{1, 0, 1ull << 40};
+        if (write(3, &header, sizeof(header)) != sizeof(header)) return nullptr;
+        while (true) sleep(1);
+    });
+    sandbox->start();
+    return sandbox;
+}
+
+} // namespace
+
+TEST(ToolSandboxTest, RunsToolsInWorkerProcesses) {
+    auto sandbox = makeSandbox();
+    json result = sandbox->execute("whoami", json::object());
+    ASSERT_TRUE(result.contains("pid"));
+    EXPECT_NE(result["pid"].get<int>(), getpid());
+    EXPECT_EQ(sandbox->execute("echo", {{"text", "hi"}})["text"], "hi");
+    EXPECT_EQ(sandbox->execute("missing", json::object())["status"], "ERROR");
+}
+
+TEST(ToolSandboxTest, WorkersComeFromTheZygoteAfterStart) {
+    ToolSandbox sandbox;
+    sandbox.registerTool(functionSchema("whoami"), [](const json&) {
+        return json{{"pid", getpid()}};
+    });
+    json early = sandbox.execute("whoami", json::object());
+    EXPECT_EQ(early["status"], "ERROR");
+    EXPECT_NE(early["message"].get<std::string>().find("not started"), std::string::npos);
+
+    sandbox.start();
+    json result = sandbox.execute("whoami", json::object());
+    ASSERT_TRUE(result.contains("pid"));
+    std::ifstream status("/proc/" + std::to_string(result["pid"].get<int>()) + "/status");
+    std::string line;
+    int parent = 0;
+    while (std::getline(status, line)) {
+        if (line.rfind("PPid:", 0) == 0) parent = std::stoi(line.substr(5));
+    }
+    EXPECT_GT(parent, 0);
+    EXPECT_NE(parent, getpid()); // the zygote's child, not ours
+}
+
+TEST(ToolSandboxTest, WorkersAreReused) {
+    SandboxOptions options;
+    options.workers = 1;
+    auto sandbox = makeSandbox(options);
+    int first = sandbox->execute("whoami", json::object())["pid"];
+    int second = sandbox->execute("whoami", json::object())["pid"];
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(sandbox->calls(), 2u);
+}
+
+TEST(ToolSandboxTest, LargePayloadsUseTheArenaOrFallBackInline) {
+    SandboxOptions options;
+    options.arena_bytes = 1 << 20;
+    auto sandbox = makeSandbox(options);
+    std::string fits(256 * 1024, 'a');
+    std::string too_big(3 << 20, 'b');
+
+    json small = sandbox->execute("echo", {{"text", fits}});
+    EXPECT_EQ(small["length"], fits.size());
+    EXPECT_EQ(small["text"], fits);
+    json big = sandbox->execute("echo", {{"text", too_big}});
+    EXPECT_EQ(big["length"], too_big.size());
+    EXPECT_EQ(big["text"].get_ref<const std::string&>().size(), too_big.size());
+}
+
+TEST(ToolSandboxTest, CrashedWorkerIsReplaced) {
+    SandboxOptions options;
+    options.workers = 1;
+    auto sandbox = makeSandbox(options);
+    int before = sandbox->execute("whoami", json::object())["pid"];
+
+    json crashed = sandbox->execute("crash", json::object());
+    EXPECT_EQ(crashed["status"], "ERROR");
+    EXPECT_NE(crashed["message"].get<std::string>().find("signal " + std::to_string(SIGSEGV)), std::string::npos);
+    EXPECT_EQ(sandbox->restarts(), 1u);
+
+    int after = sandbox->execute("whoami", json::object())["pid"];
+    EXPECT_NE(before, after);
+}
+
+TEST(ToolSandboxTest, EnforcesTimeoutMemoryAndSyscallLimits) {
+    SandboxOptions options;
+    options.workers = 1;
+    options.limits.memory_bytes = 128u << 20;
+    options.limits.timeout = std::chrono::milliseconds(300);
+    auto sandbox = makeSandbox(options);
+    sandbox->execute("whoami", json::object());
+
+    json spun = sandbox->execute("spin", json::object());
+    EXPECT_NE(spun["message"].get<std::string>().find("timed out"), std::string::npos);
+
+    json hog = sandbox->execute("hog", json::object());
+    EXPECT_EQ(hog["status"], "ERROR");
+    EXPECT_NE(hog["message"].get<std::string>().find("memory"), std::string::npos);
+
+    json network = sandbox->execute("network", json::object());
+    EXPECT_EQ(network["status"], "ERROR");
+    EXPECT_NE(network["message"].get<std::string>().find("disallowed system call"), std::string::npos);
+
+    EXPECT_NE(sandbox->execute("throws", json::object())["message"].get<std::string>().find("bad input"),
+              std::string::npos);
+    EXPECT_EQ(sandbox->execute("echo", {{"text", "still alive"}})["text"], "still alive");
+}
+
+TEST(ToolSandboxTest, OversizedResultRecyclesTheWorker) {
+    SandboxOptions options;
+    options.workers = 1;
+    auto sandbox = makeSandbox(options);
+    int before = sandbox->execute("whoami", json::object())["pid"];
+
+    json forged = sandbox->execute("forge", json::object());
+    EXPECT_EQ(forged["status"], "ERROR");
+    EXPECT_NE(forged["message"].get<std::string>().find("oversized"), std::string::npos);
+    EXPECT_EQ(sandbox->restarts(), 1u);
+    EXPECT_NE(sandbox->execute("whoami", json::object())["pid"], before);
+}
+
+TEST(ToolSandboxTest, ForkPerCallMode) {
+    SandboxOptions options;
+    options.workers = 0;
+    auto sandbox = makeSandbox(options);
+    int first = sandbox->execute("whoami", json::object())["pid"];
+    int second = sandbox->execute("whoami", json::object())["pid"];
+    EXPECT_NE(first, second);
+    EXPECT_EQ(sandbox->execute("echo", {{"text", "x"}})["text"], "x");
+}
+
+TEST(ToolSandboxTest, AgentDispatchesCustomTools) {
+    auto sandbox = makeSandbox();
+    Agent agent("key");
+    agent.setToolSandbox(sandbox);
+    agent.setMessageHandler([](const std::string&) {});
+
+    std::string first_request;
+    int calls = 0;
+    agent.getLLMClient().setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        if (calls == 0) first_request = req.body;
+        json call = calls++ == 0
+            ? json{{"name", "echo"}, {"args", {{"text", "from the sandbox"}}}}
+            : json{{"name", "send_message"}, {"args", {{"message", "done"}}}};
+        json body = {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+        return HttpResponse{200, body.dump(), "", {}};
+    });
+    agent.step("echo something");
+
+    EXPECT_NE(first_request.find("\"echo\""), std::string::npos);
+    const MessageStore& history = agent.getMessages();
+    ASSERT_GE(history.size(), 4u);
+    EXPECT_EQ(history[3].toolName(), "echo");
+    EXPECT_NE(history[3].content().find("from the sandbox"), std::string_view::npos);
+}
@@ -0,0 +1,233 @@
+#include "Agent.hpp"
+#include "Tools.hpp"
+#include "ToolSchema.hpp"
+#include <gtest/gtest.h>
+#include <regex>
+#include <set>
+
+namespace {
+
+ToolSchema schemaOf(const json& tool) {
+    return ToolSchema::compile(tool["function"]["parameters"]);
+}
+
+// Every rule a GBNF grammar references is defined, and only once
+void expectWellFormedGbnf(const std::string& grammar) {
+    std::set<std::string> defined, referenced;
+    size_t start = 0;
+    while (start < grammar.size()) {
+        size_t end = grammar.find('\n', start);
+        std::string line = grammar.substr(start, end - start);
+        start = end + 1;
+        size_t arrow = line.find(" ::= ");
+        ASSERT_NE(arrow, std::string::npos) << line;
+        EXPECT_TRUE(defined.insert(line.substr(0, arrow)).second) << "redefined: " << line;
+        for (size_t i = arrow + 5; i < line.size(); ++i) {
+            char c = line[i];
+            if (c == '"' || c == '[' || c == '{') {
+                char close = c == '"' ? '"' : c == '[' ? ']' : '}';
+                for (++i; i < line.size() && line[i] != close; ++i) {
+                    if (line[i] == '\\') ++i;
+                }
+            } else if (std::isalnum(static_cast<unsigned char>(c))) {
+                size_t j = i;
+                while (j < line.size() && (std::isalnum(static_cast<unsigned char>(line[j])) || line[j] == '-')) ++j;
+                referenced.insert(line.substr(i, j - i));
+                i = j - 1;
+            }
+        }
+    }
+    for (const auto& name : referenced) EXPECT_TRUE(defined.count(name)) << "undefined rule: " << name;
+}
+
+json geminiCall(const std::string& name, const json& args) {
+    json call = {{"name", name}, {"args", args}};
+    return {{"candidates", {{{"content", {{"parts", {{{"functionCall", call}}}}}}}}}};
+}
+
+} // namespace
+
+TEST(ToolSchemaTest, ValidatesMemoryToolArguments) {
+    ToolSchema replace = schemaOf(Tools::core_memory_replace);
+    std::string error;
+    EXPECT_TRUE(replace.validate(R"({"label":"human","old_content":"a","new_content":"b"})"));
+    EXPECT_TRUE(replace.validate(" {\"new_content\" : \"b\",\n \"label\":\"h\\u00e9\", \"old_content\":\"\"} "));
+
+    EXPECT_FALSE(replace.validate(R"({"label":"human","old_content":"a"})", &error));
+    EXPECT_NE(error.find("missing required property 'new_content' at $"), std::string::npos) << error;
+    EXPECT_FALSE(replace.validate(R"({"label":3,"old_content":"a","new_content":"b"})", &error));
+    EXPECT_NE(error.find("expected string at $.label, got number"), std::string::npos) << error;
+    EXPECT_FALSE(replace.validate(R"({"label":"human",)", &error));
+    EXPECT_NE(error.find("incomplete"), std::string::npos) << error;
+    EXPECT_FALSE(replace.validate(R"({"label":"human","old_content":"a","new_content":"b"}})", &error));
+    EXPECT_FALSE(replace.validate(R"(["human"])", &error));
+    EXPECT_FALSE(replace.validate("{\"label\":\"a\tb\",\"old_content\":\"a\",\"new_content\":\"b\"}"));
+    EXPECT_FALSE(replace.validate("{\"label\":\"\xff\",\"old_content\":\"a\",\"new_content\":\"b\"}"));
+
+    // Tools with no parameters take an empty object; extra members are allowed
+    ToolSchema finish = schemaOf(Tools::finish_memory_edits);
+    EXPECT_TRUE(finish.validate("{}"));
+    EXPECT_TRUE(finish.validate(R"({"why":[1,{"a":null}]})"));
+    EXPECT_FALSE(finish.validate("null"));
+
+    EXPECT_THROW(ToolSchema::compile({{"type", "text"}}), SchemaError);
+    EXPECT_THROW(ToolSchema::compile({{"type", "object"}, {"properties", json::array()}}), SchemaError);
+}
+
+TEST(ToolSchemaTest, StreamedArgumentsFailAtTheFirstBadByte) {
+    ToolSchema schema = ToolSchema::compile(R"({
+        "type": "object",
+        "properties": {
+            "label": {"type": "string", "enum": ["human", "persona"]},
+            "limit": {"type": "integer"},
+            "tags": {"type": "array", "items": {"type": "string"}},
+            "ratio": {"type": ["number", "null"]}
+        },
+        "required": ["label"],
+        "additionalProperties": false
+    })"_json);
+
+    std::vector<std::pair<std::string, bool>> cases = {
+        {R"({"label":"human","limit":-12,"tags":["a","b\n"],"ratio":1.5e-3})", true},
+        {R"({"label":"persona","ratio":null})", true},
+        {R"({"label":"humans"})", false},
+        {R"({"label":"human","limit":1.5})", false},
+        {R"({"label":"human","limit":012})", false},
+        {R"({"label":"human","tags":["a",2]})", false},
+        {R"({"label":"human","colour":"red"})", false},
+        {R"({"limit":1})", false},
+    };
+    for (const auto& [text, valid] : cases) {
+        // Same verdict whether the document arrives whole or a byte at a time
+        EXPECT_EQ(schema.validate(text), valid) << text;
+        ArgumentValidator streamed(schema);
+        for (char c : text) streamed.feed(std::string_view(&c, 1));
+        EXPECT_EQ(streamed.finish(), valid) << text;
+    }
+
+    // Rejected at the byte that rules out every allowed value or name
+    ArgumentValidator validator(schema);
+    EXPECT_TRUE(validator.feed(R"({"label":"hu)"));
+    EXPECT_FALSE(validator.feed(R"(x)"));
+    EXPECT_EQ(validator.offset(), 12u);
+    EXPECT_NE(validator.error().find("$.label"), std::string::npos) << validator.error();
+    EXPECT_FALSE(validator.feed(R"(man"})"));
+
+    validator.reset();
+    EXPECT_TRUE(validator.feed(R"({"label":"human","ta)"));
+    EXPECT_FALSE(validator.feed("x"));
+    EXPECT_NE(validator.error().find("unknown property 'tax"), std::string::npos) << validator.error();
+
+    validator.reset();
+    EXPECT_FALSE(validator.feed(R"({"label":"human","limit":3.)"));
+    EXPECT_NE(validator.error().find("expected integer at $.limit"), std::string::npos) << validator.error();
+
+    // Nesting is bounded
+    ArgumentValidator deep(ToolSchema{});
+    EXPECT_FALSE(deep.feed(std::string(ArgumentValidator::kMaxDepth + 1, '[')));
+}
+
+TEST(ToolSchemaTest, EmitsGrammarsForLocalBackends) {
+    ToolSchemas schemas(Tools::get_all_tools());
+    ASSERT_EQ(schemas.size(), 3u);
+    ASSERT_NE(schemas.find("core_memory_append"), nullptr);
+    EXPECT_EQ(schemas.find("missing"), nullptr);
+
+    std::string grammar = schemas.gbnf();
+    expectWellFormedGbnf(grammar);
+    EXPECT_EQ(grammar.rfind("root ::= ", 0), 0u) << grammar;
+    EXPECT_NE(grammar.find("core-memory-replace-args ::= \"{\" ws \"\\\"label\\\"\" ws \":\" ws string ws"),
+              std::string::npos) << grammar;
+    expectWellFormedGbnf(ToolSchema::compile(R"({"properties": {"a": {"type": "integer"},
+        "b": {"type": "array", "items": {"enum": ["x", 1]}}, "c": {"type": "object"}}})"_json).gbnf("opts"));
+
+    // The regex admits exactly the envelope of a valid call
+    std::regex call(schemas.regex());
+    EXPECT_TRUE(std::regex_match(R"({"name":"send_message","arguments":{"message":"hi \"there\""}})", call));
+    EXPECT_TRUE(std::regex_match("{\"name\": \"core_memory_append\", \"arguments\": {\"label\": \"human\", "
+                                 "\"content\": \"likes tea\"}}", call));
+    EXPECT_FALSE(std::regex_match(R"({"name":"core_memory_append","arguments":{"label":"human"}})", call));
+    EXPECT_FALSE(std::regex_match(R"({"name":"rm_rf","arguments":{}})", call));
+
+    std::regex optional(ToolSchema::compile(R"({"properties": {"a": {"type": "integer"},
+        "b": {"type": "boolean"}}})"_json).regex());
+    for (const char* text : {"{}", R"({"a":1})", R"({"b":true})", R"({"a":1,"b":false})"}) {
+        EXPECT_TRUE(std::regex_match(text, optional)) << text;
+    }
+    EXPECT_FALSE(std::regex_match(R"({"a":1.5})", optional));
+}
+
+TEST(ToolSchemaTest, AgentReturnsSchemaErrorsToTheModel) {
+    Agent agent("key");
+    std::vector<std::string> said;
+    agent.setMessageHandler([&](const std::string& text) { said.push_back(text); });
+    int calls = 0;
+    agent.getLLMClient().setTransport([&](const HttpRequest&, const std::atomic<bool>&) {
+        json body = calls++ == 0 ? geminiCall("send_message", {{"text", "hi"}})
+                                 : geminiCall("send_message", {{"message", "hi"}});
+        return HttpResponse{200, body.dump(), ""};
+    });
+
+    // The malformed call neither throws nor reaches the user; the model retries
+    EXPECT_TRUE(agent.step("hello"));
+    EXPECT_EQ(calls, 2);
+    ASSERT_EQ(said, std::vector<std::string>{"hi"});
+    const MessageStore& history = agent.getMessages();
+    bool reported = false;
+    for (size_t i = 0; i < history.size(); ++i) {
+        if (history[i].role() != MessageRole::Tool) continue;
+        json result = json::parse(history[i].content());
+        if (result["status"] == "ERROR") {
+            reported = true;
+            EXPECT_NE(result["message"].get<std::string>().find("missing required property 'message'"),
+                      std::string::npos);
+        }
+    }
+    EXPECT_TRUE(reported);
+}
+
+TEST(ToolSchemaTest, GuidedDecodingAgainstALocalStandIn) {
+    std::vector<json> tools = Tools::get_all_tools();
+    const std::string reply = R"({"name": "core_memory_append", "arguments": {"label": "human", "content": "x"}})";
+
+    // llama.cpp server: a GBNF "grammar" and no "tools"; the call comes back as content
+    LLMClient llama("sk-local", "http://localhost:8080/v1", "qwen2.5-7b-instruct");
+    llama.setGuidedDecoding({GuidedDecoding::Format::Gbnf, "grammar", false});
+    json sent;
+    llama.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        sent = json::parse(req.body);
+        json message = {{"role", "assistant"}, {"content", reply}};
+        return HttpResponse{200, json{{"choices", {{{"message", message}}}}}.dump(), ""};
+    });
+    RequestScheduler scheduler;
+    llama.setScheduler(scheduler);
+    json response = llama.chatCompletion(std::vector<json>{{{"role", "user"}, {"content", "hi"}}}, tools);
+    EXPECT_FALSE(sent.contains("tools"));
+    ASSERT_TRUE(sent.contains("grammar"));
+    EXPECT_EQ(sent["grammar"], ToolSchemas(tools).gbnf());
+    const json& message = response["choices"][0]["message"];
+    ASSERT_TRUE(message.contains("tool_calls")) << response.dump();
+    EXPECT_EQ(message["tool_calls"][0]["function"]["name"], "core_memory_append");
+    EXPECT_EQ(json::parse(message["tool_calls"][0]["function"]["arguments"].get<std::string>())["content"], "x");
+
+    // Each lifted call gets its own id; the cached grammar follows the tool list
+    json again = llama.chatCompletion(std::vector<json>{{{"role", "user"}, {"content", "hi"}}}, tools);
+    EXPECT_NE(again["choices"][0]["message"]["tool_calls"][0]["id"], message["tool_calls"][0]["id"]);
+    std::vector<json> fewer(tools.begin(), tools.begin() + 1);
+    llama.chatCompletion(std::vector<json>{{{"role", "user"}, {"content", "hi"}}}, fewer);
+    EXPECT_EQ(sent["grammar"], ToolSchemas(fewer).gbnf());
+
+    // vLLM: "guided_regex" next to the tools, and the reply matches it
+    LLMClient vllm("sk-local", "http://localhost:8000/v1", "llama-3.1-8b");
+    vllm.setGuidedDecoding({GuidedDecoding::Format::Regex, "guided_regex", true});
+    vllm.setScheduler(scheduler);
+    vllm.setTransport([&](const HttpRequest& req, const std::atomic<bool>&) {
+        sent = json::parse(req.body);
+        json message = {{"role", "assistant"}, {"content", "plain text"}};
+        return HttpResponse{200, json{{"choices", {{{"message", message}}}}}.dump(), ""};
+    });
+    response = vllm.chatCompletion(std::vector<json>{{{"role", "user"}, {"content", "hi"}}}, tools);
+    EXPECT_EQ(sent["tools"].size(), tools.size());
+    EXPECT_TRUE(std::regex_match(reply, std::regex(sent["guided_regex"].get<std::string>())));
+    EXPECT_EQ(response["choices"][0]["message"]["content"], "plain text");
+}
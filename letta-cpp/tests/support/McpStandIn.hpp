@@ -0,0 +1,135 @@
+#pragma once
+
+// A small MCP server for tests and benchmarks: newline-delimited JSON-RPC on
+// a pair of fds, tools/call handled on its own thread so answers can come
+// back out of order. Tools:
+//   add {a, b}   -> the sum
+//   sleep {ms}   -> "slept <ms>" after sleeping
+//   pid          -> the server's process id
+//   fail         -> an isError result
+//   grow         -> adds the tool "extra" and sends tools/list_changed
+//   exit         -> drops the connection without answering
+// tools/list is served two tools per page to exercise cursors.
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace mcp_stand_in {
+
+using json = nlohmann::json;
+
+inline json tool(const std::string& name, json properties = json::object()) {
+    return {{"name", name},
+            {"description", "Stand-in tool " + name},
+            {"inputSchema", {{"$schema", "http://json-schema.org/draft-07/schema#"},
+                             {"type", "object"}, {"properties", std::move(properties)}}}};
+}
+
+inline json textResult(const std::string& text, bool error = false) {
+    return {{"content", {{{"type", "text"}, {"text", text}}}}, {"isError", error}};
+}
+
+// Serve one connection until EOF or the exit tool
+inline void serve(int in_fd, int out_fd) {
+    std::mutex write_mutex;
+    auto send = [&](const json& message) {
+        std::string line = message.dump() + "\n";
+        std::lock_guard<std::mutex> lock(write_mutex);
+        for (size_t off = 0; off < line.size();) {
+            ssize_t n = ::send(out_fd, line.data() + off, line.size() - off, MSG_NOSIGNAL);
+            if (n <= 0 && (n = ::write(out_fd, line.data() + off, line.size() - off)) <= 0) return;
+            off += static_cast<size_t>(n);
+        }
+    };
+
+    std::mutex tools_mutex;
+    std::vector<json> tools = {
+        tool("add", {{"a", {{"type", "number"}}}, {"b", {{"type", "number"}}}}),
+        tool("sleep", {{"ms", {{"type", "integer"}}}}),
+        tool("pid"),
+        tool("fail"),
+        tool("grow"),
+        tool("exit"),
+    };
+
+    std::vector<std::thread> calls;
+    std::atomic<bool> exiting{false};
+
+    auto call = [&](json id, std::string name, json args) {
+        json result;
+        if (name == "add") {
+            result = textResult(std::to_string(args.value("a", 0) + args.value("b", 0)));
+        } else if (name == "sleep") {
+            int ms = args.value("ms", 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            result = textResult("slept " + std::to_string(ms));
+        } else if (name == "pid") {
+            result = textResult(std::to_string(::getpid()));
+        } else if (name == "fail") {
+            result = textResult("it failed", true);
+        } else if (name == "grow") {
+            {
+                std::lock_guard<std::mutex> lock(tools_mutex);
+                tools.push_back(tool("extra"));
+            }
+            send({{"jsonrpc", "2.0"}, {"method", "notifications/tools/list_changed"}});
+            result = textResult("grown");
+        } else if (name == "extra") {
+            result = textResult("extra tool");
+        } else {
+            send({{"jsonrpc", "2.0"}, {"id", id}, {"error", {{"code", -32602}, {"message", "Unknown tool: " + name}}}});
+            return;
+        }
+        send({{"jsonrpc", "2.0"}, {"id", id}, {"result", result}});
+    };
+
+    std::string buffer;
+    char chunk[65536];
+    while (!exiting) {
+        ssize_t n = ::read(in_fd, chunk, sizeof(chunk));
+        if (n <= 0) break;
+        buffer.append(chunk, static_cast<size_t>(n));
+        size_t start = 0;
+        for (size_t nl; !exiting && (nl = buffer.find('\n', start)) != std::string::npos; start = nl + 1) {
+            json message = json::parse(buffer.begin() + start, buffer.begin() + nl, nullptr, false);
+            if (message.is_discarded() || !message.contains("id") || !message.contains("method")) continue;
+            const std::string method = message["method"];
+            json params = message.value("params", json::object());
+            json id = message["id"];
+
+            if (method == "initialize") {
+                send({{"jsonrpc", "2.0"}, {"id", id}, {"result", {
+                    {"protocolVersion", params.value("protocolVersion", "")},
+                    {"capabilities", {{"tools", {{"listChanged", true}}}}},
+                    {"serverInfo", {{"name", "stand-in"}, {"version", "1.0"}}}}}});
+            } else if (method == "tools/list") {
+                size_t begin = params.contains("cursor") ? std::stoul(params["cursor"].get<std::string>()) : 0;
+                json page = {{"tools", json::array()}};
+                std::lock_guard<std::mutex> lock(tools_mutex);
+                for (size_t i = begin; i < tools.size() && i < begin + 2; ++i) page["tools"].push_back(tools[i]);
+                if (begin + 2 < tools.size()) page["nextCursor"] = std::to_string(begin + 2);
+                send({{"jsonrpc", "2.0"}, {"id", id}, {"result", page}});
+            } else if (method == "tools/call") {
+                std::string name = params.value("name", "");
+                if (name == "exit") {
+                    exiting = true;
+                    break;
+                }
+                calls.emplace_back(call, id, name, params.value("arguments", json::object()));
+            } else {
+                send({{"jsonrpc", "2.0"}, {"id", id}, {"error", {{"code", -32601}, {"message", "Method not found"}}}});
+            }
+        }
+        buffer.erase(0, std::min(start, buffer.size()));
+    }
+    if (exiting) ::shutdown(out_fd, SHUT_RDWR);
+    for (auto& t : calls) t.join();
+}
+
+} // namespace mcp_stand_in
@@ -0,0 +1,7 @@
+// Stand-in MCP server over stdio, for McpClientTest and McpBench
+#include "McpStandIn.hpp"
+
+int main() {
+    mcp_stand_in::serve(0, 1);
+    return 0;
+}